@@ -0,0 +1,441 @@
+#include "dbBackend.h"
+#include "../esys/esysControl.h"
+
+namespace ems {
+
+	std::unique_ptr<dbBackend> dbBackend::create(bool bootstrap) {
+		if (fakeStore::enabled()) return std::make_unique<fakeBackend>();
+		return std::make_unique<mysqlBackend>(bootstrap);
+	}
+
+	mysqlBackend::mysqlBackend(bool bootstrap) : bootstrap(bootstrap)
+	{
+		esysControl& esys = esysControl::getInstance();
+		url = esys.getConfig("db_url");
+		user = esys.getConfig("db_user");
+		password = esys.getConfig("db_password");
+		schema = esys.getConfig("db_schema");
+		build_file_location = esys.getConfig("db_build_file_location");
+		migration_dir = esys.getConfig("db_migration_dir");
+	}
+
+	void mysqlBackend::executeSQL(const std::string& sql) {
+		std::unique_ptr<sql::Statement> stmt(con->createStatement());
+		stmt->execute(sql);
+	}
+
+	void mysqlBackend::executeSQLFile(const std::string& path) {
+		std::ifstream file(path);
+		if (!file.is_open()) {
+			throw std::runtime_error("Failed to open SQL file: " + path + " Please make sure the create table file exist.");
+		}
+
+		// жȡ "--" ͷע
+		std::string sql;
+		std::string line;
+		while (std::getline(file, line)) {
+			if (trim(line).rfind("--", 0) == 0) continue;
+			sql += line + "\n";
+		}
+		file.close();
+
+		// SQL";"ָΪ
+		std::istringstream sqlCommands(sql);
+		std::string singleSQL;
+		while (std::getline(sqlCommands, singleSQL, ';')) {
+			singleSQL = trim(singleSQL); // ȥǰĿհַ
+			if (!singleSQL.empty()) {
+				executeSQL(singleSQL + ";");  // ִеSQL
+			}
+		}
+	}
+
+	int mysqlBackend::runMigrations() {
+		// ¼ӦǨư汾ı
+		executeSQL("CREATE TABLE IF NOT EXISTS schema_version("
+			"version INT PRIMARY KEY COMMENT 'Ǩư汾', "
+			"description VARCHAR(150) COMMENT 'Ǩ˵', "
+			"applied_at DATETIME COMMENT 'Ӧʱ')");
+
+		int current_version = 0;
+		{
+			std::unique_ptr<sql::Statement> stmt(con->createStatement());
+			std::unique_ptr<sql::ResultSet> res(stmt->executeQuery("SELECT MAX(version) FROM schema_version"));
+			if (res->next() && !res->isNull(1)) {
+				current_version = res->getInt(1);
+			}
+		}
+
+		if (migration_dir.empty() || !std::filesystem::is_directory(migration_dir)) {
+			std::cout << "[dbBackend]: Migration directory \"" << migration_dir << "\" not found, schema version is " << current_version << "." << std::endl;
+			return 0;
+		}
+
+		// ǨƽűΪ "汾_˵.sql" 001_add_clientip_index.sql
+		std::map<int, std::filesystem::path> pending;
+		for (const auto& entry : std::filesystem::directory_iterator(migration_dir)) {
+			if (!entry.is_regular_file() || entry.path().extension() != ".sql") continue;
+			std::string file_name = entry.path().stem().string();
+			size_t digits = file_name.find_first_not_of("0123456789");
+			if (digits == 0 || digits == std::string::npos || file_name[digits] != '_') continue;
+			int version = std::stoi(file_name.substr(0, digits));
+			if (version > current_version) {
+				pending[version] = entry.path();
+			}
+		}
+
+		int applied = 0;
+		for (const auto& migration : pending) {
+			std::string description = migration.second.stem().string();
+			description = description.substr(description.find('_') + 1);
+			std::cout << "[dbBackend]: Applying migration " << migration.first << " (" << description << ")..." << std::endl;
+			// DDL ޷عʧʱͣڵǰ汾޸´ִиǨƣ
+			// ǨƽűеÿһظִУȼ information_schemaɵĲ
+			executeSQLFile(migration.second.string());
+
+			std::unique_ptr<sql::PreparedStatement> pstmt(con->prepareStatement(
+				"INSERT INTO schema_version (version, description, applied_at) VALUES (?, ?, NOW())"));
+			pstmt->setInt(1, migration.first);
+			pstmt->setString(2, description);
+			pstmt->executeUpdate();
+			current_version = migration.first;
+			applied++;
+		}
+
+		std::cout << "[dbBackend]: Schema is at version " << current_version << "." << std::endl;
+		return applied;
+	}
+
+	// ȥַ˿հַĸ
+	std::string mysqlBackend::trim(const std::string& str) {
+		size_t first = str.find_first_not_of(" \t\n\r");
+		if (first == std::string::npos) return ""; // ȫǿհַ
+		size_t last = str.find_last_not_of(" \t\n\r");
+		return str.substr(first, (last - first + 1));
+	}
+
+	bool mysqlBackend::open(std::string& error) {
+		try {
+			con.reset();
+			sql::mysql::MySQL_Driver* driver = sql::mysql::get_mysql_driver_instance();
+			con.reset(driver->connect(url, user, password));
+			if (bootstrap) {
+				//  schema Ƿ
+				std::unique_ptr<sql::Statement> stmt(con->createStatement());
+				std::unique_ptr<sql::ResultSet> res(stmt->executeQuery("SHOW DATABASES LIKE '" + schema + "'"));
+
+				if (!res->next()) {
+					std::cout << "[dbBackend]: Schema '" << schema << "' does not exist. Creating schema..." << std::endl;
+					// ȡִ SQL ļ
+					executeSQLFile(build_file_location);
+
+					std::cout << "[dbBackend]: Schema created successfully." << std::endl;
+				}
+			}
+			con->setSchema(schema);
+		}
+		catch (const sql::SQLException& e) {
+			error = std::string(e.what()) + ", MySQL Error Code: " + std::to_string(e.getErrorCode()) + ", SQLState: " + e.getSQLState();
+			con.reset();
+			return false;
+		}
+		catch (const std::exception& e) {
+			error = e.what();
+			con.reset();
+			return false;
+		}
+
+		if (bootstrap) {
+			std::cout << "[dbBackend]: Connected to database successfully." << std::endl;
+			// ӦδִеǨƽűǨʧʱȻã޸´ִУ
+			// ״ʧʱǨƳٵ֮ĳʱִУʱԪݿѱ棬
+			// ֻҪִйǨƣ;ʧܵģ֪ͨ÷
+			bool changed = true;
+			try {
+				changed = runMigrations() > 0;
+			}
+			catch (const sql::SQLException& e) {
+				std::cerr << "[dbBackend]: SQLException during migration: " << e.what()
+					<< ", MySQL Error Code: " << e.getErrorCode()
+					<< ", SQLState: " << e.getSQLState() << std::endl;
+			}
+			catch (const std::exception& e) {
+				std::cerr << "[dbBackend]: Error: " << e.what() << std::endl;
+			}
+			if (changed && on_schema_changed) on_schema_changed();
+			// ʱٽǨ
+			bootstrap = false;
+		}
+		return true;
+	}
+
+	bool mysqlBackend::isOpen() {
+		try {
+			return con && !con->isClosed();
+		}
+		catch (const sql::SQLException&) {
+			return false;
+		}
+	}
+
+	void mysqlBackend::close() {
+		con.reset();
+	}
+
+	bool mysqlBackend::ensureOpen(std::string& error) {
+		return isOpen() || open(error);
+	}
+
+	dbStatus mysqlBackend::failure(const sql::SQLException& e, std::string& error) {
+		error = e.what();
+		int code = e.getErrorCode();
+		// 1205 ȴʱ1213 ѻعֱ
+		if (code == 1205 || code == 1213) return dbStatus::RETRY;
+		// 2006 ѶϿ2013 ѯӶʧһǰ
+		if (code == 2006 || code == 2013 || !isOpen()) {
+			con.reset();
+			return dbStatus::RETRY;
+		}
+		return dbStatus::REJECTED;
+	}
+
+	dbStatus mysqlBackend::describe(const std::string& table_name, std::vector<dbColumnMeta>& columns, std::string& error) {
+		if (!ensureOpen(error)) return dbStatus::RETRY;
+		try {
+			std::unique_ptr<sql::Statement> stmt(con->createStatement());
+			std::unique_ptr<sql::ResultSet> res(stmt->executeQuery("SHOW COLUMNS FROM " + table_name));
+			while (res->next()) {
+				// ȡÿһеƺͣSHOW COLUMNS еĶ˳򷵻
+				dbColumnMeta column;
+				column.name = res->getString("Field");
+				column.type = res->getString("Type");
+				column.ordinal = static_cast<unsigned int>(columns.size() + 1);
+				columns.push_back(column);
+			}
+			return dbStatus::OK;
+		}
+		catch (const sql::SQLException& e) {
+			return failure(e, error);
+		}
+	}
+
+	dbStatus mysqlBackend::insert(const std::string& table_name, const std::vector<dbInsertRow>& rows, std::string& error, bool upsert) {
+		if (rows.empty()) return dbStatus::OK;
+		if (!ensureOpen(error)) return dbStatus::RETRY;
+
+		// 嵥ȡԵһУ"NOW()" 滻Ϊеʱݿĵǰʱ䣬ֵͨ
+		const auto& first = *rows.front().columns;
+		std::string query = "INSERT INTO " + table_name + " (";
+		for (size_t c = 0; c < first.size(); ++c) {
+			if (c > 0) query += ", ";
+			query += first[c].first;
+		}
+		query += ") VALUES ";
+		for (size_t r = 0; r < rows.size(); ++r) {
+			query += r > 0 ? ", (" : "(";
+			const auto& columns = *rows[r].columns;
+			for (size_t c = 0; c < columns.size(); ++c) {
+				if (c > 0) query += ", ";
+				if (columns[c].second != "NOW()") query += "?";
+				else query += rows[r].now != 0 ? "FROM_UNIXTIME(?)" : "NOW()";
+			}
+			query += ")";
+		}
+		if (upsert) {
+			// ΨһͻʱñеֵУеֵͬһֵӰ
+			query += " ON DUPLICATE KEY UPDATE ";
+			for (size_t c = 0; c < first.size(); ++c) {
+				if (c > 0) query += ", ";
+				query += first[c].first + " = VALUES(" + first[c].first + ")";
+			}
+		}
+
+		try {
+			// ӴԶύģʽÿ䵥ύ
+			std::unique_ptr<sql::PreparedStatement> pstmt(con->prepareStatement(query));
+			unsigned int index = 1;
+			for (const auto& row : rows) {
+				for (const auto& column : *row.columns) {
+					if (column.second != "NOW()") pstmt->setString(index++, column.second);
+					else if (row.now != 0) pstmt->setInt64(index++, static_cast<int64_t>(row.now));
+				}
+			}
+			pstmt->executeUpdate();
+			return dbStatus::OK;
+		}
+		catch (const sql::SQLException& e) {
+			return failure(e, error);
+		}
+	}
+
+	dbStatus mysqlBackend::select(const dbTableMeta& meta, const dbSelect& query, std::vector<std::string>& values,
+		const std::function<bool()>& on_row, size_t& rows, std::string& error) {
+		if (!ensureOpen(error)) return dbStatus::RETRY;
+
+		// ṹе˳ѡȡУɸѡֵͷҳλͨ
+		std::string sql = meta.select_prefix;
+		if (!query.filter_column.empty()) {
+			sql += " WHERE " + query.filter_column + " = ?";
+		}
+		if (query.before_eid > 0) {
+			sql += query.filter_column.empty() ? " WHERE eid < ?" : " AND eid < ?";
+		}
+		if (query.ordered) {
+			sql += " ORDER BY eid DESC";
+		}
+		if (query.count_row > 0) {
+			sql += " LIMIT " + std::to_string(query.count_row);
+		}
+
+		try {
+			std::unique_ptr<sql::PreparedStatement> pstmt(con->prepareStatement(sql));
+			// ֻǰĽжȡ
+			pstmt->setResultSetType(sql::ResultSet::TYPE_FORWARD_ONLY);
+			unsigned int parameter = 1;
+			if (!query.filter_column.empty()) {
+				pstmt->setString(parameter++, query.filter_value);
+			}
+			if (query.before_eid > 0) {
+				pstmt->setUInt64(parameter++, query.before_eid);
+			}
+			std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+
+			// ֱȡԻԪݣÿиõ÷Ļ
+			values.resize(meta.columns.size());
+			while (res->next()) {
+				for (const auto& column : meta.columns) {
+					values[column.ordinal - 1] = res->getString(column.ordinal);
+				}
+				++rows;
+				if (!on_row()) break;
+			}
+			// ǰʱʣУͷӹһβѯʹ
+			while (res->next());
+			return dbStatus::OK;
+		}
+		catch (const sql::SQLException& e) {
+			return failure(e, error);
+		}
+	}
+
+	dbStatus mysqlBackend::update(const std::string& table_name, const std::unordered_map<std::string, std::string>& data,
+		const std::string& key_column, const std::string& key_value, std::string& error) {
+		if (data.empty()) return dbStatus::OK;
+		if (!ensureOpen(error)) return dbStatus::RETRY;
+
+		// SQL
+		std::string query = "UPDATE " + table_name + " SET ";
+		std::vector<std::string> stream_datas;
+		size_t colIndex = 0;
+		for (const auto& col : data) {
+			query += col.first + " = ";
+			if (col.second == "NOW()") {
+				query += "NOW()";
+			}
+			else {
+				query += "?";
+				stream_datas.push_back(col.second);
+			}
+			if (++colIndex < data.size()) query += ", ";
+		}
+		query += " WHERE " + key_column + " = ?";
+		stream_datas.push_back(key_value);
+
+		try {
+			std::unique_ptr<sql::PreparedStatement> pstmt(con->prepareStatement(query));
+			for (size_t i = 0; i < stream_datas.size(); ++i) {
+				pstmt->setString(static_cast<int>(i + 1), stream_datas[i]);
+			}
+			pstmt->executeUpdate();
+			return dbStatus::OK;
+		}
+		catch (const sql::SQLException& e) {
+			return failure(e, error);
+		}
+	}
+
+	dbStatus mysqlBackend::distinct(const std::string& table_name, const std::string& column, std::vector<std::string>& data, std::string& error) {
+		if (!ensureOpen(error)) return dbStatus::RETRY;
+		try {
+			std::unique_ptr<sql::Statement> stmt(con->createStatement());
+			std::unique_ptr<sql::ResultSet> res(stmt->executeQuery("SELECT DISTINCT " + column + " FROM " + table_name));
+			while (res->next()) {
+				data.push_back(res->getString(1));
+			}
+			return dbStatus::OK;
+		}
+		catch (const sql::SQLException& e) {
+			return failure(e, error);
+		}
+	}
+
+	dbStatus fakeBackend::describe(const std::string& table_name, std::vector<dbColumnMeta>& columns, std::string& error) {
+		// ൱ SHOW COLUMNS
+		std::vector<fakeColumn> fake_columns;
+		if (!fake.describe(table_name, fake_columns)) {
+			error = "Table '" + table_name + "' doesn't exist";
+			return dbStatus::REJECTED;
+		}
+		for (const auto& fake_column : fake_columns) {
+			dbColumnMeta column;
+			column.name = fake_column.name;
+			column.type = fake_column.type;
+			column.ordinal = static_cast<unsigned int>(columns.size() + 1);
+			columns.push_back(column);
+		}
+		return dbStatus::OK;
+	}
+
+	dbStatus fakeBackend::insert(const std::string& table_name, const std::vector<dbInsertRow>& rows, std::string& error, bool) {
+		// עʧΪӹϣһеһһ𱻾ܾ
+		if (!fake.roundTrip(error)) return dbStatus::RETRY;
+		std::time_t now = std::time(nullptr);
+		std::vector<fakeInsertRow> fake_rows;
+		fake_rows.reserve(rows.size());
+		for (const auto& row : rows) {
+			fake_rows.push_back({ row.columns, row.now != 0 ? row.now : now });
+		}
+		return fake.insert(table_name, fake_rows, error) ? dbStatus::OK : dbStatus::REJECTED;
+	}
+
+	dbStatus fakeBackend::select(const dbTableMeta& meta, const dbSelect& query, std::vector<std::string>& values,
+		const std::function<bool()>& on_row, size_t& rows, std::string& error) {
+		if (!fake.roundTrip(error)) return dbStatus::RETRY;
+		// ģݿⰴ˳µɷأ밴 eid һ£ҳʱв
+		auto eid = meta.index.find("eid");
+		const size_t eid_index = eid != meta.index.end() ? eid->second : std::string::npos;
+		const bool paged = query.before_eid > 0 && eid_index != std::string::npos;
+		auto copy_row = [&](const std::vector<std::string>& row) {
+			if (paged && std::strtoull(row[eid_index].c_str(), nullptr, 10) >= query.before_eid) return true;
+			values = row;
+			++rows;
+			return on_row() && (query.count_row == 0 || rows < query.count_row);
+		};
+		return fake.select(meta.table_name, query.filter_column, query.filter_value, paged ? 0 : query.count_row, copy_row, error)
+			? dbStatus::OK : dbStatus::REJECTED;
+	}
+
+	dbStatus fakeBackend::update(const std::string& table_name, const std::unordered_map<std::string, std::string>& data,
+		const std::string& key_column, const std::string& key_value, std::string& error) {
+		if (!fake.roundTrip(error)) return dbStatus::RETRY;
+		return fake.update(table_name, data, key_column, key_value, error) ? dbStatus::OK : dbStatus::REJECTED;
+	}
+
+	dbStatus fakeBackend::distinct(const std::string& table_name, const std::string& column, std::vector<std::string>& data, std::string& error) {
+		if (!fake.roundTrip(error)) return dbStatus::RETRY;
+		std::vector<fakeColumn> columns;
+		fake.describe(table_name, columns);
+		auto position = std::find_if(columns.begin(), columns.end(), [&column](const fakeColumn& c) { return c.name == column; });
+		if (position == columns.end()) {
+			error = "Unknown column '" + column + "' in 'field list'";
+			return dbStatus::REJECTED;
+		}
+		const size_t index = static_cast<size_t>(position - columns.begin());
+		std::unordered_set<std::string> seen;
+		return fake.select(table_name, "", "", 0, [&](const std::vector<std::string>& row) {
+			if (seen.insert(row[index]).second) data.push_back(row[index]);
+			return true;
+			}, error) ? dbStatus::OK : dbStatus::REJECTED;
+	}
+
+}  // namespace ems
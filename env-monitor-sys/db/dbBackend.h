@@ -0,0 +1,318 @@
+/**
+ * @file dbBackend.h
+ * @author Yilin Wang (yilin233@foxmail.com)
+ * @brief Storage backend interface used by dbTools and dbWriter, with a MySQL
+ *  implementation and an in-process fake for benchmarking.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2024 Yilin Wang
+ *
+ * MIT License
+ */
+
+
+#pragma once
+
+#include <jdbc/mysql_driver.h>
+#include <jdbc/mysql_connection.h>
+#include <jdbc/cppconn/prepared_statement.h>
+#include <jdbc/cppconn/statement.h>
+#include <jdbc/cppconn/resultset.h>
+#include <jdbc/cppconn/exception.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
+#include <ctime>
+#include "fakeStore.h"
+
+namespace ems {  // namespace ems start
+
+	/**
+	 * @struct dbColumnMeta
+	 * @brief һеԪݡ
+	 */
+	struct dbColumnMeta {
+		std::string name;		// 
+		std::string type;		// ͣ "float""char(16)"
+		unsigned int ordinal;	// ţ 1 ʼ "SELECT 嵥" һ
+	};
+
+	/**
+	 * @struct dbTableMeta
+	 * @brief Ԫݣ޸ģڶ̼߳乲
+	 */
+	struct dbTableMeta {
+		std::string table_name;								// 
+		std::vector<dbColumnMeta> columns;					// ˳е
+		std::unordered_map<std::string, size_t> index;		//  columns ±ӳ
+		std::string column_list;							// Ԥɵ嵥 "col1, col2, ..."
+		std::string select_prefix;							// Ԥɵ "SELECT 嵥 FROM "
+
+		/**
+		 * @brief ǷָС
+		 * @param column 
+		 * @return bool ڷ true
+		 */
+		bool has(const std::string& column) const { return index.find(column) != index.end(); }
+	};
+
+	/**
+	 * @brief ԪݵĹָ룬ȡʧʱΪա
+	 */
+	using dbTableMetaPtr = std::shared_ptr<const dbTableMeta>;
+
+	/**
+	 * @brief һĽ
+	 */
+	enum class dbStatus {
+		OK,			///< ִгɹ
+		REJECTED,	///< ݴҲɹ
+		RETRY		///< ӶϿʱԺԡ
+	};
+
+	/**
+	 * @struct dbInsertRow
+	 * @brief веһС
+	 */
+	struct dbInsertRow {
+		const std::vector<std::pair<std::string, std::string>>* columns;	///< ֵͬһие˳ͬ
+		std::time_t now;		///< 滻 "NOW()" ʱ䣬0 ʾʹݿĵǰʱ䡣
+	};
+
+	/**
+	 * @struct dbSelect
+	 * @brief ȡ
+	 */
+	struct dbSelect {
+		std::string filter_column;		///< ɸѡУΪʱɸѡ
+		std::string filter_value;		///< ɸѡеֵ
+		unsigned int count_row = 0;		///< Ҫȡ0 ʾơ
+		uint64_t before_eid = 0;		///< ֻȡ eid СڸֵУ0 ʾơ
+		bool ordered = true;			///< Ƿ eid ȡ
+	};
+
+	/**
+	 * @class dbBackend
+	 * @brief 洢˽ӿڣdbTools  dbWriter ֻͨݿ⡣
+	 *
+	 * ÿʵ൱һӣ̰߳ȫģɵ÷
+	 * db_backend = fake ʱ create ؽڵģݿ⣬򷵻 MySQL ӡ
+	 */
+	class dbBackend {
+	protected:
+		std::function<void()> on_schema_changed;	// Ǩ޸˱ṹã dbTools ıԪ
+
+	public:
+		virtual ~dbBackend() = default;
+
+		/**
+		 * @brief ñṹ仯ĻصִǨƵ߳Се÷ʱá
+		 *
+		 * @param listener ص
+		 */
+		void setSchemaListener(std::function<void()> listener) { on_schema_changed = std::move(listener); }
+
+		/**
+		 * @brief  db_backend ô洢ˣδӡ
+		 *
+		 * @param bootstrap ״ʱǷ񴴽ȱʧ schema ִǨƽű dbTools Ӹ
+		 * @return std::unique_ptr<dbBackend> 洢ˡ
+		 */
+		static std::unique_ptr<dbBackend> create(bool bootstrap);
+
+		/**
+		 * @brief ӣʱӡ
+		 *
+		 * @param error ʧʱԭ
+		 * @return bool ɹ true
+		 */
+		virtual bool open(std::string& error) = 0;
+
+		/**
+		 * @brief Ƿӡ
+		 */
+		virtual bool isOpen() = 0;
+
+		/**
+		 * @brief Ͽӡ
+		 */
+		virtual void close() = 0;
+
+		/**
+		 * @brief ȡУ˳С
+		 *
+		 * @param table_name 
+		 * @param columns Уordinal  1 ʼ
+		 * @param error ʧʱԭ
+		 * @return dbStatus Ľ
+		 */
+		virtual dbStatus describe(const std::string& table_name, std::vector<dbColumnMeta>& columns, std::string& error) = 0;
+
+		/**
+		 * @brief һУκһгʱж롣
+		 *
+		 * @param table_name 
+		 * @param rows УֵΪ "NOW()" ʱʹøе now
+		 * @param error ʧʱԭ
+		 * @param upsert Ϊ true ʱеΨһͻиΪ¸еĸУ»дͰ
+		 * @return dbStatus Ľ
+		 */
+		virtual dbStatus insert(const std::string& table_name, const std::vector<dbInsertRow>& rows, std::string& error, bool upsert = false) = 0;
+
+		/**
+		 * @brief ʽȡÿһа meta->columns ˳д values һλص
+		 *
+		 * @param meta Ԫݡ
+		 * @param query ȡ
+		 * @param values ÷ṩл
+		 * @param on_row лص false ʱֹͣȡ
+		 * @param rows ȡ
+		 * @param error ʧʱԭ
+		 * @return dbStatus Ľ
+		 */
+		virtual dbStatus select(const dbTableMeta& meta, const dbSelect& query, std::vector<std::string>& values,
+			const std::function<bool()>& on_row, size_t& rows, std::string& error) = 0;
+
+		/**
+		 * @brief  key_column = key_value С
+		 *
+		 * @param table_name 
+		 * @param data ҪµкֵֵΪ "NOW()" ʱʹݿ⵱ǰʱ䡣
+		 * @param key_column 
+		 * @param key_value еֵ
+		 * @param error ʧʱԭ
+		 * @return dbStatus Ľ
+		 */
+		virtual dbStatus update(const std::string& table_name, const std::unordered_map<std::string, std::string>& data,
+			const std::string& key_column, const std::string& key_value, std::string& error) = 0;
+
+		/**
+		 * @brief ѯһевֵͬ
+		 *
+		 * @param table_name 
+		 * @param column 
+		 * @param data ֵ
+		 * @param error ʧʱԭ
+		 * @return dbStatus Ľ
+		 */
+		virtual dbStatus distinct(const std::string& table_name, const std::string& column, std::vector<std::string>& data, std::string& error) = 0;
+	};
+
+	/**
+	 * @class mysqlBackend
+	 * @brief  MySQL Connector/C++ Ĵ洢ˣӶϿһǰԶӡ
+	 */
+	class mysqlBackend : public dbBackend {
+	private:
+		std::unique_ptr<sql::Connection> con;	// MySQLӶ
+		std::string url;						// ݿURL
+		std::string user;						// ݿû
+		std::string password;					// ݿ
+		std::string schema;						// ʹõݿschema
+		std::string build_file_location;		// ݿļλ
+		std::string migration_dir;				// ݿǨƽűĿ¼
+		bool bootstrap;							// ״ʱǷ񽨿ִǨ
+
+		/**
+		 * @brief ִSQL䡣
+		 * @param sql ҪִеSQLַ
+		 */
+		void executeSQL(const std::string& sql);
+
+		/**
+		 * @brief ִSQLļ";"ָ䡣
+		 * @param path SQLļ·
+		 */
+		void executeSQLFile(const std::string& path);
+
+		/**
+		 * @brief 汾˳ӦǨĿ¼δִеǨƽű
+		 *
+		 * Ӧõİ汾¼ schema_version У½ݿӰ汾 0 ʼ
+		 *
+		 * @return int ӦõǨ;ʧʱ׳쳣
+		 */
+		int runMigrations();
+
+		/**
+		 * @brief δӻѶϿʱӡ
+		 *
+		 * @param error ʧʱԭ
+		 * @return bool ӿ÷ true
+		 */
+		bool ensureOpen(std::string& error);
+
+		/**
+		 * @brief 쳣תΪĽѶϿʱرӡ
+		 *
+		 * @param e ׳쳣
+		 * @param error ԭ
+		 * @return dbStatus ʱͶΪ RETRYΪ REJECTED
+		 */
+		dbStatus failure(const sql::SQLException& e, std::string& error);
+
+		/**
+		 * @brief ȥַ˵Ŀո
+		 * @param str Ҫȥոַ
+		 * @return std::string ȥոַ
+		 */
+		static std::string trim(const std::string& str);
+
+	public:
+		/**
+		 * @brief 캯ȡá
+		 *
+		 * @param bootstrap ״ʱǷ񽨿ִǨơ
+		 */
+		explicit mysqlBackend(bool bootstrap);
+
+		bool open(std::string& error) override;
+		bool isOpen() override;
+		void close() override;
+		dbStatus describe(const std::string& table_name, std::vector<dbColumnMeta>& columns, std::string& error) override;
+		dbStatus insert(const std::string& table_name, const std::vector<dbInsertRow>& rows, std::string& error, bool upsert = false) override;
+		dbStatus select(const dbTableMeta& meta, const dbSelect& query, std::vector<std::string>& values,
+			const std::function<bool()>& on_row, size_t& rows, std::string& error) override;
+		dbStatus update(const std::string& table_name, const std::unordered_map<std::string, std::string>& data,
+			const std::string& key_column, const std::string& key_value, std::string& error) override;
+		dbStatus distinct(const std::string& table_name, const std::string& column, std::vector<std::string>& data, std::string& error) override;
+	};
+
+	/**
+	 * @class fakeBackend
+	 * @brief  fakeStore Ĵ洢ˣÿģһעʧܰߴ
+	 *
+	 * ģݿֻûΨһupsert 밴ͨ봦
+	 */
+	class fakeBackend : public dbBackend {
+	private:
+		fakeStore& fake;	// ʵģݿ
+
+	public:
+		/**
+		 * @brief 캯ṹ fakeStore ӽļн
+		 */
+		fakeBackend() : fake(fakeStore::getInstance()) {}
+
+		bool open(std::string&) override { return true; }
+		bool isOpen() override { return true; }
+		void close() override {}
+		dbStatus describe(const std::string& table_name, std::vector<dbColumnMeta>& columns, std::string& error) override;
+		dbStatus insert(const std::string& table_name, const std::vector<dbInsertRow>& rows, std::string& error, bool upsert = false) override;
+		dbStatus select(const dbTableMeta& meta, const dbSelect& query, std::vector<std::string>& values,
+			const std::function<bool()>& on_row, size_t& rows, std::string& error) override;
+		dbStatus update(const std::string& table_name, const std::unordered_map<std::string, std::string>& data,
+			const std::string& key_column, const std::string& key_value, std::string& error) override;
+		dbStatus distinct(const std::string& table_name, const std::string& column, std::vector<std::string>& data, std::string& error) override;
+	};
+
+}  // namespace ems end
@@ -0,0 +1,490 @@
+#include "dbRetention.h"
+
+namespace ems {
+
+	dbRetention::dbRetention() : raw_retention_days(0), interval_seconds(300), chunk_rows(2000), rollup_lateness_seconds(3600), chunk_pause_ms(50), running(false)
+	{
+		esysControl& esys = esysControl::getInstance();
+
+		url = esys.getConfig("db_url");
+		user = esys.getConfig("db_user");
+		password = esys.getConfig("db_password");
+		schema = esys.getConfig("db_schema");
+		source_table = "envtable";
+		log_operations = esys.getConfig("log_operations") == "false" ? false : true;
+
+		// ȡֵãʹĬֵ
+		auto readUInt = [&esys](const std::string& key, unsigned int default_value) -> unsigned int {
+			std::string value = esys.getConfig(key);
+			if (value.empty()) return default_value;
+			try {
+				return static_cast<unsigned int>(std::stoul(value));
+			}
+			catch (const std::exception&) {
+				std::cerr << "[dbRetention]: Invalid value \"" << value << "\" for " << key << ", use " << default_value << "." << std::endl;
+				return default_value;
+			}
+		};
+		raw_retention_days = readUInt("retention_raw_days", 0);
+		interval_seconds = readUInt("retention_interval_seconds", 300);
+		chunk_rows = readUInt("retention_chunk_rows", 2000);
+		chunk_pause_ms = readUInt("retention_chunk_pause_ms", 50);
+		rollup_lateness_seconds = readUInt("retention_rollup_lateness_seconds", 3600);
+		if (interval_seconds == 0) interval_seconds = 1;
+		if (chunk_rows == 0) chunk_rows = 1;
+
+		// ȡлܲ㣬ʽΪ "Ͱ, "
+		std::string prefix_of_rollup_tier = esys.getConfig("prefix_of_rollup_tier");
+		if (prefix_of_rollup_tier.empty()) return;
+		for (const auto& key : esys.getAllConfigKeys()) {
+			if (key.find(prefix_of_rollup_tier) != 0) continue;
+			rollupTier tier;
+			tier.name = key.substr(prefix_of_rollup_tier.length());
+			tier.table_name = source_table + "_" + tier.name;
+			tier.bucket_seconds = 0;
+			tier.retention_days = 0;
+			std::istringstream iss(esys.getConfig(key));
+			std::string bucket, days;
+			std::getline(iss, bucket, ',');
+			std::getline(iss, days);
+			try {
+				tier.bucket_seconds = static_cast<unsigned int>(std::stoul(bucket));
+				if (!days.empty() && days.find_first_not_of(" \t") != std::string::npos) {
+					tier.retention_days = static_cast<unsigned int>(std::stoul(days));
+				}
+			}
+			catch (const std::exception&) {
+				tier.bucket_seconds = 0;
+			}
+			if (tier.name.empty() || tier.bucket_seconds == 0) {
+				std::cerr << "[dbRetention]: Invalid rollup tier \"" << key << " = " << esys.getConfig(key) << "\", ignored." << std::endl;
+				continue;
+			}
+			tiers.push_back(tier);
+		}
+		// ͰС
+		std::sort(tiers.begin(), tiers.end(), [](const rollupTier& a, const rollupTier& b) {
+			return a.bucket_seconds < b.bucket_seconds;
+			});
+	}
+
+	dbRetention::~dbRetention()
+	{
+		stop();
+	}
+
+	bool dbRetention::prepare()
+	{
+		try {
+			sql::mysql::MySQL_Driver* driver = sql::mysql::get_mysql_driver_instance();
+			con.reset(driver->connect(url, user, password));
+			con->setSchema(schema);
+			std::string error;
+			if (!backend) backend = dbBackend::create(false);
+			if (!backend->open(error)) {
+				std::cerr << "[dbRetention]: Failed to connect the rollup writer: " << error << std::endl;
+				con.reset();
+				return false;
+			}
+
+			// ȡԭʼеĲɼֵ
+			std::string suffix_of_collected_values = esysControl::getInstance().getConfig("suffix_of_collected_values");
+			std::vector<std::string> value_columns;
+			dbTableMetaPtr meta = dbTools::getInstance().getTableStructure(source_table);
+			if (!meta) return false;
+			for (const auto& column : meta->columns) {
+				const std::string& name = column.name;
+				if (name.length() > suffix_of_collected_values.length() &&
+					name.compare(name.length() - suffix_of_collected_values.length(), std::string::npos, suffix_of_collected_values) == 0) {
+					value_columns.push_back(name);
+				}
+			}
+			std::sort(value_columns.begin(), value_columns.end());
+
+			std::unique_ptr<sql::Statement> stmt(con->createStatement());
+			for (auto& tier : tiers) {
+				// ܱÿɼֵƽֵСֵֵ
+				std::string query = "CREATE TABLE IF NOT EXISTS " + tier.table_name + "("
+					"eid BIGINT PRIMARY KEY AUTO_INCREMENT, "
+					"clientIP CHAR(16), "
+					"etime DATETIME, "
+					"sampleCount INT";
+				for (const auto& column : value_columns) {
+					query += ", " + column + " DOUBLE, " + column + "Min DOUBLE, " + column + "Max DOUBLE";
+				}
+				query += ", UNIQUE KEY uk_client_time (clientIP, etime), INDEX idx_etime (etime))";
+				stmt->execute(query);
+
+				// ɰ汾Ļܱû etime  etime ֿɾʱҪ
+				std::unique_ptr<sql::ResultSet> index(stmt->executeQuery("SHOW INDEX FROM " + tier.table_name + " WHERE Key_name = 'idx_etime'"));
+				if (!index->next()) {
+					stmt->execute("ALTER TABLE " + tier.table_name + " ADD INDEX idx_etime (etime)");
+				}
+
+				// ܱɾɰ汾ֻ߶ڵ
+				std::unique_ptr<sql::ResultSet> res(stmt->executeQuery("SHOW COLUMNS FROM " + tier.table_name));
+				std::vector<std::string> existing;
+				while (res->next()) {
+					existing.push_back(res->getString("Field"));
+				}
+				tier.columns.clear();
+				for (const auto& column : value_columns) {
+					if (std::find(existing.begin(), existing.end(), column + "Max") != existing.end()) {
+						tier.columns.push_back(column);
+					}
+				}
+			}
+			return true;
+		}
+		catch (const sql::SQLException& e) {
+			std::cerr << "[dbRetention]: SQLException during connection: " << e.what()
+				<< ", MySQL Error Code: " << e.getErrorCode()
+				<< ", SQLState: " << e.getSQLState() << std::endl;
+			con.reset();
+			return false;
+		}
+	}
+
+	void dbRetention::start()
+	{
+		if (fakeStore::enabled()) {
+			std::cout << "[dbRetention]: Not supported on the fake database backend, compactor disabled." << std::endl;
+			return;
+		}
+		// δñʱȻĺ·ݷҪǰݶ MAXVALUE 
+		if (raw_retention_days == 0 && tiers.empty()) {
+			std::cout << "[dbRetention]: No retention policy configured, only partitions of " << source_table << " are maintained." << std::endl;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			if (running) return;
+			running = true;
+		}
+		worker = std::thread(&dbRetention::workerLoop, this);
+		std::cout << "[dbRetention]: Compactor started, raw data kept " << raw_retention_days
+			<< " days, " << tiers.size() << " rollup tiers." << std::endl;
+	}
+
+	void dbRetention::stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			if (!running) return;
+			running = false;
+		}
+		cv.notify_all();
+		if (worker.joinable()) worker.join();
+		std::cout << "[dbRetention]: Compactor stopped." << std::endl;
+	}
+
+	bool dbRetention::pauseFor(unsigned int ms)
+	{
+		std::unique_lock<std::mutex> lock(mtx);
+		cv.wait_for(lock, std::chrono::milliseconds(ms), [this] { return !running; });
+		return running;
+	}
+
+	void dbRetention::workerLoop()
+	{
+		while (true) {
+			runPass();
+			if (!pauseFor(interval_seconds * 1000)) break;
+		}
+		con.reset();
+		if (backend) backend->close();
+	}
+
+	void dbRetention::runPass()
+	{
+		auto start_time = std::chrono::steady_clock::now();
+		uint64_t rolled = 0;
+		uint64_t deleted = 0;
+		uint64_t reclaimed = 0;
+		bool failed = false;
+
+		if (!con || con->isClosed() || !backend->isOpen()) {
+			if (!prepare()) {
+				std::lock_guard<std::mutex> lock(metrics_mtx);
+				metrics.errors++;
+				return;
+			}
+		}
+
+		try {
+			// Ȼܣ֤ԭʼɾǰѾܲ
+			for (const auto& tier : tiers) {
+				rolled += rollup(tier);
+			}
+			// ܱжʱɾԭʼ
+			if (pauseFor(0)) {
+				deleted += maintainPartitions(source_table, raw_retention_days, reclaimed);
+			}
+			if (raw_retention_days > 0 && pauseFor(0)) {
+				deleted += purgeExpired(source_table, raw_retention_days, reclaimed);
+			}
+			for (const auto& tier : tiers) {
+				if (tier.retention_days > 0) {
+					deleted += purgeExpired(tier.table_name, tier.retention_days, reclaimed);
+				}
+			}
+		}
+		catch (const sql::SQLException& e) {
+			std::cerr << "[dbRetention]: Error during compaction: " << e.what()
+				<< ", MySQL Error Code: " << e.getErrorCode() << std::endl;
+			failed = true;
+			con.reset();  // һ½
+		}
+		catch (const std::runtime_error& e) {
+			// ܽдʧܣֲɾݣ洢һǰԶ
+			std::cerr << "[dbRetention]: Error during compaction: " << e.what() << std::endl;
+			failed = true;
+		}
+
+		uint64_t elapsed_ms = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now() - start_time).count());
+		{
+			std::lock_guard<std::mutex> lock(metrics_mtx);
+			metrics.passes++;
+			if (failed) metrics.errors++;
+			metrics.rows_rolled_up += rolled;
+			metrics.rows_deleted += deleted;
+			metrics.bytes_reclaimed += reclaimed;
+			metrics.last_rows_deleted = deleted;
+			metrics.last_bytes_reclaimed = reclaimed;
+			metrics.last_run_ms = elapsed_ms;
+			metrics.total_run_ms += elapsed_ms;
+		}
+		if (log_operations || deleted > 0) {
+			std::cout << "[dbRetention]: Compaction pass finished in " << elapsed_ms << " ms, rolled up " << rolled
+				<< " rows, deleted " << deleted << " rows, reclaimed about " << reclaimed << " bytes." << std::endl;
+		}
+	}
+
+	long long dbRetention::dbNow()
+	{
+		std::unique_ptr<sql::Statement> stmt(con->createStatement());
+		std::unique_ptr<sql::ResultSet> res(stmt->executeQuery("SELECT UNIX_TIMESTAMP()"));
+		return res->next() ? res->getInt64(1) : 0;
+	}
+
+	uint64_t dbRetention::rollup(const rollupTier& tier)
+	{
+		const long long bucket = tier.bucket_seconds;
+		const long long now = dbNow();
+		long long begin = 0;
+		{
+			// ˮλܱµͰΪԭʼݿʼ
+			std::unique_ptr<sql::Statement> stmt(con->createStatement());
+			std::unique_ptr<sql::ResultSet> res(stmt->executeQuery("SELECT UNIX_TIMESTAMP(MAX(etime)) FROM " + tier.table_name));
+			if (res->next() && !res->isNull(1)) {
+				// 豸ʱдеԻݳٵɸͰ»
+				const long long lateness = (static_cast<long long>(rollup_lateness_seconds) + bucket - 1) / bucket * bucket;
+				begin = res->getInt64(1) + bucket - lateness;
+				// ԭʼѱɾͰ»ܣḲĻܽ
+				if (raw_retention_days > 0) {
+					const long long cutoff = now - static_cast<long long>(raw_retention_days) * 86400;
+					begin = (std::max)(begin, (cutoff + bucket - 1) / bucket * bucket);
+				}
+			}
+			else {
+				// ״λܸԭʼеȫݣѳޡͻᱻɾ
+				res.reset(stmt->executeQuery("SELECT UNIX_TIMESTAMP(MIN(etime)) FROM " + source_table));
+				if (!res->next() || res->isNull(1)) return 0;
+				begin = res->getInt64(1) / bucket * bucket;
+			}
+		}
+		// ֻѾͰ
+		const long long end = now / bucket * bucket;
+		if (begin >= end) return 0;
+
+		// ܽѯһһӦ
+		std::vector<std::string> names = { "clientIP", "etime", "sampleCount" };
+		std::string bucket_expr = "FROM_UNIXTIME(FLOOR(UNIX_TIMESTAMP(etime) / " + std::to_string(bucket) + ") * " + std::to_string(bucket) + ")";
+		std::string select = "SELECT clientIP, " + bucket_expr + " AS bucket, COUNT(*)";
+		for (const auto& column : tier.columns) {
+			select += ", AVG(" + column + "), MIN(" + column + "), MAX(" + column + ")";
+			names.push_back(column);
+			names.push_back(column + "Min");
+			names.push_back(column + "Max");
+		}
+		// clientIP Ϊ NULL вΨһԼ»ʱظд룬
+		select += " FROM " + source_table + " WHERE etime >= FROM_UNIXTIME(?) AND etime < FROM_UNIXTIME(?) AND clientIP IS NOT NULL GROUP BY clientIP, bucket";
+
+		std::unique_ptr<sql::PreparedStatement> read_stmt(con->prepareStatement(select));
+		const unsigned int field_count = static_cast<unsigned int>(names.size());
+		// MySQL һ 65535 
+		const size_t statement_rows = (std::max)(static_cast<size_t>(1), (std::min)(static_cast<size_t>(chunk_rows), static_cast<size_t>(65535 / field_count)));
+
+		// ͬһиебͬвͬﵽʱде
+		uint64_t rows = 0;
+		std::vector<std::vector<std::pair<std::string, std::string>>> pending;
+		std::vector<dbInsertRow> statement;
+		auto flush = [&]() {
+			if (pending.empty()) return;
+			statement.clear();
+			for (const auto& columns : pending) {
+				statement.push_back({ &columns, 0 });
+			}
+			std::string error;
+			if (backend->insert(tier.table_name, statement, error, true) != dbStatus::OK) {
+				throw std::runtime_error("Failed to write rollup rows into " + tier.table_name + ": " + error);
+			}
+			rows += pending.size();
+			pending.clear();
+		};
+		auto same_columns = [](const std::vector<std::pair<std::string, std::string>>& a, const std::vector<std::pair<std::string, std::string>>& b) {
+			if (a.size() != b.size()) return false;
+			for (size_t i = 0; i < a.size(); ++i) {
+				if (a[i].first != b[i].first) return false;
+			}
+			return true;
+		};
+
+		// ÿദһݣܲѯһԶԭʼ
+		const long long window = (86400 + bucket - 1) / bucket * bucket;
+		for (long long from = begin; from < end; from += window) {
+			long long to = (std::min)(from + window, end);
+			read_stmt->setInt64(1, from);
+			read_stmt->setInt64(2, to);
+			std::unique_ptr<sql::ResultSet> res(read_stmt->executeQuery());
+			while (res->next()) {
+				std::vector<std::pair<std::string, std::string>> columns;
+				columns.reserve(field_count);
+				for (unsigned int i = 1; i <= field_count; ++i) {
+					// ͰĳȫΪ NULL ʱ AVG/MIN/MAX Ϊ NULLʡԸʹȡĬֵ NULLgetString ɿմϸģʽ²ʧܣ
+					if (!res->isNull(i)) columns.emplace_back(names[i - 1], res->getString(i));
+				}
+				if (!pending.empty() && !same_columns(pending.back(), columns)) flush();
+				pending.push_back(std::move(columns));
+				if (pending.size() >= statement_rows) flush();
+			}
+			if (!pauseFor(0)) break;  // ѹֹͣ
+		}
+		flush();
+		if (log_operations) {
+			std::cout << "[dbRetention]: Rolled up " << rows << " rows into " << tier.table_name << "." << std::endl;
+		}
+		return rows;
+	}
+
+	uint64_t dbRetention::maintainPartitions(const std::string& table_name, unsigned int retention_days, uint64_t& bytes_reclaimed)
+	{
+		static constexpr int partition_ahead_months = 2;  // ǰ·
+
+		struct partitionInfo {
+			std::string name;
+			std::string bound;	// "YYYY-MM-DD HH:MM:SS"MAXVALUE Ϊ
+			uint64_t rows;
+			uint64_t bytes;
+		};
+		std::vector<partitionInfo> partitions;
+		{
+			std::unique_ptr<sql::PreparedStatement> pstmt(con->prepareStatement(
+				"SELECT PARTITION_NAME, PARTITION_DESCRIPTION, TABLE_ROWS, DATA_LENGTH + INDEX_LENGTH "
+				"FROM information_schema.PARTITIONS WHERE TABLE_SCHEMA = ? AND TABLE_NAME = ? AND PARTITION_NAME IS NOT NULL "
+				"ORDER BY PARTITION_ORDINAL_POSITION"));
+			pstmt->setString(1, schema);
+			pstmt->setString(2, table_name);
+			std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+			while (res->next()) {
+				partitionInfo info;
+				info.name = res->getString(1);
+				info.bound = res->getString(2);
+				info.bound.erase(std::remove(info.bound.begin(), info.bound.end(), '\''), info.bound.end());
+				if (info.bound == "MAXVALUE") info.bound.clear();
+				info.rows = res->getUInt64(3);
+				info.bytes = res->getUInt64(4);
+				partitions.push_back(info);
+			}
+		}
+		if (partitions.empty() || !partitions.back().bound.empty()) return 0;  // δû MAXVALUE 
+
+		std::unique_ptr<sql::Statement> stmt(con->createStatement());
+
+		//  MAXVALUE ²ֳ·MAXVALUE ͨΪգִۺС
+		{
+			std::unique_ptr<sql::ResultSet> res(stmt->executeQuery(
+				"SELECT DATE_FORMAT(NOW() + INTERVAL " + std::to_string(partition_ahead_months) + " MONTH, '%Y-%m-01 00:00:00')"));
+			std::string target = res->next() ? res->getString(1) : "";
+			const std::string future_name = partitions.back().name;
+			std::string last_bound = partitions.size() > 1 ? partitions[partitions.size() - 2].bound : "";
+			while (!last_bound.empty() && last_bound < target) {
+				int year = std::stoi(last_bound.substr(0, 4));
+				int month = std::stoi(last_bound.substr(5, 2));
+				std::ostringstream name, bound;
+				name << "p" << year << std::setw(2) << std::setfill('0') << month;
+				month = month % 12 + 1;
+				if (month == 1) year++;
+				bound << year << "-" << std::setw(2) << std::setfill('0') << month << "-01 00:00:00";
+				stmt->execute("ALTER TABLE " + table_name + " REORGANIZE PARTITION " + future_name + " INTO ("
+					"PARTITION " + name.str() + " VALUES LESS THAN ('" + bound.str() + "'), "
+					"PARTITION " + future_name + " VALUES LESS THAN (MAXVALUE))");
+				if (log_operations) {
+					std::cout << "[dbRetention]: Created partition " << name.str() << " on " << table_name << "." << std::endl;
+				}
+				last_bound = bound.str();
+			}
+		}
+
+		if (retention_days == 0) return 0;
+
+		// Ͻ粻ڱ޵ķڣֱɾɾ
+		std::string cutoff;
+		{
+			std::unique_ptr<sql::ResultSet> res(stmt->executeQuery(
+				"SELECT DATE_FORMAT(NOW() - INTERVAL " + std::to_string(retention_days) + " DAY, '%Y-%m-%d %H:%i:%s')"));
+			if (!res->next()) return 0;
+			cutoff = res->getString(1);
+		}
+		uint64_t rows = 0;
+		for (const auto& partition : partitions) {
+			if (partition.bound.empty() || partition.bound > cutoff) break;
+			stmt->execute("ALTER TABLE " + table_name + " DROP PARTITION " + partition.name);
+			rows += partition.rows;
+			bytes_reclaimed += partition.bytes;
+			std::cout << "[dbRetention]: Dropped expired partition " << partition.name << " of " << table_name
+				<< ", about " << partition.rows << " rows." << std::endl;
+		}
+		return rows;
+	}
+
+	uint64_t dbRetention::purgeExpired(const std::string& table_name, unsigned int retention_days, uint64_t& bytes_reclaimed)
+	{
+		const long long cutoff = dbNow() - static_cast<long long>(retention_days) * 86400;
+
+		// ƽгڹյĿռ
+		uint64_t avg_row_length = 0;
+		{
+			std::unique_ptr<sql::PreparedStatement> pstmt(con->prepareStatement(
+				"SELECT AVG_ROW_LENGTH FROM information_schema.TABLES WHERE TABLE_SCHEMA = ? AND TABLE_NAME = ?"));
+			pstmt->setString(1, schema);
+			pstmt->setString(2, table_name);
+			std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+			if (res->next()) avg_row_length = res->getUInt64(1);
+		}
+
+		//  etime ֿɾ etime ԭʼзüÿֻУ֮óʱд
+		std::unique_ptr<sql::PreparedStatement> pstmt(con->prepareStatement(
+			"DELETE FROM " + table_name + " WHERE etime < FROM_UNIXTIME(?) LIMIT " + std::to_string(chunk_rows)));
+		pstmt->setInt64(1, cutoff);
+		uint64_t rows = 0;
+		while (true) {
+			int affected = pstmt->executeUpdate();
+			rows += affected;
+			if (affected < static_cast<int>(chunk_rows)) break;
+			if (!pauseFor(chunk_pause_ms)) break;
+		}
+		bytes_reclaimed += rows * avg_row_length;
+		if (log_operations) {
+			std::cout << "[dbRetention]: Deleted " << rows << " expired rows from " << table_name << "." << std::endl;
+		}
+		return rows;
+	}
+
+	retentionMetrics dbRetention::getMetrics() const
+	{
+		std::lock_guard<std::mutex> lock(metrics_mtx);
+		return metrics;
+	}
+
+}  // namespace ems
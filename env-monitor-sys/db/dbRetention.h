@@ -0,0 +1,218 @@
+/**
+ * @file dbRetention.h
+ * @author Yilin Wang (yilin233@foxmail.com)
+ * @brief Data retention module, rolls raw records up into coarser tiers and
+ *  purges expired rows in small chunks by a background compactor.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2024 Yilin Wang
+ *
+ * MIT License
+ */
+
+
+#pragma once
+
+#include <jdbc/mysql_driver.h>
+#include <jdbc/mysql_connection.h>
+#include <jdbc/cppconn/prepared_statement.h>
+#include <jdbc/cppconn/statement.h>
+#include <jdbc/cppconn/resultset.h>
+#include <jdbc/cppconn/datatype.h>
+#include <jdbc/cppconn/exception.h>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include "../esys/esysControl.h"  // Զ
+#include "fakeStore.h"
+#include "dbBackend.h"
+
+namespace ems {  // namespace ems start
+
+	/**
+	 * @struct retentionMetrics
+	 * @brief ݱѹָꡣ
+	 */
+	struct retentionMetrics {
+		uint64_t passes = 0;				///< ɵѹ
+		uint64_t errors = 0;				///< 
+		uint64_t rows_rolled_up = 0;		///< ۼдܱ»ܵͰظ롣
+		uint64_t rows_deleted = 0;			///< ۼɾĹ
+		uint64_t bytes_reclaimed = 0;		///< ۼƻյֽƽг㣩
+		uint64_t last_rows_deleted = 0;		///< һɾ
+		uint64_t last_bytes_reclaimed = 0;	///< һֻյֽ
+		uint64_t last_run_ms = 0;			///< һֵĺʱ룩
+		uint64_t total_run_ms = 0;			///< ۼƺʱ룩
+	};
+
+	/**
+	 * @class dbRetention
+	 * @brief 㼶ִݱԵĺ̨ѹ
+	 *
+	 * ԭʼ retention_raw_days 죻ÿ prefix_of_rollup_tier ͷһܲ㣬
+	 * ʽΪ "Ͱ, " rollup_1m = 60, 180 ʾ 1 ӻܲ 180 죬
+	 * д envtable_1mٵݿѻܵͰÿִӻˮλǰ retention_rollup_lateness_seconds 
+	 * »ܣΨһеͰܽԶвд룬ÿ retention_chunk_rows С
+	 * ɾ etime ֿУÿ֮óʱ䣬ⳤʱд롣
+	 * ѹʹöݿӣռ dbTools 
+	 */
+	class dbRetention {
+	private:
+		/**
+		 * @brief ܲĶ塣
+		 */
+		struct rollupTier {
+			std::string name;				///<  "1m"
+			std::string table_name;			///< ܱ "envtable_1m"
+			unsigned int bucket_seconds;	///< Ͱ룩
+			unsigned int retention_days;	///< 0 ʾñ
+			std::vector<std::string> columns;	///< ܵĲɼֵС
+		};
+
+		std::unique_ptr<sql::Connection> con;	///< ѹռݿӣڲѯɾά
+		std::unique_ptr<dbBackend> backend;		///< дܱĴ洢ӡ
+		std::string url;						///< ݿURL
+		std::string user;						///< ݿû
+		std::string password;					///< ݿ
+		std::string schema;						///< ʹõݿschema
+		std::string source_table;				///< ԭʼݱ
+		unsigned int raw_retention_days;		///< ԭʼݱ0 ʾñ
+		unsigned int interval_seconds;			///< ѹ֮ļ룩
+		unsigned int chunk_rows;				///< ÿɾÿܲ
+		unsigned int rollup_lateness_seconds;	///< ÿ»ܵĻʱ룩ǳٵݡ
+		unsigned int chunk_pause_ms;			///< ηֿɾ֮ͣ٣룩
+		bool log_operations;					///< Ƿ¼־
+		std::vector<rollupTier> tiers;			///< лܲ㡣
+
+		std::thread worker;						///< ̨ѹ̡߳
+		std::mutex mtx;							///< ״̬Ļ
+		std::condition_variable cv;				///< ڻѻֹ̨̡ͣ߳
+		bool running;							///< ̨߳ǷС
+
+		mutable std::mutex metrics_mtx;			///< ָĻ
+		retentionMetrics metrics;				///< ָꡣ
+
+		/**
+		 * @brief ˽й캯ȡá
+		 */
+		dbRetention();
+
+		/**
+		 * @brief ˽ֹ̨̡ͣ߳
+		 */
+		~dbRetention();
+
+		/**
+		 * @brief ɾ캯
+		 */
+		dbRetention(const dbRetention&) = delete;
+
+		/**
+		 * @brief ɾֵ
+		 */
+		dbRetention& operator=(const dbRetention&) = delete;
+
+		/**
+		 * @brief ѹݿӣȱʧĻܱ
+		 *
+		 * @return bool ɹ true
+		 */
+		bool prepare();
+
+		/**
+		 * @brief ̨߳ѭ
+		 */
+		void workerLoop();
+
+		/**
+		 * @brief ִһѹȻܣɾݡ
+		 */
+		void runPass();
+
+		/**
+		 * @brief ԭʼʱͰָܵ㡣
+		 *
+		 * ӻˮλǰ rollup_lateness_seconds 뿪ʼ»ܵͰеֵ
+		 * ˲ԭʼݵıޣɾ˲ݵͰĻܽ
+		 *
+		 * @param tier ܲ㡣
+		 * @return uint64_t дܱ
+		 */
+		uint64_t rollup(const rollupTier& tier);
+
+		/**
+		 * @brief  etime ֿɾָڱ޵ݡ
+		 *
+		 *  eid  etime ͬ豸ʱдɵҲᰴԵ etime ɾ
+		 *
+		 * @param table_name 
+		 * @param retention_days 
+		 * @param bytes_reclaimed ۼӻֽá
+		 * @return uint64_t ɾ
+		 */
+		uint64_t purgeExpired(const std::string& table_name, unsigned int retention_days, uint64_t& bytes_reclaimed);
+
+		/**
+		 * @brief ά etime Χıǰ·ݵķֱɾڵķ
+		 *
+		 * δʱκβ
+		 *
+		 * @param table_name 
+		 * @param retention_days 0 ʾɾ
+		 * @param bytes_reclaimed ۼӻֽá
+		 * @return uint64_t ɾֵ
+		 */
+		uint64_t maintainPartitions(const std::string& table_name, unsigned int retention_days, uint64_t& bytes_reclaimed);
+
+		/**
+		 * @brief ȡݿ⵱ǰ UNIX ʱ etime  NOW() ʹͬһʱӡ
+		 *
+		 * @return long long UNIX ʱ룩
+		 */
+		long long dbNow();
+
+		/**
+		 * @brief ȴָѹֹͣǰء
+		 *
+		 * @param ms ȴʱ䣨룩
+		 * @return bool ѹз true
+		 */
+		bool pauseFor(unsigned int ms);
+
+	public:
+		/**
+		 * @brief ȡdbRetentionĵʵ
+		 *
+		 * @return dbRetention& ʵá
+		 */
+		static dbRetention& getInstance() {
+			static dbRetention instance;
+			return instance;
+		}
+
+		/**
+		 * @brief ̨ѹ̡߳δκαʱҲԱΪǰ·ݵķ
+		 */
+		void start();
+
+		/**
+		 * @brief ֹ̨ͣѹ̣߳ڽеķֿɾڵǰ˳
+		 */
+		void stop();
+
+		/**
+		 * @brief ȡѹָꡣ
+		 *
+		 * @return retentionMetrics ָĸ
+		 */
+		retentionMetrics getMetrics() const;
+	};
+
+}  // namespace ems end
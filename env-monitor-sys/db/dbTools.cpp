@@ -1,70 +1,6 @@
 #include "dbTools.h"
 
 namespace ems {
-	void dbTools::executeSQL(const std::string& sql) {
-		std::unique_ptr<sql::Statement> stmt(con->createStatement());
-		stmt->execute(sql);
-	}
-
-	// ʼӵķ
-	void dbTools::initConnection(const std::string& url, const std::string& user, const std::string& password, const std::string& schema) {
-		try {
-			std::unique_lock lock(mtx);
-			sql::mysql::MySQL_Driver* driver = sql::mysql::get_mysql_driver_instance();
-			con.reset(driver->connect(url, user, password));
-			//  schema Ƿ
-			std::unique_ptr<sql::Statement> stmt(con->createStatement());
-			std::unique_ptr<sql::ResultSet> res(stmt->executeQuery("SHOW DATABASES LIKE '" + schema + "'"));
-
-			if (!res->next()) {
-				std::cout << "[dbTools]: Schema '" << schema << "' does not exist. Creating schema..." << std::endl;
-				// ȡִ SQL ļ
-				std::ifstream file(build_file_location);
-				if (!file.is_open()) {
-					throw std::runtime_error("Failed to open SQL file: " + build_file_location + " Please make sure the create table file exist.");
-				}
-
-				std::stringstream sqlStream;
-				sqlStream << file.rdbuf();  // ȡļ
-				std::string sql = sqlStream.str();
-				file.close();
-
-				// SQL";"ָΪ
-				std::istringstream sqlCommands(sql);
-				std::string singleSQL;
-				while (std::getline(sqlCommands, singleSQL, ';')) {
-					singleSQL = trim(singleSQL); // ȥǰĿհַ
-					if (!singleSQL.empty()) {
-						executeSQL(singleSQL + ";");  // ִеSQL
-					}
-				}
-
-				std::cout << "[dbTools]: Schema created successfully." << std::endl;
-			}
-
-			con->setSchema(schema);
-			std::cout << "[dbTools]: Connected to database successfully." << std::endl;
-		}
-		catch (const sql::SQLException& e) {
-			std::cerr << "[dbTools]: SQLException during connection: " << e.what()
-				<< ", MySQL Error Code: " << e.getErrorCode()
-				<< ", SQLState: " << e.getSQLState() << std::endl;
-			// throw;  // ׳쳣Աϲ㴦
-		}
-		catch (const std::exception& e) {
-			std::cerr << "[dbTools]: Error: " << e.what() << std::endl;
-			// 쳣
-		}
-	}
-
-	// ȥַ˿հַĸ
-	std::string dbTools::trim(const std::string& str) {
-		size_t first = str.find_first_not_of(" \t\n\r");
-		if (first == std::string::npos) return ""; // ȫǿհַ
-		size_t last = str.find_last_not_of(" \t\n\r");
-		return str.substr(first, (last - first + 1));
-	}
-
 	// 캯ʵ
 	dbTools::dbTools()
 	{
@@ -72,100 +8,78 @@ namespace ems {
 		esysControl& esys = esysControl::getInstance();
 
 		// ʹ esysControl ȡ
-		url = esys.getConfig("db_url");
-		user = esys.getConfig("db_user");
-		password = esys.getConfig("db_password");
-		schema = esys.getConfig("db_schema");
-		build_file_location = esys.getConfig("db_build_file_location");
 		log_operations = esys.getConfig("log_operations") == "false" ? false : true;
 
-		// ʼ
-		initConnection(url, user, password, schema);
+		// ʼӣ״ʱȱʧ schema ִǨƽűִǨʱıԪ
+		backend = dbBackend::create(true);
+		backend->setSchemaListener([this] { invalidateTableStructure(); });
+		std::string error;
+		if (!backend->open(error)) {
+			std::cerr << "[dbTools]: Error connecting to database: " << error << std::endl;
+		}
 	}
 
 	// ȡṹĺ
-	std::unordered_map<std::string, std::string> dbTools::getTableStructure(const std::string& table_name) {
+	dbTableMetaPtr dbTools::getTableStructure(const std::string& table_name) {
 		// 黺ǷбṹϢ
-		if (table_structure_cache.find(table_name) != table_structure_cache.end()) {
-			return table_structure_cache[table_name];
+		{
+			std::shared_lock lock(cache_mtx);
+			auto it = table_structure_cache.find(table_name);
+			if (it != table_structure_cache.end()) {
+				return it->second;
+			}
 		}
 		// ṹϢδ棬Ҫѯݿ
-		std::unordered_map<std::string, std::string> columns;
-		try {
-			std::shared_lock lock(mtx);
-			std::string query = "SHOW COLUMNS FROM " + table_name;
-			std::unique_ptr<sql::Statement> stmt(con->createStatement());
-			std::unique_ptr<sql::ResultSet> res(stmt->executeQuery(query));
-
-			while (res->next()) {
-				// ȡÿһеƺ
-				columns.insert(std::make_pair(res->getString("Field"), res->getString("Type")));
+		auto meta = std::make_shared<dbTableMeta>();
+		meta->table_name = table_name;
+		{
+			std::unique_lock lock(mtx);
+			std::string error;
+			if (backend->describe(table_name, meta->columns, error) != dbStatus::OK) {
+				std::cerr << "[dbTools]: Error getting table structure: " << error << std::endl;
+				return nullptr;
 			}
-
-			// ṹϢ
-			table_structure_cache.insert(std::make_pair(table_name, columns));
 		}
-		catch (const sql::SQLException& e) {
-			std::cerr << "[dbTools]: Error getting table structure: " << e.what() << std::endl;
+		if (meta->columns.empty()) return nullptr;
+
+		// ԤͳõSQLƬ
+		for (size_t i = 0; i < meta->columns.size(); ++i) {
+			meta->index[meta->columns[i].name] = i;
+			if (i > 0) meta->column_list += ", ";
+			meta->column_list += meta->columns[i].name;
 		}
+		meta->select_prefix = "SELECT " + meta->column_list + " FROM " + table_name;
 
+		// ṹϢ߳ȻʹеĶ
+		std::unique_lock lock(cache_mtx);
+		return table_structure_cache.try_emplace(table_name, std::move(meta)).first->second;
+	}
 
-		return columns;
+	void dbTools::invalidateTableStructure() {
+		std::unique_lock lock(cache_mtx);
+		table_structure_cache.clear();
 	}
 
 	// ݵĺ
 	int dbTools::dbInsert(const std::string& table_name, const std::vector<std::unordered_map<std::string, std::string>>& data) {
 		// ȡнṹ
-		std::unordered_map<std::string, std::string> columns = getTableStructure(table_name);
+		dbTableMetaPtr meta = getTableStructure(table_name);
 
-		if (columns.empty()) {
+		if (!meta) {
 			std::cerr << "[dbTools]: Error: Unable to get table structure for " << table_name << std::endl;
 			return EXIT_FAILURE;
 		}
 
 		for (auto& row : data) {
-			// SQL
-			std::string query = "INSERT INTO " + table_name + " (";
-			std::string placeholders = " VALUES (";
-			std::vector<std::string> stream_datas;
-			int colIndex = 0;
-			for (const auto& col : row) {
-				query += col.first;
-				if (col.second == "NOW()") {
-					placeholders += "NOW()";
-				}
-				else {
-					placeholders += "?";
-					stream_datas.push_back(col.second);
-				}
-				if (colIndex < row.size() - 1) {
-					query += ", ";
-					placeholders += ", ";
-				}
-				colIndex++;
-			}
-
-			query += ")" + placeholders + ")";
-
-			try {
-				std::unique_lock lock(mtx);
-				// ׼
-				std::unique_ptr<sql::PreparedStatement> pstmt(con->prepareStatement(query));
-
-				// 󶨲
-				for (size_t i = 0; i < stream_datas.size(); ++i) {
-					pstmt->setString(static_cast<int>(i + 1), stream_datas[i]);
-				}
-
-				// ִв
-				pstmt->executeUpdate();
-
-				if (log_operations) std::cout << "[dbTools]: Inserted data successfully into table " << table_name << "." << std::endl;
-			}
-			catch (const sql::SQLException& e) {
-				std::cerr << "[dbTools]: Error inserting data: " << e.what() << std::endl;
+			// ÿе룬ֵΪ "NOW()" ʹݿ⵱ǰʱ
+			std::vector<std::pair<std::string, std::string>> columns(row.begin(), row.end());
+			std::string error;
+			std::unique_lock lock(mtx);
+			if (backend->insert(table_name, { { &columns, 0 } }, error) != dbStatus::OK) {
+				std::cerr << "[dbTools]: Error inserting data: " << error << std::endl;
 				return EXIT_FAILURE;
 			}
+			if (log_operations) std::cout << "[dbTools]: Inserted data successfully into table " << table_name << "." << std::endl;
 		}
 		return EXIT_SUCCESS;
 	}
@@ -175,54 +89,68 @@ namespace ems {
 		return dbInsert(table_name, _data);
 	}
 
+	// еһתΪֵӳ䣬ݾɽӿʹ
+	static void appendRowAsMap(const dbRowBuffer& row, std::vector<std::unordered_map<std::string, std::string>>& data) {
+		std::unordered_map<std::string, std::string> item;
+		for (size_t i = 0; i < row.size(); ++i) {
+			item[row.column(i)] = row.value(i);
+		}
+		data.push_back(std::move(item));
+	}
+
 	// ȡݵĺ
 	int dbTools::dbRead(const std::string& table_name, std::vector<std::unordered_map<std::string, std::string>>& data, unsigned int count_row) {
-		// ȡнṹ
-		std::unordered_map<std::string, std::string> columns = getTableStructure(table_name);
+		return dbReadEach(table_name, "", count_row, [&data](const dbRowBuffer& row) {
+			appendRowAsMap(row, data);
+			return true;
+			});
+	}
 
-		if (columns.empty()) {
+	int dbTools::dbReadEach(const std::string& table_name, const std::string& client_ip, unsigned int count_row, const dbRowCallback& on_row, uint64_t before_eid) {
+		dbTableMetaPtr meta = getTableStructure(table_name);
+		if (!meta) {
 			std::cerr << "[dbTools]: Error: Unable to get table structure for " << table_name << std::endl;
 			return EXIT_FAILURE;
 		}
+		// ȷдкɸѡ
+		if (!meta->has("eid")) {
+			std::cerr << "[dbTools]: Error: Table " << table_name << " does not have 'eid' column for ordering." << std::endl;
+			return EXIT_FAILURE;
+		}
+		if (!client_ip.empty() && !meta->has("clientIP")) {
+			std::cerr << "[dbTools]: Error: Table " << table_name << " does not have 'clientIP' column for filtering." << std::endl;
+			return EXIT_FAILURE;
+		}
 
-		try {
-			// ȷдΪ "eid" У滻ΪʵҪ
-			if (columns.find("eid") == columns.end()) {
-				std::cerr << "[dbTools]: Error: Table does not have 'eid' column for ordering." << std::endl;
-				return EXIT_FAILURE;
-			}
+		//  'eid' ȡÿиͬһֵṹе˳
+		dbSelect query;
+		query.filter_column = client_ip.empty() ? "" : "clientIP";
+		query.filter_value = client_ip;
+		query.count_row = count_row;
+		query.before_eid = before_eid;
 
-			// ѯ䣬 'eid' 򣬲ƽ
-			std::string query = "SELECT * FROM " + table_name + " ORDER BY eid DESC";
-			if (count_row > 0) {
-				query += " LIMIT " + std::to_string(count_row);
-			}
-			{
-				std::unique_lock lock(mtx);
-				std::unique_ptr<sql::Statement> stmt(con->createStatement());
-				std::unique_ptr<sql::ResultSet> res(stmt->executeQuery(query));
-
-				while (res->next()) {
-					std::unordered_map<std::string, std::string> row;
-					for (const auto& column : columns) {
-						row[column.first] = res->getString(column.first);
-					}
-					data.push_back(row);
-				}
-			}
-			
+		dbRowBuffer row;
+		row.meta = meta;
+		row.values.resize(meta->columns.size());
 
-			if (log_operations) std::cout << "[dbTools]: Read " << data.size() << " rows from table " << table_name << "." << std::endl;
-		}
-		catch (const sql::SQLException& e) {
-			std::cerr << "[dbTools]: Error reading data: " << e.what() << std::endl;
-			return EXIT_FAILURE;
+		size_t rows = 0;
+		{
+			std::unique_lock lock(mtx);
+			std::string error;
+			if (backend->select(*meta, query, row.values, [&] { return on_row(row); }, rows, error) != dbStatus::OK) {
+				std::cerr << "[dbTools]: Error reading data: " << error << std::endl;
+				return EXIT_FAILURE;
+			}
 		}
 
+		if (log_operations) {
+			std::cout << "[dbTools]: Read " << rows << " rows";
+			if (!client_ip.empty()) std::cout << " for clientIP '" << client_ip << "'";
+			std::cout << " from table " << table_name << "." << std::endl;
+		}
 		return EXIT_SUCCESS;
 	}
 
-
 	int dbTools::dbRead(const std::string& table_name, std::unordered_map<std::string, std::string>& data) {
 		unsigned int count_row = 1;
 		std::vector<std::unordered_map<std::string, std::string>> _data;
@@ -238,46 +166,14 @@ namespace ems {
 	}
 
 	int dbTools::dbReadByClientIP(const std::string& table_name, const std::string& client_ip, std::vector<std::unordered_map<std::string, std::string>>& data, unsigned int count_row) {
-		// ȡнṹ
-		std::unordered_map<std::string, std::string> columns = getTableStructure(table_name);
-
-		if (columns.empty()) {
-			std::cerr << "[dbTools]: Error: Unable to get table structure for " << table_name << std::endl;
+		if (client_ip.empty()) {
+			std::cerr << "[dbTools]: Error: Empty clientIP for filtering." << std::endl;
 			return EXIT_FAILURE;
 		}
-
-		try {
-			// ȷдΪ "ClientIP" У滻ΪʵҪɸѡ
-			if (columns.find("clientIP") == columns.end()) {
-				std::cerr << "[dbTools]: Error: Table does not have 'clientIP' column for filtering." << std::endl;
-				return EXIT_FAILURE;
-			}
-
-			// ѯ䣬 'eid' 򣬲ɸѡ 'ClientIP'
-			std::string query = "SELECT * FROM " + table_name + " WHERE clientIP = '" + client_ip + "' ORDER BY eid DESC";
-			if (count_row > 0) {
-				query += " LIMIT " + std::to_string(count_row);
-			}
-			{
-				std::unique_lock lock(mtx);
-				std::unique_ptr<sql::Statement> stmt(con->createStatement());
-				std::unique_ptr<sql::ResultSet> res(stmt->executeQuery(query));
-				while (res->next()) {
-					std::unordered_map<std::string, std::string> row;
-					for (const auto& column : columns) {
-						row[column.first] = res->getString(column.first);
-					}
-					data.push_back(row);
-				}
-			}
-			if (log_operations) std::cout << "[dbTools]: Read " << data.size() << " rows for clientIP '" << client_ip << "' from table " << table_name << "." << std::endl;
-		}
-		catch (const sql::SQLException& e) {
-			std::cerr << "[dbTools]: Error reading data: " << e.what() << std::endl;
-			return EXIT_FAILURE;
-		}
-
-		return EXIT_SUCCESS;
+		return dbReadEach(table_name, client_ip, count_row, [&data](const dbRowBuffer& row) {
+			appendRowAsMap(row, data);
+			return true;
+			});
 	}
 
 	int dbTools::dbReadByClientIP(const std::string& table_name, const std::string& client_ip, std::unordered_map<std::string, std::string>& data) {
@@ -294,40 +190,63 @@ namespace ems {
 		return result;
 	}
 
+	int dbTools::dbReadAll(const std::string& table_name, std::vector<std::unordered_map<std::string, std::string>>& data) {
+		// ȡнṹ
+		dbTableMetaPtr meta = getTableStructure(table_name);
 
+		if (!meta) {
+			std::cerr << "[dbTools]: Error: Unable to get table structure for " << table_name << std::endl;
+			return EXIT_FAILURE;
+		}
+
+		// ȫȡ򣬰洢˳򷵻
+		dbSelect query;
+		query.ordered = false;
+
+		dbRowBuffer row;
+		row.meta = meta;
+		row.values.resize(meta->columns.size());
+
+		size_t rows = 0;
+		std::string error;
+		std::unique_lock lock(mtx);
+		if (backend->select(*meta, query, row.values, [&] { appendRowAsMap(row, data); return true; }, rows, error) != dbStatus::OK) {
+			std::cerr << "[dbTools]: Error reading data: " << error << std::endl;
+			return EXIT_FAILURE;
+		}
+		if (log_operations) std::cout << "[dbTools]: Read " << rows << " rows from table " << table_name << "." << std::endl;
+
+		return EXIT_SUCCESS;
+	}
+
+	int dbTools::dbUpdate(const std::string& table_name, const std::unordered_map<std::string, std::string>& data, const std::string& key_column, const std::string& key_value) {
+		if (data.empty()) return EXIT_SUCCESS;
+
+		std::string error;
+		std::unique_lock lock(mtx);
+		if (backend->update(table_name, data, key_column, key_value, error) != dbStatus::OK) {
+			std::cerr << "[dbTools]: Error updating data: " << error << std::endl;
+			return EXIT_FAILURE;
+		}
+		if (log_operations) std::cout << "[dbTools]: Updated table " << table_name << " where " << key_column << " = '" << key_value << "'." << std::endl;
+		return EXIT_SUCCESS;
+	}
 
 	int dbTools::dbDistinctSelect(const std::string& table_name, const std::string& attribute, std::vector<std::string>& data)
 	{
 		// ȡнṹ
-		std::unordered_map<std::string, std::string> columns = getTableStructure(table_name);
+		dbTableMetaPtr meta = getTableStructure(table_name);
 
-		if (columns.empty()) {
+		if (!meta) {
 			std::cerr << "[dbTools]: Error: Unable to get table structure for " << table_name + "." << std::endl;
 			return EXIT_FAILURE;
 		}
 
-		bool get_attribute = false;
-		for (auto& it : columns) {
-			if (attribute == it.first) {
-				get_attribute = true;
-				break;
-			}
-		}
-		if (get_attribute) {
-			try
-			{
-				std::shared_lock lock(mtx);
-				std::string query = "SELECT DISTINCT " + attribute + " FROM " + table_name;
-
-				std::unique_ptr<sql::Statement> stmt(con->createStatement());
-				std::unique_ptr<sql::ResultSet> res(stmt->executeQuery(query));
-
-				while (res->next()) {
-					data.push_back(res->getString(attribute));
-				}
-			}
-			catch (const sql::SQLException& e) {
-				std::cerr << "[dbTools]: Error reading data: " << e.what() << std::endl;
+		if (meta->has(attribute)) {
+			std::string error;
+			std::unique_lock lock(mtx);
+			if (backend->distinct(table_name, attribute, data, error) != dbStatus::OK) {
+				std::cerr << "[dbTools]: Error reading data: " << error << std::endl;
 				return EXIT_FAILURE;
 			}
 		}
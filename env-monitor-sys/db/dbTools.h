@@ -14,43 +14,88 @@
 
 #pragma once
 
-// MySQLӺͲͷļ
-#include <jdbc/mysql_driver.h>
-#include <jdbc/mysql_connection.h>
-#include <jdbc/cppconn/prepared_statement.h>
-#include <jdbc/cppconn/statement.h>
-#include <jdbc/cppconn/resultset.h>
-#include <jdbc/cppconn/exception.h>
 #include <iostream>
 #include <memory>
 #include <unordered_map>
 #include <string>
 #include <vector>
+#include <map>
+#include <functional>
 #include <fstream>
 #include <sstream>
 #include <stdexcept>
+#include <shared_mutex>
 #include "../esys/esysControl.h"  // Զ
+#include "dbBackend.h"
 
 namespace ems {  // namespace ems start
 
+	/**
+	 * @class dbRowBuffer
+	 * @brief ʽȡʱõл
+	 *
+	 * ڴ򿪽ʱһΣ֮ÿһеֵдͬһַ
+	 * صõֻڱλصЧ
+	 */
+	class dbRowBuffer {
+	private:
+		dbTableMetaPtr meta;				// ӦıԪ
+		std::vector<std::string> values;	// ǰеֵ meta->columns һһӦ
+
+		friend class dbTools;
+
+	public:
+		/**
+		 * @brief ȡ
+		 * @return size_t 
+		 */
+		size_t size() const { return values.size(); }
+
+		/**
+		 * @brief ȡָŵ
+		 * @param index ţ 0 ʼ
+		 * @return const std::string& 
+		 */
+		const std::string& column(size_t index) const { return meta->columns[index].name; }
+
+		/**
+		 * @brief ȡǰָŵֵ
+		 * @param index ţ 0 ʼ
+		 * @return const std::string& ֵ
+		 */
+		const std::string& value(size_t index) const { return values[index]; }
+
+		/**
+		 * @brief ţӦѭһκʹ value(index)
+		 * @param column 
+		 * @return size_t ţʱ std::string::npos
+		 */
+		size_t indexOf(const std::string& column) const {
+			auto it = meta->index.find(column);
+			return it != meta->index.end() ? it->second : std::string::npos;
+		}
+	};
+
+	/**
+	 * @brief ʽȡлص false ʱֹͣȡ
+	 */
+	using dbRowCallback = std::function<bool(const dbRowBuffer&)>;
+
 	/**
 	 * @class dbTools
 	 * @brief ڴݿĹ֧࣬ݿӡ롢ȡѯȲ
 	 */
 	class dbTools {
 	private:
-		// MySQLӶ
-		std::unique_ptr<sql::Connection> con;
+		// 洢ˣdb_backend = fake ʱΪڵģݿ⣬Ϊ MySQL 
+		std::unique_ptr<dbBackend> backend;
 		// ڻṹϢӳ
-		std::unordered_map<std::string, std::unordered_map<std::string, std::string>> table_structure_cache;
+		std::unordered_map<std::string, dbTableMetaPtr> table_structure_cache;
+		// ṹĶд
+		std::shared_mutex cache_mtx;
 
-		std::string url;				// ݿURL
-		std::string user;				// ݿû
-		std::string password;			// ݿ
-		std::string schema;				// ʹõݿschema
-		std::string build_file_location;// ݿļλ
 		bool log_operations;			// Ƿ¼־
-		std::shared_mutex mtx;			// ͬ
+		std::shared_mutex mtx;			// 洢˵
 
 		/**
 		 * @brief ˽й캯ʼݿӡ
@@ -72,28 +117,6 @@ namespace ems {  // namespace ems start
 		 */
 		dbTools& operator=(const dbTools&) = delete;
 
-		/**
-		 * @brief ִSQL䡣
-		 * @param sql ҪִеSQLַ
-		 */
-		void executeSQL(const std::string& sql);
-
-		/**
-		 * @brief ʼݿӡ
-		 * @param url ݿURL
-		 * @param user ݿû
-		 * @param password ݿ롣
-		 * @param schema ʹõݿschema
-		 */
-		void initConnection(const std::string& url, const std::string& user, const std::string& password, const std::string& schema);
-
-		/**
-		 * @brief ȥַ˵Ŀո
-		 * @param str Ҫȥոַ
-		 * @return std::string ȥոַ
-		 */
-		std::string trim(const std::string& str);
-
 	public:
 		/**
 		 * @brief ȡdbToolsĵʵ
@@ -109,10 +132,15 @@ namespace ems {  // namespace ems start
 		 * @brief ȡָĽṹϢ
 		 *
 		 * @param table_name 
-		 * @return std::unordered_map<std::string, std::string> ͸͵Ĺϣ
-		 * @note ṹѻ棬ֱӴӻлȡ
+		 * @return dbTableMetaPtr ԪݣȡʧʱΪա
+		 * @note ÿűֻѯһݿ⣬ֱ֮ӷػĹ󣬲κο
+		 */
+		dbTableMetaPtr getTableStructure(const std::string& table_name);
+
+		/**
+		 * @brief ձṹ棬洢ִǨƺԶá
 		 */
-		std::unordered_map<std::string, std::string> getTableStructure(const std::string& table_name);
+		void invalidateTableStructure();
 
 		/**
 		 * @brief ָвݡ
@@ -151,6 +179,23 @@ namespace ems {  // namespace ems start
 		 */
 		int dbRead(const std::string& table_name, std::unordered_map<std::string, std::string>& data);
 
+		/**
+		 * @brief  eid ʽȡָеݣÿһеһλص
+		 *
+		 * ÿһдͬһл󽻸ص÷Ϊÿзӳ
+		 * صڼݿ̵߳ĶдҪȴصֻӦҪֵ
+		 * ӦлȺʱҲӦٵ dbTools ӿڡ
+		 * Ӧ before_eid ҳȡÿҳ֮ͷ
+		 *
+		 * @param table_name 
+		 * @param client_ip ͻIPΪʱɸѡ
+		 * @param count_row Ҫȡ0 ʾơ
+		 * @param on_row лص false ʱֹͣȡ
+		 * @param before_eid ֻȡ eid СڸֵУ0 ʾƣڴһҳһмȡ
+		 * @return int ɹ EXIT_SUCCESSʧܷ EXIT_FAILURE
+		 */
+		int dbReadEach(const std::string& table_name, const std::string& client_ip, unsigned int count_row, const dbRowCallback& on_row, uint64_t before_eid = 0);
+
 		/**
 		 * @brief ݿͻIPָжȡݡ
 		 *
@@ -172,6 +217,26 @@ namespace ems {  // namespace ems start
 		 */
 		int dbReadByClientIP(const std::string& table_name, const std::string& client_ip, std::unordered_map<std::string, std::string>& data);
 
+		/**
+		 * @brief ָжȡݣ豸С
+		 *
+		 * @param table_name 
+		 * @param data ڴ洢ȡݵãvector<map<string , string ֵ>>
+		 * @return int ɹ EXIT_SUCCESSʧܷ EXIT_FAILURE
+		 */
+		int dbReadAll(const std::string& table_name, std::vector<std::unordered_map<std::string, std::string>>& data);
+
+		/**
+		 * @brief ָ key_column = key_value С
+		 *
+		 * @param table_name 
+		 * @param data Ҫµкֵunordered_map<string , string ֵ>ֵΪ "NOW()" ʱʹݿ⵱ǰʱ䡣
+		 * @param key_column 
+		 * @param key_value еֵ
+		 * @return int ɹ EXIT_SUCCESSʧܷ EXIT_FAILURE
+		 */
+		int dbUpdate(const std::string& table_name, const std::unordered_map<std::string, std::string>& data, const std::string& key_column, const std::string& key_value);
+
 		/**
 		 * @brief ָвѯԵΨһֵ
 		 *
@@ -0,0 +1,360 @@
+#include "dbWriter.h"
+
+namespace ems {
+
+	dbWriter::dbWriter() : batch_rows(500), flush_interval_ms(100), queue_capacity(100000), max_backoff_ms(5000),
+		head(0), inflight(0), queued(0), running(false), flush_requested(false), enqueued_seq(0), completed_seq(0), discarded_pending(0), congestion(false)
+	{
+		esysControl& esys = esysControl::getInstance();
+
+		log_operations = esys.getConfig("log_operations") == "false" ? false : true;
+		// дʹöӣǨ dbTools Ӹ
+		backend = dbBackend::create(false);
+
+		// ȡֵãʹĬֵ
+		auto readUInt = [&esys](const std::string& key, unsigned int default_value) -> unsigned int {
+			std::string value = esys.getConfig(key);
+			if (value.empty()) return default_value;
+			try {
+				return static_cast<unsigned int>(std::stoul(value));
+			}
+			catch (const std::exception&) {
+				std::cerr << "[dbWriter]: Invalid value \"" << value << "\" for " << key << ", use " << default_value << "." << std::endl;
+				return default_value;
+			}
+		};
+		batch_rows = readUInt("writer_batch_rows", 500);
+		flush_interval_ms = readUInt("writer_flush_interval_ms", 100);
+		queue_capacity = readUInt("writer_queue_capacity", 100000);
+		max_backoff_ms = readUInt("writer_retry_max_backoff_ms", 5000);
+		if (batch_rows == 0) batch_rows = 1;
+		if (flush_interval_ms == 0) flush_interval_ms = 1;
+		if (max_backoff_ms < flush_interval_ms) max_backoff_ms = flush_interval_ms;
+		if (queue_capacity < batch_rows) queue_capacity = batch_rows;
+		high_watermark = readUInt("writer_high_watermark", static_cast<unsigned int>(queue_capacity / 5 * 4));
+		low_watermark = readUInt("writer_low_watermark", static_cast<unsigned int>(queue_capacity / 5));
+		if (high_watermark == 0 || high_watermark > queue_capacity) high_watermark = queue_capacity;
+		if (low_watermark >= high_watermark) low_watermark = high_watermark / 2;
+		metrics.high_watermark = high_watermark;
+		metrics.low_watermark = low_watermark;
+		// Ŷӵ queue_capacity УŻضԵռ batch_rows λ
+		slots.resize(queue_capacity + batch_rows);
+	}
+
+	dbWriter::~dbWriter()
+	{
+		stop();
+	}
+
+	bool dbWriter::prepare()
+	{
+		std::string error;
+		if (backend->open(error)) return true;
+		std::cerr << "[dbWriter]: Error connecting to database: " << error << std::endl;
+		return false;
+	}
+
+	void dbWriter::start()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			if (running) return;
+			running = true;
+		}
+		worker = std::thread(&dbWriter::workerLoop, this);
+		std::cout << "[dbWriter]: Writer started, batch " << batch_rows << " rows, flush every "
+			<< flush_interval_ms << " ms." << std::endl;
+	}
+
+	void dbWriter::stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			if (!running) return;
+			running = false;
+		}
+		cv.notify_all();
+		if (worker.joinable()) worker.join();
+		std::cout << "[dbWriter]: Writer stopped." << std::endl;
+	}
+
+	// ˳иƵ row Умϲʱÿһдͬһλãַֻʱ
+	template <typename Map>
+	static void fillRow(const Map& data, std::vector<const typename Map::value_type*>& order,
+		std::pair<std::string, std::string>* columns)
+	{
+		order.clear();
+		for (const auto& column : data) order.push_back(&column);
+		std::sort(order.begin(), order.end(), [](const auto* a, const auto* b) { return a->first < b->first; });
+		for (size_t i = 0; i < order.size(); ++i) {
+			columns[i].first.assign(order[i]->first.data(), order[i]->first.size());
+			columns[i].second.assign(order[i]->second.data(), order[i]->second.size());
+		}
+	}
+
+	int dbWriter::enqueue(const std::string& table_name, const std::unordered_map<std::string, std::string>& data)
+	{
+		thread_local pendingRow scratch;
+		thread_local std::vector<const std::unordered_map<std::string, std::string>::value_type*> order;
+		scratch.table_name = table_name;
+		scratch.columns.resize(data.size());
+		fillRow(data, order, scratch.columns.data());
+		return push(scratch);
+	}
+
+	int dbWriter::enqueue(const std::string& table_name, const fieldMap& data)
+	{
+		thread_local pendingRow scratch;
+		thread_local std::vector<const fieldMap::value_type*> order;
+		scratch.table_name = table_name;
+		scratch.columns.resize(data.size());
+		fillRow(data, order, scratch.columns.data());
+		return push(scratch);
+	}
+
+	int dbWriter::push(pendingRow& row)
+	{
+		row.enqueued_at = std::time(nullptr);
+
+		bool wake = false;
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			if (queued >= queue_capacity) {
+				metrics.dropped++;
+				return EXIT_FAILURE;
+			}
+			std::swap(slotAt(inflight + queued), row);
+			queued++;
+			enqueued_seq++;
+			metrics.enqueued++;
+			metrics.queue_depth = queued;
+			metrics.max_queue_depth = std::max(metrics.max_queue_depth, metrics.queue_depth);
+			wake = queued == batch_rows;
+			if (!congestion.load(std::memory_order_relaxed) && enqueued_seq - completed_seq >= high_watermark) {
+				congestion.store(true, std::memory_order_relaxed);
+				metrics.congestion_events++;
+				std::cerr << "[dbWriter]: Backlog reached " << enqueued_seq - completed_seq << " rows, ingest is throttled." << std::endl;
+			}
+		}
+		if (wake) cv.notify_one();
+		return EXIT_SUCCESS;
+	}
+
+	bool dbWriter::flush(unsigned int timeout_ms)
+	{
+		std::unique_lock<std::mutex> lock(mtx);
+		uint64_t target = enqueued_seq;
+		if (completed_seq >= target) return true;
+		flush_requested = true;
+		cv.notify_all();
+		return drained_cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this, target] { return completed_seq >= target; });
+	}
+
+	uint64_t dbWriter::discard()
+	{
+		uint64_t discarded;
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			discarded = queued;
+			queued = 0;
+			metrics.dropped += discarded;
+			metrics.queue_depth = 0;
+			discarded_pending += discarded;
+		}
+		// д֮ɺ̨߳д굱ǰһ completed_seq
+		cv.notify_all();
+		return discarded;
+	}
+
+	void dbWriter::workerLoop()
+	{
+		unsigned int backoff_ms = 0;
+		std::vector<pendingRow*> rows;
+		std::vector<size_t> retry;
+		while (true) {
+			size_t taken;
+			bool stopping;
+			{
+				std::unique_lock<std::mutex> lock(mtx);
+				cv.wait_for(lock, std::chrono::milliseconds(flush_interval_ms), [this] {
+					return !running || flush_requested || discarded_pending > 0 || queued >= batch_rows;
+					});
+				// ÿȡ batch_rows УһʧӰһѹһд룻
+				// ȡڲλУֻ߳д inflight + queued ֮Ĳλ
+				taken = std::min(queued, static_cast<size_t>(batch_rows));
+				inflight = taken;
+				queued -= taken;
+				rows.clear();
+				for (size_t i = 0; i < taken; ++i) rows.push_back(&slotAt(i));
+				stopping = !running;
+				if (queued == 0) flush_requested = false;
+				metrics.queue_depth = queued;
+			}
+
+			uint64_t requeued = 0;
+			uint64_t abandoned = 0;
+			if (taken > 0) {
+				auto start_time = std::chrono::steady_clock::now();
+				uint64_t written = 0;
+				retry.clear();
+				if (backend->isOpen() || prepare()) {
+					written = writeBatch(rows, retry);
+				}
+				else {
+					for (size_t i = 0; i < taken; ++i) retry.push_back(i);
+				}
+				uint64_t elapsed = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+					std::chrono::steady_clock::now() - start_time).count());
+
+				std::lock_guard<std::mutex> lock(mtx);
+				if (!retry.empty() && stopping) {
+					// ֹͣݿԲãһͶʣУùرڵȴ
+					abandoned = retry.size() + queued;
+					discarded_pending += queued;
+					head = (head + taken + queued) % slots.size();
+					queued = 0;
+					metrics.dropped += abandoned;
+					std::cerr << "[dbWriter]: Database unavailable while stopping, dropped " << abandoned << " rows." << std::endl;
+				}
+				else {
+					// δдаԭ˳Ƶһĩβڵȴд֮ǰֱдɹݿܾ
+					size_t keep = taken;
+					for (size_t i = taken, r = retry.size(); i-- > 0;) {
+						if (r == 0 || retry[r - 1] != i) continue;
+						--r;
+						if (--keep != i) std::swap(slotAt(i), slotAt(keep));
+					}
+					requeued = retry.size();
+					head = (head + taken - requeued) % slots.size();
+					queued += requeued;
+				}
+				inflight = 0;
+				// ʧʱȴʱ䷭дɹָд
+				backoff_ms = requeued == 0 ? 0 : std::min(max_backoff_ms, backoff_ms == 0 ? flush_interval_ms : backoff_ms * 2);
+				metrics.written += written;
+				metrics.failed += taken - written - retry.size();
+				metrics.requeued += requeued;
+				metrics.retry_backoff_ms = backoff_ms;
+				metrics.flushes++;
+				metrics.last_flush_ms = elapsed;
+				metrics.last_flush_rows = taken;
+				metrics.queue_depth = queued;
+			}
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				completed_seq += taken - requeued + discarded_pending;
+				discarded_pending = 0;
+				if (congestion.load(std::memory_order_relaxed) && enqueued_seq - completed_seq <= low_watermark) {
+					congestion.store(false, std::memory_order_relaxed);
+					std::cout << "[dbWriter]: Backlog fell to " << enqueued_seq - completed_seq << " rows, ingest resumed." << std::endl;
+				}
+			}
+			drained_cv.notify_all();
+
+			// ӹʱ˱ʱȴԣݿָǰתֹͣʱһ
+			if (requeued > 0) {
+				std::unique_lock<std::mutex> lock(mtx);
+				cv.wait_for(lock, std::chrono::milliseconds(backoff_ms), [this] { return !running; });
+			}
+
+			// ֹͣʱѭֱвʣ
+			if (stopping && taken == 0) break;
+		}
+		backend->close();
+	}
+
+	uint64_t dbWriter::writeBatch(const std::vector<pendingRow*>& rows, std::vector<size_t>& retry)
+	{
+		// мϷ飬"NOW()" еǣڱ˳
+		std::map<std::string, std::vector<size_t>> groups;
+		for (size_t i = 0; i < rows.size(); ++i) {
+			std::string key = rows[i]->table_name + "(";
+			for (const auto& column : rows[i]->columns) {
+				key += column.first;
+				key += column.second == "NOW()" ? "*," : ",";
+			}
+			groups[key].push_back(i);
+		}
+
+		uint64_t written = 0;
+		uint64_t statements = 0;
+		std::vector<bool> done(rows.size(), false);
+		dbStatus result = dbStatus::OK;
+		std::string error;
+		for (auto group = groups.begin(); group != groups.end() && result != dbStatus::RETRY; ++group) {
+			const std::vector<size_t>& indexes = group->second;
+			for (size_t begin = 0; begin < indexes.size() && result != dbStatus::RETRY; begin += batch_rows) {
+				size_t end = std::min(indexes.size(), begin + static_cast<size_t>(batch_rows));
+				result = insertRows(rows, indexes, begin, end, error);
+				if (result == dbStatus::OK) {
+					for (size_t r = begin; r < end; ++r) done[indexes[r]] = true;
+					written += end - begin;
+					statements++;
+					continue;
+				}
+				if (result == dbStatus::RETRY) break;
+
+				// 䱻ܾʱдֻУ豸ݲӰ
+				std::cerr << "[dbWriter]: Statement for " << rows[indexes[begin]]->table_name << " rejected (" << error
+					<< "), retrying " << end - begin << " rows one by one." << std::endl;
+				for (size_t r = begin; r < end; ++r) {
+					result = insertRows(rows, indexes, r, r + 1, error);
+					if (result == dbStatus::RETRY) break;
+					done[indexes[r]] = true;
+					if (result == dbStatus::OK) {
+						written++;
+						statements++;
+					}
+					else {
+						std::cerr << "[dbWriter]: Dropped a row for " << rows[indexes[r]]->table_name << ": " << error << std::endl;
+					}
+				}
+			}
+		}
+
+		if (result == dbStatus::RETRY) {
+			for (size_t i = 0; i < rows.size(); ++i) {
+				if (!done[i]) retry.push_back(i);
+			}
+			std::cerr << "[dbWriter]: Write interrupted (" << error << "), " << retry.size() << " rows will be retried." << std::endl;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			metrics.batches += statements;
+		}
+		if (log_operations) std::cout << "[dbWriter]: Wrote " << written << " rows in " << statements << " statements." << std::endl;
+		return written;
+	}
+
+	dbStatus dbWriter::insertRows(const std::vector<pendingRow*>& rows, const std::vector<size_t>& indexes, size_t begin, size_t end, std::string& error)
+	{
+		// һеһһ𱻾ܾ"NOW()" ʹøеʱ
+		std::vector<dbInsertRow> statement_rows;
+		statement_rows.reserve(end - begin);
+		for (size_t r = begin; r < end; ++r) {
+			statement_rows.push_back({ &rows[indexes[r]]->columns, rows[indexes[r]]->enqueued_at });
+		}
+		return backend->insert(rows[indexes[begin]]->table_name, statement_rows, error);
+	}
+
+	writerMetrics dbWriter::getMetrics() const
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		writerMetrics result = metrics;
+		result.queue_depth = queued;
+		result.backlog = enqueued_seq - completed_seq;
+		result.congested = congestion.load(std::memory_order_relaxed);
+		return result;
+	}
+
+	bool dbWriter::waitUncongested(unsigned int timeout_ms)
+	{
+		std::unique_lock<std::mutex> lock(mtx);
+		// ÿдһ֪ͨ drained_cvдֹͣٵȴ
+		return drained_cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this] {
+			return !congestion.load(std::memory_order_relaxed) || !running;
+			});
+	}
+
+}  // namespace ems
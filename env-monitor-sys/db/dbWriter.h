@@ -0,0 +1,257 @@
+/**
+ * @file dbWriter.h
+ * @author Yilin Wang (yilin233@foxmail.com)
+ * @brief Asynchronous database writer, queues rows from the hot path and inserts
+ *  them in multi-row batches inside a transaction on its own connection.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2024 Yilin Wang
+ *
+ * MIT License
+ */
+
+
+#pragma once
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <ctime>
+#include "../esys/messageArena.h"
+#include "../esys/esysControl.h"  // Զ
+#include "dbBackend.h"
+
+namespace ems {  // namespace ems start
+
+	/**
+	 * @struct writerMetrics
+	 * @brief 첽дָꡣ
+	 */
+	struct writerMetrics {
+		uint64_t enqueued = 0;			///< ۼӵ
+		uint64_t written = 0;			///< ۼдɹ
+		uint64_t failed = 0;			///< ۼдʧܵ
+		uint64_t requeued = 0;			///< ӹϷŻضԵд
+		uint64_t dropped = 0;			///< رʱֹʱֹͣ޷д
+		uint64_t retry_backoff_ms = 0;	///< ǰԵȴʱ䣨룩дɹ㡣
+		uint64_t batches = 0;			///< ۼƳɹִеĲ
+		uint64_t flushes = 0;			///< ۼƴӶȡ
+		uint64_t queue_depth = 0;		///< ǰе
+		uint64_t max_queue_depth = 0;	///< еʷ
+		uint64_t last_flush_ms = 0;		///< һύĺʱ룩
+		uint64_t last_flush_rows = 0;	///< һύ
+		uint64_t backlog = 0;			///< ӵδϵдС
+		uint64_t high_watermark = 0;	///< ѹﵽʱӵ״̬
+		uint64_t low_watermark = 0;		///< ӵѹʱӵ
+		bool congested = false;			///< ǰǷӵ״̬
+		uint64_t congestion_events = 0;	///< ۼƽӵ״̬Ĵ
+	};
+
+	/**
+	 * @class dbWriter
+	 * @brief 첽д
+	 *
+	 * ÷ֻзڴУ̨߳ÿ writer_flush_interval_ms дﵽ writer_batch_rows ʱ
+	 * Ӷȡ writer_batch_rows УмϷ飬ÿһ INSERTԶύ
+	 * ݴ󱻾ܾʱΪв룬ֻУӶϿȿԵĴδдзŻضף
+	 * ޴ԣʧʱȴʱ writer_flush_interval_ms ÿη writer_retry_max_backoff_ms 롣
+	 * ݿⳤʱ䲻ʱѹӵ״̬ writer_queue_capacity ƽնˣǶӵС
+	 * ֹֻͣ޷двŻᶪ dropped
+	 *
+	 * ԤȷĻβλֱڲλд룬̨߳ڲλԭش߳ȰиƵ߳Լ
+	 * ݴУʱλľһεݴ棬ֵַѭʹã
+	 * мͬڶתһȦ֮ʱڴ档
+	 * ֵΪ "NOW()" мΪʱ䣬дʱ䡣дʹöݿӣռ dbTools 
+	 *
+	 * ѹӵδд꣩ﵽ writer_high_watermark ʱӵ״̬ writer_low_watermark ʱ
+	 * ն˾ݴͣȡӻԺԣʹݿдʱӳٲۻ
+	 */
+	class dbWriter {
+	private:
+		/**
+		 * @brief еһС
+		 */
+		struct pendingRow {
+			std::string table_name;										///< 
+			std::vector<std::pair<std::string, std::string>> columns;	///< ֵ
+			std::time_t enqueued_at;									///< ʱ䣬滻 "NOW()"
+		};
+
+		std::unique_ptr<dbBackend> backend;	///< дռĴ洢ӡ
+		unsigned int batch_rows;				///< ÿ INSERT ҲǰѺ̵̨߳Ķгȡ
+		unsigned int flush_interval_ms;			///< д֮룩
+		size_t queue_capacity;					///< еʱС
+		unsigned int max_backoff_ms;			///< ʱȴʱޣ룩
+		uint64_t high_watermark;				///< ӵ״̬Ļѹ
+		uint64_t low_watermark;					///< ӵ״̬Ļѹ
+		bool log_operations;					///< Ƿ¼־
+
+		std::vector<pendingRow> slots;			///< ζеĲλ writer_queue_capacity + writer_batch_rows 
+		size_t head;							///< һУдУڵĲλ
+		size_t inflight;						///<  head ɺ̨߳д
+		size_t queued;							///< д֮ȴд
+		std::thread worker;						///< ̨д̡߳
+		mutable std::mutex mtx;					///< С״ָ̬Ļ
+		std::condition_variable cv;				///< Ѻ̨̡߳
+		std::condition_variable drained_cv;		///< ֪ͨȴ flush ̡߳
+		bool running;							///< ̨߳ǷС
+		bool flush_requested;					///< Ƿ߳ڵȴ flush򲻵д롣
+		uint64_t enqueued_seq;					///< ӵš
+		uint64_t completed_seq;					///< Ѵϣɹʧܣš
+		uint64_t discarded_pending;				///< Ѷδ completed_seq 
+		writerMetrics metrics;					///< ָ꣬й mtx
+		std::atomic<bool> congestion;			///< Ƿӵ״̬ mtx ޸ģ·ȡ
+
+		/**
+		 * @brief ˽й캯ȡдá
+		 */
+		dbWriter();
+
+		/**
+		 * @brief ˽дʣвֹ̨̡ͣ߳
+		 */
+		~dbWriter();
+
+		/**
+		 * @brief ɾ캯
+		 */
+		dbWriter(const dbWriter&) = delete;
+
+		/**
+		 * @brief ɾֵ
+		 */
+		dbWriter& operator=(const dbWriter&) = delete;
+
+		/**
+		 * @brief дݿӡ
+		 *
+		 * @return bool ɹ true
+		 */
+		bool prepare();
+
+		/**
+		 * @brief ̨߳ѭ
+		 */
+		void workerLoop();
+
+		/**
+		 * @brief ȡ head  offset ڵĲλ
+		 */
+		pendingRow& slotAt(size_t offset) { return slots[(head + offset) % slots.size()]; }
+
+		/**
+		 * @brief дһУÿ䵥ύ
+		 *
+		 * @param rows дУָдĲλ
+		 * @param retry ԵĴδд rows е±꣬С
+		 * @return uint64_t дɹ
+		 */
+		uint64_t writeBatch(const std::vector<pendingRow*>& rows, std::vector<size_t>& retry);
+
+		/**
+		 * @brief һ INSERT дһмͬС
+		 *
+		 * @param rows еС
+		 * @param indexes  rows е±ꡣ
+		 * @param begin д indexes ʼλá
+		 * @param end д indexes Ľλã
+		 * @param error ʧʱԭ
+		 * @return dbStatus Ľ
+		 */
+		dbStatus insertRows(const std::vector<pendingRow*>& rows, const std::vector<size_t>& indexes, size_t begin, size_t end, std::string& error);
+
+		/**
+		 * @brief еβĿղλдС
+		 *
+		 * @param row дУʱΪλлľУΪһεݴС
+		 * @return int ӳɹ EXIT_SUCCESS EXIT_FAILURE
+		 */
+		int push(pendingRow& row);
+
+	public:
+		/**
+		 * @brief ȡdbWriterĵʵ
+		 *
+		 * @return dbWriter& ʵá
+		 */
+		static dbWriter& getInstance() {
+			static dbWriter instance;
+			return instance;
+		}
+
+		/**
+		 * @brief ̨д̡߳
+		 */
+		void start();
+
+		/**
+		 * @brief дʣкֹ̨ͣд̡߳
+		 */
+		void stop();
+
+		/**
+		 * @brief һздУء
+		 *
+		 * @param table_name 
+		 * @param data ֵӳ䣬ֵΪ "NOW()" ʱдʱ䡣
+		 * @return int ӳɹ EXIT_SUCCESS EXIT_FAILURE
+		 */
+		int enqueue(const std::string& table_name, const std::unordered_map<std::string, std::string>& data);
+
+		/**
+		 * @brief Ϣ·һздУֵƵУdata ڷغͷš
+		 *
+		 * @param table_name 
+		 * @param data ֵӳ䣬ֵΪ "NOW()" ʱдʱ䡣
+		 * @return int ӳɹ EXIT_SUCCESS EXIT_FAILURE
+		 */
+		int enqueue(const std::string& table_name, const fieldMap& data);
+
+		/**
+		 * @brief ȴǰӵжѴϡ
+		 *
+		 * @param timeout_ms ȴʱ䣨룩
+		 * @return bool ȫϷ trueʱ false
+		 */
+		bool flush(unsigned int timeout_ms);
+
+		/**
+		 * @brief δʼдУ droppedڹرʱֹʱ
+		 *
+		 * @return uint64_t 
+		 */
+		uint64_t discard();
+
+		/**
+		 * @brief ȡдָꡣ
+		 *
+		 * @return writerMetrics ָĸ
+		 */
+		writerMetrics getMetrics() const;
+
+		/**
+		 * @brief Ƿӵ״̬
+		 *
+		 * @return bool ѹˮλδˮλʱ true
+		 */
+		bool congested() const { return congestion.load(std::memory_order_relaxed); }
+
+		/**
+		 * @brief ȴӵ
+		 *
+		 * @param timeout_ms ȴʱ䣨룩
+		 * @return bool δӵ״̬ trueʱ false
+		 */
+		bool waitUncongested(unsigned int timeout_ms);
+	};
+
+}  // namespace ems end
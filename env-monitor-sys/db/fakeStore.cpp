@@ -0,0 +1,447 @@
+#include "fakeStore.h"
+#include "../esys/esysControl.h"
+
+namespace ems {
+
+	// ȥַ˿հַĸ
+	static std::string trimSQL(const std::string& str) {
+		size_t first = str.find_first_not_of(" \t\n\r");
+		if (first == std::string::npos) return "";
+		size_t last = str.find_last_not_of(" \t\n\r");
+		return str.substr(first, (last - first + 1));
+	}
+
+	// ֻת ASCII ַעеĶֲַֽ
+	static std::string upperSQL(std::string str) {
+		for (auto& c : str) {
+			if (c >= 'a' && c <= 'z') c = static_cast<char>(c - 'a' + 'A');
+		}
+		return str;
+	}
+
+	static std::string lowerSQL(std::string str) {
+		for (auto& c : str) {
+			if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+		}
+		return str;
+	}
+
+	// ȥʶķźֵ
+	static std::string unquoteSQL(const std::string& str) {
+		if (str.size() >= 2 && (str.front() == '`' || str.front() == '\'' || str.front() == '"') && str.back() == str.front()) {
+			return str.substr(1, str.size() - 2);
+		}
+		return str;
+	}
+
+	fakeStore::fakeStore() : latency_us(1000), jitter_us(0), failure_rate(0), max_rows(100000),
+		round_trips(0), failures(0), injected_us(0), rows_inserted(0), rows_evicted(0)
+	{
+		esysControl& esys = esysControl::getInstance();
+
+		// ȡֵãʹĬֵ
+		auto readNumber = [&esys](const std::string& key, double default_value) -> double {
+			std::string value = esys.getConfig(key);
+			if (value.empty()) return default_value;
+			try {
+				return std::max(0.0, std::stod(value));
+			}
+			catch (const std::exception&) {
+				std::cerr << "[fakeStore]: Invalid value \"" << value << "\" for " << key << ", use " << default_value << "." << std::endl;
+				return default_value;
+			}
+		};
+		latency_us = static_cast<unsigned int>(readNumber("fake_db_latency_ms", 1) * 1000);
+		jitter_us = static_cast<unsigned int>(readNumber("fake_db_jitter_ms", 0) * 1000);
+		failure_rate = std::min(1.0, readNumber("fake_db_failure_rate", 0));
+		max_rows = static_cast<size_t>(readNumber("fake_db_max_rows", 100000));
+		rng.seed(static_cast<uint64_t>(readNumber("fake_db_seed", 1)));
+
+		// ṹȡԽļǨƽűǨƽű汾˳
+		loadSchema(esys.getConfig("db_build_file_location"));
+		std::string migration_dir = esys.getConfig("db_migration_dir");
+		if (!migration_dir.empty() && std::filesystem::is_directory(migration_dir)) {
+			std::map<int, std::filesystem::path> migrations;
+			for (const auto& entry : std::filesystem::directory_iterator(migration_dir)) {
+				if (!entry.is_regular_file() || entry.path().extension() != ".sql") continue;
+				std::string file_name = entry.path().stem().string();
+				size_t digits = file_name.find_first_not_of("0123456789");
+				if (digits == 0 || digits == std::string::npos || file_name[digits] != '_') continue;
+				migrations[std::stoi(file_name.substr(0, digits))] = entry.path();
+			}
+			for (const auto& migration : migrations) {
+				loadSchema(migration.second.string());
+			}
+		}
+
+		std::cout << "[fakeStore]: Using the in-memory database stand-in with " << tables.size() << " tables, latency "
+			<< latency_us / 1000.0 << " ms, jitter " << jitter_us / 1000.0 << " ms, failure rate " << failure_rate << "." << std::endl;
+	}
+
+	void fakeStore::loadSchema(const std::string& path) {
+		std::ifstream file(path);
+		if (!file.is_open()) {
+			std::cerr << "[fakeStore]: Failed to open SQL file \"" << path << "\"." << std::endl;
+			return;
+		}
+
+		//  dbTools::executeSQLFile ͬ "--" ͷעУ ";" ָ
+		std::string sql;
+		std::string line;
+		while (std::getline(file, line)) {
+			if (trimSQL(line).rfind("--", 0) == 0) continue;
+			sql += line + "\n";
+		}
+
+		std::istringstream statements(sql);
+		std::string statement;
+		while (std::getline(statements, statement, ';')) {
+			statement = trimSQL(statement);
+			if (upperSQL(statement.substr(0, 12)) == "CREATE TABLE") {
+				parseCreateTable(statement);
+			}
+		}
+	}
+
+	void fakeStore::parseCreateTable(const std::string& statement) {
+		size_t open = statement.find('(');
+		size_t close = statement.rfind(')');
+		if (open == std::string::npos || close == std::string::npos || close < open) return;
+
+		std::string name = trimSQL(statement.substr(12, open - 12));
+		if (upperSQL(name).rfind("IF NOT EXISTS", 0) == 0) {
+			name = trimSQL(name.substr(13));
+		}
+		name = unquoteSQL(name.substr(name.find('.') == std::string::npos ? 0 : name.find('.') + 1));
+		// IF NOT EXISTS 壬Ѵڵıֲ
+		if (name.empty() || tables.count(name)) return;
+
+		// źڵĶŷָж壬CHAR(16)嵥עеĶŲᱻֿ
+		std::vector<std::string> items;
+		std::string item;
+		int depth = 0;
+		bool quoted = false;
+		for (size_t i = open + 1; i < close; ++i) {
+			char c = statement[i];
+			if (c == '\'') quoted = !quoted;
+			else if (!quoted && c == '(') depth++;
+			else if (!quoted && c == ')') depth--;
+			else if (!quoted && depth == 0 && c == ',') {
+				items.push_back(trimSQL(item));
+				item.clear();
+				continue;
+			}
+			item += c;
+		}
+		items.push_back(trimSQL(item));
+
+		fakeTable table;
+		for (const auto& definition : items) {
+			std::istringstream words(definition);
+			std::string column_name, column_type;
+			words >> column_name >> column_type;
+			std::string keyword = upperSQL(column_name);
+			if (column_name.empty() || keyword == "PRIMARY" || keyword == "INDEX" || keyword == "KEY" || keyword == "UNIQUE"
+				|| keyword == "CONSTRAINT" || keyword == "FOREIGN" || keyword == "FULLTEXT") continue;
+
+			fakeColumn column;
+			column.name = unquoteSQL(column_name);
+			column.type = lowerSQL(column_type);
+			std::string upper_definition = upperSQL(definition);
+			size_t default_pos = upper_definition.find(" DEFAULT ");
+			if (default_pos != std::string::npos) {
+				std::istringstream value(definition.substr(default_pos + 9));
+				std::string default_value;
+				value >> default_value;
+				std::string upper_value = upperSQL(default_value);
+				if (upper_value == "CURRENT_TIMESTAMP" || upper_value == "NOW()") column.default_value = "NOW()";
+				else if (upper_value != "NULL") column.default_value = unquoteSQL(default_value);
+			}
+
+			size_t index = table.columns.size();
+			if (upper_definition.find("AUTO_INCREMENT") != std::string::npos) table.auto_column = index;
+			else if (upper_definition.find("PRIMARY KEY") != std::string::npos) table.key_column = index;
+			table.index[column.name] = index;
+			table.types.push_back(parseType(column.type));
+			table.columns.push_back(std::move(column));
+		}
+		if (table.columns.empty()) return;
+		tables.emplace(name, std::move(table));
+	}
+
+	fakeStore::fakeValueType fakeStore::parseType(const std::string& type) {
+		fakeValueType result;
+		std::string base = type.substr(0, type.find('('));
+		size_t length = 0;
+		if (base.length() < type.length()) {
+			length = static_cast<size_t>(std::strtoull(type.c_str() + base.length() + 1, nullptr, 10));
+		}
+		if (base == "tinyint") result = { fakeValueType::INTEGER, 127.0 };
+		else if (base == "smallint") result = { fakeValueType::INTEGER, 32767.0 };
+		else if (base == "mediumint") result = { fakeValueType::INTEGER, 8388607.0 };
+		else if (base == "int" || base == "integer") result = { fakeValueType::INTEGER, 2147483647.0 };
+		else if (base == "bigint") result = { fakeValueType::INTEGER, 9223372036854775807.0 };
+		else if (base == "float") result = { fakeValueType::REAL, 3.402823466e38 };
+		else if (base == "double" || base == "real" || base == "decimal" || base == "numeric") {
+			result = { fakeValueType::REAL, (std::numeric_limits<double>::max)() };
+		}
+		else if (base == "datetime" || base == "timestamp" || base == "date") result.kind = fakeValueType::DATETIME;
+		else if (base == "char" || base == "varchar") result.length = length;
+		return result;
+	}
+
+	bool fakeStore::checkValue(const fakeColumn& column, const fakeValueType& type, const std::string& value, size_t row, std::string& error) {
+		const std::string at = " for column '" + column.name + "' at row " + std::to_string(row);
+		switch (type.kind) {
+		case fakeValueType::INTEGER:
+		case fakeValueType::REAL: {
+			// MySQL ֻʮ֣strtod ܵ infnan ʮﱻܾ
+			bool digits = value.find_first_of("0123456789") != std::string::npos;
+			bool plain = value.find_first_not_of("0123456789+-.eE \t") == std::string::npos;
+			char* end = nullptr;
+			double number = digits && plain ? std::strtod(value.c_str(), &end) : 0;
+			if (!digits || !plain || trimSQL(end).length() > 0) {
+				error = std::string("Incorrect ") + (type.kind == fakeValueType::INTEGER ? "integer" : "double")
+					+ " value: '" + value + "'" + at;
+				return false;
+			}
+			if (type.kind == fakeValueType::INTEGER) number = std::round(number);
+			if (!std::isfinite(number) || std::fabs(number) > type.limit) {
+				error = "Out of range value" + at;
+				return false;
+			}
+			return true;
+		}
+		case fakeValueType::DATETIME: {
+			// Ҫ "YYYY-MM-DD" ʽڲ
+			bool valid = value.length() >= 10 && value[4] == '-' && value[7] == '-';
+			for (size_t i : { 0, 1, 2, 3, 5, 6, 8, 9 }) {
+				valid = valid && value[i] >= '0' && value[i] <= '9';
+			}
+			if (!valid) {
+				error = "Incorrect datetime value: '" + value + "'" + at;
+				return false;
+			}
+			return true;
+		}
+		default: {
+			if (type.length == 0) return true;
+			// ַUTF-8 ĺֽڲ
+			size_t characters = 0;
+			for (char c : value) {
+				if ((static_cast<unsigned char>(c) & 0xC0) != 0x80) characters++;
+			}
+			if (characters > type.length) {
+				error = "Data too long" + at;
+				return false;
+			}
+			return true;
+		}
+		}
+	}
+
+	bool fakeStore::enabled() {
+		static const bool fake = esysControl::getInstance().getConfig("db_backend") == "fake";
+		return fake;
+	}
+
+	std::string fakeStore::formatTime(std::time_t time) {
+		std::tm local_time;
+		if (localtime_s(&local_time, &time) != 0) return "";
+		std::ostringstream oss;
+		oss << std::put_time(&local_time, "%Y-%m-%d %H:%M:%S");
+		return oss.str();
+	}
+
+	bool fakeStore::roundTrip(std::string& error) {
+		int64_t delay_us = latency_us;
+		bool fail = false;
+		if (jitter_us > 0 || failure_rate > 0) {
+			std::lock_guard<std::mutex> lock(rng_mtx);
+			if (jitter_us > 0) {
+				delay_us += std::uniform_int_distribution<int64_t>(-static_cast<int64_t>(jitter_us), jitter_us)(rng);
+			}
+			if (failure_rate > 0) {
+				fail = std::uniform_real_distribution<double>(0.0, 1.0)(rng) < failure_rate;
+			}
+		}
+
+		if (delay_us > 0) {
+			// Windows ĬϵĶʱԼΪ 15.6 룬ֻ˯ߵֹʱǰһʱڣ
+			// ʣʱóʱƬȴǺ뼶ӳҲ׼ȷע
+			auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(delay_us);
+			if (delay_us > 16000) std::this_thread::sleep_for(std::chrono::microseconds(delay_us - 16000));
+			while (std::chrono::steady_clock::now() < deadline) std::this_thread::yield();
+			injected_us.fetch_add(static_cast<uint64_t>(delay_us), std::memory_order_relaxed);
+		}
+		round_trips.fetch_add(1, std::memory_order_relaxed);
+
+		if (fail) {
+			failures.fetch_add(1, std::memory_order_relaxed);
+			error = "Injected failure (fake_db_failure_rate)";
+			return false;
+		}
+		return true;
+	}
+
+	bool fakeStore::describe(const std::string& table_name, std::vector<fakeColumn>& columns) {
+		std::shared_lock lock(mtx);
+		auto it = tables.find(table_name);
+		if (it == tables.end()) return false;
+		columns = it->second.columns;
+		return true;
+	}
+
+	bool fakeStore::insert(const std::string& table_name, const fakeRow& row, std::time_t now, std::string& error) {
+		return insert(table_name, std::vector<fakeInsertRow>{ { &row, now } }, error);
+	}
+
+	bool fakeStore::insert(const std::string& table_name, const std::vector<fakeInsertRow>& rows, std::string& error) {
+		std::unique_lock lock(mtx);
+		auto it = tables.find(table_name);
+		if (it == tables.end()) {
+			error = "Table '" + table_name + "' doesn't exist";
+			return false;
+		}
+		fakeTable& table = it->second;
+
+		// ɲеУκһгʱ䶼룬ʵݿеԭһ
+		std::vector<std::vector<std::string>> staged;
+		staged.reserve(rows.size());
+		std::unordered_set<std::string> staged_keys;
+		uint64_t next_id = table.next_id;
+		for (const auto& insert_row : rows) {
+			std::string now_text;
+			auto value_of = [&now_text, &insert_row](const std::string& value) -> const std::string& {
+				if (value != "NOW()") return value;
+				if (now_text.empty()) now_text = formatTime(insert_row.now);
+				return now_text;
+			};
+
+			std::vector<std::string> values(table.columns.size());
+			for (size_t i = 0; i < table.columns.size(); ++i) {
+				values[i] = value_of(table.columns[i].default_value);
+			}
+			for (const auto& column : *insert_row.row) {
+				auto index = table.index.find(column.first);
+				if (index == table.index.end()) {
+					error = "Unknown column '" + column.first + "' in 'field list'";
+					return false;
+				}
+				values[index->second] = value_of(column.second);
+				if (!checkValue(table.columns[index->second], table.types[index->second], values[index->second], staged.size() + 1, error)) {
+					return false;
+				}
+			}
+
+			if (table.auto_column != std::string::npos && values[table.auto_column].empty()) {
+				values[table.auto_column] = std::to_string(next_id++);
+			}
+			if (table.key_column != std::string::npos) {
+				const std::string& key = values[table.key_column];
+				if (table.keys.count(key) || !staged_keys.insert(key).second) {
+					error = "Duplicate entry '" + key + "' for key 'PRIMARY'";
+					return false;
+				}
+			}
+			staged.push_back(std::move(values));
+		}
+
+		table.next_id = next_id;
+		for (auto& values : staged) {
+			if (table.key_column != std::string::npos) table.keys.insert(values[table.key_column]);
+			table.rows.push_back(std::move(values));
+		}
+		rows_inserted.fetch_add(staged.size(), std::memory_order_relaxed);
+		while (max_rows != 0 && table.rows.size() > max_rows) {
+			if (table.key_column != std::string::npos) table.keys.erase(table.rows.front()[table.key_column]);
+			table.rows.pop_front();
+			rows_evicted.fetch_add(1, std::memory_order_relaxed);
+		}
+		return true;
+	}
+
+	bool fakeStore::select(const std::string& table_name, const std::string& filter_column, const std::string& filter_value,
+		unsigned int count_row, const fakeRowCallback& on_row, std::string& error) {
+		std::shared_lock lock(mtx);
+		auto it = tables.find(table_name);
+		if (it == tables.end()) {
+			error = "Table '" + table_name + "' doesn't exist";
+			return false;
+		}
+		const fakeTable& table = it->second;
+
+		size_t filter = std::string::npos;
+		if (!filter_column.empty()) {
+			auto index = table.index.find(filter_column);
+			if (index == table.index.end()) {
+				error = "Unknown column '" + filter_column + "' in 'where clause'";
+				return false;
+			}
+			filter = index->second;
+		}
+
+		// а˳򱣴棬еΪн
+		unsigned int rows = 0;
+		for (auto row = table.rows.rbegin(); row != table.rows.rend(); ++row) {
+			if (filter != std::string::npos && (*row)[filter] != filter_value) continue;
+			if (!on_row(*row)) break;
+			if (count_row > 0 && ++rows >= count_row) break;
+		}
+		return true;
+	}
+
+	bool fakeStore::update(const std::string& table_name, const std::unordered_map<std::string, std::string>& data,
+		const std::string& key_column, const std::string& key_value, std::string& error) {
+		std::string now_text = formatTime(std::time(nullptr));
+
+		std::unique_lock lock(mtx);
+		auto it = tables.find(table_name);
+		if (it == tables.end()) {
+			error = "Table '" + table_name + "' doesn't exist";
+			return false;
+		}
+		fakeTable& table = it->second;
+
+		auto key = table.index.find(key_column);
+		if (key == table.index.end()) {
+			error = "Unknown column '" + key_column + "' in 'where clause'";
+			return false;
+		}
+		std::vector<std::pair<size_t, const std::string*>> assignments;
+		for (const auto& column : data) {
+			auto index = table.index.find(column.first);
+			if (index == table.index.end()) {
+				error = "Unknown column '" + column.first + "' in 'field list'";
+				return false;
+			}
+			assignments.emplace_back(index->second, column.second == "NOW()" ? &now_text : &column.second);
+			if (!checkValue(table.columns[index->second], table.types[index->second], *assignments.back().second, 1, error)) {
+				return false;
+			}
+		}
+
+		for (auto& row : table.rows) {
+			if (row[key->second] != key_value) continue;
+			for (const auto& assignment : assignments) {
+				if (assignment.first == table.key_column) {
+					table.keys.erase(row[assignment.first]);
+					table.keys.insert(*assignment.second);
+				}
+				row[assignment.first] = *assignment.second;
+			}
+		}
+		return true;
+	}
+
+	fakeStoreMetrics fakeStore::getMetrics() const {
+		fakeStoreMetrics result;
+		result.round_trips = round_trips.load(std::memory_order_relaxed);
+		result.failures = failures.load(std::memory_order_relaxed);
+		result.injected_us = injected_us.load(std::memory_order_relaxed);
+		result.rows_inserted = rows_inserted.load(std::memory_order_relaxed);
+		result.rows_evicted = rows_evicted.load(std::memory_order_relaxed);
+		return result;
+	}
+
+}  // namespace ems
@@ -0,0 +1,282 @@
+/**
+ * @file fakeStore.h
+ * @author Yilin Wang (yilin233@foxmail.com)
+ * @brief In-process stand-in for the MySQL server, keeps rows in memory and injects
+ *  latency, jitter and failures so dbTools and dbWriter can be benchmarked without a database.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2024 Yilin Wang
+ *
+ * MIT License
+ */
+
+
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
+#include <shared_mutex>
+#include <mutex>
+#include <atomic>
+#include <random>
+#include <thread>
+#include <chrono>
+#include <ctime>
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace ems {  // namespace ems start
+
+	/**
+	 * @struct fakeColumn
+	 * @brief еһС
+	 */
+	struct fakeColumn {
+		std::string name;			///< 
+		std::string type;			///< Сдͣ SHOW COLUMNS  Type һ£ "char(16)"
+		std::string default_value;	///< DEFAULT ӾֵûʱΪա
+	};
+
+	/**
+	 * @struct fakeStoreMetrics
+	 * @brief ģݿָꡣ
+	 */
+	struct fakeStoreMetrics {
+		uint64_t round_trips = 0;		///< ۼƵ
+		uint64_t failures = 0;			///< ۼעʧܴ
+		uint64_t injected_us = 0;		///< ۼעӳ٣΢룩
+		uint64_t rows_inserted = 0;		///< ۼƲ
+		uint64_t rows_evicted = 0;		///< 򳬹 fake_db_max_rows ľ
+	};
+
+	/**
+	 * @brief һдݣֵֵΪ "NOW()" ʱʹòʱ䡣
+	 */
+	using fakeRow = std::vector<std::pair<std::string, std::string>>;
+
+	/**
+	 * @struct fakeInsertRow
+	 * @brief һвеһС
+	 */
+	struct fakeInsertRow {
+		const fakeRow* row;		///< ֵ
+		std::time_t now;		///< 滻 "NOW()" ʱ䡣
+	};
+
+	/**
+	 * @brief ȡʱлصΪж˳еֵ false ʱֹͣȡ
+	 */
+	using fakeRowCallback = std::function<bool(const std::vector<std::string>&)>;
+
+	/**
+	 * @class fakeStore
+	 * @brief ݿĽdb_backend = fake ʱ fakeBackend  MySQL ʹá
+	 *
+	 * ṹ db_build_file_location  db_migration_dir е CREATE TABLE 
+	 * ֱ֧ĿõĲ롢 eid ȡɰ clientIP ɸѡȫȡͰ¡
+	 * дֵͼ飬ַ inf дֵСΧַ͸ʽʱ
+	 * ʹʧܣ MySQL ϸģʽһ£ѹгʵݿͬ
+	 * ÿһһύȵȴ fake_db_latency_ms Ӽ fake_db_jitter_ms ľȶ
+	 *  fake_db_failure_rate ĸʧܣ fake_db_seed ʼͬĸÿεõͬʧС
+	 * ÿűౣ fake_db_max_rows УʱɵУʱѹʱڴ治
+	 * ALTER TABLEͶģ⣬ݱڸģʽ²
+	 */
+	class fakeStore {
+	private:
+		/**
+		 * @brief ͵õȡֵ MySQL ϸģʽ¾ֵܾһ¡
+		 */
+		struct fakeValueType {
+			enum kindType { TEXT, INTEGER, REAL, DATETIME } kind = TEXT;	///< ֵ
+			double limit = 0;		///< ֵеֵ
+			size_t length = 0;		///< ַеַ0 ʾơ
+		};
+
+		/**
+		 * @brief ڴеһű
+		 */
+		struct fakeTable {
+			std::vector<fakeColumn> columns;						///< ˳еС
+			std::vector<fakeValueType> types;						///<  columns һһӦȡֵ
+			std::unordered_map<std::string, size_t> index;			///<  columns ±ӳ䡣
+			size_t auto_column = std::string::npos;					///< AUTO_INCREMENT е±ꡣ
+			size_t key_column = std::string::npos;					///< ĵ±꣬ʱظ
+			uint64_t next_id = 1;									///< һֵ
+			std::deque<std::vector<std::string>> rows;				///< ˳еС
+			std::unordered_set<std::string> keys;					///< Ѵڵֵ
+		};
+
+		std::unordered_map<std::string, fakeTable> tables;	///< ӳ䡣
+		std::shared_mutex mtx;								///< бĶд
+
+		unsigned int latency_us;		///< ÿĹ̶ӳ٣΢룩
+		unsigned int jitter_us;			///< ӳٵĶȣ΢룩
+		double failure_rate;			///< ÿʧܵĸʡ
+		size_t max_rows;				///< ÿű0 ʾơ
+		std::mt19937_64 rng;			///< עӳٺʧܵ
+		std::mutex rng_mtx;				///< 
+
+		std::atomic<uint64_t> round_trips;		///< 
+		std::atomic<uint64_t> failures;			///< עʧܴ
+		std::atomic<uint64_t> injected_us;		///< עӳ٣΢룩
+		std::atomic<uint64_t> rows_inserted;	///< 
+		std::atomic<uint64_t> rows_evicted;		///< ľ
+
+		/**
+		 * @brief ˽й캯ȡò䡣
+		 */
+		fakeStore();
+
+		/**
+		 * @brief ˽
+		 */
+		~fakeStore() = default;
+
+		/**
+		 * @brief ɾ캯
+		 */
+		fakeStore(const fakeStore&) = delete;
+
+		/**
+		 * @brief ɾֵ
+		 */
+		fakeStore& operator=(const fakeStore&) = delete;
+
+		/**
+		 * @brief  SQL ļе CREATE TABLE 䣬Ѵڵıᱻǡ
+		 *
+		 * @param path SQLļ·
+		 */
+		void loadSchema(const std::string& path);
+
+		/**
+		 * @brief һ CREATE TABLE 䡣
+		 *
+		 * @param statement ȥעͺ䡣
+		 */
+		void parseCreateTable(const std::string& statement);
+
+		/**
+		 * @brief ʽΪ DATETIME ַ
+		 */
+		static std::string formatTime(std::time_t time);
+
+		/**
+		 * @brief ͣ "float""char(16)""tinyint(1)"
+		 */
+		static fakeValueType parseType(const std::string& type);
+
+		/**
+		 * @brief деֵַinfnan дֵкͳַܾ
+		 *
+		 * @param column ж塣
+		 * @param type еȡֵ
+		 * @param value Ҫдֵ
+		 * @param row ֵڵкţ 1 ʼڴϢ
+		 * @param error ʧʱԭ MySQL ĴϢʽһ¡
+		 * @return bool ֵд뷵 true
+		 */
+		static bool checkValue(const fakeColumn& column, const fakeValueType& type, const std::string& value, size_t row, std::string& error);
+
+	public:
+		/**
+		 * @brief ȡfakeStoreĵʵ
+		 *
+		 * @return fakeStore& ʵá
+		 */
+		static fakeStore& getInstance() {
+			static fakeStore instance;
+			return instance;
+		}
+
+		/**
+		 * @brief ǷΪʹģݿ⣨db_backend = fake
+		 */
+		static bool enabled();
+
+		/**
+		 * @brief ģһȴעӳ٣ʧʾǷʧܡ
+		 *
+		 * @param error ʧʱԭ
+		 * @return bool ɹ true
+		 */
+		bool roundTrip(std::string& error);
+
+		/**
+		 * @brief ȡУ൱ SHOW COLUMNS
+		 *
+		 * @param table_name 
+		 * @param columns У˳С
+		 * @return bool ڷ true
+		 */
+		bool describe(const std::string& table_name, std::vector<fakeColumn>& columns);
+
+		/**
+		 * @brief һУɵ÷ɹá
+		 *
+		 * @param table_name 
+		 * @param row ֵ
+		 * @param now 滻 "NOW()" ʱ䡣
+		 * @param error ʧʱԭ򣨱вڡֵͲظ
+		 * @return bool ɹ true
+		 */
+		bool insert(const std::string& table_name, const fakeRow& row, std::time_t now, std::string& error);
+
+		/**
+		 * @brief һУκһгʱж룬
+		 *
+		 * @param table_name 
+		 * @param rows С
+		 * @param error ʧʱԭ
+		 * @return bool ɹ true
+		 */
+		bool insert(const std::string& table_name, const std::vector<fakeInsertRow>& rows, std::string& error);
+
+		/**
+		 * @brief ˳µɶȡУ൱ڰнѯ
+		 *
+		 * صڼжصвӦٵ fakeStore дӿڡ
+		 *
+		 * @param table_name 
+		 * @param filter_column ɸѡУΪʱɸѡ
+		 * @param filter_value ɸѡеֵ
+		 * @param count_row Ҫȡ0 ʾơ
+		 * @param on_row лص
+		 * @param error ʧʱԭ
+		 * @return bool ɹ true
+		 */
+		bool select(const std::string& table_name, const std::string& filter_column, const std::string& filter_value,
+			unsigned int count_row, const fakeRowCallback& on_row, std::string& error);
+
+		/**
+		 * @brief  key_column = key_value У
+		 *
+		 * @param table_name 
+		 * @param data ҪµкֵֵΪ "NOW()" ʱʹõǰʱ䡣
+		 * @param key_column 
+		 * @param key_value еֵ
+		 * @param error ʧʱԭ
+		 * @return bool ɹ true
+		 */
+		bool update(const std::string& table_name, const std::unordered_map<std::string, std::string>& data,
+			const std::string& key_column, const std::string& key_value, std::string& error);
+
+		/**
+		 * @brief ȡָꡣ
+		 */
+		fakeStoreMetrics getMetrics() const;
+	};
+
+}  // namespace ems end
@@ -0,0 +1,128 @@
+#include "alarmEvents.h"
+#include "esysControl.h"
+
+namespace ems {
+
+	void alarmEventLog::configure(size_t capacity, bool persist_events) {
+		std::lock_guard<std::mutex> lock(mtx);
+		ring.assign(capacity > 0 ? capacity : 1, alarmEvent());
+		next_id = 1;
+		persist = persist_events;
+	}
+
+	void alarmEventLog::push(alarmEvent event) {
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			if (ring.empty()) ring.resize(1024);
+			event.id = next_id++;
+			ring[(event.id - 1) % ring.size()] = event;
+		}
+		if (!persist) return;
+
+		// ־ûд߳ɣֻѽṹֶתΪֵ
+		std::unordered_map<std::string, std::string> row;
+		row["clientIP"] = event.clientIP;
+		row["rule_name"] = event.rule;
+		row["metric"] = event.metric;
+		if (!std::isnan(event.value)) row["value"] = std::to_string(event.value);
+		row["threshold"] = std::to_string(event.threshold);
+		row["from_state"] = alarmStateName(event.from);
+		row["to_state"] = alarmStateName(event.to);
+		row["event_time"] = formatTime(event.time_ms);
+		row["started_at"] = formatTime(event.since_ms);
+		dbWriter::getInstance().enqueue("alarm_events", row);
+	}
+
+	std::vector<alarmEvent> alarmEventLog::query(const std::string& clientIP, size_t limit) const {
+		std::lock_guard<std::mutex> lock(mtx);
+		std::vector<alarmEvent> result;
+		if (ring.empty()) return result;
+		uint64_t count = std::min<uint64_t>(next_id - 1, ring.size());
+		for (uint64_t i = 0; i < count && result.size() < limit; ++i) {
+			const alarmEvent& event = ring[(next_id - 2 - i) % ring.size()];
+			if (event.id != next_id - 1 - i) break;  // ӿջָʱû
+			if (clientIP.empty() || event.clientIP == clientIP) result.push_back(event);
+		}
+		return result;
+	}
+
+	uint64_t alarmEventLog::version() const {
+		std::lock_guard<std::mutex> lock(mtx);
+		return next_id;
+	}
+
+	void alarmEventLog::save(snapshotWriter& out) const {
+		std::lock_guard<std::mutex> lock(mtx);
+		out.put(next_id);
+		uint64_t count = ring.empty() ? 0 : std::min<uint64_t>(next_id - 1, ring.size());
+		out.put(count);
+		for (uint64_t id = next_id - count; id < next_id; ++id) saveEvent(out, ring[(id - 1) % ring.size()]);
+	}
+
+	bool alarmEventLog::restore(snapshotReader& in) {
+		std::lock_guard<std::mutex> lock(mtx);
+		uint64_t saved_next_id = in.get<uint64_t>();
+		uint64_t count = in.get<uint64_t>();
+		if (ring.empty()) ring.resize(1024);
+		// Ӿɵµ˳ŻأСʱ¼Ǿ¼
+		for (uint64_t n = 0; n < count && in.ok(); ++n) {
+			alarmEvent event = restoreEvent(in);
+			if (event.id == 0 || event.id >= saved_next_id) return false;
+			ring[(event.id - 1) % ring.size()] = std::move(event);
+		}
+		if (!in.ok()) return false;
+		next_id = std::max(next_id, saved_next_id);
+		return true;
+	}
+
+	void alarmEventLog::saveEvent(snapshotWriter& out, const alarmEvent& event) {
+		out.put(event.id);
+		out.putString(event.clientIP);
+		out.putString(event.rule);
+		out.putString(event.metric);
+		out.put(event.value);
+		out.put(event.threshold);
+		out.put(event.from);
+		out.put(event.to);
+		out.put(event.time_ms);
+		out.put(event.since_ms);
+	}
+
+	alarmEvent alarmEventLog::restoreEvent(snapshotReader& in) {
+		alarmEvent event;
+		event.id = in.get<uint64_t>();
+		event.clientIP = in.getString();
+		event.rule = in.getString();
+		event.metric = in.getString();
+		event.value = in.get<double>();
+		event.threshold = in.get<double>();
+		event.from = in.get<alarmState>();
+		event.to = in.get<alarmState>();
+		event.time_ms = in.get<int64_t>();
+		event.since_ms = in.get<int64_t>();
+		return event;
+	}
+
+	std::string alarmEventLog::formatTime(int64_t time_ms) {
+		char buffer[32];
+		return std::string(buffer, formatTime(time_ms, buffer, sizeof(buffer)));
+	}
+
+	size_t alarmEventLog::formatTime(int64_t time_ms, char* buffer, size_t size) {
+		std::time_t seconds = static_cast<std::time_t>(time_ms / 1000);
+		std::tm local_time;
+		if (localtime_s(&local_time, &seconds) != 0) return 0;
+		return std::strftime(buffer, size, "%Y-%m-%d %H:%M:%S", &local_time);
+	}
+
+	const char* alarmStateName(alarmState state) {
+		switch (state) {
+		case alarmState::NORMAL: return "normal";
+		case alarmState::PENDING: return "pending";
+		case alarmState::ACTIVE: return "active";
+		case alarmState::RECOVERING: return "recovering";
+		}
+		return "unknown";
+	}
+
+}  // namespace ems
@@ -0,0 +1,145 @@
+/**
+ * @file alarmEvents.h
+ * @author Yilin Wang (yilin233@foxmail.com)
+ * @brief Alarm event history, keeps the latest alarm transitions in a fixed-size
+ *  ring buffer and persists them to the alarm_events table through dbWriter.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2024 Yilin Wang
+ *
+ * MIT License
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+#include "stateSnapshot.h"
+
+namespace ems {
+
+    /**
+     * @brief 豸ı״̬
+     */
+    enum class alarmState : uint8_t {
+        NORMAL,     ///< 
+        PENDING,    ///< ѳĴδﵽ alarm_trip_samples
+        ACTIVE,     ///< С
+        RECOVERING  ///<  alarm_clear_samples ΣʱδﵽҪ
+    };
+
+    /**
+     * @struct alarmEvent
+     * @brief һ¼Ӧһ״̬תеһ
+     */
+    struct alarmEvent {
+        uint64_t id = 0;            ///< ¼ţ 1 ʼ
+        std::string clientIP;       ///< 豸 IP ַ
+        std::string rule;           ///< 
+        std::string metric;         ///< еһȽʽõָ꣬ "temperature""mean(smoke)"
+        double value = 0;           ///< תʱֵָȱʧʱΪ NaN
+        double threshold = 0;       ///< ñȽʽĳ
+        alarmState from = alarmState::NORMAL;   ///< תǰ״̬
+        alarmState to = alarmState::NORMAL;     ///< ת״̬
+        int64_t time_ms = 0;        ///< תʱ䣨UNIX 룩
+        int64_t since_ms = 0;       ///< αʼ״йʱ䣨UNIX 룩
+    };
+
+    /**
+     * @class alarmEventLog
+     * @brief ¼Ĺ̶λ
+     *
+     * ¼Խṹ屣棬ֻڲѯ־ûʱŸʽдĴ¼ȣ޹ء
+     */
+    class alarmEventLog {
+    private:
+        std::vector<alarmEvent> ring;   ///< λ
+        uint64_t next_id = 1;           ///< һ¼š
+        bool persist = true;            ///< Ƿд alarm_events 
+        mutable std::mutex mtx;         ///< Ļ
+
+    public:
+        /**
+         * @brief ûǷ־ûڵһ push ֮ǰá
+         *
+         * @param capacity 
+         * @param persist_events Ƿд alarm_events 
+         */
+        void configure(size_t capacity, bool persist_events);
+
+        /**
+         * @brief ¼һ¼ʱ¼ dbWriter 첽дݿ⡣
+         *
+         * @param event ¼id ɱ䡣
+         */
+        void push(alarmEvent event);
+
+        /**
+         * @brief ѯ¼ʱµС
+         *
+         * @param clientIP 豸 IP ַΪձʾ豸
+         * @param limit ෵ص¼
+         * @return std::vector<alarmEvent> ¼б
+         */
+        std::vector<alarmEvent> query(const std::string& clientIP, size_t limit) const;
+
+        /**
+         * @brief ȡ¼¼İ汾ţÿ¼һ¼һ
+         *
+         * @return uint64_t 汾š
+         */
+        uint64_t version() const;
+
+        /**
+         * @brief е¼һдա
+         */
+        void save(snapshotWriter& out) const;
+
+        /**
+         * @brief ӿջָ¼ظдݿ⣻Сʱֻµ¼
+         *
+         * @return bool  true
+         */
+        bool restore(snapshotReader& in);
+
+        /**
+         * @brief һ¼дա
+         */
+        static void saveEvent(snapshotWriter& out, const alarmEvent& event);
+
+        /**
+         * @brief ӿնȡһ¼
+         */
+        static alarmEvent restoreEvent(snapshotReader& in);
+
+        /**
+         * @brief  UNIX ʱʽΪ "YYYY-MM-DD HH:MM:SS" ʽıʱ䡣
+         *
+         * @param time_ms UNIX ʱ䡣
+         * @return std::string ʽʱ䡣
+         */
+        static std::string formatTime(int64_t time_ms);
+
+        /**
+         * @brief  UNIX ʱʽ÷ĻУڴ档
+         *
+         * @param time_ms UNIX ʱ䡣
+         * @param buffer  20 ֽڡ
+         * @param size ֽ
+         * @return size_t дַβ '\0'ʧܷ 0
+         */
+        static size_t formatTime(int64_t time_ms, char* buffer, size_t size);
+    };
+
+    /**
+     * @brief ȡ״̬ơ
+     *
+     * @param state ״̬
+     * @return const char* ״̬ "active"
+     */
+    const char* alarmStateName(alarmState state);
+
+}  // namespace ems
@@ -2,21 +2,53 @@
 
 namespace ems {
 
-	std::mutex alarmModule::mtx;
-	std::condition_variable alarmModule::cv;
-	int alarmModule::alarm_lock_duration_seconds = 10;
-	std::unordered_map<std::string, double> alarmModule::threshold;
-	std::unordered_map<std::string, std::atomic<bool>> alarmModule::reset_timer_active_ip;
-	std::unordered_map<std::string, std::atomic<bool>> alarmModule::alarm_active_ip;
-	std::unordered_map<std::string, std::unordered_map<std::string, double>> alarmModule::alarm_active_message;
-
-	alarmModule::alarmModule(): alarmMessage("") {
+	alarmModule::alarmModule() {
 		esysControl& esys = esysControl::getInstance();
+		log_operations = esys.getConfig("log_operations") == "false" ? false : true;
 		alarm_lock_duration_seconds = std::stoi(esys.getConfig("alarm_lock_duration_seconds"));
+		std::string trip = esys.getConfig("alarm_trip_samples");
+		std::string clear = esys.getConfig("alarm_clear_samples");
+		trip_samples = trip.empty() ? 1 : std::max(1, std::stoi(trip));
+		clear_samples = clear.empty() ? 1 : std::max(1, std::stoi(clear));
+		std::string history = esys.getConfig("alarm_history_size");
+		event_log.configure(history.empty() ? 1024 : std::stoul(history), esys.getConfig("alarm_persist_events") != "false");
+		loadRules();
+		if (rules.usesWindows()) {
+			std::string samples = esys.getConfig("alarm_window_samples");
+			std::string seconds = esys.getConfig("alarm_window_seconds");
+			std::string alpha = esys.getConfig("alarm_ewma_alpha");
+			windows.configure(samples.empty() ? 60 : std::stoul(samples),
+				seconds.empty() ? 0 : std::stod(seconds),
+				alpha.empty() ? 0.2 : std::stod(alpha));
+			// Ԥ޿ɰǣ anomaly_noise_floor_smoke = 5
+			const sensorSchema& schema = sensorSchema::getInstance();
+			std::string anomaly_alpha = esys.getConfig("anomaly_alpha");
+			std::string default_warmup = esys.getConfig("anomaly_warmup_samples");
+			std::string default_floor = esys.getConfig("anomaly_noise_floor");
+			std::vector<uint64_t> warmup(schema.size(), default_warmup.empty() ? 30 : std::stoull(default_warmup));
+			std::vector<double> noise_floor(schema.size(), default_floor.empty() ? 0.1 : std::stod(default_floor));
+			for (size_t id = 0; id < schema.size(); ++id) {
+				const std::string& sensor = schema.nameOf(static_cast<int>(id));
+				std::string sensor_warmup = esys.getConfig("anomaly_warmup_samples_" + sensor);
+				std::string sensor_floor = esys.getConfig("anomaly_noise_floor_" + sensor);
+				if (!sensor_warmup.empty()) warmup[id] = std::stoull(sensor_warmup);
+				if (!sensor_floor.empty()) noise_floor[id] = std::stod(sensor_floor);
+			}
+			windows.configureAnomaly(anomaly_alpha.empty() ? 0.05 : std::stod(anomaly_alpha), warmup, noise_floor);
+		}
+	}
+
+	void alarmModule::loadRules()
+	{
+		esysControl& esys = esysControl::getInstance();
+		const sensorSchema& schema = sensorSchema::getInstance();
 		std::string prefix_of_threshold_value = esys.getConfig("prefix_of_threshold_value");
+		std::string prefix_of_alarm_rule = esys.getConfig("prefix_of_alarm_rule");
 		size_t prefix_of_threshold_length = prefix_of_threshold_value.length();
 		// ȡļ
 		std::vector<std::string> configKeys = esys.getAllConfigKeys();
+		std::string error;
+		std::vector<std::string> unavailable;  // űʱδ֪Ĺ
 
 		for (const auto& key : configKeys) {
 			if (key.find(prefix_of_threshold_value) == 0) {  // Ƿ "threshold_" ͷ
@@ -24,116 +56,390 @@ namespace ems {
 				std::string value = esys.getConfig(key);  
 
 				if (!value.empty()) {  
-					threshold[param] = std::stod(value);
+					// ʽΪ "ֵ"  "ֵ, ֵ"
+					std::string trip_value = value.substr(0, value.find(','));
+					std::string clear_value = value.find(',') != std::string::npos ? value.substr(value.find(',') + 1) : "";
+					clear_value.erase(0, clear_value.find_first_not_of(" \t"));
+					threshold[param] = std::stod(trip_value);
+					// ֵȼڹ "param >= ֵ"Ϊ "param < ֵ"
+					if (!rules.addRule(param, param + " >= " + trip_value, "", schema, error) ||
+						(!clear_value.empty() && !rules.addClearRule(param, param + " < " + clear_value, "", schema, error))) {
+						std::cerr << "[alarmModule]: Error: Invalid threshold \"" + key + "\": " + error + "." << std::endl;
+					}
 				}
 			}
 		}
 
+		// 쳣ʱΪÿɹ "anomaly_<>"ľֵ anomaly_threshold ʱ
+		std::string anomaly_method = esys.getConfig("anomaly_method");
+		if (!anomaly_method.empty()) {
+			std::string feature = anomaly_method == "mad" ? "mzscore" : "zscore";
+			std::string limit = esys.getConfig("anomaly_threshold");
+			if (limit.empty()) limit = "4";
+			if (anomaly_method != "zscore" && anomaly_method != "mad") {
+				std::cerr << "[alarmModule]: Error: Unknown anomaly_method \"" + anomaly_method + "\", use zscore." << std::endl;
+			}
+			for (size_t id = 0; id < schema.size(); ++id) {
+				const std::string& sensor = schema.nameOf(static_cast<int>(id));
+				std::string operand = feature + "(" + sensor + ")";
+				if (!rules.addRule("anomaly_" + sensor, operand + " > " + limit + " OR " + operand + " < -" + limit, "", schema, error)) {
+					std::cerr << "[alarmModule]: Error: Invalid anomaly_threshold \"" + limit + "\": " + error + "." << std::endl;
+					break;
+				}
+			}
+		}
+
+		// ֵ֮أͬʱֵɵĹ
+		//  rule_<name> = ʽ Ϊȫֹrule_<name>@<ip> = ʽ ΪֻԸ豸Чĸǣ
+		// ڼĩβ ".clear" ʾùĽ
+		const std::string clear_suffix = ".clear";
+		for (const auto& key : configKeys) {
+			if (prefix_of_alarm_rule.empty() || key.find(prefix_of_alarm_rule) != 0) continue;
+			std::string name = key.substr(prefix_of_alarm_rule.length());
+			bool is_clear = name.length() > clear_suffix.length() &&
+				name.compare(name.length() - clear_suffix.length(), std::string::npos, clear_suffix) == 0;
+			if (is_clear) name.erase(name.length() - clear_suffix.length());
+			std::string device;
+			size_t at = name.find('@');
+			if (at != std::string::npos) {
+				device = name.substr(at + 1);
+				name = name.substr(0, at);
+			}
+			std::string expression = esys.getConfig(key);
+			if (expression.empty() && (device.empty() || is_clear)) continue;
+			bool ok = is_clear ? rules.addClearRule(name, expression, device, schema, error)
+				: rules.addRule(name, expression, device, schema, error);
+			if (ok) continue;
+			if (schema.fromConfig() && error.rfind("unknown sensor", 0) == 0) {
+				unavailable.push_back(key);
+				continue;
+			}
+			std::cerr << "[alarmModule]: Error: Invalid alarm rule \"" + key + "\": " + error + "." << std::endl;
+		}
+		rules.build();
+		std::cout << "[alarmModule]: Compiled " << rules.size() << " alarm rules." << std::endl;
+		if (schema.fromConfig()) {
+			std::string skipped;
+			for (const auto& key : unavailable) skipped += (skipped.empty() ? "" : ", ") + key;
+			std::cerr << "[alarmModule]: Warning: Running in degraded mode, envtable was unavailable at startup and only "
+				<< prefix_of_threshold_value << "* sensors are known"
+				<< (unavailable.empty() ? "." : ", skipped " + std::to_string(unavailable.size()) + " rules: " + skipped + ".")
+				<< " Restart after the database is reachable to enable all rules." << std::endl;
+		}
 	}
 
-	std::string alarmModule::alarmMonitor(const std::unordered_map<std::string, std::string>& data)
+	alarmModule::deviceAlarm& alarmModule::findOrCreate(const std::string& clientIP)
 	{
-		bool tmpalarm = false;
-		std::string clientIP = data.at("clientIP");
-		esysControl& esys = esysControl::getInstance();
-		std::string suffix_of_collected_values  = esys.getConfig("suffix_of_collected_values");
-		try {
-			for (auto& thr : threshold) {
-				if (std::stod(data.at(thr.first + suffix_of_collected_values)) >= thr.second) tmpalarm = true;
-			}
-		}
-		catch (const std::out_of_range& e) {
-			std::cerr << "[alarmModule]: Key not found in data: " << e.what() << std::endl;
-			return "error";
-		}
-		catch (const std::invalid_argument& e) {
-			std::cerr << "[alarmModule]: Invalid argument in data: " << e.what() << std::endl;
-			return "error";
-		}
-
-		if (tmpalarm || alarm_active_ip[clientIP]) {
-			std::unordered_map<std::string, double> alarm_data;
-			for (auto& thr : threshold) {
-				alarm_data[thr.first] = std::stod(data.at(thr.first + suffix_of_collected_values));
-			}
-			alarm_active_message[clientIP] = alarm_data;
-			if (!alarm_active_ip[clientIP]) {
-				std::thread alarmThread(alarmActive, clientIP);
-				alarmThread.detach();
-				while (!alarm_active_ip[clientIP]);
-			}
-			else if (tmpalarm && alarm_active_ip[clientIP]) {
-				std::lock_guard<std::mutex> lock(mtx);
-				reset_timer_active_ip[clientIP] = true;
-			}
-			std::cout << "[alarmModule]: Alarm is atcive now at [" + clientIP + "]." << std::endl;
-			bool val_not_under_threshold_exist = false;
-			
-			for (auto& it : alarm_active_message[clientIP]) {
-				if (it.second >= threshold[it.first]) {
-					val_not_under_threshold_exist = true;
-					std::stringstream ss;
-					ss << "[alarmModule]: " + it.first + suffix_of_collected_values + " is at " << it.second
-						<< ", which is should be under " << threshold[it.first] << ".";
-					alarmMessage = ss.str();
-					ss << std::endl;
-					std::cout << ss.str();
+		{
+			std::shared_lock lock(devices_mtx);
+			auto it = devices.find(clientIP);
+			if (it != devices.end()) return *it->second;
+		}
+		std::unique_lock lock(devices_mtx);
+		auto& device = devices[clientIP];
+		if (!device) device = std::make_unique<deviceAlarm>();
+		return *device;
+	}
+
+	alarmModule::deviceAlarm* alarmModule::find(const std::string& clientIP)
+	{
+		std::shared_lock lock(devices_mtx);
+		auto it = devices.find(clientIP);
+		return it != devices.end() ? it->second.get() : nullptr;
+	}
+
+	std::string alarmModule::alarmMonitor(const fieldMap& data)
+	{
+		// ÿ̸߳Լļ¼ɼֵֻһ
+		thread_local sensorRecord record;
+		sensorSchema::getInstance().parse(data, record);
+		alarmState current = process(record);
+		return current == alarmState::ACTIVE || current == alarmState::RECOVERING ? "alarm_active" : "ack";
+	}
+
+	size_t alarmModule::alarmMonitorBatch(const sensorBatch& batch, std::vector<uint64_t>& alarm_mask)
+	{
+		thread_local sensorRecord record;
+		thread_local std::vector<uint64_t> tripped;
+		rules.evaluateBatch(batch, tripped);
+		alarm_mask.assign(tripped.size(), 0);
+
+		// ÿ豸ֻһ״̬û״̬豸һ״̬
+		thread_local std::vector<deviceAlarm*> device_states;
+		device_states.assign(batch.devices.size(), nullptr);
+		for (size_t d = 0; d < batch.devices.size(); ++d) {
+			device_states[d] = find(batch.devices[d]);
+		}
+
+		size_t active = 0;
+		bool windowed = rules.usesWindows();
+		const sensorSchema& schema = sensorSchema::getInstance();
+		for (size_t row = 0; row < batch.rows; ++row) {
+			uint32_t d = batch.device_ids[row];
+			uint64_t bit = uint64_t(1) << (row & 63);
+			bool normal = device_states[d] == nullptr || device_states[d]->state.load(std::memory_order_acquire) == alarmState::NORMAL;
+			if (!windowed && normal && !(tripped[row >> 6] & bit)) continue;
+
+			schema.extract(batch, row, record);
+			alarmState current = process(record);
+			if (device_states[d] == nullptr) device_states[d] = find(batch.devices[d]);
+			if (current == alarmState::ACTIVE || current == alarmState::RECOVERING) {
+				alarm_mask[row >> 6] |= bit;
+				++active;
+			}
+		}
+		return active;
+	}
+
+	alarmState alarmModule::process(sensorRecord& record)
+	{
+		using namespace std::chrono;
+
+		thread_local std::vector<uint32_t> fired;
+		steady_clock::time_point now = steady_clock::now();
+		if (rules.usesWindows()) {
+			windows.update(record, duration<double>(now.time_since_epoch()).count());
+		}
+		bool tripped = rules.evaluateAll(record, fired) > 0;
+
+		deviceAlarm& device = findOrCreate(record.clientIP);
+		// ֻ״̬仯ʱŸ豸ַ͹бûб仯ڴ
+		alarmTransition transition{ {}, alarmState::NORMAL, alarmState::NORMAL, {}, 0 };
+		alarmState current;
+		{
+			std::lock_guard<std::mutex> lock(device.mtx);
+			alarmState before = device.state.load(std::memory_order_relaxed);
+			if (tripped) {
+				device.last_trip = now;
+				for (uint32_t rule : fired) {
+					if (std::find(device.latched.begin(), device.latched.end(), rule) == device.latched.end()) {
+						device.latched.push_back(rule);
+					}
 				}
 			}
-			if (!val_not_under_threshold_exist) {
-				std::stringstream ss;
-				ss << "[alarmModule]: No collected data exceeds the threshold, " <<
-					"but the alarm lock needs to ensure at least "<< alarm_lock_duration_seconds << " seconds of alarm time.";
-				alarmMessage += '\t';
-				alarmMessage += ss.str();
-				ss << std::endl;
-				std::cout << ss.str();
+			// αгĹѽ
+			bool all_cleared = !tripped;
+			for (size_t i = 0; all_cleared && i < device.latched.size(); ++i) {
+				all_cleared = rules.cleared(device.latched[i], record.values.data());
 			}
-			message[clientIP] = alarmMessage;
-			return "alarm_active";
-		}
-		else {
-			if (alarm_active_message.count(clientIP) > 0) {
-				alarm_active_message.erase(clientIP);
-				message.erase(clientIP);
+
+			switch (device.state) {
+			case alarmState::NORMAL:
+				if (tripped) {
+					device.count = trip_samples <= 1 ? 0 : 1;
+					device.since_ms = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+					device.state = trip_samples <= 1 ? alarmState::ACTIVE : alarmState::PENDING;
+				}
+				break;
+			case alarmState::PENDING:
+				if (!tripped) {
+					// ļ岻
+					device.state = alarmState::NORMAL;
+					device.latched.clear();
+				}
+				else if (++device.count >= trip_samples) {
+					device.count = 0;
+					device.state = alarmState::ACTIVE;
+				}
+				break;
+			case alarmState::ACTIVE:
+				//  alarm_clear_samples κŽָУֵڱֵزʱֱ
+				// ÿ active  recovering ֮лһ
+				if (!all_cleared) {
+					device.count = 0;
+					break;
+				}
+				if (++device.count < clear_samples) break;
+				device.state = alarmState::RECOVERING;
+				[[fallthrough]];
+			case alarmState::RECOVERING:
+				if (tripped) {
+					// ֮ٴγ¿ʼ
+					device.count = 0;
+					device.state = alarmState::ACTIVE;
+				}
+				else if (all_cleared && now - device.last_trip >= seconds(alarm_lock_duration_seconds)) {
+					device.state = alarmState::NORMAL;
+				}
+				// ֵصֵͽֵ֮ʱָֻУýҲָ
+				break;
 			}
+
+			if (device.state != before) {
+				transition.clientIP = record.clientIP;
+				transition.from = before;
+				transition.to = device.state;
+				transition.rules = device.latched;
+				transition.since_ms = device.since_ms;
+			}
+			if (device.state == alarmState::NORMAL) device.latched.clear();
+			current = device.state;
 		}
 
-		return "ack";
+		if (transition.from != transition.to) onTransition(transition, record);
+
+		return current;
 	}
 
-	void alarmModule::alarmActive(const std::string& clientIP)
+	void alarmModule::onTransition(const alarmTransition& transition, const sensorRecord& record)
 	{
 		using namespace std::chrono;
 
-		auto start_time = steady_clock::now();
-		auto end_time = start_time + seconds(static_cast<int>(alarm_lock_duration_seconds));
+		std::vector<alarmEvent> events;
+		events.reserve(transition.rules.size());
+		int64_t now_ms = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+		for (uint32_t id : transition.rules) {
+			const alarmRule& rule = rules.getRule(id);
+			alarmEvent event;
+			event.clientIP = transition.clientIP;
+			event.rule = rule.name;
+			event.metric = rule.metric;
+			event.value = rule.metric_slot < record.values.size() ? record.values[rule.metric_slot] : std::nan("");
+			event.threshold = rule.metric_threshold;
+			event.from = transition.from;
+			event.to = transition.to;
+			event.time_ms = now_ms;
+			event.since_ms = transition.since_ms;
+			event_log.push(event);
+			events.push_back(std::move(event));
+		}
 
 		{
 			std::lock_guard<std::mutex> lock(mtx);
-			alarm_active_ip[clientIP] = true;
+			if (transition.to == alarmState::ACTIVE) {
+				active_events[transition.clientIP] = std::move(events);
+				alarm_version.fetch_add(1, std::memory_order_release);
+			}
+			else if (transition.to == alarmState::NORMAL) {
+				active_events.erase(transition.clientIP);
+				alarm_version.fetch_add(1, std::memory_order_release);
+			}
 		}
+		// 뱨ͻָָем״̬תܺƵֻڿ־ʱ
+		bool raised = transition.to == alarmState::ACTIVE;
+		// ʱʱ active һֱӻָ recovering
+		bool resolved = transition.to == alarmState::NORMAL &&
+			(transition.from == alarmState::ACTIVE || transition.from == alarmState::RECOVERING);
+		if (raised || resolved || log_operations) {
+			std::cout << "[alarmModule]: Alarm state of [" << transition.clientIP << "] changed from "
+				<< alarmStateName(transition.from) << " to " << alarmStateName(transition.to) << "." << std::endl;
+		}
+	}
 
-		while (steady_clock::now() < end_time) {
-			// ǷҪüʱ
-			if (reset_timer_active_ip[clientIP]) {
-				start_time = steady_clock::now();
-				end_time = start_time + seconds(static_cast<int>(alarm_lock_duration_seconds));
-				reset_timer_active_ip[clientIP] = false;  // ñ־
-			}
+	std::vector<alarmEvent> alarmModule::getAlarmHistory(const std::string& clientIP, size_t limit)
+	{
+		return event_log.query(clientIP, limit);
+	}
 
-			std::this_thread::sleep_for(milliseconds(100));  // 
+	std::map<std::string, std::string> alarmModule::getAlarmMessage()
+	{
+		std::map<std::string, std::string> message;
+		std::lock_guard<std::mutex> lock(mtx);
+		for (const auto& device : active_events) {
+			std::stringstream ss;
+			for (const auto& event : device.second) {
+				if (ss.tellp() > 0) ss << '\t';
+				ss << "[alarmModule]: Rule \"" << event.rule << "\" is triggered, " << event.metric << " is at " << event.value
+					<< " (threshold " << event.threshold << ").";
+			}
+			message[device.first] = ss.str();
 		}
+		return message;
+	}
+
+	void alarmModule::saveState(snapshotWriter& out)
+	{
+		using namespace std::chrono;
 
+		{
+			std::shared_lock lock(devices_mtx);
+			std::vector<std::pair<const std::string*, deviceAlarm*>> pending;
+			for (const auto& [clientIP, device] : devices) {
+				if (device->state.load(std::memory_order_acquire) != alarmState::NORMAL) pending.emplace_back(&clientIP, device.get());
+			}
+			out.put<uint64_t>(pending.size());
+			for (const auto& [clientIP, device] : pending) {
+				std::lock_guard<std::mutex> device_lock(device->mtx);
+				out.putString(*clientIP);
+				out.put(device->state.load());
+				out.put<uint32_t>(device->count);
+				out.put<int64_t>(duration_cast<milliseconds>(device->last_trip.time_since_epoch()).count());
+				out.put(device->since_ms);
+				// ܱ仯ƺͱʽ
+				out.put<uint32_t>(static_cast<uint32_t>(device->latched.size()));
+				for (uint32_t id : device->latched) {
+					out.putString(rules.getRule(id).name);
+					out.putString(rules.getRule(id).expression);
+				}
+			}
+		}
 		{
 			std::lock_guard<std::mutex> lock(mtx);
-			alarm_active_ip[clientIP] = false;
+			out.put<uint64_t>(active_events.size());
+			for (const auto& [clientIP, events] : active_events) {
+				out.putString(clientIP);
+				out.put<uint64_t>(events.size());
+				for (const alarmEvent& event : events) alarmEventLog::saveEvent(out, event);
+			}
 		}
+		event_log.save(out);
 	}
 
-	std::map<std::string, std::string> alarmModule::getAlarmMessage()
+	size_t alarmModule::restoreState(snapshotReader& in, int64_t steady_shift_ms)
 	{
-		return message;
+		using namespace std::chrono;
+
+		std::unordered_map<std::string, uint32_t> rule_ids;
+		for (size_t id = 0; id < rules.size(); ++id) {
+			const alarmRule& rule = rules.getRule(static_cast<uint32_t>(id));
+			rule_ids.emplace(rule.name + '\n' + rule.expression, static_cast<uint32_t>(id));
+		}
+
+		size_t restored = 0;
+		uint64_t count = in.get<uint64_t>();
+		for (uint64_t n = 0; n < count && in.ok(); ++n) {
+			std::string clientIP = in.getString();
+			alarmState state = in.get<alarmState>();
+			unsigned int state_count = in.get<uint32_t>();
+			int64_t last_trip_ms = in.get<int64_t>();
+			int64_t since_ms = in.get<int64_t>();
+			uint32_t latched_count = in.get<uint32_t>();
+			std::vector<uint32_t> latched;
+			for (uint32_t i = 0; i < latched_count && in.ok(); ++i) {
+				std::string name = in.getString();
+				auto it = rule_ids.find(name + '\n' + in.getString());
+				if (it != rule_ids.end()) latched.push_back(it->second);
+			}
+			if (!in.ok() || state > alarmState::RECOVERING) break;
+			// Ĺɾʱ״̬޷ٽֱӻص
+			if (latched.empty()) continue;
+			deviceAlarm& device = findOrCreate(clientIP);
+			std::lock_guard<std::mutex> lock(device.mtx);
+			device.count = state_count;
+			device.last_trip = steady_clock::time_point(milliseconds(last_trip_ms + steady_shift_ms));
+			device.since_ms = since_ms;
+			device.latched = std::move(latched);
+			device.state.store(state, std::memory_order_release);
+			++restored;
+		}
+
+		count = in.get<uint64_t>();
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			for (uint64_t n = 0; n < count && in.ok(); ++n) {
+				std::string clientIP = in.getString();
+				uint64_t event_count = in.get<uint64_t>();
+				std::vector<alarmEvent> events;
+				for (uint64_t i = 0; i < event_count && in.ok(); ++i) events.push_back(alarmEventLog::restoreEvent(in));
+				// ָֻ״̬ڱе豸
+				deviceAlarm* device = find(clientIP);
+				if (in.ok() && device != nullptr && device->state.load() != alarmState::NORMAL) active_events[clientIP] = std::move(events);
+			}
+			alarm_version.fetch_add(1, std::memory_order_release);
+		}
+
+		event_log.restore(in);
+		return restored;
 	}
 
 	std::unordered_map<std::string, double> alarmModule::getThreshold()
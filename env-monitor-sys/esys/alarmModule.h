@@ -14,58 +14,116 @@
 #pragma once
 #include <unordered_map>
 #include <set>
+#include <map>
+#include <memory>
+#include <atomic>
 #include "esysControl.h"  // Զ
 
 namespace ems {  // ռ ems ʼ
 
+	/**
+	 * @struct alarmTransition
+	 * @brief һα״̬ת
+	 */
+	struct alarmTransition {
+		std::string clientIP;			///< 豸 IP ַ
+		alarmState from;				///< תǰ״̬
+		alarmState to;					///< ת״̬
+		std::vector<uint32_t> rules;	///< αгĹš
+		int64_t since_ms;				///< αʼʱ䣨UNIX 룩
+	};
+
 	/**
 	 * @class alarmModule
 	 * @brief ڹͼرģ顣
 	 *
-	 * ṩ˱ءֵͱܣֶ֧̻߳µı״̬
+	 * ÿ豸һ״̬normal -> pending -> active -> recovering -> normalʱʱ active Ҳֱӻص normal
+	 *  alarm_trip_samples κ뱨гĹ alarm_clear_samples κָУ
+	 * һγѳ alarm_lock_duration_seconds Żָﵽʱѳʱӱֱӻָ
+	 * ʱֱûýֵĹڱֵʱᷴл״ָֻ̬йٴγŻص
+	 * ֵڱֵͽֵ֮ʱָֻУֱ
+	 * ֻ״̬תʱŻ±ϢصĿתȣȣ
+	 * ־ֻ¼뱨ʹӱָлصת log_operations ʱż¼
 	 */
 	class alarmModule
 	{
 	private:
 		/**
-		 * @brief ĳʱ䣨룩
+		 * @brief 豸ı״̬
+		 */
+		struct deviceAlarm {
+			std::mutex mtx;										///< 豸״̬Ļ
+			std::atomic<alarmState> state{ alarmState::NORMAL };	///< ǰ״̬ mtx ޸ģֵʱȡ
+			unsigned int count = 0;								///< ǰ״̬תĴ
+			std::chrono::steady_clock::time_point last_trip;	///< һйʱ䡣
+			std::vector<uint32_t> latched;						///< αгĹš
+			int64_t since_ms = 0;								///< αʼʱ䣨UNIX 룩
+		};
+
+		/**
+		 * @brief ̳ʱ䣨룩һйʱ
+		 */
+		int alarm_lock_duration_seconds;
+
+		/**
+		 * @brief 뱨
 		 */
-		static int alarm_lock_duration_seconds;
+		unsigned int trip_samples;
 
 		/**
-		 * @brief ڱݵķʡ
+		 * @brief ָҲǱ״̬פ
 		 */
-		static std::mutex mtx;
+		unsigned int clear_samples;
 
 		/**
-		 * @brief ڶ߳ͬ
+		 * @brief Ƿ״̬ת־رʱֻ뱨ͻָ
 		 */
-		static std::condition_variable cv;
+		bool log_operations;
 
 		/**
-		 * @brief üʱı־key Ϊ IP ַvalue ΪǷüʱԭӲֵ
+		 * @brief ڱڱ豸ķʡ
 		 */
-		static std::unordered_map<std::string, std::atomic<bool>> reset_timer_active_ip;
+		std::mutex mtx;
+
+		/**
+		 * @brief 豸״̬ṹĶд
+		 */
+		std::shared_mutex devices_mtx;
+
+		/**
+		 * @brief 豸ı״̬key Ϊ IP ַ
+		 */
+		std::unordered_map<std::string, std::unique_ptr<deviceAlarm>> devices;
 
 		/**
 		 * @brief ֵӳ䣬key Ϊͣvalue ΪӦֵ
 		 */
-		static std::unordered_map<std::string, double> threshold;
+		std::unordered_map<std::string, double> threshold;
+
+		/**
+		 * @brief ı򣬰ֵɵĹ prefix_of_alarm_rule ͷĹ
+		 */
+		alarmRuleSet rules;
 
 		/**
-		 * @brief ͻ˱״̬ӳ䣬key Ϊ IP ַvalue ΪǷڱ״̬ԭӲֵ
+		 * @brief ÿ豸ÿĻڣڹ˴ͳʱά
 		 */
-		static std::unordered_map<std::string, std::atomic<bool>> alarm_active_ip;
+		sensorWindows windows;
 
 		/**
-		 * @brief ͻ˱Ϣӳ䣬key Ϊ IP ַvalue Ϊһڲӳ䣬ӳ key Ϊͣvalue Ϊľֵ
+		 * @brief ڱ豸һν뱨ʱ¼key Ϊ IP ַ
 		 */
-		static std::unordered_map<std::string, std::unordered_map<std::string, double>> alarm_active_message;
+		std::map<std::string, std::vector<alarmEvent>> active_events;
 
 		/**
-		 * @brief Ϣַ
+		 * @brief ¼ʷ¼
 		 */
-		std::string alarmMessage;
+		alarmEventLog event_log;
+
+		/**
+		 * @brief Ϣactive_eventsİ汾ţڱ豸ϻ¼仯ʱһ
+		 */
+		std::atomic<uint64_t> alarm_version{ 1 };
 
 		/**
 		 * @brief ˽й캯ֹʵ
@@ -87,6 +145,43 @@ namespace ems {  // 
 		 */
 		alarmModule& operator=(const alarmModule&) = delete;
 
+		/**
+		 * @brief ļֵͱ򲢱롣
+		 */
+		void loadRules();
+
+		/**
+		 * @brief 豸ı״̬ʱ
+		 *
+		 * @param clientIP 豸 IP ַ
+		 * @return deviceAlarm& ״̬á
+		 */
+		deviceAlarm& findOrCreate(const std::string& clientIP);
+
+		/**
+		 * @brief 豸ı״̬ʱ nullptr
+		 *
+		 * @param clientIP 豸 IP ַ
+		 * @return deviceAlarm* ״ָ̬롣
+		 */
+		deviceAlarm* find(const std::string& clientIP);
+
+		/**
+		 * @brief һѽļ¼»ڡֵƽ豸״̬
+		 *
+		 * @param record ɼ¼ͳдС
+		 * @return alarmState 豸״̬
+		 */
+		alarmState process(sensorRecord& record);
+
+		/**
+		 * @brief һ״̬תΪÿĹ¼һ¼ڱ豸
+		 *
+		 * @param transition ״̬ת
+		 * @param record תĲɼ¼
+		 */
+		void onTransition(const alarmTransition& transition, const sensorRecord& record);
+
 		/**
 		 * @brief  esysControl Ԫ
 		 */
@@ -96,21 +191,22 @@ namespace ems {  // 
 		 * @brief ر״̬
 		 *
 		 * @param data ݵӳ䡣
-		 * @return std::string Ϣַ
+		 * @return std::string з "alarm_active"򷵻 "ack"
 		 */
-		std::string alarmMonitor(const std::unordered_map<std::string, std::string>& data);
+		std::string alarmMonitor(const fieldMap& data);
 
 		/**
-		 * @brief ָͻ IP ı״̬
+		 * @brief ر״̬
 		 *
-		 * @param clientIP ͻ˵ IP ַ
-		 */
-		static void alarmActive(const std::string& clientIP);
-
-		/**
-		 * @brief 洢Ϣӳ䣬key Ϊͣvalue Ϊľֵ
+		 *  alarmRuleSet::evaluateBatch йУ
+		 * ֻй豸״̬˻ڵвƽ״ֱ̬Ϊ
+		 * ͬһ豸Ķак˳ alarmMonitor ͬ
+		 *
+		 * @param batch дŵһɼݡ
+		 * @param alarm_mask λͼ i д豸ڱʱ alarm_mask[i / 64] ĵ i % 64 λΪ 1
+		 * @return size_t ڱе
 		 */
-		std::map<std::string, std::string> message;
+		size_t alarmMonitorBatch(const sensorBatch& batch, std::vector<uint64_t>& alarm_mask);
 
 	public:
 		/**
@@ -126,15 +222,71 @@ namespace ems {  // 
 		/**
 		 * @brief ȡǰıϢ
 		 *
-		 * @return std::map<std::string, std::string> Ϣӳ䣬key Ϊͣvalue Ϊľֵ
+		 * @return std::map<std::string, std::string> Ϣӳ䣬key Ϊ IP ַvalue ΪϢ
+		 * @note Ϣڵʱɽṹ¼ɣжϵĹвκַʽ
 		 */
 		std::map<std::string, std::string> getAlarmMessage();
 
+		/**
+		 * @brief ѯı¼
+		 *
+		 * @param clientIP 豸 IP ַΪձʾ豸
+		 * @param limit ෵ص¼
+		 * @return std::vector<alarmEvent> ¼бʱµС
+		 */
+		std::vector<alarmEvent> getAlarmHistory(const std::string& clientIP, size_t limit);
+
+		/**
+		 * @brief ȡϢgetAlarmMessageİ汾š
+		 *
+		 * @return uint64_t 汾š
+		 */
+		uint64_t getAlarmVersion() const { return alarm_version.load(std::memory_order_acquire); }
+
+		/**
+		 * @brief ȡ¼ʷgetAlarmHistoryİ汾š
+		 *
+		 * @return uint64_t 汾š
+		 */
+		uint64_t getHistoryVersion() const { return event_log.version(); }
+
 		/**
 		 * @brief ȡǰõıֵ
 		 *
 		 * @return std::unordered_map<std::string, double> ֵӳ䣬key Ϊͣvalue Ϊֵ
 		 */
 		std::unordered_map<std::string, double> getThreshold();
+
+		/**
+		 * @brief ״̬豸״̬ڱ¼¼ʷдա
+		 *
+		 * @param out д
+		 */
+		void saveState(snapshotWriter& out);
+
+		/**
+		 * @brief ӿջָ״̬ڿʼ֮ǰá
+		 *
+		 * ĹƺͱʽӦǰĹţɾ޸ĹĹ򱻶
+		 *
+		 * @param in ݡ
+		 * @param steady_shift_ms steady_clock ʱƽ룩
+		 * @return size_t ָ豸״̬
+		 */
+		size_t restoreState(snapshotReader& in, int64_t steady_shift_ms);
+
+		/**
+		 * @brief ں쳣дգδôʱдյĴڱ
+		 */
+		void saveWindows(snapshotWriter& out) const { windows.saveState(out); }
+
+		/**
+		 * @brief ӿջָں쳣
+		 *
+		 * @param in ݡ
+		 * @param time_shift ʱƽ룩
+		 * @return size_t ָ豸
+		 */
+		size_t restoreWindows(snapshotReader& in, double time_shift) { return windows.restoreState(in, time_shift); }
 	};
 } // namespace ems 
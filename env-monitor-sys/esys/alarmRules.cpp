@@ -0,0 +1,490 @@
+#include "alarmRules.h"
+
+namespace ems {
+
+	// ȽָıֵNaN ıȽϾΪ
+	template <alarmOp op>
+	static inline bool compareScalar(double v, double c) {
+		switch (op) {
+		case alarmOp::GT: return v > c;
+		case alarmOp::GE: return v >= c;
+		case alarmOp::LT: return v < c;
+		case alarmOp::LE: return v <= c;
+		case alarmOp::EQ: return v == c;
+		default: return !std::isnan(v) && v != c;
+		}
+	}
+
+#if EMS_ALARM_SSE2
+	// Ƚָ SSE2 ֵȽ϶ NaN ؼ٣NE 
+	template <alarmOp op>
+	static inline __m128d compareVector(__m128d v, __m128d c) {
+		switch (op) {
+		case alarmOp::GT: return _mm_cmpgt_pd(v, c);
+		case alarmOp::GE: return _mm_cmpge_pd(v, c);
+		case alarmOp::LT: return _mm_cmplt_pd(v, c);
+		case alarmOp::LE: return _mm_cmple_pd(v, c);
+		case alarmOp::EQ: return _mm_cmpeq_pd(v, c);
+		default: return _mm_and_pd(_mm_cmpneq_pd(v, c), _mm_cmpord_pd(v, v));
+		}
+	}
+#endif
+
+	// һ볣Ƚϣλͼλ
+	template <alarmOp op>
+	static void compareColumn(const double* column, size_t rows, double constant, uint64_t* mask) {
+		size_t i = 0;
+#if EMS_ALARM_SSE2
+		const __m128d c = _mm_set1_pd(constant);
+		// ÿδ 8 У8  64õλԽλͼе
+		for (; i + 8 <= rows; i += 8) {
+			int bits = _mm_movemask_pd(compareVector<op>(_mm_loadu_pd(column + i), c))
+				| (_mm_movemask_pd(compareVector<op>(_mm_loadu_pd(column + i + 2), c)) << 2)
+				| (_mm_movemask_pd(compareVector<op>(_mm_loadu_pd(column + i + 4), c)) << 4)
+				| (_mm_movemask_pd(compareVector<op>(_mm_loadu_pd(column + i + 6), c)) << 6);
+			mask[i >> 6] |= static_cast<uint64_t>(bits) << (i & 63);
+		}
+#endif
+		for (; i < rows; ++i) {
+			if (compareScalar<op>(column[i], constant)) mask[i >> 6] |= uint64_t(1) << (i & 63);
+		}
+	}
+
+	// ͳλͼλĸÿλ 1word & (word - 1)ѭλ
+	// ͨ٣ѭܿĿ C++17 룬û std::popcountҲضڽ
+	static size_t countBits(const std::vector<uint64_t>& mask) {
+		size_t count = 0;
+		for (uint64_t word : mask) {
+			while (word) {
+				word &= word - 1;
+				++count;
+			}
+		}
+		return count;
+	}
+
+	class alarmRuleSet::compiler {
+	private:
+		const std::string& text;
+		const sensorSchema& schema;
+		std::vector<alarmInstr>& code;
+		size_t pos;
+		size_t depth;
+		size_t max_depth;
+		bool windowed;
+
+		void skipSpace() {
+			while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) ++pos;
+		}
+
+		// ȡһؼֻţɹʱǰ
+		bool accept(const char* token) {
+			skipSpace();
+			size_t len = std::strlen(token);
+			if (text.compare(pos, len, token) != 0) return false;
+			// ؼֺ治ܽʶַ
+			if (std::isalpha(static_cast<unsigned char>(token[0])) && pos + len < text.size() &&
+				(std::isalnum(static_cast<unsigned char>(text[pos + len])) || text[pos + len] == '_')) {
+				return false;
+			}
+			pos += len;
+			return true;
+		}
+
+		bool acceptAnd() { return accept("AND") || accept("and") || accept("&&"); }
+		bool acceptOr() { return accept("OR") || accept("or") || accept("||"); }
+
+		void emit(const alarmInstr& instr) {
+			code.push_back(instr);
+			if (instr.op == alarmOp::AND || instr.op == alarmOp::OR) {
+				--depth;
+			}
+			else if (++depth > max_depth) {
+				max_depth = depth;
+			}
+		}
+
+		std::string readIdentifier() {
+			skipSpace();
+			size_t begin = pos;
+			while (pos < text.size() && (std::isalnum(static_cast<unsigned char>(text[pos])) || text[pos] == '_')) ++pos;
+			if (begin == pos || std::isdigit(static_cast<unsigned char>(text[begin]))) {
+				pos = begin;
+				return "";
+			}
+			return text.substr(begin, pos - begin);
+		}
+
+		// ֻ֡ŻС㿪ͷļǺŲŰֽ"infrared""nan_count" ȴᱻ inf/nan
+		// from_chars Ӱ죬ʮƣ"-inf" ȷֵҲΪ
+		bool readNumber(double& value) {
+			skipSpace();
+			if (pos >= text.size()) return false;
+			char first = text[pos];
+			if (!std::isdigit(static_cast<unsigned char>(first)) && first != '+' && first != '-' && first != '.') return false;
+			const char* begin = text.data() + pos + (first == '+' ? 1 : 0);
+			const char* last = text.data() + text.size();
+			if (first == '+' && begin < last && (*begin == '+' || *begin == '-')) return false;
+			auto result = std::from_chars(begin, last, value, std::chars_format::general);
+			if (result.ec != std::errc() || !std::isfinite(value)) return false;
+			pos = static_cast<size_t>(result.ptr - text.data());
+			return true;
+		}
+
+		bool readComparison(alarmOp& op) {
+			if (accept(">=")) op = alarmOp::GE;
+			else if (accept("<=")) op = alarmOp::LE;
+			else if (accept("==")) op = alarmOp::EQ;
+			else if (accept("!=")) op = alarmOp::NE;
+			else if (accept(">")) op = alarmOp::GT;
+			else if (accept("<")) op = alarmOp::LT;
+			else return false;
+			return true;
+		}
+
+		// дʱȽϷ "40 < temperature" ȼ "temperature > 40"
+		static alarmOp flip(alarmOp op) {
+			switch (op) {
+			case alarmOp::GT: return alarmOp::LT;
+			case alarmOp::GE: return alarmOp::LE;
+			case alarmOp::LT: return alarmOp::GT;
+			case alarmOp::LE: return alarmOp::GE;
+			default: return op;
+			}
+		}
+
+		// Ϊ "ͳ()"Ϊ¼е±
+		bool readOperand(uint32_t& slot, std::string& error) {
+			std::string name = readIdentifier();
+			if (name.empty()) {
+				error = "expected sensor name at position " + std::to_string(pos);
+				return false;
+			}
+			sensorFeature feature = sensorFeature::VALUE;
+			if (accept("(")) {
+				static const std::unordered_map<std::string, sensorFeature> features = {
+					{ "mean", sensorFeature::MEAN }, { "min", sensorFeature::MIN }, { "max", sensorFeature::MAX },
+					{ "slope", sensorFeature::SLOPE }, { "ewma", sensorFeature::EWMA },
+					{ "zscore", sensorFeature::ZSCORE }, { "mzscore", sensorFeature::MZSCORE }
+				};
+				auto it = features.find(name);
+				if (it == features.end()) {
+					error = "unknown function \"" + name + "\"";
+					return false;
+				}
+				feature = it->second;
+				name = readIdentifier();
+				if (name.empty() || !accept(")")) {
+					error = "expected sensor name and ')' at position " + std::to_string(pos);
+					return false;
+				}
+				windowed = true;
+			}
+			int id = schema.idOf(name);
+			if (id < 0) {
+				error = "unknown sensor \"" + name + "\"";
+				return false;
+			}
+			slot = static_cast<uint32_t>(schema.slotOf(id, feature));
+			return true;
+		}
+
+		bool parseComparison(std::string& error) {
+			alarmInstr instr{};
+			double constant = 0;
+			bool constant_first = readNumber(constant);
+			if (constant_first) {
+				if (!readComparison(instr.op)) {
+					error = "expected comparison operator at position " + std::to_string(pos);
+					return false;
+				}
+				instr.op = flip(instr.op);
+				if (!readOperand(instr.slot, error)) return false;
+			}
+			else {
+				if (!readOperand(instr.slot, error)) return false;
+				if (!readComparison(instr.op)) {
+					error = "expected comparison operator at position " + std::to_string(pos);
+					return false;
+				}
+				if (!readNumber(constant)) {
+					error = "expected number at position " + std::to_string(pos);
+					return false;
+				}
+			}
+			instr.constant = constant;
+			emit(instr);
+			return true;
+		}
+
+		bool parsePrimary(std::string& error) {
+			if (accept("(")) {
+				if (!parseOr(error)) return false;
+				if (!accept(")")) {
+					error = "expected ')' at position " + std::to_string(pos);
+					return false;
+				}
+				return true;
+			}
+			return parseComparison(error);
+		}
+
+		bool parseAnd(std::string& error) {
+			if (!parsePrimary(error)) return false;
+			while (acceptAnd()) {
+				if (!parsePrimary(error)) return false;
+				emit({ alarmOp::AND, 0, 0 });
+			}
+			return true;
+		}
+
+		bool parseOr(std::string& error) {
+			if (!parseAnd(error)) return false;
+			while (acceptOr()) {
+				if (!parseAnd(error)) return false;
+				emit({ alarmOp::OR, 0, 0 });
+			}
+			return true;
+		}
+
+	public:
+		compiler(const std::string& text, const sensorSchema& schema, std::vector<alarmInstr>& code)
+			: text(text), schema(schema), code(code), pos(0), depth(0), max_depth(0), windowed(false) {}
+
+		bool isWindowed() const { return windowed; }
+
+		bool run(std::string& error) {
+			size_t start = code.size();
+			bool ok = parseOr(error);
+			skipSpace();
+			if (ok && pos != text.size()) {
+				error = "unexpected character '" + std::string(1, text[pos]) + "' at position " + std::to_string(pos);
+				ok = false;
+			}
+			if (ok && max_depth > max_stack_depth) {
+				error = "expression is nested too deeply";
+				ok = false;
+			}
+			if (!ok) code.resize(start);
+			return ok;
+		}
+	};
+
+	int64_t alarmRuleSet::compile(const std::string& name, const std::string& expression, const sensorSchema& schema, std::string& error)
+	{
+		alarmRule rule;
+		rule.name = name;
+		rule.expression = expression;
+		rule.begin = static_cast<uint32_t>(code.size());
+		compiler c(expression, schema, code);
+		if (!c.run(error)) return -1;
+		uses_windows = uses_windows || c.isWindowed();
+		rule.end = static_cast<uint32_t>(code.size());
+		// ¼һȽʽ¼Ϊָ
+		for (uint32_t i = rule.begin; i < rule.end; ++i) {
+			if (code[i].op == alarmOp::AND || code[i].op == alarmOp::OR) continue;
+			static const char* feature_names[] = { "", "mean", "min", "max", "slope", "ewma", "zscore", "mzscore" };
+			size_t sensors = schema.size();
+			size_t feature = code[i].slot / sensors;
+			const std::string& sensor = schema.nameOf(static_cast<int>(code[i].slot % sensors));
+			rule.metric = feature == 0 ? sensor : std::string(feature_names[feature]) + "(" + sensor + ")";
+			rule.metric_slot = code[i].slot;
+			rule.metric_threshold = code[i].constant;
+			break;
+		}
+		rule.columnar = rule.end - rule.begin == 1 && code[rule.begin].slot < schema.size();
+		slot_count = schema.slotCount();
+		rules.push_back(rule);
+		return static_cast<int64_t>(rules.size() - 1);
+	}
+
+	bool alarmRuleSet::addRule(const std::string& name, const std::string& expression, const std::string& device,
+		const sensorSchema& schema, std::string& error)
+	{
+		int64_t id = -1;
+		if (!expression.empty()) {
+			id = compile(name, expression, schema, error);
+			if (id < 0) return false;
+		}
+		else if (device.empty()) {
+			error = "empty expression";
+			return false;
+		}
+		if (device.empty()) {
+			global_rules[name] = static_cast<uint32_t>(id);
+		}
+		else {
+			overrides[device][name] = id;
+		}
+		return true;
+	}
+
+	bool alarmRuleSet::addClearRule(const std::string& name, const std::string& expression, const std::string& device,
+		const sensorSchema& schema, std::string& error)
+	{
+		int64_t id = compile(name + ".clear", expression, schema, error);
+		if (id < 0) return false;
+		if (device.empty()) {
+			global_clears[name] = static_cast<uint32_t>(id);
+		}
+		else {
+			override_clears[device][name] = static_cast<uint32_t>(id);
+		}
+		return true;
+	}
+
+	void alarmRuleSet::build()
+	{
+		// 豸ǵĹʹø豸ĽȫֹĽ
+		for (const auto& rule : global_rules) {
+			auto clear = global_clears.find(rule.first);
+			if (clear != global_clears.end()) rules[rule.second].clear = clear->second;
+		}
+		for (const auto& device : overrides) {
+			auto device_clears = override_clears.find(device.first);
+			for (const auto& rule : device.second) {
+				if (rule.second < 0) continue;
+				int64_t clear = -1;
+				auto global_clear = global_clears.find(rule.first);
+				if (global_clear != global_clears.end()) clear = global_clear->second;
+				if (device_clears != override_clears.end()) {
+					auto it = device_clears->second.find(rule.first);
+					if (it != device_clears->second.end()) clear = it->second;
+				}
+				rules[rule.second].clear = clear;
+			}
+		}
+
+		default_list.clear();
+		device_lists.clear();
+		std::vector<std::pair<std::string, uint32_t>> ordered(global_rules.begin(), global_rules.end());
+		// ʹ˳õļ˳һ
+		std::sort(ordered.begin(), ordered.end(), [](const auto& a, const auto& b) { return a.second < b.second; });
+		columnar_rules.clear();
+		row_rules.clear();
+		for (const auto& rule : ordered) {
+			default_list.push_back(rule.second);
+			(rules[rule.second].columnar ? columnar_rules : row_rules).push_back(rule.second);
+		}
+		for (const auto& device : overrides) {
+			std::vector<uint32_t>& list = device_lists[device.first];
+			for (const auto& rule : ordered) {
+				auto it = device.second.find(rule.first);
+				if (it == device.second.end()) list.push_back(rule.second);
+				else if (it->second >= 0) list.push_back(static_cast<uint32_t>(it->second));
+			}
+			// ֻԸ豸ЧĹ
+			for (const auto& rule : device.second) {
+				if (rule.second >= 0 && global_rules.count(rule.first) == 0) {
+					list.push_back(static_cast<uint32_t>(rule.second));
+				}
+			}
+		}
+	}
+
+	const std::vector<uint32_t>& alarmRuleSet::rulesFor(const std::string& clientIP) const
+	{
+		if (!device_lists.empty()) {
+			auto it = device_lists.find(clientIP);
+			if (it != device_lists.end()) return it->second;
+		}
+		return default_list;
+	}
+
+	bool alarmRuleSet::evaluate(uint32_t rule, const double* values) const
+	{
+		bool stack[max_stack_depth];
+		size_t top = 0;
+		const alarmInstr* it = code.data() + rules[rule].begin;
+		const alarmInstr* end = code.data() + rules[rule].end;
+		for (; it != end; ++it) {
+			// NaN ıȽϾΪ٣NE 赥
+			switch (it->op) {
+			case alarmOp::GT: stack[top++] = values[it->slot] > it->constant; break;
+			case alarmOp::GE: stack[top++] = values[it->slot] >= it->constant; break;
+			case alarmOp::LT: stack[top++] = values[it->slot] < it->constant; break;
+			case alarmOp::LE: stack[top++] = values[it->slot] <= it->constant; break;
+			case alarmOp::EQ: stack[top++] = values[it->slot] == it->constant; break;
+			case alarmOp::NE: stack[top++] = !std::isnan(values[it->slot]) && values[it->slot] != it->constant; break;
+			case alarmOp::AND: --top; stack[top - 1] = stack[top - 1] && stack[top]; break;
+			case alarmOp::OR: --top; stack[top - 1] = stack[top - 1] || stack[top]; break;
+			}
+		}
+		return top > 0 && stack[top - 1];
+	}
+
+	bool alarmRuleSet::cleared(uint32_t rule, const double* values) const
+	{
+		if (evaluate(rule, values)) return false;
+		int64_t clear = rules[rule].clear;
+		return clear < 0 || evaluate(static_cast<uint32_t>(clear), values);
+	}
+
+	size_t alarmRuleSet::evaluateBatch(const sensorBatch& batch, std::vector<uint64_t>& tripped) const
+	{
+		tripped.assign((batch.rows + 63) / 64, 0);
+		if (batch.rows == 0) return 0;
+		uint64_t* mask = tripped.data();
+
+		// бȽϣÿֻɨõһ
+		for (uint32_t id : columnar_rules) {
+			const alarmInstr& instr = code[rules[id].begin];
+			const double* column = batch.column(instr.slot);
+			switch (instr.op) {
+			case alarmOp::GT: compareColumn<alarmOp::GT>(column, batch.rows, instr.constant, mask); break;
+			case alarmOp::GE: compareColumn<alarmOp::GE>(column, batch.rows, instr.constant, mask); break;
+			case alarmOp::LT: compareColumn<alarmOp::LT>(column, batch.rows, instr.constant, mask); break;
+			case alarmOp::LE: compareColumn<alarmOp::LE>(column, batch.rows, instr.constant, mask); break;
+			case alarmOp::EQ: compareColumn<alarmOp::EQ>(column, batch.rows, instr.constant, mask); break;
+			case alarmOp::NE: compareColumn<alarmOp::NE>(column, batch.rows, instr.constant, mask); break;
+			default: break;
+			}
+		}
+
+		// ֵϹԼ豸ǵУеİнϣ豸Ĺб㣩
+		thread_local std::vector<const std::vector<uint32_t>*> device_rules;
+		device_rules.assign(batch.devices.size(), nullptr);
+		bool any_override = false;
+		for (size_t d = 0; d < batch.devices.size(); ++d) {
+			auto it = device_lists.find(batch.devices[d]);
+			if (it != device_lists.end()) {
+				device_rules[d] = &it->second;
+				any_override = true;
+			}
+		}
+		if (!row_rules.empty() || any_override) {
+			thread_local std::vector<double> values;
+			size_t sensors = batch.sensors;
+			values.assign(std::max(slot_count, sensors), std::numeric_limits<double>::quiet_NaN());
+			for (size_t row = 0; row < batch.rows; ++row) {
+				const std::vector<uint32_t>* list = device_rules[batch.device_ids[row]];
+				uint64_t bit = uint64_t(1) << (row & 63);
+				if (list == nullptr && (row_rules.empty() || (mask[row >> 6] & bit))) continue;
+				for (size_t sensor = 0; sensor < sensors; ++sensor) {
+					values[sensor] = batch.column(sensor)[row];
+				}
+				bool hit = false;
+				for (uint32_t id : list != nullptr ? *list : row_rules) {
+					if (evaluate(id, values.data())) {
+						hit = true;
+						break;
+					}
+				}
+				mask[row >> 6] = hit ? (mask[row >> 6] | bit) : (mask[row >> 6] & ~bit);
+			}
+		}
+
+		return countBits(tripped);
+	}
+
+	size_t alarmRuleSet::evaluateAll(const sensorRecord& record, std::vector<uint32_t>& fired) const
+	{
+		fired.clear();
+		const double* values = record.values.data();
+		for (uint32_t rule : rulesFor(record.clientIP)) {
+			if (evaluate(rule, values)) fired.push_back(rule);
+		}
+		return fired.size();
+	}
+
+} // namespace ems
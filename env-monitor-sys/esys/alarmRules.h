@@ -0,0 +1,229 @@
+/**
+ * @file alarmRules.h
+ * @author Yilin Wang (yilin233@foxmail.com)
+ * @brief Alarm rule compiler, turns rule expressions from the config file into flat
+ *  postfix bytecode that is evaluated against a typed sensor record.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2024 Yilin Wang
+ *
+ * MIT License
+ */
+
+
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <cmath>
+#include <limits>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define EMS_ALARM_SSE2 1
+#else
+#define EMS_ALARM_SSE2 0
+#endif
+#include "sensorRecord.h"  // Զ
+
+namespace ems {  // ռ ems ʼ
+
+	/**
+	 * @brief ֽĲ롣
+	 */
+	enum class alarmOp : uint8_t {
+		GT,		///< ɼֵ > 
+		GE,		///< ɼֵ >= 
+		LT,		///< ɼֵ < 
+		LE,		///< ɼֵ <= 
+		EQ,		///< ɼֵ == 
+		NE,		///< ɼֵ != 
+		AND,	///< ѹߵ
+		OR		///< ѹߵĻ
+	};
+
+	/**
+	 * @struct alarmInstr
+	 * @brief һָֽȽָȡ¼ slot λõֵ constant Ƚϣѹջ
+	 */
+	struct alarmInstr {
+		alarmOp op;			///< 롣
+		uint32_t slot;		///< ֵ sensorRecord::values е±꣬Ƚָʹá
+		double constant;	///< ȽϵĳȽָʹá
+	};
+
+	/**
+	 * @struct alarmRule
+	 * @brief һĹָλ alarmRuleSet::code  [begin, end) 䡣
+	 */
+	struct alarmRule {
+		std::string name;			///< 
+		std::string expression;		///< ԭʼʽ
+		uint32_t begin;				///< һָλá
+		uint32_t end;				///< һָ֮λá
+		int64_t clear = -1;			///< Ĺţ-1 ʾٳɽ
+		std::string metric;			///< һȽʽõָ꣬ "temperature""mean(smoke)"ڱ¼
+		uint32_t metric_slot = 0;	///< ָ sensorRecord::values е±ꡣ
+		double metric_threshold = 0;	///< ñȽʽĳ
+		bool columnar = false;		///< ǷֻһòɼֵıȽʽɰȽϡ
+	};
+
+	/**
+	 * @class alarmRuleSet
+	 * @brief ı򼯺ϡ
+	 *
+	 * ﷨ȽʽΪ "  "Ϊ >>=<<===!=
+	 * Ϊβɼֵͳ mean(x)min(x)max(x)slope(x)ewma(x)
+	 * 쳣 zscore(x)mzscore(x)
+	 * Ƚʽ֮ AND/OR &&/||Ӳŷ飬AND ȼ OR
+	 *  "temperature >= 40 AND (humidity < 20 OR slope(smoke) > 50)"
+	 * йڼʱΪͬһĺ׺ָ飬ֵʱֻʺͱȽϡ
+	 * ȱʧĲɼֵΪ NaNκαȽϽΪ١
+	 * ÿһʵֳͣʱֱ򲻳ҽ
+	 * ȫɺ build() ÿ豸Ĺб˺󼯺ֻڶ̼߳乲
+	 */
+	class alarmRuleSet
+	{
+	private:
+		/**
+		 * @brief ֵջȡ
+		 */
+		static constexpr size_t max_stack_depth = 64;
+
+		std::vector<alarmInstr> code;											///< йָ
+		std::vector<alarmRule> rules;											///< й±Ϊš
+		std::unordered_map<std::string, uint32_t> global_rules;				///< ȫֹŵӳ䡣
+		std::unordered_map<std::string, std::unordered_map<std::string, int64_t>> overrides;	///< 豸ǣIP ->  -> ţ-1 ʾã
+		std::unordered_map<std::string, uint32_t> global_clears;				///< ȫֹŵӳ䡣
+		std::unordered_map<std::string, std::unordered_map<std::string, uint32_t>> override_clears;	///< 豸ǵĽIP ->  -> š
+		std::vector<uint32_t> default_list;										///< δǵ豸ʹõĹб
+		std::unordered_map<std::string, std::vector<uint32_t>> device_lists;	///< иǵ豸ʹõĹб
+		bool uses_windows = false;												///< Ƿй˻ͳ
+		size_t slot_count = 0;													///< ¼ֵֵʱʹá
+		std::vector<uint32_t> columnar_rules;									///< ĬϹбпɰȽϵĹ
+		std::vector<uint32_t> row_rules;										///< ĬϹбҪֵĹ
+
+		/**
+		 * @brief ʽݹ½ؽʽֱ׺ָ
+		 */
+		class compiler;
+
+		/**
+		 * @brief һʽ׷ӵָ顣
+		 *
+		 * @param name 
+		 * @param expression ʽ
+		 * @param schema ű
+		 * @param error ʧʱĴϢ
+		 * @return int64_t ţʧʱ -1
+		 */
+		int64_t compile(const std::string& name, const std::string& expression, const sensorSchema& schema, std::string& error);
+
+	public:
+		/**
+		 * @brief һ
+		 *
+		 * @param name ͬȫֹᱻ滻
+		 * @param expression ʽΪ device ǿʱʾԸ豸ô˹
+		 * @param device 豸 IPΪձʾȫֹ򣬷ΪֻԸ豸Чĸǡ
+		 * @param schema ű
+		 * @param error ʧʱĴϢ
+		 * @return bool ɹ true
+		 */
+		bool addRule(const std::string& name, const std::string& expression, const std::string& device,
+			const sensorSchema& schema, std::string& error);
+
+		/**
+		 * @brief Ϊӽ
+		 *
+		 * @param name 
+		 * @param expression ıʽ
+		 * @param device 豸 IPΪձʾȫֹĽֻڸ豸ǵĹ
+		 * @param schema ű
+		 * @param error ʧʱĴϢ
+		 * @return bool ɹ true
+		 */
+		bool addClearRule(const std::string& name, const std::string& expression, const std::string& device,
+			const sensorSchema& schema, std::string& error);
+
+		/**
+		 * @brief ĬϹбÿ豸Ĺбйɺá
+		 */
+		void build();
+
+		/**
+		 * @brief ȡָ豸ҪĹб
+		 *
+		 * @param clientIP 豸 IP ַ
+		 * @return const std::vector<uint32_t>& б
+		 */
+		const std::vector<uint32_t>& rulesFor(const std::string& clientIP) const;
+
+		/**
+		 * @brief һֵ
+		 *
+		 * @param rule š
+		 * @param values ɼֵ飬±Ϊš
+		 * @return bool  true
+		 */
+		bool evaluate(uint32_t rule, const double* values) const;
+
+		/**
+		 * @brief жһǷѽ򲻳нʱ
+		 *
+		 * @param rule š
+		 * @param values ɼֵ顣
+		 * @return bool ѽ true
+		 */
+		bool cleared(uint32_t rule, const double* values) const;
+
+		/**
+		 * @brief һɼֵõÿһǷй
+		 *
+		 * ֻһȽʽòɼֵĬϹ SIMD бȽϣÿαȽ double
+		 * Լ豸ǵֵͳҪ˳£ֵʱΪȱʧ
+		 *
+		 * @param batch дŵһɼݡ
+		 * @param tripped λͼ i жӦ tripped[i / 64] ĵ i % 64 λ
+		 * @return size_t й
+		 */
+		size_t evaluateBatch(const sensorBatch& batch, std::vector<uint64_t>& tripped) const;
+
+		/**
+		 * @brief 豸йֵ
+		 *
+		 * @param record ɼ¼
+		 * @param fired Ĺţǰᱻա
+		 * @return size_t Ĺ
+		 */
+		size_t evaluateAll(const sensorRecord& record, std::vector<uint32_t>& fired) const;
+
+		/**
+		 * @brief Ƿй˻ͳûʱάڡ
+		 *
+		 * @return bool ÷ true
+		 */
+		bool usesWindows() const { return uses_windows; }
+
+		/**
+		 * @brief ȡ
+		 *
+		 * @param rule š
+		 * @return const alarmRule& á
+		 */
+		const alarmRule& getRule(uint32_t rule) const { return rules[rule]; }
+
+		/**
+		 * @brief ȡ豸ǣ
+		 *
+		 * @return size_t 
+		 */
+		size_t size() const { return rules.size(); }
+	};
+} // namespace ems 
@@ -0,0 +1,154 @@
+#include "anomalyDetector.h"
+
+namespace ems {
+
+	void p2Quantile::adjust(int i, double d) {
+		double q = heights[i] + d / (positions[i + 1] - positions[i - 1]) *
+			((positions[i] - positions[i - 1] + d) * (heights[i + 1] - heights[i]) / (positions[i + 1] - positions[i]) +
+			(positions[i + 1] - positions[i] - d) * (heights[i] - heights[i - 1]) / (positions[i] - positions[i - 1]));
+		if (heights[i - 1] < q && q < heights[i + 1]) {
+			heights[i] = q;
+		}
+		else {
+			int j = i + static_cast<int>(d);
+			heights[i] += d * (heights[j] - heights[i]) / (positions[j] - positions[i]);
+		}
+		positions[i] += d;
+	}
+
+	void p2Quantile::push(double x) {
+		// ǰ 5 ֱΪǵĳʼ߶
+		if (count < 5) {
+			heights[count++] = x;
+			if (count == 5) {
+				std::sort(heights, heights + 5);
+				for (int i = 0; i < 5; ++i) positions[i] = i;
+				desired[0] = 0;
+				desired[1] = 2 * p;
+				desired[2] = 4 * p;
+				desired[3] = 2 + 2 * p;
+				desired[4] = 4;
+				increments[0] = 0;
+				increments[1] = p / 2;
+				increments[2] = p;
+				increments[3] = (1 + p) / 2;
+				increments[4] = 1;
+			}
+			return;
+		}
+
+		// ҵڵ䣬˵ļֵ֮ǵλ
+		int k;
+		if (x < heights[0]) {
+			heights[0] = x;
+			k = 0;
+		}
+		else if (x >= heights[4]) {
+			heights[4] = x;
+			k = 3;
+		}
+		else {
+			k = 0;
+			while (k < 3 && x >= heights[k + 1]) ++k;
+		}
+		for (int i = k + 1; i < 5; ++i) positions[i] += 1;
+		for (int i = 0; i < 5; ++i) desired[i] += increments[i];
+		++count;
+
+		// ƫλó 1 мǵλƶһ
+		for (int i = 1; i < 4; ++i) {
+			double d = desired[i] - positions[i];
+			if ((d >= 1 && positions[i + 1] - positions[i] > 1) || (d <= -1 && positions[i - 1] - positions[i] < -1)) {
+				adjust(i, d > 0 ? 1.0 : -1.0);
+			}
+		}
+	}
+
+	double p2Quantile::value() const {
+		if (count == 0) return std::numeric_limits<double>::quiet_NaN();
+		if (count >= 5) return heights[2];
+		//  5 ʱֱȡĶӦλ
+		double sorted[5];
+		std::copy(heights, heights + count, sorted);
+		std::sort(sorted, sorted + count);
+		return sorted[static_cast<size_t>(p * (count - 1) + 0.5)];
+	}
+
+	void p2Quantile::save(snapshotWriter& out) const {
+		for (int i = 0; i < 5; ++i) {
+			out.put(heights[i]);
+			out.put(positions[i]);
+			out.put(desired[i]);
+			out.put(increments[i]);
+		}
+		out.put(count);
+		out.put(p);
+	}
+
+	bool p2Quantile::restore(snapshotReader& in) {
+		for (int i = 0; i < 5; ++i) {
+			heights[i] = in.get<double>();
+			positions[i] = in.get<double>();
+			desired[i] = in.get<double>();
+			increments[i] = in.get<double>();
+		}
+		count = in.get<uint64_t>();
+		p = in.get<double>();
+		return in.ok();
+	}
+
+	void anomalyDetector::push(double x, double alpha, uint64_t warmup, double noise_floor) {
+		if (std::isnan(x)) {
+			z = mz = std::numeric_limits<double>::quiet_NaN();
+			return;
+		}
+
+		// еͳ֣ɢ̶ȵڴޣһֱ䣩ʱ޴棬
+		// ڵĶֻõСķȵͻܵõܴķ
+		// Ϊ 0 ʱһڶļСޣ 0
+		bool ready = count >= warmup && count > 0;
+		double center = median.value();
+		double mad = deviation.value();
+		double floor_z = std::max(noise_floor, 1e-6 * std::max(1.0, std::fabs(mean)));
+		double floor_mz = std::max(noise_floor, 1e-6 * std::max(1.0, std::fabs(center)));
+		z = ready ? (x - mean) / std::max(std::sqrt(variance), floor_z) : std::numeric_limits<double>::quiet_NaN();
+		mz = ready ? 0.6745 * (x - center) / std::max(mad, floor_mz) : std::numeric_limits<double>::quiet_NaN();
+
+		// ָȨľֵͷ
+		if (count == 0) {
+			mean = x;
+			variance = 0;
+		}
+		else {
+			double diff = x - mean;
+			double increment = alpha * diff;
+			mean += increment;
+			variance = (1 - alpha) * (variance + diff * increment);
+		}
+		median.push(x);
+		deviation.push(std::fabs(x - median.value()));
+		++count;
+	}
+
+	void anomalyDetector::save(snapshotWriter& out) const {
+		out.put(mean);
+		out.put(variance);
+		out.put(count);
+		median.save(out);
+		deviation.save(out);
+		out.put(z);
+		out.put(mz);
+	}
+
+	bool anomalyDetector::restore(snapshotReader& in) {
+		mean = in.get<double>();
+		variance = in.get<double>();
+		count = in.get<uint64_t>();
+		median.restore(in);
+		deviation.restore(in);
+		z = in.get<double>();
+		mz = in.get<double>();
+		return in.ok();
+	}
+
+}  // namespace ems
@@ -0,0 +1,129 @@
+/**
+ * @file anomalyDetector.h
+ * @author Yilin Wang (yilin233@foxmail.com)
+ * @brief Online per-sensor anomaly scores, an EWMA z-score and a robust modified
+ *  z-score from streaming median/MAD estimates, each updated in O(1) per reading.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2024 Yilin Wang
+ *
+ * MIT License
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include "stateSnapshot.h"
+
+namespace ems {
+
+    /**
+     * @class p2Quantile
+     * @brief  P2 㷨ķλ
+     *
+     * ֻ 5 ǵĸ߶ȺλãÿĴΪ O(1)Ҫ
+     */
+    class p2Quantile {
+    private:
+        double heights[5] = {};     ///< ǵĸ߶ȣλĹֵ
+        double positions[5] = {};   ///< ǵʵλá
+        double desired[5] = {};     ///< ǵλá
+        double increments[5] = {};  ///< ÿλõ
+        uint64_t count = 0;         ///< Ѽ
+        double p = 0.5;             ///< ҪƵķλ
+
+        /**
+         * @brief ֵ߲ʱԲֵ i ǵ㡣
+         *
+         * @param i ǵ±꣬ȡֵ 1~3
+         * @param d ƶ+1  -1
+         */
+        void adjust(int i, double d);
+
+    public:
+        /**
+         * @brief 캯
+         *
+         * @param quantile ҪƵķλȡֵ (0, 1)
+         */
+        explicit p2Quantile(double quantile = 0.5) : p(quantile) {}
+
+        /**
+         * @brief һ
+         *
+         * @param x ֵ
+         */
+        void push(double x);
+
+        /**
+         * @brief ȡǰķλֵ
+         *
+         * @return double ֵûʱΪ NaN
+         */
+        double value() const;
+
+        /**
+         * @brief ״̬дա
+         */
+        void save(snapshotWriter& out) const;
+
+        /**
+         * @brief ӿջָ״̬
+         *
+         * @return bool  true
+         */
+        bool restore(snapshotReader& in);
+    };
+
+    /**
+     * @class anomalyDetector
+     * @brief 쳣״̬С̶
+     *
+     * ͬʱάַü뱾֮ǰͳ㣬쳣ֵԼĻߣ
+     * - zscore EWMA ֵ EWMA ׼ƫʺƽȵݣ
+     * - mzscore0.6745 * (x - λ) / MADλ MAD  p2Quantile ƣȺֵӰ졣
+     * δﵽԤʱΪ NaN򲻳
+     * ׼ MAD ڴޣʱ伸ʱڵĶõܴķ
+     */
+    class anomalyDetector {
+    private:
+        double mean = 0;            ///< EWMA ֵ
+        double variance = 0;        ///< EWMA 
+        uint64_t count = 0;         ///< Ѽ
+        p2Quantile median;          ///< λơ
+        p2Quantile deviation;       ///< λľƫλMADơ
+        double z = std::numeric_limits<double>::quiet_NaN();    ///< һ zscore
+        double mz = std::numeric_limits<double>::quiet_NaN();   ///< һ mzscore
+
+    public:
+        /**
+         * @brief һȼ쳣ٸͳ
+         *
+         * @param x ֵΪ NaN ʱҲΪ NaNͳ䡣
+         * @param alpha EWMA ֵͷƽϵȡֵ (0, 1]
+         * @param warmup ʼǰҪ
+         * @param noise_floor ׼ MAD ľޣĵλͬͨȡķֱʻȡ
+         */
+        void push(double x, double alpha, uint64_t warmup, double noise_floor);
+
+        double zscore() const { return z; }     ///< һ EWMA z 
+        double mzscore() const { return mz; }   ///< һλ/MAD  z 
+
+        /**
+         * @brief ״̬дա
+         */
+        void save(snapshotWriter& out) const;
+
+        /**
+         * @brief ӿջָ״̬
+         *
+         * @return bool  true
+         */
+        bool restore(snapshotReader& in);
+    };
+
+}  // namespace ems
@@ -0,0 +1,234 @@
+#include "deviceRegistry.h"
+
+namespace ems {
+
+	// ݿе DATETIME ַתΪ time_t
+	static std::time_t parseDateTime(const std::string& value) {
+		if (value.empty()) return 0;
+		std::tm tm = {};
+		std::istringstream iss(value);
+		iss >> std::get_time(&tm, "%Y-%m-%d %H:%M:%S");
+		if (iss.fail()) return 0;
+		tm.tm_isdst = -1;
+		return std::mktime(&tm);
+	}
+
+	deviceRegistry::deviceRegistry() {
+		esysControl& esys = esysControl::getInstance();
+		log_operations = esys.getConfig("log_operations") == "false" ? false : true;
+		// ϴرʱ豸ɿջָݿ
+		if (!stateSnapshot::getInstance().cleanShutdown()) loadFromDatabase();
+	}
+
+	void deviceRegistry::loadFromDatabase() {
+		dbTools& db = dbTools::getInstance();
+		std::vector<std::unordered_map<std::string, std::string>> rows;
+		db.dbReadAll("devices", rows);
+		// ϴ쳣˳ʱ״̬ʱ豸Ϊ
+		std::unordered_map<std::string, std::string> offline = { { "connected", "0" } };
+		db.dbUpdate("devices", offline, "connected", "1");
+		std::unique_lock lock(mtx);
+		for (const auto& row : rows) {
+			auto ip = row.find("clientIP");
+			if (ip == row.end() || ip->second.empty()) continue;
+			auto result = devices.try_emplace(ip->second);
+			if (!result.second) continue;
+			deviceState& state = result.first->second;
+			auto first_seen = row.find("first_seen");
+			auto last_seen = row.find("last_seen");
+			state.first_seen = first_seen != row.end() ? parseDateTime(first_seen->second) : 0;
+			state.last_seen = last_seen != row.end() ? parseDateTime(last_seen->second) : 0;
+			order.push_back(ip->second);
+		}
+		list_version.fetch_add(1, std::memory_order_release);
+		state_version.fetch_add(1, std::memory_order_release);
+		std::cout << "[deviceRegistry]: Loaded " << order.size() << " known devices." << std::endl;
+	}
+
+	void deviceRegistry::saveState(snapshotWriter& out) const {
+		std::shared_lock lock(mtx);
+		out.put<uint64_t>(order.size());
+		for (const std::string& clientIP : order) {
+			const deviceState& state = devices.find(clientIP)->second;
+			out.putString(clientIP);
+			out.put<int64_t>(state.first_seen);
+			out.put<int64_t>(state.last_seen.load(std::memory_order_relaxed));
+			std::lock_guard<std::mutex> latest_lock(state.latest_mtx);
+			out.put<uint32_t>(static_cast<uint32_t>(state.latest.size()));
+			for (const auto& [column, value] : state.latest) {
+				out.putString(column);
+				out.putString(value);
+			}
+		}
+	}
+
+	size_t deviceRegistry::restoreState(snapshotReader& in) {
+		size_t restored = 0;
+		std::unique_lock lock(mtx);
+		uint64_t count = in.get<uint64_t>();
+		for (uint64_t n = 0; n < count && in.ok(); ++n) {
+			std::string clientIP = in.getString();
+			std::time_t first_seen = static_cast<std::time_t>(in.get<int64_t>());
+			std::time_t last_seen = static_cast<std::time_t>(in.get<int64_t>());
+			uint32_t columns = in.get<uint32_t>();
+			readingRow latest;
+			for (uint32_t i = 0; i < columns && in.ok(); ++i) {
+				std::string column = in.getString();
+				latest.emplace_back(std::move(column), in.getString());
+			}
+			if (!in.ok() || clientIP.empty()) break;
+
+			// Ѵݿص豸ֻݣʱȡнµ
+			auto result = devices.try_emplace(clientIP);
+			deviceState& state = result.first->second;
+			if (result.second) {
+				state.first_seen = first_seen;
+				order.push_back(clientIP);
+			}
+			if (last_seen > state.last_seen.load(std::memory_order_relaxed)) state.last_seen.store(last_seen, std::memory_order_relaxed);
+			if (columns > 0) {
+				std::sort(latest.begin(), latest.end());
+				std::lock_guard<std::mutex> latest_lock(state.latest_mtx);
+				state.latest = std::move(latest);
+				state.reading_version.fetch_add(1, std::memory_order_release);
+			}
+			++restored;
+		}
+		list_version.fetch_add(1, std::memory_order_release);
+		state_version.fetch_add(1, std::memory_order_release);
+		return restored;
+	}
+
+	deviceRegistry::deviceState& deviceRegistry::findOrRegister(const std::string& clientIP, std::time_t now) {
+		{
+			std::shared_lock lock(mtx);
+			auto it = devices.find(clientIP);
+			if (it != devices.end()) return it->second;
+		}
+
+		// 豸дݿٵǼǵڴ棺߳ҵ豸ʱݿжӦУ
+		// persistState ĸ²ΪлڶգҲᱻĲ븲
+		std::lock_guard<std::mutex> register_lock(register_mtx);
+		{
+			std::shared_lock lock(mtx);
+			auto it = devices.find(clientIP);
+			if (it != devices.end()) return it->second;  // ߳ѾǼ
+		}
+		std::unordered_map<std::string, std::string> data;
+		data["clientIP"] = clientIP;
+		data["first_seen"] = "NOW()";
+		data["last_seen"] = "NOW()";
+		data["connected"] = "0";
+		dbTools::getInstance().dbInsert("devices", data);
+
+		deviceState* state = nullptr;
+		{
+			std::unique_lock lock(mtx);
+			auto result = devices.try_emplace(clientIP);
+			state = &result.first->second;
+			if (result.second) {
+				state->first_seen = now;
+				state->last_seen = now;
+				order.push_back(clientIP);
+				list_version.fetch_add(1, std::memory_order_release);
+				state_version.fetch_add(1, std::memory_order_release);
+			}
+		}
+		std::cout << "[deviceRegistry]: New device [" + clientIP + "] registered." << std::endl;
+		return *state;
+	}
+
+	void deviceRegistry::persistState(const std::string& clientIP, bool connected) {
+		std::unordered_map<std::string, std::string> data;
+		data["connected"] = connected ? "1" : "0";
+		data["last_seen"] = "NOW()";
+		dbTools::getInstance().dbUpdate("devices", data, "clientIP", clientIP);
+	}
+
+	void deviceRegistry::touch(const std::string& clientIP, const fieldMap& data, std::string_view now_text) {
+		std::time_t now = std::time(nullptr);
+		deviceState& state = findOrRegister(clientIP, now);
+		{
+			// 滻Ӱ汾ţ°汾ʱһܶӦ
+			std::lock_guard<std::mutex> lock(state.latest_mtx);
+			readingRow& row = state.latest;
+			// мһͬʱҵλԭظֵַظʹ
+			bool same_columns = row.size() == data.size();
+			for (auto it = data.begin(); same_columns && it != data.end(); ++it) {
+				std::string_view column(it->first);
+				auto pos = std::lower_bound(row.begin(), row.end(), column,
+					[](const std::pair<std::string, std::string>& entry, std::string_view key) { return entry.first < key; });
+				same_columns = pos != row.end() && pos->first == column;
+				if (same_columns) {
+					std::string_view value = it->second == "NOW()" ? now_text : std::string_view(it->second);
+					pos->second.assign(value.data(), value.size());
+				}
+			}
+			if (!same_columns) {
+				row.clear();
+				for (const auto& column : data) {
+					row.emplace_back(column.first, column.second == "NOW()" ? now_text : std::string_view(column.second));
+				}
+				std::sort(row.begin(), row.end());
+			}
+		}
+		state.reading_version.fetch_add(1, std::memory_order_release);
+		// ʱΪλͬһڵĶݲı豸Ϣİ汾
+		if (state.last_seen.exchange(now, std::memory_order_relaxed) != now) {
+			state_version.fetch_add(1, std::memory_order_release);
+		}
+	}
+
+	void deviceRegistry::connected(const std::string& clientIP) {
+		std::time_t now = std::time(nullptr);
+		deviceState& state = findOrRegister(clientIP, now);
+		state.last_seen.store(now, std::memory_order_relaxed);
+		if (state.connections.fetch_add(1) == 0) {
+			persistState(clientIP, true);
+		}
+		state_version.fetch_add(1, std::memory_order_release);
+	}
+
+	void deviceRegistry::disconnected(const std::string& clientIP) {
+		std::time_t now = std::time(nullptr);
+		deviceState& state = findOrRegister(clientIP, now);
+		state.last_seen.store(now, std::memory_order_relaxed);
+		if (state.connections.fetch_sub(1) == 1) {
+			persistState(clientIP, false);
+		}
+		state_version.fetch_add(1, std::memory_order_release);
+	}
+
+	std::vector<std::string> deviceRegistry::getClientIPs() const {
+		std::shared_lock lock(mtx);
+		return order;
+	}
+
+	bool deviceRegistry::getLatest(const std::string& clientIP, readingRow& row) const {
+		std::shared_lock lock(mtx);
+		auto it = devices.find(clientIP);
+		if (it == devices.end()) return false;
+		std::lock_guard<std::mutex> latest_lock(it->second.latest_mtx);
+		row = it->second.latest;
+		return !row.empty();
+	}
+
+	uint64_t deviceRegistry::getReadingVersion(const std::string& clientIP) const {
+		std::shared_lock lock(mtx);
+		auto it = devices.find(clientIP);
+		return it != devices.end() ? it->second.reading_version.load(std::memory_order_acquire) : 0;
+	}
+
+	std::vector<deviceInfo> deviceRegistry::getDevices() const {
+		std::shared_lock lock(mtx);
+		std::vector<deviceInfo> result;
+		result.reserve(order.size());
+		for (const auto& ip : order) {
+			const deviceState& state = devices.at(ip);
+			result.push_back({ ip, state.first_seen, state.last_seen.load(std::memory_order_relaxed),
+				state.connections.load(std::memory_order_relaxed) });
+		}
+		return result;
+	}
+
+}  // namespace ems
@@ -0,0 +1,215 @@
+/**
+ * @file deviceRegistry.h
+ * @author Yilin Wang (yilin233@foxmail.com)
+ * @brief Device registry, keeps every known collector device in memory with its
+ *  last-seen time and connection state, backed by the devices table.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2024 Yilin Wang
+ *
+ * MIT License
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <atomic>
+#include <algorithm>
+#include <mutex>
+#include <string_view>
+#include <ctime>
+#include <memory>
+#include <shared_mutex>
+#include "esysControl.h"  // Զ
+
+namespace ems {
+
+    /**
+     * @struct deviceInfo
+     * @brief 豸ϢĿա
+     */
+    struct deviceInfo {
+        std::string clientIP;       ///< 豸 IP ַ
+        std::time_t first_seen;     ///< ״γʱ䡣
+        std::time_t last_seen;      ///< һյݻӱ仯ʱ䡣
+        int connections;            ///< ǰ 0 ʾߡ
+    };
+
+    /**
+     * @brief һɼݵĿգֵ
+     */
+    using readingRow = std::vector<std::pair<std::string, std::string>>;
+
+    /**
+     * @class deviceRegistry
+     * @brief 豸עڴά֪豸
+     *
+     * ʱ devices һΣϴرʱΪӿջָ˺ֻ豸״γֺ״̬仯ʱд⣬
+     * ÿֻڴеʱ䡣ѯ豸бĴֻ豸йء
+     * ÿ豸һҲڴУѯݲҪݿ⡣豸ԼĻԭظǣ
+     * мϲʱڴ棻ѯʱһݸ÷
+     * 豸б豸״̬ÿ豸ݸһİ汾ţHTTP ӿھݴ ETag
+     */
+    class deviceRegistry {
+    private:
+        /**
+         * @brief 豸״ֶ̬ξΪԭйɸ¡
+         */
+        struct deviceState {
+            std::time_t first_seen = 0;                 ///< ״γʱ䣬޸ġ
+            std::atomic<std::time_t> last_seen{ 0 };    ///< ʱ䡣
+            std::atomic<int> connections{ 0 };          ///< ǰ
+            std::atomic<uint64_t> reading_version{ 0 }; ///< ݵİ汾ţÿյһݼһ
+            mutable std::mutex latest_mtx;              ///<  latest Ļ
+            readingRow latest;                          ///< ݣΪձʾлûյݡ
+        };
+
+        std::unordered_map<std::string, deviceState> devices;  ///< 豸key Ϊ IP ַ
+        std::vector<std::string> order;                         ///< 豸ķ˳
+        mutable std::shared_mutex mtx;                          ///< 豸ṹĶд
+        std::mutex register_mtx;                                ///< л豸ĵǼǣ֤ݿеڴе豸֡
+        std::atomic<uint64_t> list_version{ 1 };                ///< 豸бİ汾ţ豸ʱһ
+        std::atomic<uint64_t> state_version{ 1 };               ///< 豸Ϣİ汾ţб״̬ʱ䣨룩仯ʱһ
+        bool log_operations;                                    ///< Ƿ¼־
+
+        /**
+         * @brief ˽й캯ϴûرʱݿ豸
+         */
+        deviceRegistry();
+
+        /**
+         * @brief ˽
+         */
+        ~deviceRegistry() = default;
+
+        /**
+         * @brief ɾĿ캯ֹơ
+         */
+        deviceRegistry(const deviceRegistry&) = delete;
+
+        /**
+         * @brief ɾĸֵֵֹ
+         */
+        deviceRegistry& operator=(const deviceRegistry&) = delete;
+
+        /**
+         * @brief 豸ʱдݿ⣬ٵǼΪ豸
+         *
+         * @param clientIP 豸 IP ַ
+         * @param now ǰʱ䡣
+         * @return deviceState& 豸״̬ãڵַעڱֲ䣩
+         */
+        deviceState& findOrRegister(const std::string& clientIP, std::time_t now);
+
+        /**
+         * @brief 豸״̬ʱдݿ⡣
+         *
+         * @param clientIP 豸 IP ַ
+         * @param connected Ƿߡ
+         */
+        void persistState(const std::string& clientIP, bool connected);
+
+    public:
+        /**
+         * @brief ȡ deviceRegistry ĵʵ
+         *
+         * @return deviceRegistry& ʵá
+         */
+        static deviceRegistry& getInstance() {
+            static deviceRegistry instance;
+            return instance;
+        }
+
+        /**
+         * @brief ¼豸һݣֻڴеʱ䡢ݺͰ汾š
+         *
+         * @param clientIP 豸 IP ַ
+         * @param data ݣƵ豸С
+         * @param now ֵΪ "NOW()" 滻ɵʱ䡣
+         */
+        void touch(const std::string& clientIP, const fieldMap& data, std::string_view now);
+
+        /**
+         * @brief ȡ豸ڱյһݡ
+         *
+         * @param clientIP 豸 IP ַ
+         * @param row ݸ
+         * @return bool ݷ trueδ֪豸򱾴лûյݷ false
+         */
+        bool getLatest(const std::string& clientIP, readingRow& row) const;
+
+        /**
+         * @brief ¼豸һӡ
+         *
+         * @param clientIP 豸 IP ַ
+         */
+        void connected(const std::string& clientIP);
+
+        /**
+         * @brief ¼豸Ͽһӡ
+         *
+         * @param clientIP 豸 IP ַ
+         */
+        void disconnected(const std::string& clientIP);
+
+        /**
+         * @brief ȡ֪豸 IP ַ˳С
+         *
+         * @return std::vector<std::string> 豸 IP ַб
+         */
+        std::vector<std::string> getClientIPs() const;
+
+        /**
+         * @brief ȡ֪豸Ϣա
+         *
+         * @return std::vector<deviceInfo> 豸Ϣб
+         */
+        std::vector<deviceInfo> getDevices() const;
+
+        /**
+         * @brief ȡ豸бgetClientIPsİ汾š
+         *
+         * @return uint64_t 汾š
+         */
+        uint64_t getListVersion() const { return list_version.load(std::memory_order_acquire); }
+
+        /**
+         * @brief ȡ豸ϢgetDevicesİ汾š
+         *
+         * @return uint64_t 汾š
+         */
+        uint64_t getStateVersion() const { return state_version.load(std::memory_order_acquire); }
+
+        /**
+         * @brief ȡ豸ݵİ汾š
+         *
+         * @param clientIP 豸 IP ַ
+         * @return uint64_t 汾ţδ֪豸 0
+         */
+        uint64_t getReadingVersion(const std::string& clientIP) const;
+
+        /**
+         * @brief  devices 豸״̬Ϊߡ
+         */
+        void loadFromDatabase();
+
+        /**
+         * @brief 豸дգ档
+         *
+         * @param out д
+         */
+        void saveState(snapshotWriter& out) const;
+
+        /**
+         * @brief ӿջָ豸ݣѼص豸ϲ
+         *
+         * @param in ݡ
+         * @return size_t ָ豸
+         */
+        size_t restoreState(snapshotReader& in);
+    };
+
+}  // namespace ems
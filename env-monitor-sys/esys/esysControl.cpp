@@ -1,4 +1,5 @@
 #include "esysControl.h"
+#include "../network/udpListener.h"
 
 namespace ems {
 
@@ -8,6 +9,17 @@ namespace ems {
 		setupLogging();
 		// ļ
 		loadConfig(configFilePath);
+
+		// ʱƫÿжҪõʱһΣЧʱʹĬֵ
+		std::string skew_value = getConfig("ingest_max_clock_skew_seconds");
+		int64_t skew_seconds = 300;
+		try {
+			if (!skew_value.empty()) skew_seconds = std::stoll(skew_value);
+		}
+		catch (const std::exception&) {
+			std::cerr << "[esysControl]: Invalid value \"" << skew_value << "\" for ingest_max_clock_skew_seconds, use 300." << std::endl;
+		}
+		max_clock_skew_ms = skew_seconds * 1000;
 	}
 
 	void esysControl::create_directory_if_not_exists(const std::filesystem::path& dir) {
@@ -67,23 +79,83 @@ namespace ems {
 			"# tcp server's ip address and port",
 			"tcp_server_ip = 127.0.0.1",	
 			"tcp_server_port = 8080",
+			"tcp_backend = threads",
+			"tcp_iocp_threads = 0",
+			"tcp_throttle_rate = 2",
+			"tcp_idle_timeout_seconds = 300",
+			"tcp_keepalive_seconds = 60",
+			"tcp_max_connections = 1000",
+			"tcp_max_connections_per_ip = 0",
+			"ingest_max_clock_skew_seconds = 300",
+			"# tcp traffic capture, leave the file empty to disable",
+			"capture_file = ",
+			"capture_max_mb = 1024",
+			"# udp datagram ingest, leave the port empty to disable",
+			"udp_server_port = ",
+			"udp_threads = 1",
+			"udp_recv_buffer_bytes = 4194304",
+			"udp_batch_size = 64",
 			"# the database settings",
 			"db_url = tcp://127.0.0.1:3306",
 			"db_user = root",
 			"db_password = 1234",
 			"db_schema = envdb",
 			"db_build_file_location = ./envdb.sql",
+			"db_migration_dir = ./migrations",
+			"# database backend, mysql or fake (in-memory stand-in for benchmarking)",
+			"db_backend = mysql",
+			"fake_db_latency_ms = 1",
+			"fake_db_jitter_ms = 0",
+			"fake_db_failure_rate = 0",
+			"fake_db_max_rows = 100000",
+			"fake_db_seed = 1",
 			"suffix_of_collected_values = Val",
+			"# async writer settings",
+			"writer_batch_rows = 500",
+			"writer_flush_interval_ms = 100",
+			"writer_retry_max_backoff_ms = 5000",
+			"writer_queue_capacity = 100000",
+			"writer_high_watermark = 80000",
+			"writer_low_watermark = 20000",
+			"# data retention settings",
+			"retention_raw_days = 0",
+			"retention_interval_seconds = 300",
+			"retention_chunk_rows = 2000",
+			"retention_chunk_pause_ms = 50",
+			"prefix_of_rollup_tier = rollup_",
 			"# the http server settings",
 			"hs_host = 127.0.0.1",
 			"hs_port = 5050",
-			"hs_mount_dir = ./dist"
+			"hs_mount_dir = ./dist",
+			"hs_static_cache = true",
+			"hs_static_reload_seconds = 2",
+			"hs_ingest_max_rows = 10000",
+			"hs_max_payload_bytes = 8388608",
+			"hs_history_max_rows = 10000",
 			"# alarm program settings",
 			"prefix_of_threshold_value = threshold_",
 			"threshold_temperature = ",
 			"threshold_humidity = ",
 			"threshold_smoke = ",
+			"prefix_of_alarm_rule = rule_",
+			"alarm_window_samples = 60",
+			"alarm_window_seconds = 0",
+			"alarm_ewma_alpha = 0.2",
+			"anomaly_method = ",
+			"anomaly_threshold = 4",
+			"anomaly_alpha = 0.05",
+			"anomaly_warmup_samples = 30",
+			"anomaly_noise_floor = 0.1",
 			"alarm_lock_duration_seconds = 60",
+			"alarm_trip_samples = 2",
+			"alarm_clear_samples = 3",
+			"alarm_history_size = 1024",
+			"alarm_persist_events = true",
+			"# shutdown settings",
+			"shutdown_timeout_seconds = 30",
+			"# snapshot settings",
+			"snapshot_file = ./data/esys.snapshot",
+			"snapshot_interval_seconds = 60",
 			"# log settings",
 			"log_operations = false"
 		};
@@ -225,36 +297,135 @@ namespace ems {
 		std::cerr.rdbuf(logStreamBuf);
 	}
 
-	void esysControl::runTcpServer(std::shared_mutex& mtx)
+	std::string esysControl::onTextMessage(const std::string& clientIP, std::string_view request, messageArena& arena)
 	{
-		tcpConnector conn(mtx);
-		conn.startServer([](const std::string& clientIP, const std::string& request) -> std::string {
-			esysControl& esys = esysControl::getInstance();
-			return esys.messageHandle(clientIP, request);
-			});
+		return esysControl::getInstance().messageHandle(clientIP, request, arena);
 	}
 
-	void esysControl::runHttpServer(std::shared_mutex& mtx)
+	void esysControl::onBinaryBatch(const sensorBatch& batch, std::vector<uint64_t>& alarm_mask)
+	{
+		esysControl::getInstance().ingestBatch(batch, alarm_mask);
+	}
+
+	void esysControl::runTcpServer(tcpConnector& conn)
+	{
+		conn.startServer(onTextMessage, onBinaryBatch);
+	}
+
+	void esysControl::runUdpServer(udpListener& udp)
+	{
+		if (!udp.enabled()) return;
+		udp.startServer(onTextMessage, onBinaryBatch);
+	}
+
+	void esysControl::runHttpServer(httpServer& hvr)
 	{
-		httpServer hvr(mtx);
 		hvr.run();
 	}
 
+	std::atomic<bool> esysControl::shutdown_requested{ false };
+	std::atomic<bool> esysControl::shutdown_complete{ false };
+
+	void esysControl::onSignal(int signal)
+	{
+		shutdown_requested = true;
+	}
+
+	BOOL WINAPI esysControl::onConsoleEvent(DWORD event)
+	{
+		switch (event) {
+		case CTRL_CLOSE_EVENT:
+		case CTRL_LOGOFF_EVENT:
+		case CTRL_SHUTDOWN_EVENT:
+			shutdown_requested = true;
+			while (!shutdown_complete) std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			return TRUE;
+		default:
+			return FALSE;
+		}
+	}
+
+	void esysControl::gracefulShutdown(tcpConnector& tcp, udpListener& udp, httpServer& hvr, std::vector<std::thread>& threads)
+	{
+		using namespace std::chrono;
+		std::string timeout_value = getConfig("shutdown_timeout_seconds");
+		unsigned int timeout_seconds = timeout_value.empty() ? 30 : static_cast<unsigned int>(std::stoul(timeout_value));
+		auto start_time = steady_clock::now();
+		auto deadline = start_time + seconds(timeout_seconds);
+		std::cout << "[esysControl]: Shutting down, deadline " << timeout_seconds << " s." << std::endl;
+
+		// ֹͣݣUDP ȡݱHTTP еTCP Ӵյݺر
+		udp.stop();
+		hvr.stop();
+		tcp.stop(deadline);
+		for (auto& th : threads) {
+			if (th.joinable()) th.join();
+		}
+
+		// ˺ӣڽֹʱǰддУʣж
+		dbWriter& writer = dbWriter::getInstance();
+		writerMetrics before = writer.getMetrics();
+		int64_t remaining_ms = duration_cast<milliseconds>(deadline - steady_clock::now()).count();
+		bool flushed = writer.flush(static_cast<unsigned int>(std::max<int64_t>(remaining_ms, 0)));
+		uint64_t discarded = flushed ? 0 : writer.discard();
+		writer.stop();
+		writerMetrics after = writer.getMetrics();
+		std::cout << "[esysControl]: Drained " << (after.written + after.failed) - (before.written + before.failed)
+			<< " queued rows (" << after.written - before.written << " written, " << after.failed - before.failed << " failed), "
+			<< discarded << " discarded at the deadline." << std::endl;
+
+		// дſպ󱣴յĿգΪر
+		stateSnapshot::getInstance().stop();
+		stateSnapshot::getInstance().save(true);
+
+		// ֹ̨ͣ߳
+		connectionTracker::getInstance().stop();
+		dbRetention::getInstance().stop();
+
+		std::cout << "[esysControl]: Shutdown complete in "
+			<< duration_cast<milliseconds>(steady_clock::now() - start_time).count() << " ms." << std::endl;
+	}
 
 	int esysControl::sysRun()
 	{
 		// ʼݿ
 		dbTools::getInstance();
-		// ʼģ
+		// 첽д
+		dbWriter::getInstance().start();
+		// ӳϴε״̬գ豸עݴ˾Ƿݿ
+		stateSnapshot& snapshot = stateSnapshot::getInstance();
+		snapshot.open();
+		// 豸ע
+		deviceRegistry::getInstance();
+		// شűʼģ
+		sensorSchema::getInstance();
 		alarmModule::getInstance();
+		// ӿջָ豸״̬ͻڣ֮д
+		snapshot.restore();
+		snapshot.start();
+		// ݱѹ
+		dbRetention::getInstance().start();
+
+		// յرźź˳رգֱӽ
+		std::signal(SIGINT, onSignal);
+		std::signal(SIGTERM, onSignal);
+		SetConsoleCtrlHandler(onConsoleEvent, TRUE);
 
 		std::shared_mutex mtx;
-		
-		std::thread httpServer(runHttpServer, std::ref(mtx));
+		httpServer hvr(mtx);
+		tcpConnector tcp(mtx);
+		udpListener udp(mtx);
 
-		std::thread tcpServer(runTcpServer, std::ref(mtx));
-		if(httpServer.joinable())	httpServer.join();
-		if(tcpServer.joinable())	tcpServer.join();
+		std::vector<std::thread> servers;
+		servers.emplace_back(runHttpServer, std::ref(hvr));
+		servers.emplace_back(runTcpServer, std::ref(tcp));
+		servers.emplace_back(runUdpServer, std::ref(udp));
+
+		while (!shutdown_requested) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(200));
+		}
+		gracefulShutdown(tcp, udp, hvr, servers);
+		shutdown_complete = true;
 		return 0;
 	}
 
@@ -279,32 +450,132 @@ namespace ems {
 		return keys;
 	}
 
-	// Ϣ
-	std::string esysControl::messageHandle(const std::string& clientIP, const std::string& request) {
-		dbTools& db = dbTools::getInstance();
-		alarmModule& am = alarmModule::getInstance();
+	// תϢд pos ʼƥһֵ \"key\" : valueԭʽ
+	// (\\"|\\')(\w+)(\\"|\\')\s*:\s*(\d+\.?\d*) ͬƥɹʱ pos Ƶֵ֮
+	static bool matchKeyValue(std::string_view request, size_t& pos, std::string_view& key, std::string_view& value) {
+		auto isWord = [](char c) { return std::isalnum(static_cast<unsigned char>(c)) || c == '_'; };
+		auto isDigit = [](char c) { return c >= '0' && c <= '9'; };
+		auto isQuote = [&request](size_t i) { return i + 1 < request.size() && request[i] == '\\' && (request[i + 1] == '"' || request[i + 1] == '\''); };
+		auto skipSpace = [&request](size_t& i) { while (i < request.size() && std::isspace(static_cast<unsigned char>(request[i]))) ++i; };
+
+		size_t i = pos;
+		if (!isQuote(i)) return false;
+		i += 2;
+		size_t key_begin = i;
+		while (i < request.size() && isWord(request[i])) ++i;
+		if (i == key_begin || !isQuote(i)) return false;
+		key = request.substr(key_begin, i - key_begin);
+		i += 2;
+		skipSpace(i);
+		if (i >= request.size() || request[i] != ':') return false;
+		++i;
+		skipSpace(i);
+		size_t value_begin = i;
+		while (i < request.size() && isDigit(request[i])) ++i;
+		if (i == value_begin) return false;
+		if (i < request.size() && request[i] == '.') ++i;
+		while (i < request.size() && isDigit(request[i])) ++i;
+		value = request.substr(value_begin, i - value_begin);
+		pos = i;
+		return true;
+	}
 
-		std::unordered_map<std::string, std::string> dataMap;
+	// Ϣ
+	std::string esysControl::messageHandle(const std::string& clientIP, std::string_view request, messageArena& arena) {
+		std::pmr::memory_resource* resource = arena.resource();
+		fieldMap dataMap(resource);
+		dataMap.reserve(16);
 		dataMap["clientIP"] = clientIP;
 
-		// ʽƥֵ
-		std::regex keyValuePattern(R"+((\\"|\\')(\w+)(\\"|\\')\s*:\s*(\d+\.?\d*))+");
-		auto wordsBegin = std::sregex_iterator(request.begin(), request.end(), keyValuePattern);
-		auto wordsEnd = std::sregex_iterator();
-
-		for (std::sregex_iterator i = wordsBegin; i != wordsEnd; ++i) {
-			std::smatch match = *i;
-			std::string key = match[2].str();
-			std::string value = match[4].str();
-			dataMap[key] = value;
+		// λƥֵԣΪÿϢʽ
+		// ֻ envtable дڵУеֵܴͣ INSERT ᱻݿܾ
+		const sensorSchema& schema = sensorSchema::getInstance();
+		std::string_view key, value;
+		for (size_t pos = 0; pos < request.size();) {
+			if (matchKeyValue(request, pos, key, value)) {
+				int id = schema.columnIdOf(key);
+				if (id >= 0) {
+					double number = 0;
+					auto result = std::from_chars(value.data(), value.data() + value.size(), number);
+					if (result.ec != std::errc() || !schema.accepts(id, number)) continue;
+				}
+				else if (!schema.writableColumn(key)) {
+					continue;
+				}
+				dataMap[std::pmr::string(key, resource)] = value;
+			}
+			else {
+				++pos;
+			}
 		}
 
-		// ݵݿ
 		dataMap["etime"] = "NOW()";
-		std::string table_name = "envtable";
-		int result = db.dbInsert(table_name, dataMap);
+		std::string reply;
+		// дʱûб棬ظ "ack"е豸Իظ "alarm_active"
+		if (ingest(dataMap, reply) != EXIT_SUCCESS && reply == "ack") return "busy";
+		return reply;
+	}
+
+	int esysControl::ingest(const fieldMap& data, std::string& reply) {
+		using namespace std::chrono;
+		auto ip = data.find("clientIP");
+		std::string clientIP = ip != data.end() ? std::string(ip->second) : "";
+
+		// д첽дݿ⣬߳еȴʧʱԸݲж
+		int result = dbWriter::getInstance().enqueue("envtable", data);
+		int64_t now_ms = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+		char now[32];
+		size_t now_length = alarmEventLog::formatTime(now_ms, now, sizeof(now));
+		deviceRegistry::getInstance().touch(clientIP, data, std::string_view(now, now_length));
+
+		reply = alarmModule::getInstance().alarmMonitor(data);
+		return result;
+	}
+
+	ingestSummary esysControl::ingestBatch(const sensorBatch& batch, std::vector<uint64_t>& alarm_mask) {
+		using namespace std::chrono;
+		const sensorSchema& schema = sensorSchema::getInstance();
+		dbWriter& writer = dbWriter::getInstance();
+		deviceRegistry& registry = deviceRegistry::getInstance();
+		ingestSummary summary;
+		summary.rows = batch.rows;
+
+		int64_t now_ms = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+		char now_buffer[32];
+		std::string_view now(now_buffer, alarmEventLog::formatTime(now_ms, now_buffer, sizeof(now_buffer)));
+		// 豸ʱӿδУ׼ɼʱʱʱ÷ʱ䣺
+		// ƫ etime ĻͰͷʱлڱ޵ǰͱɾ
+		// ÿеļֵԴ߳Լڴط䣬дͷ
+		thread_local messageArena arena;
+		char buffer[32];
+		for (size_t row = 0; row < batch.rows; ++row) {
+			{
+				fieldMap data(arena.resource());
+				data.reserve(batch.sensors + 2);
+				const std::string& clientIP = batch.devices[batch.device_ids[row]];
+				data["clientIP"] = clientIP;
+				int64_t time_ms = batch.times[row];
+				if (time_ms > 0 && std::llabs(time_ms - now_ms) <= max_clock_skew_ms) {
+					data["etime"].assign(buffer, alarmEventLog::formatTime(time_ms, buffer, sizeof(buffer)));
+				}
+				else {
+					data["etime"] = "NOW()";
+				}
+				for (size_t sensor = 0; sensor < batch.sensors; ++sensor) {
+					double value = batch.column(sensor)[row];
+					if (!schema.accepts(static_cast<int>(sensor), value)) continue;
+					std::snprintf(buffer, sizeof(buffer), "%.15g", value);
+					data.emplace(schema.columnOf(static_cast<int>(sensor)), buffer);
+				}
+				if (writer.enqueue("envtable", data) == EXIT_SUCCESS) summary.stored++;
+				else summary.dropped++;
+				registry.touch(clientIP, data, now);
+			}
+			arena.reset();
+		}
 
-		return am.alarmMonitor(dataMap);
+		summary.alarm_rows = alarmModule::getInstance().alarmMonitorBatch(batch, alarm_mask);
+		return summary;
 	}
 
 }  // namespace ems
@@ -20,15 +20,43 @@
 #include <iomanip>
 #include <chrono>
 #include <regex>
+#include <string_view>
+#include <charconv>
 #include <mutex>  
 #include <shared_mutex>
+#include <atomic>
+#include <csignal>
 #include "../db/dbTools.h"
+#include "../db/dbRetention.h"
+#include "../db/dbWriter.h"
 #include "../network/tcpConnector.h"
 #include "../network/httpServer.h"
+#include "stateSnapshot.h"
+#include "sensorRecord.h"
+#include "anomalyDetector.h"
+#include "sensorWindow.h"
+#include "alarmRules.h"
+#include "alarmEvents.h"
 #include "alarmModule.h"
+#include "deviceRegistry.h"
 
 namespace ems {
 
+    class tcpConnector;
+    class udpListener;
+    class httpServer;
+
+    /**
+     * @struct ingestSummary
+     * @brief һɼݵĴ
+     */
+    struct ingestSummary {
+        size_t rows = 0;        ///< 
+        size_t stored = 0;      ///< ɹде
+        size_t dropped = 0;     ///< дδ
+        size_t alarm_rows = 0;  ///< 豸ڱе
+    };
+
     /**
      * @class esysControl
      * @brief ڹá־¼ͷҪģ顣
@@ -38,6 +66,7 @@ namespace ems {
         std::unordered_map<std::string, std::string> config;       ///< Ϣݡ
         const std::string& configFilePath;                         ///< ļ·
         std::string logFilePath;                                   ///< ־ļ·
+        int64_t max_clock_skew_ms;                                 ///< ɼʱʱƫ룩ʱ÷ʱ䡣
 
         /**
          * @brief ˽й캯ֹʵ
@@ -156,19 +185,75 @@ namespace ems {
          */
         void setupLogging();
 
+        static std::atomic<bool> shutdown_requested;    ///< Ƿյرźš
+        static std::atomic<bool> shutdown_complete;     ///< رǷɡ
+
+        /**
+         * @brief SIGINT  SIGTERM Ĵֻ shutdown_requested
+         *
+         * @param signal źűš
+         */
+        static void onSignal(int signal);
+
+        /**
+         * @brief ̨¼Ĵ
+         *
+         * رտ̨ڡעػʱ̻ڴغ󱻽ȴرɣ
+         * Ctrl+C  Ctrl+Break  C пתΪ SIGINT
+         *
+         * @param event ̨¼
+         * @return BOOL Ѵ TRUE
+         */
+        static BOOL WINAPI onConsoleEvent(DWORD event);
+
+        /**
+         * @brief ˳رոģ飺ֹͣݡȴӴյݡддСֹ̨̡ͣ߳
+         *
+         * @param tcp TCP 
+         * @param udp UDP 
+         * @param hvr HTTP 
+         * @param threads з̡߳
+         */
+        void gracefulShutdown(tcpConnector& tcp, udpListener& udp, httpServer& hvr, std::vector<std::thread>& threads);
+
         /**
          * @brief ڵ߳ TCP 
          *
-         * @param mtx ͬĹ
+         * @param conn TCP 
+         */
+        static void runTcpServer(tcpConnector& conn);
+
+        /**
+         * @brief ڵ߳ UDP δ udp_server_port ʱֱӷء
+         *
+         * @param udp UDP 
+         */
+        static void runUdpServer(udpListener& udp);
+
+        /**
+         * @brief TCP  UDP õıЭ鴦
+         *
+         * @param clientIP ͻ˵ IP ַ
+         * @param request תϢ
+         * @param arena Ϣڴء
+         * @return std::string ͻ˵Ӧ
          */
-        static void runTcpServer(std::shared_mutex& mtx);
+        static std::string onTextMessage(const std::string& clientIP, std::string_view request, messageArena& arena);
+
+        /**
+         * @brief TCP  UDP õĶЭ鴦
+         *
+         * @param batch Ρ
+         * @param alarm_mask ıλͼ
+         */
+        static void onBinaryBatch(const sensorBatch& batch, std::vector<uint64_t>& alarm_mask);
 
         /**
          * @brief ڵ߳ HTTP 
          *
-         * @param mtx ͬĹ
+         * @param hvr HTTP 
          */
-        static void runHttpServer(std::shared_mutex& mtx);
+        static void runHttpServer(httpServer& hvr);
 
     public:
         /**
@@ -182,12 +267,17 @@ namespace ems {
         }
 
         /**
-         * @brief ϵͳѭ
+         * @brief ϵͳѭյ SIGINTSIGTERM ̨ر¼˳رղء
          *
          * @return int ״̬롣
          */
         int sysRun();
 
+        /**
+         * @brief رϵͳsysRun Ժʼر̡
+         */
+        void requestShutdown() { shutdown_requested = true; }
+
         /**
          * @brief ͨȡϢֵ
          *
@@ -206,11 +296,32 @@ namespace ems {
         /**
          * @brief Կͻ˵Ϣ
          *
+         * ļֵԴ arena 䣬ֻдек豸ҪϢḴƵдеĲλ豸עĻУ߶ظʹеַ
+         *
          * @param clientIP ͻ˵ IP ַ
          * @param request Ϣ
-         * @return std::string ԿͻӦ
+         * @param arena Ϣڴأɵ÷ڴͷš
+         * @return std::string ԿͻӦдδܱ豸ڱʱ "busy"
+         */
+        std::string messageHandle(const std::string& clientIP, std::string_view request, messageArena& arena);
+
+        /**
+         * @brief һɼ봦ˮߣ첽дС豸ݡжϡ
+         *
+         * @param data ɼݣkey Ϊ "clientIP"
+         * @param reply ӦΪ "alarm_active"Ϊ "ack"
+         * @return int дгɹ EXIT_SUCCESS EXIT_FAILUREʱ reply Ч
+         */
+        int ingest(const fieldMap& data, std::string& reply);
+
+        /**
+         * @brief һɼ ingest ͬĴˮߣжϰС
+         *
+         * @param batch дŵһɼݡ
+         * @param alarm_mask λͼ i д豸ڱʱ alarm_mask[i / 64] ĵ i % 64 λΪ 1
+         * @return ingestSummary 
          */
-        std::string messageHandle(const std::string& clientIP, const std::string& request);
+        ingestSummary ingestBatch(const sensorBatch& batch, std::vector<uint64_t>& alarm_mask);
     };
 
 }  // namespace ems
@@ -0,0 +1,60 @@
+/**
+ * @file messageArena.h
+ * @author Yilin Wang (yilin233@foxmail.com)
+ * @brief Per-connection monotonic arena for the message processing path, backed
+ *  by an inline buffer and released after every received batch.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2024 Yilin Wang
+ *
+ * MIT License
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <string>
+#include <unordered_map>
+
+namespace ems {
+
+    /**
+     * @brief һıϢļֵԣkey ΪڴԹʱ memory_resource
+     */
+    using fieldMap = std::pmr::unordered_map<std::pmr::string, std::pmr::string>;
+
+    /**
+     * @class messageArena
+     * @brief Ϣ·ʹõĵڴء
+     *
+     * ÿӣ UDP ̣߳һһϢʱתϢ fieldMap ʱ󶼴䣬
+     *  reset һͷšСϢֻʹõĻȫֶѣ
+     * ʱȫֶ룬reset 黹Ķ reset ֮ʹá
+     */
+    class messageArena {
+    public:
+        static constexpr size_t capacity = 16 * 1024;  ///< ûֽ
+
+        messageArena() : resource_(buffer, sizeof(buffer), std::pmr::new_delete_resource()) {}
+
+        messageArena(const messageArena&) = delete;
+        messageArena& operator=(const messageArena&) = delete;
+
+        /**
+         * @brief ȡڴԴڹ std::pmr 
+         */
+        std::pmr::memory_resource* resource() { return &resource_; }
+
+        /**
+         * @brief ͷűϢڴ棬صû㡣
+         */
+        void reset() { resource_.release(); }
+
+    private:
+        alignas(std::max_align_t) std::byte buffer[capacity];  ///< û
+        std::pmr::monotonic_buffer_resource resource_;          ///< 
+    };
+
+}  // namespace ems
@@ -0,0 +1,95 @@
+#include "sensorRecord.h"
+#include "esysControl.h"
+
+namespace ems {
+
+	//  SHOW COLUMNS ȡֵֵܱ
+	static double columnLimit(const std::string& type) {
+		auto is = [&type](const char* prefix) { return type.rfind(prefix, 0) == 0; };
+		if (is("tinyint")) return 127;
+		if (is("smallint")) return 32767;
+		if (is("mediumint")) return 8388607;
+		if (is("int")) return 2147483647;
+		if (is("bigint")) return 9.2e18;
+		if (is("float")) return std::numeric_limits<float>::max();
+		return std::numeric_limits<double>::max();
+	}
+
+	sensorSchema::sensorSchema() {
+		esysControl& esys = esysControl::getInstance();
+		std::string suffix = esys.getConfig("suffix_of_collected_values");
+		dbTableMetaPtr meta = dbTools::getInstance().getTableStructure("envtable");
+		if (!meta) {
+			// ݿⲻʱ threshold_* űֵȻã
+			// δ֪ FLOAT еķΧ飬ڱжд
+			std::string prefix = esys.getConfig("prefix_of_threshold_value");
+			for (const auto& key : esys.getAllConfigKeys()) {
+				if (prefix.empty() || key.length() <= prefix.length() || key.compare(0, prefix.length(), prefix) != 0) continue;
+				std::string name = key.substr(prefix.length());
+				if (ids.count(name)) continue;
+				ids[name] = static_cast<int>(names.size());
+				names.push_back(name);
+				columns.push_back(name + suffix);
+				column_keys.emplace_back(name + suffix);
+				limits.push_back(columnLimit("float"));
+			}
+			from_config = true;
+			std::cerr << "[sensorSchema]: Warning: Unable to get table structure for envtable, using " << names.size()
+				<< " sensors from the " << prefix << "* settings. Alarm rules on other sensors stay disabled until restart." << std::endl;
+			return;
+		}
+		for (const auto& column : meta->columns) {
+			const std::string& name = column.name;
+			if (name.length() > suffix.length() &&
+				name.compare(name.length() - suffix.length(), std::string::npos, suffix) == 0) {
+				ids[name.substr(0, name.length() - suffix.length())] = static_cast<int>(names.size());
+				names.push_back(name.substr(0, name.length() - suffix.length()));
+				columns.push_back(name);
+				column_keys.emplace_back(name);
+				limits.push_back(columnLimit(column.type));
+			}
+			else if (name != "eid" && name != "clientIP" && name != "etime") {
+				writable.push_back(name);
+			}
+		}
+		std::cout << "[sensorSchema]: Loaded " << names.size() << " sensors from envtable." << std::endl;
+	}
+
+	int sensorSchema::idOf(const std::string& name) const {
+		auto it = ids.find(name);
+		if (it != ids.end()) return it->second;
+		// Ҳܴ׺
+		for (size_t i = 0; i < columns.size(); ++i) {
+			if (columns[i] == name) return static_cast<int>(i);
+		}
+		return -1;
+	}
+
+	size_t sensorSchema::parse(const fieldMap& data, sensorRecord& record) const {
+		size_t parsed = 0;
+		auto ip = data.find("clientIP");
+		record.clientIP = ip != data.end() ? ip->second : "";
+		record.values.assign(slotCount(), std::numeric_limits<double>::quiet_NaN());
+		for (size_t i = 0; i < column_keys.size(); ++i) {
+			auto it = data.find(column_keys[i]);
+			if (it == data.end() || it->second.empty()) continue;
+			const char* begin = it->second.c_str();
+			char* end = nullptr;
+			double value = std::strtod(begin, &end);
+			if (end != begin) {
+				record.values[i] = value;
+				++parsed;
+			}
+		}
+		return parsed;
+	}
+
+	void sensorSchema::extract(const sensorBatch& batch, size_t row, sensorRecord& record) const {
+		record.clientIP = batch.devices[batch.device_ids[row]];
+		record.values.assign(slotCount(), std::numeric_limits<double>::quiet_NaN());
+		for (size_t i = 0; i < names.size(); ++i) {
+			record.values[i] = batch.column(i)[row];
+		}
+	}
+
+}  // namespace ems
@@ -0,0 +1,283 @@
+/**
+ * @file sensorRecord.h
+ * @author Yilin Wang (yilin233@foxmail.com)
+ * @brief Sensor schema and typed sensor record, maps every collected value to a
+ *  dense sensor id so that readings are parsed once and evaluated as doubles.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2024 Yilin Wang
+ *
+ * MIT License
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <limits>
+#include <cmath>
+#include <string_view>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include "messageArena.h"
+
+namespace ems {
+
+    /**
+     * @brief õĴͳ
+     */
+    enum class sensorFeature : uint8_t {
+        VALUE,      ///< εĲɼֵ
+        MEAN,       ///< ڵƽֵ
+        MIN,        ///< ڵСֵ
+        MAX,        ///< ڵֵ
+        SLOPE,      ///< ÿı仯ʡ
+        EWMA,       ///< ָȨƶƽ
+        ZSCORE,     ///<  EWMA ֵͷ쳣
+        MZSCORE,    ///< λ MAD  z 
+        COUNT       ///< ͳ
+    };
+
+    /**
+     * @struct sensorRecord
+     * @brief һĲɼݡ
+     *
+     * values ͳֿţÿ鳤ΪһΪɼֵΪ sensorFeature еĸͳ
+     * ± sensorSchema::slotOf 㡣ȱʧֵΪ NaN
+     */
+    struct sensorRecord {
+        std::string clientIP;           ///< ɼ豸 IP ַ
+        std::vector<double> values;     ///< ɼֵ͸ͳ
+    };
+
+    /**
+     * @struct sensorBatch
+     * @brief һɼݣУṹ飩ţֵʹá
+     *
+     *  s  columns ţʼλΪ s * capacity
+     * ÿе豸 device_ids ָ devices е IP ַ
+     */
+    struct sensorBatch {
+        std::vector<std::string> devices;       ///< 漰豸 IP ַ
+        std::unordered_map<std::string, uint32_t> device_index;    ///< 豸 IP ַ豸ŵӳ䡣
+        std::vector<uint32_t> device_ids;       ///< ÿе豸ţ devices ±ꡣ
+        std::vector<int64_t> times;             ///< ÿеĲɼʱ䣨UNIX 룩0 ʾʹ÷յݵʱ䣬ƫʱдʱͬ÷ʱ䡣
+        std::vector<double> columns;            ///< еĲɼֵȱʧΪ NaN
+        size_t sensors = 0;                     ///< 
+        size_t rows = 0;                        ///< 
+        size_t capacity = 0;                    ///< ÿе
+
+        /**
+         * @brief βΪָзռ䣬֮ addRow ׷С
+         *
+         * @param sensor_count 
+         * @param row_capacity ʼ
+         */
+        void reset(size_t sensor_count, size_t row_capacity) {
+            devices.clear();
+            device_index.clear();
+            device_ids.clear();
+            times.clear();
+            rows = 0;
+            sensors = sensor_count;
+            capacity = row_capacity;
+            columns.assign(sensor_count * row_capacity, std::numeric_limits<double>::quiet_NaN());
+        }
+
+        /**
+         * @brief ȡĳС
+         *
+         * @param sensor š
+         * @return const double* еһеĵַ
+         */
+        const double* column(size_t sensor) const { return columns.data() + sensor * capacity; }
+        double* column(size_t sensor) { return columns.data() + sensor * capacity; }
+
+        /**
+         * @brief ĩβ׷һУɼֵΪ NaNʱݡ
+         *
+         * @param clientIP е豸 IP ַ
+         * @return size_t екš
+         */
+        size_t addRow(const std::string& clientIP) {
+            if (rows == capacity) {
+                size_t grown = capacity > 0 ? capacity * 2 : 64;
+                std::vector<double> moved(sensors * grown, std::numeric_limits<double>::quiet_NaN());
+                for (size_t s = 0; s < sensors; ++s) {
+                    std::copy(column(s), column(s) + rows, moved.data() + s * grown);
+                }
+                columns.swap(moved);
+                capacity = grown;
+            }
+            auto it = device_index.try_emplace(clientIP, static_cast<uint32_t>(devices.size())).first;
+            if (it->second == devices.size()) devices.push_back(clientIP);
+            device_ids.push_back(it->second);
+            times.push_back(0);
+            return rows++;
+        }
+    };
+
+    /**
+     * @class sensorSchema
+     * @brief ű
+     *
+     * ʱ envtable ıṹȡ suffix_of_collected_values βУ
+     * еĶ˳ţ֮޸ģڶ̼߳ȡ
+     * ͬʱ¼豸дкÿаܱķΧδ֪кʹ治µֵǰ
+     *  INSERT 䱻ݿܾ
+     * ʱݿⲻ threshold_* еĴֵ֤Ȼá
+     */
+    class sensorSchema {
+    private:
+        std::vector<std::string> names;                 ///< ׺±Ϊš
+        std::vector<std::string> columns;               ///< Ӧ׺
+        std::unordered_map<std::string, int> ids;       ///< ŵӳ䡣
+        std::vector<std::pmr::string> column_keys;      ///<  columns ͬ fieldMap вҶʱַ
+        std::vector<double> limits;                     ///< ֵܱ;
+        std::vector<std::string> writable;              ///< 豸дУ eidclientIP  etime
+        bool from_config = false;                       ///< ʱ envtable ãű threshold_* 
+
+        /**
+         * @brief ˽й캯 envtable ıṹű
+         */
+        sensorSchema();
+
+        /**
+         * @brief ˽
+         */
+        ~sensorSchema() = default;
+
+        /**
+         * @brief ɾĿ캯ֹơ
+         */
+        sensorSchema(const sensorSchema&) = delete;
+
+        /**
+         * @brief ɾĸֵֵֹ
+         */
+        sensorSchema& operator=(const sensorSchema&) = delete;
+
+    public:
+        /**
+         * @brief ȡ sensorSchema ĵʵ
+         *
+         * @return sensorSchema& ʵá
+         */
+        static sensorSchema& getInstance() {
+            static sensorSchema instance;
+            return instance;
+        }
+
+        /**
+         * @brief ȡ
+         *
+         * @return size_t 
+         */
+        size_t size() const { return names.size(); }
+
+        /**
+         * @brief űǷ threshold_* ʱ envtable ã
+         *
+         * @return bool  true
+         */
+        bool fromConfig() const { return from_config; }
+
+        /**
+         * @brief ȡ¼ֵͳ
+         *
+         * @return size_t ֵ
+         */
+        size_t slotCount() const { return names.size() * static_cast<size_t>(sensorFeature::COUNT); }
+
+        /**
+         * @brief ĳĳͳڼ¼е±ꡣ
+         *
+         * @param id š
+         * @param feature ͳ
+         * @return size_t  sensorRecord::values е±ꡣ
+         */
+        size_t slotOf(int id, sensorFeature feature) const {
+            return static_cast<size_t>(feature) * names.size() + static_cast<size_t>(id);
+        }
+
+        /**
+         * @brief ұš
+         *
+         * @param name ɴ򲻴ɼֵ׺
+         * @return int ţʱ -1
+         */
+        int idOf(const std::string& name) const;
+
+        /**
+         * @brief Ҵţֻܴ׺
+         *
+         * @param column 
+         * @return int ţʱ -1
+         */
+        int columnIdOf(std::string_view column) const {
+            for (size_t i = 0; i < columns.size(); ++i) {
+                if (columns[i] == column) return static_cast<int>(i);
+            }
+            return -1;
+        }
+
+        /**
+         * @brief 豸ǷдĳУ note
+         *
+         * @param column 
+         * @return bool д뷵 true
+         */
+        bool writableColumn(std::string_view column) const {
+            return std::find(writable.begin(), writable.end(), column) != writable.end();
+        }
+
+        /**
+         * @brief ɼֵܷд봫ӦС
+         *
+         * @param id š
+         * @param value ɼֵ
+         * @return bool ֵ͵ķΧʱ true
+         */
+        bool accepts(int id, double value) const {
+            return std::isfinite(value) && std::fabs(value) <= limits[id];
+        }
+
+        /**
+         * @brief ȡ
+         *
+         * @param id š
+         * @return const std::string& ׺
+         */
+        const std::string& nameOf(int id) const { return names[id]; }
+
+        /**
+         * @brief ȡӦ
+         *
+         * @param id š
+         * @return const std::string& ׺
+         */
+        const std::string& columnOf(int id) const { return columns[id]; }
+
+        /**
+         * @brief һֵʽĲɼݽΪ͵ļ¼ÿֵֻһΡ
+         *
+         * @param data ɼݣkey Ϊ
+         * @param record ļ¼仺ظʹá
+         * @return size_t ɹĲɼֵ
+         */
+        size_t parse(const fieldMap& data, sensorRecord& record) const;
+
+        /**
+         * @brief еһȡΪ͵ļ¼
+         *
+         * @param batch Ρ
+         * @param row кš
+         * @param record ļ¼仺ظʹá
+         */
+        void extract(const sensorBatch& batch, size_t row, sensorRecord& record) const;
+    };
+
+}  // namespace ems
@@ -0,0 +1,229 @@
+#include "sensorWindow.h"
+
+namespace ems {
+
+	metricWindow::metricWindow(size_t capacity) : times(capacity), values(capacity) {
+		min_queue.slots.resize(capacity);
+		max_queue.slots.resize(capacity);
+	}
+
+	void metricWindow::evict() {
+		size_t i = static_cast<size_t>(first % values.size());
+		double t = times[i], v = values[i];
+		sum_t -= t;
+		sum_v -= v;
+		sum_tt -= t * t;
+		sum_tv -= t * v;
+		if (!min_queue.empty() && min_queue.front() == first) min_queue.pop_front();
+		if (!max_queue.empty() && max_queue.front() == first) max_queue.pop_front();
+		++first;
+		++evictions;
+	}
+
+	void metricWindow::recompute() {
+		// ͬʱʱ׼Ƶʹʱ䱣ֽСбʵļ㲻ʧ
+		double shift = size() > 0 ? times[first % values.size()] : 0;
+		base_time += shift;
+		sum_t = sum_v = sum_tt = sum_tv = 0;
+		for (uint64_t n = first; n < next; ++n) {
+			size_t i = static_cast<size_t>(n % values.size());
+			times[i] -= shift;
+			sum_t += times[i];
+			sum_v += values[i];
+			sum_tt += times[i] * times[i];
+			sum_tv += times[i] * values[i];
+		}
+		evictions = 0;
+	}
+
+	void metricWindow::push(double time, double value, double span_seconds, double alpha) {
+		if (std::isnan(value)) return;
+		if (size() == 0) base_time = time;
+		double t = time - base_time;
+
+		// ȰʱȺƳ
+		while (size() > 0 && span_seconds > 0 && t - times[first % values.size()] > span_seconds) evict();
+		if (size() == values.size()) evict();
+		if (size() == 0) {
+			base_time = time;
+			t = 0;
+			recompute();
+		}
+
+		size_t i = static_cast<size_t>(next % values.size());
+		times[i] = t;
+		values[i] = value;
+		sum_t += t;
+		sum_v += value;
+		sum_tt += t * t;
+		sum_tv += t * value;
+
+		// УƳβвٳΪСֵ
+		while (!min_queue.empty() && values[min_queue.back() % values.size()] >= value) min_queue.pop_back();
+		min_queue.push_back(next);
+		while (!max_queue.empty() && values[max_queue.back() % values.size()] <= value) max_queue.pop_back();
+		max_queue.push_back(next);
+		++next;
+
+		// ÿƳһһۼӺ̯ͣΪ O(1)
+		if (evictions >= values.size()) recompute();
+
+		ewma = std::isnan(ewma) ? value : alpha * value + (1 - alpha) * ewma;
+	}
+
+	double metricWindow::mean() const {
+		return size() > 0 ? sum_v / size() : std::numeric_limits<double>::quiet_NaN();
+	}
+
+	double metricWindow::min() const {
+		return size() > 0 ? values[min_queue.front() % values.size()] : std::numeric_limits<double>::quiet_NaN();
+	}
+
+	double metricWindow::max() const {
+		return size() > 0 ? values[max_queue.front() % values.size()] : std::numeric_limits<double>::quiet_NaN();
+	}
+
+	double metricWindow::slope() const {
+		double n = static_cast<double>(size());
+		double denominator = n * sum_tt - sum_t * sum_t;
+		if (n < 2 || denominator <= 0) return std::numeric_limits<double>::quiet_NaN();
+		return (n * sum_tv - sum_t * sum_v) / denominator;
+	}
+
+	void metricWindow::save(snapshotWriter& out) const {
+		out.putArray(times);
+		out.putArray(values);
+		out.put(first);
+		out.put(next);
+		out.put(base_time);
+		out.put(sum_t);
+		out.put(sum_v);
+		out.put(sum_tt);
+		out.put(sum_tv);
+		out.put(evictions);
+		for (const indexDeque* queue : { &min_queue, &max_queue }) {
+			out.putArray(queue->slots);
+			out.put<uint64_t>(queue->head);
+			out.put<uint64_t>(queue->count);
+		}
+		out.put(ewma);
+	}
+
+	bool metricWindow::restore(snapshotReader& in, double time_shift) {
+		size_t capacity = values.size();
+		in.getArray(times, capacity);
+		in.getArray(values, capacity);
+		first = in.get<uint64_t>();
+		next = in.get<uint64_t>();
+		base_time = in.get<double>() + time_shift;
+		sum_t = in.get<double>();
+		sum_v = in.get<double>();
+		sum_tt = in.get<double>();
+		sum_tv = in.get<double>();
+		evictions = in.get<uint64_t>();
+		bool valid = next >= first && next - first <= capacity;
+		for (indexDeque* queue : { &min_queue, &max_queue }) {
+			in.getArray(queue->slots, capacity);
+			queue->head = static_cast<size_t>(in.get<uint64_t>());
+			queue->count = static_cast<size_t>(in.get<uint64_t>());
+			valid = valid && queue->head < capacity && queue->count <= next - first;
+		}
+		ewma = in.get<double>();
+		return in.ok() && valid;
+	}
+
+	void sensorWindows::configure(size_t samples, double seconds, double ewma_alpha) {
+		std::unique_lock lock(mtx);
+		capacity = samples > 0 ? samples : 1;
+		span_seconds = seconds > 0 ? seconds : 0;
+		alpha = ewma_alpha > 0 && ewma_alpha <= 1 ? ewma_alpha : 1;
+	}
+
+	void sensorWindows::configureAnomaly(double alpha, const std::vector<uint64_t>& warmup, const std::vector<double>& noise_floor) {
+		std::unique_lock lock(mtx);
+		anomaly_alpha = alpha > 0 && alpha <= 1 ? alpha : 0.05;
+		anomaly_warmup = warmup;
+		for (uint64_t& samples : anomaly_warmup) samples = std::max(samples, min_anomaly_warmup);
+		anomaly_noise_floor = noise_floor;
+		for (double& floor : anomaly_noise_floor) floor = floor > 0 ? floor : 0;
+	}
+
+	sensorWindows::deviceWindows& sensorWindows::findOrCreate(const std::string& clientIP, size_t sensors) {
+		{
+			std::shared_lock lock(mtx);
+			auto it = devices.find(clientIP);
+			if (it != devices.end()) return *it->second;
+		}
+		std::unique_lock lock(mtx);
+		auto& device = devices[clientIP];
+		if (!device) {
+			device = std::make_unique<deviceWindows>();
+			device->metrics.assign(sensors, metricWindow(capacity));
+			device->detectors.assign(sensors, anomalyDetector());
+		}
+		return *device;
+	}
+
+	void sensorWindows::update(sensorRecord& record, double now) {
+		const sensorSchema& schema = sensorSchema::getInstance();
+		size_t sensors = schema.size();
+		deviceWindows& device = findOrCreate(record.clientIP, sensors);
+		std::lock_guard<std::mutex> lock(device.mtx);
+		for (size_t id = 0; id < sensors; ++id) {
+			metricWindow& window = device.metrics[id];
+			window.push(now, record.values[id], span_seconds, alpha);
+			int sensor = static_cast<int>(id);
+			record.values[schema.slotOf(sensor, sensorFeature::MEAN)] = window.mean();
+			record.values[schema.slotOf(sensor, sensorFeature::MIN)] = window.min();
+			record.values[schema.slotOf(sensor, sensorFeature::MAX)] = window.max();
+			record.values[schema.slotOf(sensor, sensorFeature::SLOPE)] = window.slope();
+			record.values[schema.slotOf(sensor, sensorFeature::EWMA)] = window.ewmaValue();
+			anomalyDetector& detector = device.detectors[id];
+			detector.push(record.values[id], anomaly_alpha,
+				id < anomaly_warmup.size() ? anomaly_warmup[id] : min_anomaly_warmup,
+				id < anomaly_noise_floor.size() ? anomaly_noise_floor[id] : 0);
+			record.values[schema.slotOf(sensor, sensorFeature::ZSCORE)] = detector.zscore();
+			record.values[schema.slotOf(sensor, sensorFeature::MZSCORE)] = detector.mzscore();
+		}
+	}
+
+	void sensorWindows::saveState(snapshotWriter& out) const {
+		std::shared_lock lock(mtx);
+		out.put<uint64_t>(capacity);
+		out.put<uint64_t>(devices.size());
+		for (const auto& [clientIP, device] : devices) {
+			std::lock_guard<std::mutex> device_lock(device->mtx);
+			out.putString(clientIP);
+			out.put<uint32_t>(static_cast<uint32_t>(device->metrics.size()));
+			for (const metricWindow& window : device->metrics) window.save(out);
+			for (const anomalyDetector& detector : device->detectors) detector.save(out);
+		}
+	}
+
+	size_t sensorWindows::restoreState(snapshotReader& in, double time_shift) {
+		size_t sensors = sensorSchema::getInstance().size();
+		std::unique_lock lock(mtx);
+		uint64_t saved_capacity = in.get<uint64_t>();
+		uint64_t count = in.get<uint64_t>();
+		// 仯Ĵλòͬη
+		if (!in.ok() || saved_capacity != capacity) return 0;
+
+		std::unordered_map<std::string, std::unique_ptr<deviceWindows>> restored;
+		for (uint64_t n = 0; n < count && in.ok(); ++n) {
+			std::string clientIP = in.getString();
+			if (in.get<uint32_t>() != sensors) break;
+			auto device = std::make_unique<deviceWindows>();
+			device->metrics.assign(sensors, metricWindow(capacity));
+			device->detectors.assign(sensors, anomalyDetector());
+			bool valid = true;
+			for (metricWindow& window : device->metrics) valid = window.restore(in, time_shift) && valid;
+			for (anomalyDetector& detector : device->detectors) valid = detector.restore(in) && valid;
+			if (!valid) break;
+			restored[clientIP] = std::move(device);
+		}
+		if (restored.size() != count || !in.done()) return 0;
+		devices = std::move(restored);
+		return devices.size();
+	}
+
+}  // namespace ems
@@ -0,0 +1,200 @@
+/**
+ * @file sensorWindow.h
+ * @author Yilin Wang (yilin233@foxmail.com)
+ * @brief Per-device sliding windows over every sensor, maintains mean, min/max,
+ *  slope, EWMA and anomaly scores incrementally so that alarm rules can reference them.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2024 Yilin Wang
+ *
+ * MIT License
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <mutex>
+#include <shared_mutex>
+#include <cmath>
+#include <limits>
+#include "sensorRecord.h"  // Զ
+#include "anomalyDetector.h"
+
+namespace ems {
+
+    /**
+     * @class metricWindow
+     * @brief Ļڡ
+     *
+     * ڹ̶ĻλУͬʱʱơ
+     * ƽֵбۼӺάСֵֵɵάÿμľ̯Ϊ O(1)
+     */
+    class metricWindow {
+    private:
+        /**
+         * @brief ̶Ļ˫˶УţС
+         */
+        struct indexDeque {
+            std::vector<uint64_t> slots;    ///< 洢ռ䡣
+            size_t head = 0;                ///< λá
+            size_t count = 0;               ///< Ԫ
+
+            uint64_t front() const { return slots[head]; }
+            uint64_t back() const { return slots[(head + count - 1) % slots.size()]; }
+            void push_back(uint64_t v) { slots[(head + count) % slots.size()] = v; ++count; }
+            void pop_back() { --count; }
+            void pop_front() { head = (head + 1) % slots.size(); --count; }
+            bool empty() const { return count == 0; }
+        };
+
+        std::vector<double> times;          ///< ʱ䣨룬 base_timeȡģš
+        std::vector<double> values;         ///< ֵȡģš
+        uint64_t first = 0;                 ///< š
+        uint64_t next = 0;                  ///< һš
+        double base_time = 0;               ///< ʱ׼ʱãۼӺͶʧȡ
+        double sum_t = 0, sum_v = 0, sum_tt = 0, sum_tv = 0;   ///< ƽֵСбʵۼӺ͡
+        uint64_t evictions = 0;             ///< ϴۼӺƳ
+        indexDeque min_queue;               ///< ֵŶУΪСֵ
+        indexDeque max_queue;               ///< ֵݼŶУΪֵ
+        double ewma = std::numeric_limits<double>::quiet_NaN();    ///< ָȨƶƽ
+
+        /**
+         * @brief Ƴ
+         */
+        void evict();
+
+        /**
+         * @brief Ӵе¼ۼӺͣۻ
+         */
+        void recompute();
+
+    public:
+        /**
+         * @brief 캯
+         *
+         * @param capacity ڵ
+         */
+        explicit metricWindow(size_t capacity);
+
+        /**
+         * @brief һƳʱȵľ
+         *
+         * @param time ʱ䣨룩
+         * @param value ֵ
+         * @param span_seconds ڵʱȣ0 ʾֻơ
+         * @param alpha EWMA ƽϵ
+         */
+        void push(double time, double value, double span_seconds, double alpha);
+
+        size_t size() const { return static_cast<size_t>(next - first); }     ///< е
+        double mean() const;    ///< ƽֵΪʱΪ NaN
+        double min() const;     ///< СֵΪʱΪ NaN
+        double max() const;     ///< ֵΪʱΪ NaN
+        double slope() const;   ///< ÿı仯ʣСбʣʱΪ NaN
+        double ewmaValue() const { return ewma; }   ///< ָȨƶƽ
+
+        /**
+         * @brief ڵۼӺдա
+         */
+        void save(snapshotWriter& out) const;
+
+        /**
+         * @brief ӿջָڣеͬ
+         *
+         * @param in ݡ
+         * @param time_shift ʱƽ룩ϴеʱ任㵽С
+         * @return bool һ· true
+         */
+        bool restore(snapshotReader& in, double time_shift);
+    };
+
+    /**
+     * @class sensorWindows
+     * @brief 豸Ļڡ
+     *
+     * ÿ豸Ϊÿάһ metricWindowÿڵڴ
+     * ͬ豸ĸ»ͬһ豸ĸɸ豸ԼĻл
+     */
+    class sensorWindows {
+    private:
+        /**
+         * @brief 豸Ĵڡ
+         */
+        struct deviceWindows {
+            std::mutex mtx;                         ///< 豸ڵĻ
+            std::vector<metricWindow> metrics;      ///< ÿĴڣ±Ϊš
+            std::vector<anomalyDetector> detectors; ///< ÿ쳣±Ϊš
+        };
+
+        std::unordered_map<std::string, std::unique_ptr<deviceWindows>> devices;    ///< 豸Ĵڣkey Ϊ IP ַ
+        mutable std::shared_mutex mtx;      ///< 豸ṹĶд
+        size_t capacity = 60;               ///< ÿڵ
+        double span_seconds = 0;            ///< ڵʱȣ룩0 ʾֻơ
+        double alpha = 0.2;                 ///< EWMA ƽϵ
+        double anomaly_alpha = 0.05;        ///< 쳣 EWMA ֵͷƽϵ
+        std::vector<uint64_t> anomaly_warmup;       ///< ÿʼǰҪ±Ϊš
+        std::vector<double> anomaly_noise_floor;    ///< ÿı׼ MAD ľޣ±Ϊš
+
+        /**
+         * @brief 豸Ĵڣʱ
+         *
+         * @param clientIP 豸 IP ַ
+         * @param sensors 
+         * @return deviceWindows& 豸ڵá
+         */
+        deviceWindows& findOrCreate(const std::string& clientIP, size_t sensors);
+
+    public:
+        /**
+         * @brief ôڲڵһ update ֮ǰá
+         *
+         * @param samples ÿڵ
+         * @param seconds ڵʱȣ룩0 ʾֻơ
+         * @param ewma_alpha EWMA ƽϵȡֵ (0, 1]
+         */
+        void configure(size_t samples, double seconds, double ewma_alpha);
+
+        /**
+         * @brief 쳣ҪԤP2 λ 5 ֮ſʼǵ㡣
+         */
+        static constexpr uint64_t min_anomaly_warmup = 5;
+
+        /**
+         * @brief 쳣ڵһ update ֮ǰá
+         *
+         * @param alpha EWMA ֵͷƽϵȡֵ (0, 1]
+         * @param warmup ÿʼǰҪ±ΪţС min_anomaly_warmup ʱ min_anomaly_warmup
+         * @param noise_floor ÿı׼ MAD ľޣ±Ϊţ 0
+         */
+        void configureAnomaly(double alpha, const std::vector<uint64_t>& warmup, const std::vector<double>& noise_floor);
+
+        /**
+         * @brief ¼еĲɼֵ豸Ĵں쳣Ѹͳ쳣д¼
+         *
+         * @param record ɼ¼values Ѱ sensorSchema::slotCount() 䡣
+         * @param now ǰʱ䣨룩
+         */
+        void update(sensorRecord& record, double now);
+
+        /**
+         * @brief 豸Ĵں쳣дա
+         */
+        void saveState(snapshotWriter& out) const;
+
+        /**
+         * @brief ӿջָ豸Ĵں쳣ڵһ update ֮ǰá
+         *
+         * 򴫸ղͬʱָκ豸ȡʧܺ in.done() Ϊ false
+         *
+         * @param in ݡ
+         * @param time_shift ʱƽ룩
+         * @return size_t ָ豸
+         */
+        size_t restoreState(snapshotReader& in, double time_shift);
+    };
+
+}  // namespace ems
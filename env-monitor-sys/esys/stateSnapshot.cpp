@@ -0,0 +1,254 @@
+#include "stateSnapshot.h"
+#include "esysControl.h"
+
+namespace ems {
+
+	// ֶαʶСΪɶĸַ
+	static constexpr uint32_t sectionTag(char a, char b, char c, char d) {
+		return static_cast<uint32_t>(static_cast<uint8_t>(a)) | static_cast<uint32_t>(static_cast<uint8_t>(b)) << 8 |
+			static_cast<uint32_t>(static_cast<uint8_t>(c)) << 16 | static_cast<uint32_t>(static_cast<uint8_t>(d)) << 24;
+	}
+
+	static constexpr uint32_t section_devices = sectionTag('D', 'E', 'V', 'S');	// 豸ע
+	static constexpr uint32_t section_alarms = sectionTag('A', 'L', 'R', 'M');	// ״̬ͱ¼
+	static constexpr uint32_t section_windows = sectionTag('W', 'I', 'N', 'D');	// ں쳣
+
+	static int64_t nowMs() {
+		using namespace std::chrono;
+		return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+	}
+
+	static int64_t steadyNowMs() {
+		using namespace std::chrono;
+		return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+	}
+
+	stateSnapshot::stateSnapshot() {
+		esysControl& esys = esysControl::getInstance();
+		file_path = esys.getConfig("snapshot_file");
+		std::string interval = esys.getConfig("snapshot_interval_seconds");
+		interval_seconds = interval.empty() ? 60 : static_cast<unsigned int>(std::stoul(interval));
+	}
+
+	stateSnapshot::~stateSnapshot() {
+		stop();
+		close();
+	}
+
+	uint64_t stateSnapshot::fnv1a(const char* data, size_t size, uint64_t hash) {
+		for (size_t i = 0; i < size; ++i) {
+			hash ^= static_cast<uint8_t>(data[i]);
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	uint64_t stateSnapshot::schemaHash() {
+		const sensorSchema& schema = sensorSchema::getInstance();
+		uint64_t hash = fnv1a(nullptr, 0);
+		for (size_t id = 0; id < schema.size(); ++id) {
+			const std::string& column = schema.columnOf(static_cast<int>(id));
+			hash = fnv1a(column.data(), column.size(), hash);
+			hash = fnv1a("\n", 1, hash);
+		}
+		return hash;
+	}
+
+	void stateSnapshot::close() {
+		if (view != nullptr) UnmapViewOfFile(view);
+		if (mapping != nullptr) CloseHandle(mapping);
+		view = nullptr;
+		mapping = nullptr;
+		payload = nullptr;
+		std::vector<char>().swap(mapped_copy);
+	}
+
+	bool stateSnapshot::open() {
+		if (file_path.empty()) return false;
+		auto start_time = std::chrono::steady_clock::now();
+
+		// ֻӳ򿪣ҳڻָʱ룻ӳʧʱڴ
+		HANDLE file = CreateFileA(file_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			std::cout << "[stateSnapshot]: No snapshot at \"" << file_path << "\", starting cold." << std::endl;
+			return false;
+		}
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(file, &file_size) || static_cast<uint64_t>(file_size.QuadPart) < sizeof(fileHeader)) {
+			CloseHandle(file);
+			std::cerr << "[stateSnapshot]: Snapshot \"" << file_path << "\" is truncated, starting cold." << std::endl;
+			return false;
+		}
+		size_t size = static_cast<size_t>(file_size.QuadPart);
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping != nullptr) view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(file);
+		const char* base = static_cast<const char*>(view);
+		if (base == nullptr) {
+			close();
+			std::ifstream in(file_path, std::ios::binary);
+			mapped_copy.resize(size);
+			if (!in.read(mapped_copy.data(), static_cast<std::streamsize>(size))) {
+				close();
+				std::cerr << "[stateSnapshot]: Failed to read snapshot \"" << file_path << "\", starting cold." << std::endl;
+				return false;
+			}
+			base = mapped_copy.data();
+		}
+
+		std::memcpy(&header, base, sizeof(header));
+		const char* body = base + sizeof(fileHeader);
+		std::string error;
+		if (std::memcmp(header.magic, "EMSS", 4) != 0) error = "bad magic";
+		else if (header.version != format_version) error = "format version " + std::to_string(header.version);
+		else if (header.payload_size != size - sizeof(fileHeader)) error = "size mismatch";
+		else if (fnv1a(body, static_cast<size_t>(header.payload_size)) != header.checksum) error = "checksum mismatch";
+		if (!error.empty()) {
+			close();
+			std::cerr << "[stateSnapshot]: Ignoring snapshot \"" << file_path << "\": " << error << "." << std::endl;
+			return false;
+		}
+
+		payload = body;
+		opened = true;
+		std::cout << "[stateSnapshot]: Mapped snapshot of " << size << " bytes written " << (nowMs() - header.saved_ms) / 1000
+			<< " s ago (" << (cleanShutdown() ? "clean shutdown" : "unclean shutdown") << ") in "
+			<< std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time).count() << " ms." << std::endl;
+		return true;
+	}
+
+	void stateSnapshot::restore() {
+		if (!opened || payload == nullptr) return;
+		auto start_time = std::chrono::steady_clock::now();
+
+		// ϴе steady_clock ʱ㻻㵽УȰϴдʱĲֵϵͳʱ䣬ٻرε steady_clock
+		int64_t steady_shift_ms = (steadyNowMs() - header.saved_steady_ms) - (nowMs() - header.saved_ms);
+		bool same_schema = header.schema_hash == schemaHash();
+
+		deviceRegistry& registry = deviceRegistry::getInstance();
+		alarmModule& alarms = alarmModule::getInstance();
+		size_t devices = 0, alarm_states = 0, windows = 0;
+		bool devices_restored = false;
+		snapshotReader reader(payload, static_cast<size_t>(header.payload_size));
+		snapshotReader section(nullptr, 0);
+		uint32_t tag;
+		while (reader.nextSection(tag, section)) {
+			if (tag == section_devices) {
+				devices = registry.restoreState(section);
+				devices_restored = section.done();
+				if (!devices_restored) std::cerr << "[stateSnapshot]: Device section is damaged." << std::endl;
+			}
+			else if (tag == section_alarms) {
+				alarm_states = alarms.restoreState(section, steady_shift_ms);
+				if (!section.done()) std::cerr << "[stateSnapshot]: Alarm section is damaged." << std::endl;
+			}
+			else if (tag == section_windows) {
+				if (!same_schema) {
+					std::cout << "[stateSnapshot]: Sensor columns changed, sliding windows start empty." << std::endl;
+					continue;
+				}
+				windows = alarms.restoreWindows(section, steady_shift_ms / 1000.0);
+				if (!section.done()) std::cerr << "[stateSnapshot]: Window section is damaged or was written with a different window size." << std::endl;
+			}
+		}
+		// е豸ʱرҲҪݿ
+		if (!devices_restored && cleanShutdown()) registry.loadFromDatabase();
+
+		bool was_clean = cleanShutdown();
+		close();
+		opened = false;
+		// ָرձ־֮쳣˳ʱٰݿյ豸
+		if (was_clean) {
+			std::fstream file(file_path, std::ios::binary | std::ios::in | std::ios::out);
+			uint32_t flags = header.flags & ~flag_clean;
+			file.seekp(offsetof(fileHeader, flags));
+			file.write(reinterpret_cast<const char*>(&flags), sizeof(flags));
+		}
+		std::cout << "[stateSnapshot]: Restored " << devices << " devices, " << alarm_states << " alarm states and "
+			<< windows << " device windows in "
+			<< std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time).count() << " ms." << std::endl;
+	}
+
+	bool stateSnapshot::save(bool clean) {
+		if (file_path.empty()) return false;
+		std::lock_guard<std::mutex> lock(save_mtx);
+		auto start_time = std::chrono::steady_clock::now();
+
+		snapshotWriter out;
+		size_t start = out.beginSection(section_devices);
+		deviceRegistry::getInstance().saveState(out);
+		out.endSection(start);
+		start = out.beginSection(section_alarms);
+		alarmModule::getInstance().saveState(out);
+		out.endSection(start);
+		start = out.beginSection(section_windows);
+		alarmModule::getInstance().saveWindows(out);
+		out.endSection(start);
+
+		fileHeader file_header{};
+		std::memcpy(file_header.magic, "EMSS", 4);
+		file_header.version = format_version;
+		file_header.flags = clean ? flag_clean : 0;
+		file_header.saved_ms = nowMs();
+		file_header.saved_steady_ms = steadyNowMs();
+		file_header.schema_hash = schemaHash();
+		file_header.payload_size = out.data().size();
+		file_header.checksum = fnv1a(out.data().data(), out.data().size());
+
+		// дʱļ滻д;˳ʱԭеĿȻ
+		std::filesystem::path path(file_path);
+		std::filesystem::path temp_path(file_path + ".tmp");
+		std::error_code ec;
+		if (path.has_parent_path()) std::filesystem::create_directories(path.parent_path(), ec);
+		{
+			std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+			file.write(reinterpret_cast<const char*>(&file_header), sizeof(file_header));
+			file.write(out.data().data(), static_cast<std::streamsize>(out.data().size()));
+			if (!file) {
+				std::cerr << "[stateSnapshot]: Failed to write \"" << temp_path.string() << "\"." << std::endl;
+				return false;
+			}
+		}
+		std::filesystem::rename(temp_path, path, ec);
+		if (ec) {
+			std::cerr << "[stateSnapshot]: Failed to replace \"" << file_path << "\": " << ec.message() << std::endl;
+			return false;
+		}
+		if (clean || esysControl::getInstance().getConfig("log_operations") != "false") {
+			std::cout << "[stateSnapshot]: Saved " << sizeof(file_header) + out.data().size() << " bytes in "
+				<< std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time).count() << " ms." << std::endl;
+		}
+		return true;
+	}
+
+	void stateSnapshot::start() {
+		if (file_path.empty() || interval_seconds == 0) return;
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			if (running) return;
+			running = true;
+		}
+		worker = std::thread(&stateSnapshot::workerLoop, this);
+	}
+
+	void stateSnapshot::stop() {
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			if (!running) return;
+			running = false;
+		}
+		cv.notify_all();
+		if (worker.joinable()) worker.join();
+	}
+
+	void stateSnapshot::workerLoop() {
+		std::unique_lock<std::mutex> lock(mtx);
+		while (running) {
+			if (cv.wait_for(lock, std::chrono::seconds(interval_seconds), [this] { return !running; })) break;
+			lock.unlock();
+			save(false);
+			lock.lock();
+		}
+	}
+
+}  // namespace ems
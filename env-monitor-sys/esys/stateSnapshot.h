@@ -0,0 +1,310 @@
+/**
+ * @file stateSnapshot.h
+ * @author Yilin Wang (yilin233@foxmail.com)
+ * @brief Periodic binary snapshot of the in-memory state (device registry, alarm
+ *  state machines, sliding windows) that is mapped and restored at startup.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2024 Yilin Wang
+ *
+ * MIT License
+ */
+
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace ems {
+
+    /**
+     * @class snapshotWriter
+     * @brief д붨ֶκֶַΰֽСˣš
+     */
+    class snapshotWriter {
+    private:
+        std::string buffer;     ///< дݡ
+
+    public:
+        /**
+         * @brief дһֶΡ
+         */
+        template <typename T>
+        void put(const T& value) {
+            static_assert(std::is_trivially_copyable<T>::value, "snapshot fields must be trivially copyable");
+            buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+
+        /**
+         * @brief дһ鶨ֶΣд
+         */
+        template <typename T>
+        void putArray(const std::vector<T>& values) {
+            static_assert(std::is_trivially_copyable<T>::value, "snapshot fields must be trivially copyable");
+            put<uint64_t>(values.size());
+            buffer.append(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+        }
+
+        /**
+         * @brief дַдȡ
+         */
+        void putString(const std::string& value) {
+            put<uint32_t>(static_cast<uint32_t>(value.size()));
+            buffer.append(value);
+        }
+
+        /**
+         * @brief ʼһֶΣسֶελã endSection 
+         *
+         * @param tag ֶαʶ
+         * @return size_t ֶελá
+         */
+        size_t beginSection(uint32_t tag) {
+            put(tag);
+            put<uint64_t>(0);
+            return buffer.size();
+        }
+
+        /**
+         * @brief ֶΣֶγȡ
+         *
+         * @param start beginSection ķֵ
+         */
+        void endSection(size_t start) {
+            uint64_t length = buffer.size() - start;
+            std::memcpy(&buffer[start - sizeof(uint64_t)], &length, sizeof(length));
+        }
+
+        const std::string& data() const { return buffer; }  ///< дݡ
+    };
+
+    /**
+     * @class snapshotReader
+     * @brief ӿжȡֶΣԽ򳤶ȲʱΪʧ״̬֮ĶȡĬֵ
+     */
+    class snapshotReader {
+    private:
+        const char* data;       ///< 㡣
+        size_t size;            ///< ݳȡ
+        size_t pos = 0;         ///< ǰλá
+        bool valid = true;      ///< ǷûзԽ硣
+
+    public:
+        snapshotReader(const char* data, size_t size) : data(data), size(size) {}
+
+        /**
+         * @brief ȡһֶΡ
+         */
+        template <typename T>
+        T get() {
+            static_assert(std::is_trivially_copyable<T>::value, "snapshot fields must be trivially copyable");
+            T value{};
+            if (!valid || size - pos < sizeof(T)) {
+                valid = false;
+                return value;
+            }
+            std::memcpy(&value, data + pos, sizeof(T));
+            pos += sizeof(T);
+            return value;
+        }
+
+        /**
+         * @brief ȡһ鶨ֶΡ
+         *
+         * @param values ֶΡ
+         * @param expected ͬʱȡʧܣ0 ʾ顣
+         */
+        template <typename T>
+        void getArray(std::vector<T>& values, size_t expected = 0) {
+            uint64_t count = get<uint64_t>();
+            if (!valid || (expected != 0 && count != expected) || count > (size - pos) / sizeof(T)) {
+                valid = false;
+                return;
+            }
+            values.resize(static_cast<size_t>(count));
+            std::memcpy(values.data(), data + pos, static_cast<size_t>(count) * sizeof(T));
+            pos += static_cast<size_t>(count) * sizeof(T);
+        }
+
+        /**
+         * @brief ȡַ
+         */
+        std::string getString() {
+            uint32_t length = get<uint32_t>();
+            if (!valid || length > size - pos) {
+                valid = false;
+                return std::string();
+            }
+            std::string value(data + pos, length);
+            pos += length;
+            return value;
+        }
+
+        /**
+         * @brief ȡһֶΡ
+         *
+         * @param tag ķֶαʶ
+         * @param section ķֶݡ
+         * @return bool ķֶη true
+         */
+        bool nextSection(uint32_t& tag, snapshotReader& section) {
+            if (!valid || pos == size) return false;
+            tag = get<uint32_t>();
+            uint64_t length = get<uint64_t>();
+            if (!valid || length > size - pos) {
+                valid = false;
+                return false;
+            }
+            section = snapshotReader(data + pos, static_cast<size_t>(length));
+            pos += static_cast<size_t>(length);
+            return true;
+        }
+
+        bool ok() const { return valid; }                   ///< ǷûзԽ硣
+        bool done() const { return valid && pos == size; }  ///< Ƿǡöݡ
+    };
+
+    /**
+     * @class stateSnapshot
+     * @brief ڴ״̬Ŀա
+     *
+     * ̨߳ÿ snapshot_interval_seconds 뽫豸עÿ豸ݣ״̬ͱ¼
+     * ں쳣д snapshot_fileддʱļ滻;˳ƻԭеĿա
+     * رʱдһβΪرա
+     *
+     * ʱֻӳ򿪿ղУļͷУͣ豸ע״̬ʹֱӴӿջָ
+     * ϴرʱ豸עٴݿأб仯󴰿ڷֶαԣƺͱʽ¶Ӧ
+     * ɾĹ򱻶е steady_clock ʱ䰴֮侭ϵͳʱ任㡣
+     */
+    class stateSnapshot {
+    private:
+        static constexpr uint32_t format_version = 1;       ///< ոʽİ汾
+        static constexpr uint32_t flag_clean = 1;           ///< ļͷ־رд롣
+
+        /**
+         * @brief յļͷ payload_size ֽڵķֶݡ
+         */
+        struct fileHeader {
+            char magic[4];              ///< ̶Ϊ "EMSS"
+            uint32_t version;           ///< ʽ汾
+            uint32_t flags;             ///< ־λ
+            uint32_t reserved;          ///< Ϊ 0
+            int64_t saved_ms;           ///< дʱϵͳʱ䣨UNIX 룩
+            int64_t saved_steady_ms;    ///< дʱ steady_clock ʱ䣨룩
+            uint64_t schema_hash;       ///< еָơ
+            uint64_t payload_size;      ///< ֶݵֽ
+            uint64_t checksum;          ///< ֶݵ FNV-1a У͡
+        };
+
+        std::string file_path;                  ///< ļ·Ϊձʾá
+        unsigned int interval_seconds;          ///< ο֮ļ룩0 ʾֻڹرʱд롣
+
+        std::vector<char> mapped_copy;          ///< ӳʧʱڴĿա
+        const char* payload = nullptr;          ///< Уķֶݣrestore ʧЧ
+        void* mapping = nullptr;                ///< ļӳ
+        const void* view = nullptr;             ///< ӳͼ
+        fileHeader header{};                    ///< Ѵ򿪿յļͷ
+        bool opened = false;                    ///< ǷѴ򿪲У˿ա
+
+        std::mutex save_mtx;                    ///< ʹյд뻥⡣
+        std::thread worker;                     ///< дյ̡߳
+        std::mutex mtx;                         ///< ״̬
+        std::condition_variable cv;             ///< ֹ̨̡ͣ߳
+        bool running = false;                   ///< ̨߳ǷС
+
+        /**
+         * @brief ˽й캯ȡá
+         */
+        stateSnapshot();
+
+        /**
+         * @brief ˽ֹ̨̲ͣ߳ӳ䡣
+         */
+        ~stateSnapshot();
+
+        /**
+         * @brief ɾ캯
+         */
+        stateSnapshot(const stateSnapshot&) = delete;
+
+        /**
+         * @brief ɾֵ
+         */
+        stateSnapshot& operator=(const stateSnapshot&) = delete;
+
+        /**
+         * @brief յӳ䡣
+         */
+        void close();
+
+        /**
+         * @brief  FNV-1a 64 λϣ
+         */
+        static uint64_t fnv1a(const char* data, size_t size, uint64_t hash = 14695981039346656037ull);
+
+        /**
+         * @brief 㵱ǰеָơ
+         */
+        static uint64_t schemaHash();
+
+        /**
+         * @brief ̨߳ѭ
+         */
+        void workerLoop();
+
+    public:
+        /**
+         * @brief ȡstateSnapshotĵʵ
+         *
+         * @return stateSnapshot& ʵá
+         */
+        static stateSnapshot& getInstance() {
+            static stateSnapshot instance;
+            return instance;
+        }
+
+        /**
+         * @brief ӳļУļͷУͣģʼ֮ǰá
+         *
+         * @return bool տ÷ true
+         */
+        bool open();
+
+        /**
+         * @brief ϴǷرգҿտá
+         */
+        bool cleanShutdown() const { return opened && (header.flags & flag_clean) != 0; }
+
+        /**
+         * @brief Ѵ򿪵Ŀջָģ״̬Ȼӳ䣬ļΪرա
+         */
+        void restore();
+
+        /**
+         * @brief дһοա
+         *
+         * @param clean Ƿرд롣
+         * @return bool дɹ true
+         */
+        bool save(bool clean);
+
+        /**
+         * @brief дյ̡߳
+         */
+        void start();
+
+        /**
+         * @brief ֹ̨̡ͣ߳
+         */
+        void stop();
+    };
+
+}  // namespace ems
@@ -0,0 +1,32 @@
+-- 为按设备读取最新数据添加 (clientIP, eid) 索引，并将 envtable 按 etime 进行范围分区。
+-- 分区表的主键必须包含分区列，因此主键由 eid 改为 (eid, etime)，etime 改为非空。
+-- p_history 的上界为执行迁移时的下个月一日，之后的按月分区由 dbRetention 提前创建，过期的整月分区直接删除。
+-- DDL 无法回滚，中途失败后下次启动会重新执行本脚本，因此每一步先检查是否已完成，已完成的步骤替换为空语句 DO 0。
+UPDATE envtable SET etime = '1970-01-01 00:00:00' WHERE etime IS NULL;
+
+-- 主键加入 etime，etime 须同时改为非空
+SET @migration_ddl = IF((SELECT COUNT(*) FROM information_schema.STATISTICS
+    WHERE TABLE_SCHEMA = DATABASE() AND TABLE_NAME = 'envtable' AND INDEX_NAME = 'PRIMARY' AND COLUMN_NAME = 'etime') > 0,
+  'DO 0',
+  'ALTER TABLE envtable MODIFY etime DATETIME NOT NULL DEFAULT CURRENT_TIMESTAMP COMMENT ''录入信息时间'', DROP PRIMARY KEY, ADD PRIMARY KEY (eid, etime)');
+PREPARE migration_step FROM @migration_ddl;
+EXECUTE migration_step;
+DEALLOCATE PREPARE migration_step;
+
+SET @migration_ddl = IF((SELECT COUNT(*) FROM information_schema.STATISTICS
+    WHERE TABLE_SCHEMA = DATABASE() AND TABLE_NAME = 'envtable' AND INDEX_NAME = 'idx_clientip_eid') > 0,
+  'DO 0',
+  'ALTER TABLE envtable ADD INDEX idx_clientip_eid (clientIP, eid)');
+PREPARE migration_step FROM @migration_ddl;
+EXECUTE migration_step;
+DEALLOCATE PREPARE migration_step;
+
+SET @migration_ddl = IF((SELECT COUNT(*) FROM information_schema.PARTITIONS
+    WHERE TABLE_SCHEMA = DATABASE() AND TABLE_NAME = 'envtable' AND PARTITION_NAME IS NOT NULL) > 0,
+  'DO 0',
+  CONCAT('ALTER TABLE envtable PARTITION BY RANGE COLUMNS(etime) (',
+    'PARTITION p_history VALUES LESS THAN (''', DATE_FORMAT(NOW() + INTERVAL 1 MONTH, '%Y-%m-01 00:00:00'), '''), ',
+    'PARTITION p_future VALUES LESS THAN (MAXVALUE))'));
+PREPARE migration_step FROM @migration_ddl;
+EXECUTE migration_step;
+DEALLOCATE PREPARE migration_step;
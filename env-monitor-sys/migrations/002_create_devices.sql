@@ -0,0 +1,11 @@
+-- 设备注册表：记录每个采集设备的首次/最近出现时间和连接状态，替代对历史数据的 SELECT DISTINCT。
+CREATE TABLE IF NOT EXISTS devices(
+  clientIP CHAR(16) PRIMARY KEY COMMENT '采集设备ip地址',
+  first_seen DATETIME COMMENT '首次出现时间',
+  last_seen DATETIME COMMENT '最近出现时间',
+  connected TINYINT(1) NOT NULL DEFAULT 0 COMMENT '是否在线'
+);
+
+-- 从历史数据一次性回填已有设备
+INSERT IGNORE INTO devices (clientIP, first_seen, last_seen, connected)
+  SELECT clientIP, MIN(etime), MAX(etime), 0 FROM envtable WHERE clientIP IS NOT NULL GROUP BY clientIP;
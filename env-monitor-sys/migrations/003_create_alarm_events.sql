@@ -0,0 +1,14 @@
+-- 报警事件表：记录每次报警状态转换中成立过的规则，由异步写入器批量写入。
+CREATE TABLE IF NOT EXISTS alarm_events(
+  id BIGINT PRIMARY KEY AUTO_INCREMENT COMMENT '主键自增',
+  clientIP CHAR(16) COMMENT '采集设备ip地址',
+  rule_name VARCHAR(64) COMMENT '规则名',
+  metric VARCHAR(64) COMMENT '规则引用的指标',
+  value DOUBLE COMMENT '转换时指标的值',
+  threshold DOUBLE COMMENT '规则中的阈值',
+  from_state VARCHAR(16) COMMENT '转换前的状态',
+  to_state VARCHAR(16) COMMENT '转换后的状态',
+  event_time DATETIME COMMENT '转换时间',
+  started_at DATETIME COMMENT '本次报警开始时间',
+  INDEX idx_clientip_time (clientIP, event_time)
+);
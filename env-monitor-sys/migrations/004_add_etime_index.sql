@@ -0,0 +1,9 @@
+-- 为 envtable 添加 etime 索引，dbRetention 按 etime 分块删除过期数据、按时间范围汇总时使用，不再依赖 eid 与 etime 同序。
+-- 中途失败后下次启动会重新执行本脚本，已完成的步骤替换为空语句 DO 0。
+SET @migration_ddl = IF((SELECT COUNT(*) FROM information_schema.STATISTICS
+    WHERE TABLE_SCHEMA = DATABASE() AND TABLE_NAME = 'envtable' AND INDEX_NAME = 'idx_etime') > 0,
+  'DO 0',
+  'ALTER TABLE envtable ADD INDEX idx_etime (etime)');
+PREPARE migration_step FROM @migration_ddl;
+EXECUTE migration_step;
+DEALLOCATE PREPARE migration_step;
@@ -0,0 +1,98 @@
+#include "binaryProtocol.h"
+
+namespace ems {
+	namespace binaryProtocol {
+
+		// Сдֽ޹
+		template <typename T>
+		static T readLE(const char* p) {
+			T value = 0;
+			for (size_t i = 0; i < sizeof(T); ++i) {
+				value |= static_cast<T>(static_cast<uint8_t>(p[i])) << (8 * i);
+			}
+			return value;
+		}
+
+		template <typename T>
+		static void writeLE(std::string& out, T value) {
+			for (size_t i = 0; i < sizeof(T); ++i) {
+				out += static_cast<char>((value >> (8 * i)) & 0xFF);
+			}
+		}
+
+		static std::string formatIPv4(uint32_t address) {
+			// device_id ֽţһֽǵַĵһ
+			const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&address);
+			return std::to_string(bytes[0]) + "." + std::to_string(bytes[1]) + "." +
+				std::to_string(bytes[2]) + "." + std::to_string(bytes[3]);
+		}
+
+		size_t decode(const char* data, size_t length, const std::string& peerIP, sensorBatch& batch,
+			std::vector<uint32_t>& sequences, std::string& error)
+		{
+			size_t consumed = 0;
+			while (length - consumed >= header_size) {
+				const char* frame = data + consumed;
+				if (static_cast<uint8_t>(frame[0]) != magic0 || static_cast<uint8_t>(frame[1]) != magic1) {
+					error = "bad magic";
+					return consumed;
+				}
+				frameHeader header;
+				header.version = static_cast<uint8_t>(frame[2]);
+				header.flags = static_cast<uint8_t>(frame[3]);
+				std::memcpy(&header.device_id, frame + 4, sizeof(header.device_id));
+				header.sequence = readLE<uint32_t>(frame + 8);
+				header.timestamp_ms = readLE<uint64_t>(frame + 12);
+				header.payload_length = readLE<uint16_t>(frame + 20);
+				if (header.version != version) {
+					error = "unsupported version " + std::to_string(header.version);
+					return consumed;
+				}
+				if (header.payload_length > max_payload) {
+					error = "payload too large";
+					return consumed;
+				}
+				if (length - consumed < header_size + header.payload_length) break;
+
+				size_t row = batch.addRow(header.device_id == 0 ? peerIP : formatIPv4(header.device_id));
+				batch.times[row] = static_cast<int64_t>(header.timestamp_ms);
+				const char* entry = frame + header_size;
+				const char* end = entry + header.payload_length;
+				while (end - entry >= 2) {
+					uint8_t sensor = static_cast<uint8_t>(entry[0]);
+					uint8_t size = static_cast<uint8_t>(entry[1]);
+					if (end - entry - 2 < size) break;
+					if (size == sizeof(float) && sensor < batch.sensors) {
+						float value;
+						std::memcpy(&value, entry + 2, sizeof(float));
+						batch.column(sensor)[row] = value;
+					}
+					entry += 2 + size;
+				}
+				sequences.push_back(header.sequence);
+				consumed += header_size + header.payload_length;
+			}
+			return consumed;
+		}
+
+		void encode(frameHeader header, const std::vector<uint8_t>& sensors, const std::vector<float>& values, std::string& out)
+		{
+			size_t count = std::min(sensors.size(), values.size());
+			header.payload_length = static_cast<uint16_t>(count * (2 + sizeof(float)));
+			out += static_cast<char>(magic0);
+			out += static_cast<char>(magic1);
+			out += static_cast<char>(header.version);
+			out += static_cast<char>(header.flags);
+			out.append(reinterpret_cast<const char*>(&header.device_id), sizeof(header.device_id));
+			writeLE<uint32_t>(out, header.sequence);
+			writeLE<uint64_t>(out, header.timestamp_ms);
+			writeLE<uint16_t>(out, header.payload_length);
+			for (size_t i = 0; i < count; ++i) {
+				out += static_cast<char>(sensors[i]);
+				out += static_cast<char>(sizeof(float));
+				out.append(reinterpret_cast<const char*>(&values[i]), sizeof(float));
+			}
+		}
+
+	}  // namespace binaryProtocol
+}  // namespace ems
@@ -0,0 +1,101 @@
+/**
+ * @file binaryProtocol.h
+ * @author Yilin Wang (yilin233@foxmail.com)
+ * @brief Compact binary device protocol, a fixed little-endian frame header followed
+ *  by TLV sensor entries with float32 values, decoded straight into a sensor batch.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2024 Yilin Wang
+ *
+ * MIT License
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include "../esys/sensorRecord.h"
+
+namespace ems {
+
+    /**
+     * @brief Эĳ֡ʽ
+     *
+     * ֶξΪСһ֡ 22 ֽڵ֡ͷ payload_length ֽڵ TLV Ŀɣ
+     *
+     *   ƫ    ֶ
+     *   0     2     magic̶Ϊ 0x90EBֽ 0xEBǿɴӡַıЭ飩
+     *   2     1     versionǰΪ 1
+     *   3     1     flags 0
+     *   4     4     device_id豸 IPv4 ַֽ in_addrΪ 0 ʾʹӵĶԶ˵ַ
+     *   8     4     sequence豸֡
+     *   12    8     timestamp_msɼʱ䣨UNIX 룩Ϊ 0 ʱ ingest_max_clock_skew_seconds ʱʹ÷յݵʱ
+     *   20    2     payload_lengthTLV Ŀֽ
+     *
+     * ÿ TLV ĿΪ 1 ֽڴţsensorSchema еıţ envtable вɼֵе˳򣩡
+     * 1 ֵֽȣǰΪ 4 float32 ֵʶıŻ򳤶Ȱ
+     * ÿһ֡ظ 1 ֽڣbinaryAckbinaryAlarm  binaryError
+     */
+    namespace binaryProtocol {
+        constexpr uint8_t magic0 = 0xEB;            ///< magic ĵһֽڡ
+        constexpr uint8_t magic1 = 0x90;            ///< magic ĵڶֽڡ
+        constexpr uint8_t version = 1;              ///< Э汾
+        constexpr size_t header_size = 22;          ///< ֡ͷֽ
+        constexpr size_t max_payload = 4096;        ///< ֡ TLV Ŀֽ
+        constexpr uint8_t binaryAck = 0x00;         ///< ظѽգ豸
+        constexpr uint8_t binaryAlarm = 0x01;       ///< ظѽգ豸ڱС
+        constexpr uint8_t binaryError = 0x02;       ///< ظ֡ʽӽرա
+
+        /**
+         * @struct frameHeader
+         * @brief ֡ͷ
+         */
+        struct frameHeader {
+            uint8_t version = 0;        ///< Э汾
+            uint8_t flags = 0;          ///< 
+            uint32_t device_id = 0;     ///< 豸 IPv4 ַ0 ʾʹöԶ˵ַ
+            uint32_t sequence = 0;      ///< ֡š
+            uint64_t timestamp_ms = 0;  ///< ɼʱ䣨UNIX 룩0 ʾʹ÷ʱ䡣
+            uint16_t payload_length = 0;    ///< TLV Ŀֽ
+        };
+
+        /**
+         * @brief жյĵһǷΪЭ顣
+         *
+         * @param data ݡ
+         * @param length ݳȡ
+         * @return bool ǶЭ鷵 true
+         */
+        inline bool detect(const char* data, size_t length) {
+            return length > 0 && static_cast<uint8_t>(data[0]) == magic0;
+        }
+
+        /**
+         * @brief ӻн֡ÿ֡׷ΪеһС
+         *
+         * @param data 
+         * @param length ȡ
+         * @param peerIP ӵĶԶ˵ַ device_id Ϊ 0 ֡
+         * @param batch Σ sensorBatch::reset ʼ
+         * @param sequences ÿһ֡ţ׷ӵһһӦ
+         * @param error ֡ʽʱĴϢ
+         * @return size_t ĵֽʣֽǲ֡ʱس֮֡ǰĵֽ error
+         */
+        size_t decode(const char* data, size_t length, const std::string& peerIP, sensorBatch& batch,
+            std::vector<uint32_t>& sequences, std::string& error);
+
+        /**
+         * @brief һ֡Ϊֽڣ豸˺ͲԹʹá
+         *
+         * @param header ֡ͷpayload_length ɱд
+         * @param sensors š
+         * @param values Ӧֵ
+         * @param out ׷ĩβ
+         */
+        void encode(frameHeader header, const std::vector<uint8_t>& sensors, const std::vector<float>& values, std::string& out);
+    }
+
+}  // namespace ems
@@ -0,0 +1,154 @@
+/**
+ * @file captureFormat.h
+ * @author Yilin Wang (yilin233@foxmail.com)
+ * @brief Binary format of TCP traffic captures, shared by the capture mode of
+ *  tcpConnector and the trafficReplay tool.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2024 Yilin Wang
+ *
+ * MIT License
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iterator>
+
+namespace ems {
+
+    /**
+     * @brief ץļм¼͡
+     */
+    enum class captureRecord : uint8_t {
+        OPEN = 1,   ///< ӣͻ IP
+        DATA = 2,   ///< յһݣԭʼֽڡ
+        CLOSE = 3   ///< ӹرա
+    };
+
+    /**
+     * @struct captureEvent
+     * @brief һ¼
+     */
+    struct captureEvent {
+        captureRecord type;         ///< ¼͡
+        uint64_t time_us;           ///< ץʼ΢
+        uint32_t connection;        ///< ӱţ 1 ʼ
+        std::string payload;        ///< OPEN Ϊͻ IPDATA ΪյݣCLOSE Ϊա
+    };
+
+    /**
+     * @class captureFormat
+     * @brief ץļĸʽ
+     *
+     * ļͷΪ 4 ֽ "EMTC"4 ֽڰ汾ź 8 ֽץʼʱϵͳʱ䣨UNIX 룩ΪС
+     * ֮ÿ¼Ϊ1 ֽ͡һ¼΢ӱţOPEN  DATA ٸȺݣ
+     *  LEB128 䳤룬СÿֻмֽڵĿ¼յȫ˳С
+     */
+    class captureFormat {
+    public:
+        static constexpr char magic[4] = { 'E', 'M', 'T', 'C' };   ///< ļʶ
+        static constexpr uint32_t version = 1;                      ///< ʽ汾
+        static constexpr size_t header_size = 16;                   ///< ļͷֽ
+
+        /**
+         * @brief дļͷ
+         *
+         * @param out 
+         * @param start_ms ץʼʱϵͳʱ䣨UNIX 룩
+         */
+        static void putHeader(std::string& out, int64_t start_ms) {
+            out.append(magic, sizeof(magic));
+            out.append(reinterpret_cast<const char*>(&version), sizeof(version));
+            out.append(reinterpret_cast<const char*>(&start_ms), sizeof(start_ms));
+        }
+
+        /**
+         * @brief  LEB128 дһ޷
+         */
+        static void putVarint(std::string& out, uint64_t value) {
+            while (value >= 0x80) {
+                out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+                value >>= 7;
+            }
+            out.push_back(static_cast<char>(value));
+        }
+
+        /**
+         * @brief ȡһ LEB128 
+         *
+         * @param p ȡλãɹǰơ
+         * @param end ĩβ
+         * @param value 
+         * @return bool  true
+         */
+        static bool getVarint(const char*& p, const char* end, uint64_t& value) {
+            value = 0;
+            for (int shift = 0; p < end && shift < 64; shift += 7) {
+                uint8_t byte = static_cast<uint8_t>(*p++);
+                value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+                if ((byte & 0x80) == 0) return true;
+            }
+            return false;
+        }
+
+        /**
+         * @brief ȡץļ
+         *
+         * @param path ļ·
+         * @param events ļ¼ʱ˳С
+         * @param start_ms ץʼʱ䣨UNIX 룩
+         * @param error ʧʱԭ
+         * @return bool ɹ trueļĩβļ¼ץ쳣˳ʱü¼Է true
+         */
+        static bool readFile(const std::string& path, std::vector<captureEvent>& events, int64_t& start_ms, std::string& error) {
+            std::ifstream file(path, std::ios::binary);
+            if (!file) {
+                error = "cannot open " + path;
+                return false;
+            }
+            std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            uint32_t file_version = 0;
+            if (data.size() < header_size || std::memcmp(data.data(), magic, sizeof(magic)) != 0) {
+                error = "not a capture file";
+                return false;
+            }
+            std::memcpy(&file_version, data.data() + 4, sizeof(file_version));
+            std::memcpy(&start_ms, data.data() + 8, sizeof(start_ms));
+            if (file_version != version) {
+                error = "unsupported capture version " + std::to_string(file_version);
+                return false;
+            }
+
+            const char* p = data.data() + header_size;
+            const char* end = data.data() + data.size();
+            uint64_t time_us = 0;
+            while (p < end) {
+                captureEvent event;
+                uint64_t delta, connection, length = 0;
+                event.type = static_cast<captureRecord>(*p++);
+                if (!getVarint(p, end, delta) || !getVarint(p, end, connection)) break;
+                if (event.type == captureRecord::OPEN || event.type == captureRecord::DATA) {
+                    if (!getVarint(p, end, length) || length > static_cast<uint64_t>(end - p)) break;
+                    event.payload.assign(p, static_cast<size_t>(length));
+                    p += length;
+                }
+                else if (event.type != captureRecord::CLOSE) {
+                    error = "unknown record type";
+                    return false;
+                }
+                time_us += delta;
+                event.time_us = time_us;
+                event.connection = static_cast<uint32_t>(connection);
+                events.push_back(std::move(event));
+            }
+            return true;
+        }
+    };
+
+}  // namespace ems
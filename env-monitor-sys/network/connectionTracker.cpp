@@ -0,0 +1,216 @@
+#include "connectionTracker.h"
+#include "../esys/esysControl.h"
+
+namespace ems {
+
+    static int64_t steadyNowMs() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void trackedConnection::touch() {
+        last_activity_ms.store(steadyNowMs(), std::memory_order_relaxed);
+    }
+
+    connectionTracker::connectionTracker() : wheel(wheel_slots), current_tick(0), next_id(1), running(false) {
+        esysControl& esys = esysControl::getInstance();
+        auto readUInt = [&esys](const std::string& key, unsigned int default_value) -> unsigned int {
+            std::string value = esys.getConfig(key);
+            if (value.empty()) return default_value;
+            try {
+                return static_cast<unsigned int>(std::stoul(value));
+            }
+            catch (const std::exception&) {
+                std::cerr << "[connectionTracker]: Invalid value \"" << value << "\" for " << key << ", use " << default_value << "." << std::endl;
+                return default_value;
+            }
+        };
+        idle_timeout_seconds = readUInt("tcp_idle_timeout_seconds", 300);
+        keepalive_seconds = readUInt("tcp_keepalive_seconds", 60);
+        max_connections = readUInt("tcp_max_connections", 1000);
+        // ĬϲƵԴַNAT غĶ̨豸һַַƻܾ豸
+        max_connections_per_ip = readUInt("tcp_max_connections_per_ip", 0);
+        log_operations = esys.getConfig("log_operations") == "false" ? false : true;
+    }
+
+    connectionTracker::~connectionTracker() {
+        stop();
+    }
+
+    void connectionTracker::start() {
+        if (idle_timeout_seconds == 0) return;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (running) return;
+            running = true;
+        }
+        ticker = std::thread(&connectionTracker::tickLoop, this);
+        std::cout << "[connectionTracker]: Reaping connections idle for " << idle_timeout_seconds << " s." << std::endl;
+    }
+
+    void connectionTracker::stop() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (!running) return;
+            running = false;
+        }
+        cv.notify_all();
+        if (ticker.joinable()) ticker.join();
+    }
+
+    std::shared_ptr<trackedConnection> connectionTracker::admit(SOCKET clientSocket, const std::string& clientIP) {
+        auto connection = std::make_shared<trackedConnection>();
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            size_t& from_ip = per_ip[clientIP];
+            if ((max_connections > 0 && connections.size() >= max_connections) ||
+                (max_connections_per_ip > 0 && from_ip >= max_connections_per_ip)) {
+                if (from_ip == 0) per_ip.erase(clientIP);
+                metrics.rejected++;
+                std::cerr << "[connectionTracker]: [" + clientIP + "] Connection rejected, " << connections.size()
+                    << " live and " << from_ip << " from this address." << std::endl;
+                return nullptr;
+            }
+            from_ip++;
+            connection->id = next_id++;
+            connection->socket = clientSocket;
+            connection->clientIP = clientIP;
+            connection->touch();
+            connections.emplace(connection->id, connection);
+            metrics.accepted++;
+            metrics.peak = std::max<uint64_t>(metrics.peak, connections.size());
+            if (idle_timeout_seconds > 0) schedule(connection, current_tick + idle_timeout_seconds);
+        }
+
+        // 뿪ӣ豸ϵжϣٷκݣ keepalive ̽Ⲣ recv ʧ
+        if (keepalive_seconds > 0) {
+            tcp_keepalive settings;
+            settings.onoff = 1;
+            settings.keepalivetime = keepalive_seconds * 1000;
+            settings.keepaliveinterval = 1000;
+            DWORD bytes_returned = 0;
+            WSAIoctl(clientSocket, SIO_KEEPALIVE_VALS, &settings, sizeof(settings), nullptr, 0, &bytes_returned, nullptr, nullptr);
+        }
+        return connection;
+    }
+
+    void connectionTracker::release(const std::shared_ptr<trackedConnection>& connection) {
+        if (!connection) return;
+        {
+            std::lock_guard<std::mutex> lock(connection->mtx);
+            connection->released = true;
+        }
+        std::lock_guard<std::mutex> lock(mtx);
+        if (connections.erase(connection->id) == 0) return;
+        auto it = per_ip.find(connection->clientIP);
+        if (it != per_ip.end() && --it->second == 0) per_ip.erase(it);
+        if (connections.empty()) cv.notify_all();
+    }
+
+    size_t connectionTracker::closeAll() {
+        std::vector<std::shared_ptr<trackedConnection>> live;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            live.reserve(connections.size());
+            for (const auto& connection : connections) live.push_back(connection.second);
+        }
+        size_t closed = 0;
+        for (const auto& connection : live) {
+            std::lock_guard<std::mutex> lock(connection->mtx);
+            if (connection->released) continue;
+            closed++;
+            connection->draining = true;
+            shutdown(connection->socket, SD_BOTH);
+            CancelIoEx(reinterpret_cast<HANDLE>(connection->socket), nullptr);
+        }
+        return closed;
+    }
+
+    bool connectionTracker::waitReleased(std::chrono::steady_clock::time_point deadline) {
+        std::unique_lock<std::mutex> lock(mtx);
+        return cv.wait_until(lock, deadline, [this] { return connections.empty(); });
+    }
+
+    void connectionTracker::schedule(const std::shared_ptr<trackedConnection>& connection, uint64_t deadline_tick) {
+        // ʱ䲻һ񣬵ǰѾ
+        deadline_tick = std::max(deadline_tick, current_tick + 1);
+        wheel[deadline_tick % wheel_slots].push_back({ connection, deadline_tick });
+    }
+
+    void connectionTracker::advance() {
+        std::vector<std::shared_ptr<trackedConnection>> expired;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            current_tick++;
+            std::vector<timerEntry>& slot = wheel[current_tick % wheel_slots];
+            int64_t now_ms = steadyNowMs();
+            int64_t timeout_ms = static_cast<int64_t>(idle_timeout_seconds) * 1000;
+            size_t kept = 0;
+            for (size_t i = 0; i < slot.size(); ++i) {
+                std::shared_ptr<trackedConnection> connection = slot[i].connection.lock();
+                if (!connection || connection->released) continue;
+                // ҪתȦŵ
+                if (slot[i].deadline_tick > current_tick) {
+                    slot[kept++] = slot[i];
+                    continue;
+                }
+                int64_t idle_ms = now_ms - connection->last_activity_ms.load(std::memory_order_relaxed);
+                if (idle_ms >= timeout_ms) {
+                    expired.push_back(connection);
+                    continue;
+                }
+                // ڼյݣһεʱ¼㵽ʱ
+                uint64_t remaining_ticks = static_cast<uint64_t>((timeout_ms - idle_ms + 999) / 1000);
+                uint64_t deadline = current_tick + remaining_ticks;
+                if (deadline % wheel_slots == current_tick % wheel_slots) {
+                    slot[kept++] = { connection, deadline };
+                }
+                else {
+                    schedule(connection, deadline);
+                }
+            }
+            slot.resize(kept);
+        }
+
+        size_t reaped = 0;
+        for (const auto& connection : expired) {
+            std::lock_guard<std::mutex> lock(connection->mtx);
+            if (connection->released) continue;
+            reaped++;
+            connection->reaped = true;
+            // ֻжӣ׽ɺ˹رգCancelIoEx ʹ recv ص WSARecv 
+            shutdown(connection->socket, SD_BOTH);
+            CancelIoEx(reinterpret_cast<HANDLE>(connection->socket), nullptr);
+            if (log_operations) std::cout << "[connectionTracker]: [" + connection->clientIP + "] Closing idle connection." << std::endl;
+        }
+        if (reaped > 0) {
+            std::lock_guard<std::mutex> lock(mtx);
+            metrics.reaped += reaped;
+        }
+    }
+
+    void connectionTracker::tickLoop() {
+        auto next = std::chrono::steady_clock::now();
+        std::unique_lock<std::mutex> lock(mtx);
+        while (running) {
+            next += std::chrono::seconds(1);
+            if (cv.wait_until(lock, next, [this] { return !running; })) break;
+            lock.unlock();
+            advance();
+            lock.lock();
+        }
+    }
+
+    connectionMetrics connectionTracker::getMetrics() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        connectionMetrics result = metrics;
+        result.live = connections.size();
+        // гʱһʱûݵӼΪУδóʱʱ 60 Ϊ׼
+        int64_t threshold_ms = idle_timeout_seconds > 0 ? static_cast<int64_t>(idle_timeout_seconds) * 500 : 60000;
+        int64_t now_ms = steadyNowMs();
+        for (const auto& connection : connections) {
+            if (now_ms - connection.second->last_activity_ms.load(std::memory_order_relaxed) >= threshold_ms) result.idle++;
+        }
+        return result;
+    }
+
+}  // namespace ems
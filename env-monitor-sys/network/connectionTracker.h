@@ -0,0 +1,209 @@
+/**
+ * @file connectionTracker.h
+ * @author Yilin Wang (yilin233@foxmail.com)
+ * @brief Connection lifecycle management for the TCP server, admission limits,
+ *  keepalive, and idle reaping driven by a hashed timer wheel.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2024 Yilin Wang
+ *
+ * MIT License
+ */
+
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+#include <winsock2.h>
+#include <mstcpip.h>  // For SIO_KEEPALIVE_VALS
+
+namespace ems {
+
+    /**
+     * @struct connectionMetrics
+     * @brief TCP ӵָꡣ
+     */
+    struct connectionMetrics {
+        uint64_t live = 0;              ///< ǰ
+        uint64_t idle = 0;              ///< ǰегʱһʱûݣ
+        uint64_t peak = 0;              ///< ʷ
+        uint64_t accepted = 0;          ///< ۼƽܵ
+        uint64_t rejected = 0;          ///< ޱܾ
+        uint64_t reaped = 0;            ///< гʱرյ
+    };
+
+    /**
+     * @struct trackedConnection
+     * @brief һٵӣɺ˳Уյʱ last_activity_ms
+     *
+     * ׽ʼɺ˹رգֻδͷʱ shutdown ȡδɵĽգ
+     * ʹ˵ recv ֪ͨԴ󷵻أ˲رһѱ·׽־
+     */
+    struct trackedConnection {
+        uint64_t id = 0;                                ///< ӱš
+        SOCKET socket = INVALID_SOCKET;                 ///< ͻ׽֡
+        std::string clientIP;                           ///< ͻ IP ַ
+        std::atomic<int64_t> last_activity_ms{ 0 };     ///< һյݵʱ䣨steady_clock 룩
+        std::mutex mtx;                                 ///< ʹͷźͻջ⡣
+        std::atomic<bool> released{ false };            ///< Ƿͷӡ
+        std::atomic<bool> reaped{ false };              ///< Ƿгʱرա
+        std::atomic<bool> draining{ false };            ///< Ƿرձжϡ
+
+        /**
+         * @brief ¼յݣֻдһԭ
+         */
+        void touch();
+    };
+
+    /**
+     * @class connectionTracker
+     * @brief ڹ
+     *
+     *  TCP ˽Ӻ admitȫ tcp_max_connections 
+     * Դַ tcp_max_connections_per_ip tcp_keepalive_seconds  TCP keepalive
+     * ӽʱ release
+     *
+     * гʱһϣʱʱ wheel_slots ۣÿǰһӰʱӦĲۣ
+     * һȦĵʱ¼ʣȦյֻӵʱƶʱеĿ
+     * ĿʱټʱݵӰµĵʱ·룬رա
+     */
+    class connectionTracker {
+    private:
+        static constexpr size_t wheel_slots = 64;       ///< ʱֵĲÿ 1 롣
+
+        /**
+         * @brief ʱеһĿ
+         */
+        struct timerEntry {
+            std::weak_ptr<trackedConnection> connection;    ///< ӣͷźԶʧЧ
+            uint64_t deadline_tick;                         ///< ڵʱ̶ֿȡ
+        };
+
+        unsigned int idle_timeout_seconds;      ///< гʱ룩0 ʾա
+        unsigned int keepalive_seconds;         ///< TCP keepalive Ŀʱ䣨룩0 ʾá
+        size_t max_connections;                 ///< ȫޣ0 ʾơ
+        size_t max_connections_per_ip;          ///< Դַޣ0 ʾƣĬϣ
+        bool log_operations;                    ///< Ƿ¼־
+
+        mutable std::mutex mtx;                 ///< ³Ա
+        std::unordered_map<uint64_t, std::shared_ptr<trackedConnection>> connections;   ///< ǰӡ
+        std::unordered_map<std::string, size_t> per_ip;     ///< ÿԴַ
+        std::vector<std::vector<timerEntry>> wheel;         ///< ʱ֡
+        uint64_t current_tick;                  ///< ʱֵǰĿ̶ȡ
+        uint64_t next_id;                       ///< һӱš
+        connectionMetrics metrics;              ///< ָ꣬live  idle ڶȡʱ㡣
+
+        std::thread ticker;                     ///< ƽʱֵ̡߳
+        std::condition_variable cv;             ///< ֹͣ tickerԼ֪ͨӶͷš
+        bool running;                           ///< ticker ǷС
+
+        /**
+         * @brief ˽й캯ȡӹá
+         */
+        connectionTracker();
+
+        /**
+         * @brief ˽ֹͣ ticker
+         */
+        ~connectionTracker();
+
+        /**
+         * @brief ɾ캯
+         */
+        connectionTracker(const connectionTracker&) = delete;
+
+        /**
+         * @brief ɾֵ
+         */
+        connectionTracker& operator=(const connectionTracker&) = delete;
+
+        /**
+         * @brief Ӱʱʱ֣÷ mtx
+         *
+         * @param connection ӡ
+         * @param deadline_tick ڵĿ̶ȡ
+         */
+        void schedule(const std::shared_ptr<trackedConnection>& connection, uint64_t deadline_tick);
+
+        /**
+         * @brief ƽʱһ񣬴ڵĿ
+         */
+        void advance();
+
+        /**
+         * @brief ticker ߳ѭ
+         */
+        void tickLoop();
+
+    public:
+        /**
+         * @brief ȡconnectionTrackerĵʵ
+         *
+         * @return connectionTracker& ʵá
+         */
+        static connectionTracker& getInstance() {
+            static connectionTracker instance;
+            return instance;
+        }
+
+        /**
+         * @brief ʱ֣δÿгʱʱ
+         */
+        void start();
+
+        /**
+         * @brief ֹͣʱ֡
+         */
+        void stop();
+
+        /**
+         * @brief һӡ
+         *
+         * @param clientSocket ͻ׽֡
+         * @param clientIP ͻ IP ַ
+         * @return std::shared_ptr<trackedConnection> ʱؿָ룬ɵ÷ر׽֡
+         */
+        std::shared_ptr<trackedConnection> admit(SOCKET clientSocket, const std::string& clientIP);
+
+        /**
+         * @brief ͷӣúɺ˹ر׽֡
+         *
+         * @param connection admit صӡ
+         */
+        void release(const std::shared_ptr<trackedConnection>& connection);
+
+        /**
+         * @brief رʱжӣʽлͬɺ˹رա
+         *
+         * ڴݻᴦϣ֮ recv ֪ͨԴ󷵻ء
+         *
+         * @return size_t жϵ
+         */
+        size_t closeAll();
+
+        /**
+         * @brief ȴӶͷš
+         *
+         * @param deadline ȴʱ㡣
+         * @return bool ȫͷŷ trueʱ false
+         */
+        bool waitReleased(std::chrono::steady_clock::time_point deadline);
+
+        /**
+         * @brief ȡӵָꡣ
+         *
+         * @return connectionMetrics ָĸ
+         */
+        connectionMetrics getMetrics() const;
+    };
+
+}  // namespace ems
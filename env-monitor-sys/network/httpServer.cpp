@@ -7,11 +7,232 @@ namespace ems {
 		host = esys.getConfig("hs_host");
 		port = esys.getConfig("hs_port");
 		mount_dir = esys.getConfig("hs_mount_dir");
+		static_cache = esys.getConfig("hs_static_cache") != "false";
+		std::string reload = esys.getConfig("hs_static_reload_seconds");
+		static_reload_seconds = reload.empty() ? 2 : static_cast<unsigned int>(std::stoul(reload));
 		log_operations = esys.getConfig("log_operations") == "false" ? false : true;
+		std::string max_rows = esys.getConfig("hs_ingest_max_rows");
+		ingest_max_rows = max_rows.empty() ? 10000 : static_cast<size_t>(std::stoul(max_rows));
+		std::string max_payload = esys.getConfig("hs_max_payload_bytes");
+		max_payload_bytes = max_payload.empty() ? 8388608 : static_cast<size_t>(std::stoull(max_payload));
+		std::string history_rows = esys.getConfig("hs_history_max_rows");
+		history_max_rows = history_rows.empty() ? 10000 : static_cast<size_t>(std::stoul(history_rows));
+		if (history_max_rows == 0) history_max_rows = 1;
+		instance_tag = std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count());
 	}
+	std::string httpServer::jsonString(const std::string& value)
+	{
+		static const char hex[] = "0123456789abcdef";
+		std::string quoted = "\"";
+		quoted.reserve(value.length() + 2);
+		for (char c : value) {
+			unsigned char u = static_cast<unsigned char>(c);
+			if (c == '"' || c == '\\') {
+				quoted += '\\';
+				quoted += c;
+			}
+			else if (u < 0x20) {
+				quoted += "\\u00";
+				quoted += hex[u >> 4];
+				quoted += hex[u & 0xf];
+			}
+			else {
+				quoted += c;
+			}
+		}
+		return quoted + "\"";
+	}
+
+	void httpServer::writeRowJson(std::stringstream& ss, const dbRowBuffer& row)
+	{
+		for (size_t i = 0; i < row.size(); ++i) {
+			if (i > 0) ss << ", ";
+			ss << jsonString(row.column(i)) << ": " << jsonString(row.value(i));
+		}
+	}
+
+	std::string httpServer::apiEtag(const std::string& api, const httplib::Request& req) const
+	{
+		uint64_t version;
+		if (api == "clientip") {
+			version = deviceRegistry::getInstance().getListVersion();
+		}
+		else if (api == "devices") {
+			version = deviceRegistry::getInstance().getStateVersion();
+		}
+		else if (api == "record") {
+			version = deviceRegistry::getInstance().getReadingVersion(req.get_param_value("ip"));
+		}
+		else if (api == "alarm") {
+			version = alarmModule::getInstance().getAlarmVersion();
+		}
+		else if (api == "alarm/history") {
+			version = alarmModule::getInstance().getHistoryVersion();
+		}
+		else {
+			return "";
+		}
+		return "\"" + instance_tag + "-" + std::to_string(version) + "\"";
+	}
+
+	void httpServer::handleIngest(const httplib::Request& req, httplib::Response& res)
+	{
+		// дӵʱԺԣ׷
+		if (dbWriter::getInstance().congested()) {
+			ingest_busy++;
+			res.status = httplib::StatusCode::ServiceUnavailable_503;
+			res.set_header("Retry-After", "1");
+			res.set_content("{ \"code\" : 503, \"data\" : { \"error\": \"storage is busy, retry later\" } }", "application/json");
+			return;
+		}
+
+		thread_local sensorBatch batch;
+		thread_local std::vector<uint64_t> alarm_mask;
+		std::vector<std::string> errors;
+		batch.reset(sensorSchema::getInstance().size(), 256);
+		//  ingest_max_rows + 1 ʱֹͣ޵󲻻ᱻ
+		size_t accepted = ingestParser::parse(req.body, req.remote_addr, ingest_max_rows + 1, batch, errors);
+
+		std::stringstream ss;
+		if (batch.rows > ingest_max_rows) {
+			res.status = httplib::StatusCode::PayloadTooLarge_413;
+			ss << "{ \"code\" : 413, \"data\" : { \"error\": \"too many readings (more than hs_ingest_max_rows "
+				<< ingest_max_rows << ")\" } }";
+			res.set_content(ss.str(), "application/json");
+			return;
+		}
+
+		ingestSummary summary = esysControl::getInstance().ingestBatch(batch, alarm_mask);
+
+		// ÿ豸ڱеһжǷڱ
+		std::vector<size_t> last_row(batch.devices.size(), 0);
+		for (size_t row = 0; row < batch.rows; ++row) last_row[batch.device_ids[row]] = row;
+
+		ss << "{ \"code\" : 200, \"data\" : { "
+			<< "\"accepted\": " << accepted << ", "
+			<< "\"rejected\": " << errors.size() << ", "
+			<< "\"stored\": " << summary.stored << ", "
+			<< "\"dropped\": " << summary.dropped << ", "
+			<< "\"alarm_rows\": " << summary.alarm_rows << ", "
+			<< "\"alarm_active\": [";
+		bool first = true;
+		for (size_t d = 0; d < batch.devices.size(); ++d) {
+			size_t row = last_row[d];
+			if (!(alarm_mask[row >> 6] >> (row & 63) & 1)) continue;
+			ss << (first ? "" : ", ") << jsonString(batch.devices[d]);
+			first = false;
+		}
+		ss << "], \"errors\": [";
+		// Ϣ෵ 100 ʽĴõͬӦ
+		for (size_t i = 0; i < errors.size() && i < 100; ++i) {
+			ss << (i > 0 ? ", " : "") << jsonString(errors[i]);
+		}
+		ss << "] } }";
+		{
+			std::unique_lock lock(mtx);
+			if (log_operations) {
+				std::cout << "[httpServer]: Ingested " << accepted << " readings from \"" + req.remote_addr + "\", "
+					<< errors.size() << " rejected." << std::endl;
+			}
+		}
+		res.set_content(ss.str(), "application/json");
+	}
+
+	void httpServer::handleHistory(const httplib::Request& req, httplib::Response& res)
+	{
+		static constexpr size_t page_rows = 500;  // ÿҳȡ
+
+		// limit ȱʡΪ 100Ϊ 0 򳬹 hs_history_max_rows ʱ޷
+		size_t limit = 100;
+		uint64_t before = 0;
+		try {
+			if (req.has_param("limit")) limit = static_cast<size_t>(std::stoul(req.get_param_value("limit")));
+			if (req.has_param("before")) before = std::stoull(req.get_param_value("before"));
+		}
+		catch (const std::exception&) {}
+		if (limit == 0 || limit > history_max_rows) limit = history_max_rows;
+
+		struct historyCursor {
+			std::string client_ip;
+			size_t remaining;
+			uint64_t before;
+			bool started = false;
+			bool any = false;
+		};
+		auto cursor = std::make_shared<historyCursor>(historyCursor{ req.get_param_value("ip"), limit, before });
+		if (cursor->client_ip.empty()) {
+			res.set_content("{ \"code\" : 200, \"data\" : [], \"next_before\" : null }", "application/json");
+			return;
+		}
+
+		res.set_chunked_content_provider("application/json", [cursor](size_t, httplib::DataSink& sink) {
+			std::string chunk;
+			if (!cursor->started) {
+				chunk = "{ \"code\" : 200, \"data\" : [";
+				cursor->started = true;
+			}
+
+			// ݿʱֵֻлͷ֮
+			thread_local std::vector<std::string> names, values;
+			size_t columns = 0, eid_index = std::string::npos, rows = 0;
+			values.clear();
+			size_t page = (std::min)(cursor->remaining, page_rows);
+			int result = dbTools::getInstance().dbReadEach("envtable", cursor->client_ip, static_cast<unsigned int>(page),
+				[&](const dbRowBuffer& row) {
+					if (rows == 0) {
+						columns = row.size();
+						eid_index = row.indexOf("eid");
+						names.resize(columns);
+						for (size_t i = 0; i < columns; ++i) names[i] = row.column(i);
+					}
+					for (size_t i = 0; i < columns; ++i) values.push_back(row.value(i));
+					++rows;
+					return true;
+				}, cursor->before);
+
+			for (size_t r = 0; r < rows; ++r) {
+				chunk += cursor->any ? ", {" : "{";
+				cursor->any = true;
+				for (size_t i = 0; i < columns; ++i) {
+					if (i > 0) chunk += ", ";
+					chunk += jsonString(names[i]) + ": " + jsonString(values[r * columns + i]);
+				}
+				chunk += "}";
+			}
+			cursor->remaining -= rows;
+			if (rows > 0 && eid_index != std::string::npos) {
+				cursor->before = std::strtoull(values[(rows - 1) * columns + eid_index].c_str(), nullptr, 10);
+			}
+
+			bool finished = result != EXIT_SUCCESS || rows < page || cursor->remaining == 0;
+			if (finished) {
+				chunk += "], \"next_before\" : ";
+				// ʱܻиݣһҳ
+				chunk += result == EXIT_SUCCESS && rows == page && rows > 0 ? std::to_string(cursor->before) : "null";
+				if (result != EXIT_SUCCESS) chunk += ", \"error\" : \"failed to read history\"";
+				chunk += " }";
+			}
+			if (!sink.write(chunk.data(), chunk.size())) return false;
+			if (finished) sink.done();
+			return true;
+			});
+	}
+
 	void httpServer::bindApi()
 	{
 		using namespace httplib;
+		hvr.Post("/api/ingest", [this](const Request& req, Response& res) {
+			handleIngest(req, res);
+			});
+		// ͨõ /api/(.*) עᣬƥ
+		hvr.Get("/api/history", [this](const Request& req, Response& res) {
+			if (log_operations) {
+				std::unique_lock lock(mtx);
+				std::cout << "[httpServer]: HTTP GET Request from \"" + req.get_header_value("Host") + req.path + "\"." << std::endl;
+			}
+			handleHistory(req, res);
+			});
 		hvr.Get(R"(/api/(.*))", [&](const Request& req, Response& res) {
 			std::string url = req.path;
 			std::string api = "";
@@ -20,36 +241,65 @@ namespace ems {
 			if (pos != std::string::npos) {
 				api = url.substr(pos + prefix.length());
 			}
+			// δ仯ʱֱӷ 304ѯݿҲ JSON
+			std::string etag = apiEtag(api, req);
+			if (!etag.empty()) {
+				res.set_header("ETag", etag);
+				res.set_header("Cache-Control", "no-cache");
+				if (req.get_header_value("If-None-Match") == etag) {
+					res.status = httplib::StatusCode::NotModified_304;
+					return;
+				}
+			}
 			dbTools& db = dbTools::getInstance();
 			std::string http_status_code = "200";
 			std::stringstream ss;
 			ss << "{ \"code\" : " + http_status_code + ", " << "\"data\" : ";
 			if (api == "clientip") {
-				std::vector<std::string> all_client_ip;
-				db.dbDistinctSelect("envtable", "clientIP", all_client_ip);
+				std::vector<std::string> all_client_ip = deviceRegistry::getInstance().getClientIPs();
 				ss << "[";
 				for (size_t i = 0; i < all_client_ip.size(); ++i) {
-					ss << "\"" + all_client_ip[i] + "\"";
+					ss << jsonString(all_client_ip[i]);
 					if (i != all_client_ip.size() - 1) {
 						ss << ", ";
 					}
 				}
 				ss << "]";
 			}
+			else if (api == "devices") {
+				std::vector<deviceInfo> devices = deviceRegistry::getInstance().getDevices();
+				ss << "[";
+				for (size_t i = 0; i < devices.size(); ++i) {
+					ss << "{ \"clientIP\": " << jsonString(devices[i].clientIP) << ", "
+						<< "\"first_seen\": " << devices[i].first_seen << ", "
+						<< "\"last_seen\": " << devices[i].last_seen << ", "
+						<< "\"connected\": " << (devices[i].connections > 0 ? "true" : "false") << " }";
+					if (i != devices.size() - 1) {
+						ss << ", ";
+					}
+				}
+				ss << "]";
+			}
 			else if (api == "record") {
-				std::unordered_map<std::string, std::string> data;
-				std::unordered_map<std::string, std::string> table_structure;
-				db.dbReadByClientIP("envtable", req.get_param_value("ip"), data);
-				table_structure = db.getTableStructure("envtable");
+				std::string client_ip = req.get_param_value("ip");
+				readingRow latest;
+				// ȶ汾ٶݣݲȰ汾ž
+				uint64_t version = client_ip.empty() ? 0 : deviceRegistry::getInstance().getReadingVersion(client_ip);
 				ss << "{";
-				auto it = data.begin();
-				while (it != data.end()) {
-					ss << "\"" + it->first + "\": " +"\"" + it->second + "\"";
-					++it;
-					if (it != data.end()) {
-						ss << ", ";
+				if (!client_ip.empty() && deviceRegistry::getInstance().getLatest(client_ip, latest)) {
+					// յݵ豸ֱӷڴеݣݿепܻдУû eid
+					// seq ɽ̱ʶ͸豸ݰ汾ɣҳݴжǷΪ
+					ss << "\"seq\": \"" << instance_tag << "-" << version << "\"";
+					for (const auto& [column, value] : latest) {
+						ss << ", " << jsonString(column) << ": " << jsonString(value);
 					}
 				}
+				else if (!client_ip.empty()) {
+					db.dbReadEach("envtable", client_ip, 1, [&ss](const dbRowBuffer& row) {
+						writeRowJson(ss, row);
+						return true;
+						});
+				}
 				ss << "}";
 			}
 			else if (api == "alarm") {
@@ -57,7 +307,7 @@ namespace ems {
 				ss << "{ \"message\": {";
 				auto itm = message.begin();
 				while (itm != message.end()) {
-					ss << "\""+ itm->first + "\": \"" << itm->second << "\"";
+					ss << jsonString(itm->first) << ": " << jsonString(itm->second);
 					++itm;
 					if (itm != message.end()) {
 						ss << ", ";
@@ -67,7 +317,7 @@ namespace ems {
 				static std::unordered_map<std::string, double> threshold = alarmModule::getInstance().getThreshold();
 				auto itt = threshold.begin();
 				while (itt != threshold.end()) {
-					ss << "\""+ itt->first +  "\": \"" << itt->second << "\"";
+					ss << jsonString(itt->first) << ": \"" << itt->second << "\"";
 					++itt;
 					if (itt != threshold.end()) {
 						ss << ", ";
@@ -75,6 +325,92 @@ namespace ems {
 				}
 				ss << "} }";
 			}
+			else if (api == "alarm/history") {
+				// ı¼ʱµ
+				std::string client_ip = req.get_param_value("ip");
+				size_t limit = 100;
+				if (req.has_param("limit")) {
+					try {
+						limit = static_cast<size_t>(std::stoul(req.get_param_value("limit")));
+					}
+					catch (const std::exception&) {}
+				}
+				std::vector<alarmEvent> events = alarmModule::getInstance().getAlarmHistory(client_ip, limit);
+				ss << "[";
+				for (size_t i = 0; i < events.size(); ++i) {
+					const alarmEvent& event = events[i];
+					ss << "{ \"id\": " << event.id << ", "
+						<< "\"clientIP\": " << jsonString(event.clientIP) << ", "
+						<< "\"rule\": " << jsonString(event.rule) << ", "
+						<< "\"metric\": " << jsonString(event.metric) << ", "
+						<< "\"value\": ";
+					if (std::isnan(event.value)) ss << "null";
+					else ss << event.value;
+					ss << ", \"threshold\": " << event.threshold << ", "
+						<< "\"from\": \"" << alarmStateName(event.from) << "\", "
+						<< "\"to\": \"" << alarmStateName(event.to) << "\", "
+						<< "\"time\": " << event.time_ms << ", "
+						<< "\"since\": " << event.since_ms << " }";
+					if (i != events.size() - 1) {
+						ss << ", ";
+					}
+				}
+				ss << "]";
+			}
+			else if (api == "metrics") {
+				retentionMetrics retention = dbRetention::getInstance().getMetrics();
+				writerMetrics writer = dbWriter::getInstance().getMetrics();
+				connectionMetrics connections = connectionTracker::getInstance().getMetrics();
+				ss << "{ \"writer\": { "
+					<< "\"enqueued\": " << writer.enqueued << ", "
+					<< "\"written\": " << writer.written << ", "
+					<< "\"failed\": " << writer.failed << ", "
+					<< "\"requeued\": " << writer.requeued << ", "
+					<< "\"dropped\": " << writer.dropped << ", "
+					<< "\"retry_backoff_ms\": " << writer.retry_backoff_ms << ", "
+					<< "\"batches\": " << writer.batches << ", "
+					<< "\"flushes\": " << writer.flushes << ", "
+					<< "\"queue_depth\": " << writer.queue_depth << ", "
+					<< "\"max_queue_depth\": " << writer.max_queue_depth << ", "
+					<< "\"last_flush_ms\": " << writer.last_flush_ms << ", "
+					<< "\"last_flush_rows\": " << writer.last_flush_rows << ", "
+					<< "\"backlog\": " << writer.backlog << ", "
+					<< "\"high_watermark\": " << writer.high_watermark << ", "
+					<< "\"low_watermark\": " << writer.low_watermark << ", "
+					<< "\"congested\": " << (writer.congested ? "true" : "false") << ", "
+					<< "\"congestion_events\": " << writer.congestion_events << " }, "
+					<< "\"ingest\": { "
+					<< "\"throttled_connections\": " << clientSession::throttledConnections() << ", "
+					<< "\"throttle_events\": " << clientSession::throttleEvents() << ", "
+					<< "\"busy_replies\": " << ingest_busy.load() << " }, "
+					<< "\"connections\": { "
+					<< "\"live\": " << connections.live << ", "
+					<< "\"idle\": " << connections.idle << ", "
+					<< "\"peak\": " << connections.peak << ", "
+					<< "\"accepted\": " << connections.accepted << ", "
+					<< "\"rejected\": " << connections.rejected << ", "
+					<< "\"reaped\": " << connections.reaped << " }, "
+					<< "\"retention\": { "
+					<< "\"passes\": " << retention.passes << ", "
+					<< "\"errors\": " << retention.errors << ", "
+					<< "\"rows_rolled_up\": " << retention.rows_rolled_up << ", "
+					<< "\"rows_deleted\": " << retention.rows_deleted << ", "
+					<< "\"bytes_reclaimed\": " << retention.bytes_reclaimed << ", "
+					<< "\"last_rows_deleted\": " << retention.last_rows_deleted << ", "
+					<< "\"last_bytes_reclaimed\": " << retention.last_bytes_reclaimed << ", "
+					<< "\"last_run_ms\": " << retention.last_run_ms << ", "
+					<< "\"total_run_ms\": " << retention.total_run_ms << " }";
+				if (fakeStore::enabled()) {
+					fakeStoreMetrics fake = fakeStore::getInstance().getMetrics();
+					ss << ", \"fake_db\": { "
+						<< "\"round_trips\": " << fake.round_trips << ", "
+						<< "\"failures\": " << fake.failures << ", "
+						<< "\"injected_us\": " << fake.injected_us << ", "
+						<< "\"rows_inserted\": " << fake.rows_inserted << ", "
+						<< "\"rows_evicted\": " << fake.rows_evicted << " }";
+				}
+				ss << " }";
+			}
 			else {
 				ss << "'Invaild api'";
 			}
@@ -97,8 +433,19 @@ namespace ems {
 			ss << hvr.bind_to_any_port(host);
 			port = ss.str();
 		}
+		// 峬ʱ httplib ڶȡǰֱӷ 413
+		hvr.set_payload_max_length(max_payload_bytes);
 		bindApi();
-		hvr.set_mount_point("/", mount_dir);
+		if (static_cache) {
+			// API ·עᣬƥ䣻 GET ڴеľ̬ļӦ
+			assets.start(mount_dir, static_reload_seconds);
+			hvr.Get("/.*", [this](const httplib::Request& req, httplib::Response& res) {
+				if (!assets.serve(req, res)) res.status = httplib::StatusCode::NotFound_404;
+				});
+		}
+		else {
+			hvr.set_mount_point("/", mount_dir);
+		}
 		bool rt = hvr.bind_to_port(host, stoi(port));
 		if (rt) {
 			std::unique_lock lock(mtx);
@@ -119,6 +466,7 @@ namespace ems {
 	int httpServer::stop()
 	{
 		hvr.stop();
+		assets.stop();
 		return 0;
 	}
 } // namespace ems
\ No newline at end of file
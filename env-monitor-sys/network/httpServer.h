@@ -13,10 +13,14 @@
 #pragma once
 
 #include "httplib.h"
+#include "staticCache.h"
+#include "ingestParser.h"
 #include "../esys/esysControl.h"
 
 namespace ems {
 
+    class dbRowBuffer;
+
     /**
      * @class httpServer
      * @brief HTTP࣬ڹHTTPAPI󶨡
@@ -27,6 +31,14 @@ namespace ems {
         std::string host;       ///<ַ
         std::string port;       ///<˿ںš
         std::string mount_dir;  ///<ڹؾ̬ļĿ¼
+        bool static_cache;      ///<Ƿ񽫾̬ļڴṩÿӴ̶ȡ
+        unsigned int static_reload_seconds; ///<龲̬ļĿ¼仯ļ0 ʾ顣
+        staticCache assets;     ///<̬ļ档
+        std::string instance_tag;   ///<еıʶ ETag У汾ظ
+        size_t ingest_max_rows; ///<POST /api/ingest һܵ
+        size_t max_payload_bytes;   ///<ֽ
+        size_t history_max_rows;    ///<GET /api/history һ෵صͨ before ҳȡ
+        std::atomic<uint64_t> ingest_busy{ 0 };  ///<дӵʱ 503 ܾ POST /api/ingest 
         std::shared_mutex& mtx; ///<߳ͬ
         bool log_operations;    ///<Ƿ¼־
         httplib::Server hvr;    ///<HTTPڴ
@@ -41,11 +53,57 @@ namespace ems {
          */
         httpServer& operator=(const httpServer&) = delete;
 
+        /**
+         * @brief ɴŵ JSON ַתšбܺͿַ
+         *
+         * 豸Ϣݿеֵⲿ룬дӦǰ뾭ת塣
+         *
+         * @param value ԭʼַ
+         * @return std::string ŵ JSON ַ
+         */
+        static std::string jsonString(const std::string& value);
+
+        /**
+         * @brief һ "": "ֵ" ʽд JSON 󣨲ţ
+         *
+         * @param ss 
+         * @param row ǰС
+         */
+        static void writeRowJson(std::stringstream& ss, const dbRowBuffer& row);
+
+        /**
+         * @brief  API ǰݵ ETagֻȡԴİ汾ţ JSON
+         *
+         * @param api API  "record"
+         * @param req HTTP ڶȡ ip 
+         * @return std::string ŵ ETagԴûа汾ʱؿַ
+         */
+        std::string apiEtag(const std::string& api, const httplib::Request& req) const;
+
         /**
          * @brief APIӿڵʵ֡
          */
         void bindApi();
 
+        /**
+         * @brief صϴPOST /api/ingest TCP ϱݽͬһˮߡ
+         *
+         * @param req HTTP Ϊ NDJSON  JSON 顣
+         * @param res HTTP ӦرĴ
+         */
+        void handleIngest(const httplib::Request& req, httplib::Response& res);
+
+        /**
+         * @brief ʷݲѯGET /api/history?ip=&limit=&before=ֿʽء
+         *
+         * ÿδݿȡһҳȡʱֻƸеֵͷݿлͣ
+         * ѯ᳤ʱд룬ӦҲ建ڴС
+         *
+         * @param req HTTP 
+         * @param res HTTP Ӧdata Ϊ eid еУnext_before Ϊһҳ before ûиʱΪ null
+         */
+        void handleHistory(const httplib::Request& req, httplib::Response& res);
+
         /**
          * @brief HTTP
          *
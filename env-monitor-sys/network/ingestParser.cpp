@@ -0,0 +1,236 @@
+#include "ingestParser.h"
+
+namespace ems {
+
+	//  JSON ֽ䣬жֵַʱʧܣfrom_chars Ӱ
+	static bool parseNumber(const char* first, const char* last, double& number) {
+		auto result = std::from_chars(first, last, number, std::chars_format::general);
+		return result.ec == std::errc() && result.ptr == last && std::isfinite(number);
+	}
+
+	void ingestParser::skipSpace(bool newlines) {
+		while (pos < text.length()) {
+			char c = text[pos];
+			if (c == ' ' || c == '\t' || (newlines && (c == '\r' || c == '\n'))) ++pos;
+			else break;
+		}
+	}
+
+	bool ingestParser::accept(char c) {
+		if (pos < text.length() && text[pos] == c) {
+			++pos;
+			return true;
+		}
+		return false;
+	}
+
+	void ingestParser::skipLine() {
+		size_t end = text.find('\n', pos);
+		pos = end == std::string::npos ? text.length() : end + 1;
+	}
+
+	bool ingestParser::validAddress(const std::string& address) {
+		if (address.empty() || address.length() > 15) return false;
+		int parts = 0, digits = 0, octet = 0;
+		for (char c : address) {
+			if (c == '.') {
+				if (digits == 0 || ++parts > 3) return false;
+				digits = octet = 0;
+			}
+			else if (c >= '0' && c <= '9') {
+				octet = octet * 10 + (c - '0');
+				if (++digits > 3 || octet > 255) return false;
+			}
+			else {
+				return false;
+			}
+		}
+		return parts == 3 && digits > 0;
+	}
+
+	bool ingestParser::readString(std::string& value) {
+		skipSpace();
+		if (!accept('"')) return false;
+		value.clear();
+		while (pos < text.length()) {
+			char c = text[pos++];
+			if (c == '"') return true;
+			if (c != '\\') {
+				value += c;
+				continue;
+			}
+			if (pos >= text.length()) break;
+			char escaped = text[pos++];
+			switch (escaped) {
+			case 'n': value += '\n'; break;
+			case 't': value += '\t'; break;
+			case 'r': value += '\r'; break;
+			case 'b': value += '\b'; break;
+			case 'f': value += '\f'; break;
+			case 'u':
+				// 豸ֵвַ ASCII ַ\uXXXX 
+				pos = std::min(pos + 4, text.length());
+				value += '?';
+				break;
+			default: value += escaped; break;
+			}
+		}
+		return false;
+	}
+
+	bool ingestParser::readValue(std::string& raw, double& number, bool& is_number, std::string& error) {
+		skipSpace();
+		is_number = false;
+		raw.clear();
+		if (pos >= text.length()) {
+			error = "unexpected end of input";
+			return false;
+		}
+		char c = text[pos];
+		if (c == '"') {
+			if (!readString(raw)) {
+				error = "unterminated string at position " + std::to_string(pos);
+				return false;
+			}
+			return true;
+		}
+		if (c == '{' || c == '[') {
+			error = "nested values are not supported at position " + std::to_string(pos);
+			return false;
+		}
+		for (const char* literal : { "true", "false", "null" }) {
+			size_t length = std::char_traits<char>::length(literal);
+			if (text.compare(pos, length, literal) == 0) {
+				pos += length;
+				return true;
+			}
+		}
+		// ֵָΪֹ"12abc""1.5.2" ûбֵЧ
+		size_t end = text.find_first_of(" \t\r\n,}]", pos);
+		if (end == std::string::npos) end = text.length();
+		if (!parseNumber(text.data() + pos, text.data() + end, number)) {
+			error = "invalid value at position " + std::to_string(pos);
+			return false;
+		}
+		pos = end;
+		is_number = true;
+		return true;
+	}
+
+	bool ingestParser::readObject(const std::string& default_ip, sensorBatch& batch, std::string& error) {
+		if (!accept('{')) {
+			error = "expected '{' at position " + std::to_string(pos);
+			return false;
+		}
+		complete = false;
+		std::fill(values.begin(), values.end(), std::numeric_limits<double>::quiet_NaN());
+		std::string device = default_ip;
+		std::string key, raw;
+		bool any = false, bad_device = false;
+
+		skipSpace();
+		if (!accept('}')) {
+			while (true) {
+				if (!readString(key)) {
+					error = "expected key at position " + std::to_string(pos);
+					return false;
+				}
+				skipSpace();
+				if (!accept(':')) {
+					error = "expected ':' at position " + std::to_string(pos);
+					return false;
+				}
+				double number = 0;
+				bool is_number = false;
+				if (!readValue(raw, number, is_number, error)) return false;
+
+				if (key == "clientIP" || key == "ip" || key == "device") {
+					if (validAddress(raw)) device = raw;
+					else bad_device = true;
+				}
+				else {
+					int id = schema.idOf(key);
+					if (id >= 0 && !is_number && !raw.empty()) {
+						// ֵҲдַַһ
+						is_number = parseNumber(raw.data(), raw.data() + raw.size(), number);
+					}
+					if (id >= 0 && is_number) {
+						values[id] = number;
+						any = true;
+					}
+				}
+
+				skipSpace();
+				if (accept(',')) continue;
+				if (accept('}')) break;
+				error = "expected ',' or '}' at position " + std::to_string(pos);
+				return false;
+			}
+		}
+		// ִʱȡпԼһ
+		complete = true;
+		if (bad_device) {
+			error = "invalid device address, expected dotted IPv4";
+			return false;
+		}
+		if (!any) {
+			error = "no known sensor values";
+			return false;
+		}
+
+		size_t row = batch.addRow(device);
+		for (size_t sensor = 0; sensor < values.size(); ++sensor) {
+			batch.column(sensor)[row] = values[sensor];
+		}
+		return true;
+	}
+
+	size_t ingestParser::parse(const std::string& body, const std::string& default_ip, size_t max_rows, sensorBatch& batch, std::vector<std::string>& errors) {
+		ingestParser parser(body, sensorSchema::getInstance());
+		parser.values.resize(parser.schema.size());
+		size_t parsed = 0, index = 0;
+
+		parser.skipSpace();
+		bool array = parser.accept('[');
+		while (batch.rows < max_rows) {
+			parser.skipSpace();
+			if (parser.pos >= body.length()) {
+				if (array) errors.push_back("unterminated array");
+				break;
+			}
+			if (array && parser.accept(']')) break;
+
+			++index;
+			std::string error;
+			if (parser.readObject(default_ip, batch, error)) {
+				++parsed;
+			}
+			else {
+				errors.push_back("reading " + std::to_string(index) + ": " + error);
+				if (array && !parser.complete) break;
+				if (!array) {
+					parser.skipLine();
+					continue;
+				}
+			}
+
+			if (array) {
+				parser.skipSpace();
+				if (parser.accept(',')) continue;
+				if (parser.pos < body.length() && body[parser.pos] == ']') continue;
+				errors.push_back("reading " + std::to_string(index) + ": expected ',' or ']' at position " + std::to_string(parser.pos));
+				break;
+			}
+			else {
+				// NDJSON һֻһ
+				parser.skipSpace(false);
+				if (parser.pos < body.length() && body[parser.pos] != '\r' && body[parser.pos] != '\n') {
+					errors.push_back("reading " + std::to_string(index) + ": ignored data after object at position " + std::to_string(parser.pos));
+					parser.skipLine();
+				}
+			}
+		}
+		return parsed;
+	}
+
+}  // namespace ems
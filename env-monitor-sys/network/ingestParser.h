@@ -0,0 +1,74 @@
+/**
+ * @file ingestParser.h
+ * @author Yilin Wang (yilin233@foxmail.com)
+ * @brief Single-pass parser for gateway batch uploads, reads newline-delimited or
+ *  array JSON readings straight into a column-major sensor batch.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2024 Yilin Wang
+ *
+ * MIT License
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cmath>
+#include <charconv>
+#include "../esys/sensorRecord.h"
+
+namespace ems {
+
+    /**
+     * @class ingestParser
+     * @brief ϴݵĽ
+     *
+     * Ϊÿһ JSON NDJSONһɶɵ JSON 顣ÿһɼݣ
+     * {"clientIP": "192.168.1.10", "temperature": 23.5, "humidityVal": 40}
+     * "clientIP" "ip""device"ָ豸ΪʮƵ IPv4 ַʡʱʹԼĵַ
+     * ɴ򲻴ɼֵ׺ƥ䣬ֵΪַֻδ֪ļԡ
+     * ֻɨһ壬ɼֱֵд sensorBatch Умļֵӳ䡣
+     */
+    class ingestParser {
+    private:
+        const std::string& text;            ///< 塣
+        size_t pos = 0;                     ///< ǰλá
+        const sensorSchema& schema;         ///< ű
+        std::vector<double> values;         ///< ǰĲɼֵ±Ϊš
+        bool complete = false;              ///< ǰǷȡʱжܷ
+
+        ingestParser(const std::string& body, const sensorSchema& sensors) : text(body), schema(sensors) {}
+
+        void skipSpace(bool newlines = true);
+        bool accept(char c);
+        bool readString(std::string& value);
+        bool readValue(std::string& raw, double& number, bool& is_number, std::string& error);
+        bool readObject(const std::string& default_ip, sensorBatch& batch, std::string& error);
+        void skipLine();
+
+        /**
+         * @brief 豸ַǷΪʮƵ IPv4 ַ 15 ַ
+         *  ַ豸עһ豸ֱʹеֵ
+         */
+        static bool validAddress(const std::string& address);
+
+    public:
+        /**
+         * @brief 岢׷ӵС
+         *
+         * NDJSON ĳһгʱмеĶ﷨ȷЧʱö
+         * ﷨ʱ޷ɿضλһֹͣ
+         *
+         * @param body 塣
+         * @param default_ip ûָ豸ʱʹõ IP ַ
+         * @param max_rows еﵽֵʱֹͣʣ岻ٶȡ
+         * @param batch Σ sensorBatch::reset ʼ
+         * @param errors ĴϢÿ "reading 3: expected ':'"
+         * @return size_t ɹĲɼ
+         */
+        static size_t parse(const std::string& body, const std::string& default_ip, size_t max_rows, sensorBatch& batch, std::vector<std::string>& errors);
+    };
+
+}  // namespace ems
@@ -0,0 +1,225 @@
+#include "iocpServer.h"
+
+namespace ems {
+
+    iocpServer::iocpServer(std::shared_mutex& mtx, bool log_operations, unsigned int thread_count)
+        : thread_count(thread_count), running(false), mtx(mtx), log_operations(log_operations) {
+        if (this->thread_count == 0) this->thread_count = std::max(1u, std::thread::hardware_concurrency());
+        completionPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, this->thread_count);
+        if (completionPort == nullptr) {
+            std::unique_lock lock(mtx);
+            std::cerr << "[iocpServer]: Failed to create completion port: " << GetLastError() << std::endl;
+        }
+    }
+
+    iocpServer::~iocpServer() {
+        running = false;
+        if (resumer.joinable()) resumer.join();
+        for (connection* conn : paused) {
+            clientSession::setThrottled(false);
+            closeConnection(conn);
+        }
+        paused.clear();
+        // յ֪ͨʾ߳Ӧ˳
+        for (size_t i = 0; i < threads.size(); ++i) {
+            PostQueuedCompletionStatus(completionPort, 0, 0, nullptr);
+        }
+        for (auto& th : threads) {
+            if (th.joinable()) {
+                th.join();
+            }
+        }
+        if (completionPort != nullptr) CloseHandle(completionPort);
+    }
+
+    bool iocpServer::postReceive(connection* conn) {
+        ZeroMemory(&conn->overlapped, sizeof(conn->overlapped));
+        DWORD flags = 0;
+        if (WSARecv(conn->socket, &conn->wsabuf, 1, nullptr, &flags, &conn->overlapped, nullptr) == SOCKET_ERROR) {
+            int error = WSAGetLastError();
+            if (error != WSA_IO_PENDING) {
+                std::unique_lock lock(mtx);
+                std::cerr << "[iocpServer]:[" + conn->session.ip() + "] Receive failed: " << error << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void iocpServer::closeConnection(connection* conn) {
+        connectionTracker::getInstance().release(conn->tracked);
+        closesocket(conn->socket);
+        if (!conn->session.ip().empty()) {
+            deviceRegistry::getInstance().disconnected(conn->session.ip());
+        }
+        delete conn;
+    }
+
+    void iocpServer::workerLoop() {
+        OVERLAPPED_ENTRY entries[completion_batch];
+        while (true) {
+            ULONG removed = 0;
+            if (!GetQueuedCompletionStatusEx(completionPort, entries, static_cast<ULONG>(completion_batch), &removed, INFINITE, FALSE)) {
+                std::unique_lock lock(mtx);
+                std::cerr << "[iocpServer]: Failed to dequeue completions: " << GetLastError() << std::endl;
+                return;
+            }
+            // ˳֪֪֮ͨͨҪ꣬ЩӼȲᱻرҲյ
+            ULONG exits = 0;
+            for (ULONG i = 0; i < removed; ++i) {
+                if (entries[i].lpOverlapped == nullptr) {
+                    ++exits;
+                    continue;
+                }
+                connection* conn = CONTAINING_RECORD(entries[i].lpOverlapped, connection, overlapped);
+                DWORD bytesRead = entries[i].dwNumberOfBytesTransferred;
+
+                // Internal ״̬ 0 ʾճ
+                if (entries[i].lpOverlapped->Internal != 0) {
+                    {
+                        std::unique_lock lock(mtx);
+                        if (conn->tracked->reaped) std::cout << "[iocpServer]:[" + conn->session.ip() + "] Idle connection closed." << std::endl;
+                        else if (conn->tracked->draining) std::cout << "[iocpServer]:[" + conn->session.ip() + "] Connection closed for shutdown." << std::endl;
+                        else std::cerr << "[iocpServer]:[" + conn->session.ip() + "] Receive failed: " << entries[i].lpOverlapped->Internal << std::endl;
+                    }
+                    closeConnection(conn);
+                    continue;
+                }
+                if (bytesRead == 0) {
+                    {
+                        std::unique_lock lock(mtx);
+                        std::cout << "[iocpServer]:[" + conn->session.ip() + "] Client disconnected." << std::endl;
+                    }
+                    closeConnection(conn);
+                    continue;
+                }
+
+                conn->tracked->touch();
+                bool keep = conn->session.onData(conn->buffer, static_cast<int>(bytesRead), conn->reply);
+                // ظֱ̣ܶͬд׽ַͻپɶ˿
+                if (!conn->reply.empty()) send(conn->socket, conn->reply.data(), static_cast<int>(conn->reply.size()), 0);
+                if (!keep) {
+                    closeConnection(conn);
+                    continue;
+                }
+                if (conn->session.shouldThrottle()) {
+                    // drain ֹͣ resumer ͣ
+                    std::lock_guard<std::mutex> lock(paused_mtx);
+                    if (running) {
+                        clientSession::setThrottled(true);
+                        paused.push_back(conn);
+                        continue;
+                    }
+                }
+                if (!postReceive(conn)) closeConnection(conn);
+            }
+            if (exits > 0) {
+                // ÿ̸߳һ˳֪ͨһȡʱѶķŻȥ
+                for (ULONG i = 1; i < exits; ++i) {
+                    PostQueuedCompletionStatus(completionPort, 0, 0, nullptr);
+                }
+                return;
+            }
+        }
+    }
+
+    void iocpServer::resumeLoop() {
+        dbWriter& writer = dbWriter::getInstance();
+        std::vector<connection*> resumed;
+        while (running) {
+            if (!writer.waitUncongested(200)) {
+                // ͣеӲУӵгʱӻᱻ뿪ӹر
+                std::lock_guard<std::mutex> lock(paused_mtx);
+                for (connection* conn : paused) conn->tracked->touch();
+                continue;
+            }
+            {
+                std::lock_guard<std::mutex> lock(paused_mtx);
+                resumed.swap(paused);
+            }
+            if (resumed.empty()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                continue;
+            }
+            for (connection* conn : resumed) {
+                clientSession::setThrottled(false);
+                if (!postReceive(conn)) closeConnection(conn);
+            }
+            resumed.clear();
+        }
+    }
+
+    void iocpServer::drain(std::chrono::steady_clock::time_point deadline) {
+        // ȡӵĽգ߳յ֪ͨر
+        connectionTracker& tracker = connectionTracker::getInstance();
+        size_t closed = tracker.closeAll();
+        // ͣûδɵĽգֱӹر
+        {
+            std::lock_guard<std::mutex> lock(paused_mtx);
+            running = false;
+        }
+        if (resumer.joinable()) resumer.join();
+        {
+            std::lock_guard<std::mutex> lock(paused_mtx);
+            for (connection* conn : paused) {
+                clientSession::setThrottled(false);
+                closeConnection(conn);
+            }
+            paused.clear();
+        }
+        bool finished = tracker.waitReleased(deadline);
+        std::unique_lock lock(mtx);
+        std::cout << "[iocpServer]: Closed " << closed << " connection(s) for shutdown"
+            << (finished ? "." : ", some did not finish before the deadline.") << std::endl;
+    }
+
+    int iocpServer::run(SOCKET listenSocket, textHandler handleFunction, batchHandler handleBatch, const std::atomic<bool>& stopping) {
+        if (completionPort == nullptr) return 1;
+        running = true;
+        for (unsigned int i = 0; i < thread_count; ++i) {
+            threads.emplace_back(&iocpServer::workerLoop, this);
+        }
+        resumer = std::thread(&iocpServer::resumeLoop, this);
+
+        {
+            std::unique_lock lock(mtx);
+            std::cout << "[iocpServer]: Serving connections with " << thread_count << " completion thread(s).\n";
+        }
+
+        while (!stopping) {
+            SOCKET clientSocket = accept(listenSocket, nullptr, nullptr);
+            if (clientSocket == INVALID_SOCKET) {
+                if (stopping) break;
+                std::unique_lock lock(mtx);
+                std::cerr << "[iocpServer]: Accept failed: " << WSAGetLastError() << std::endl;
+                continue;
+            }
+
+            std::string clientIP = tcpConnector::peerAddress(clientSocket);
+            std::shared_ptr<trackedConnection> tracked = connectionTracker::getInstance().admit(clientSocket, clientIP);
+            if (!tracked) {
+                closesocket(clientSocket);
+                continue;
+            }
+            tcpConnector::configureClient(clientSocket);
+            if (!clientIP.empty()) deviceRegistry::getInstance().connected(clientIP);
+            {
+                std::unique_lock lock(mtx);
+                std::cout << "[iocpServer]: Connection accepted!\n";
+            }
+
+            connection* conn = new connection(tracked, clientSession(mtx, log_operations, clientIP, handleFunction, handleBatch));
+            if (CreateIoCompletionPort(reinterpret_cast<HANDLE>(clientSocket), completionPort, 0, 0) == nullptr) {
+                {
+                    std::unique_lock lock(mtx);
+                    std::cerr << "[iocpServer]: Failed to associate socket: " << GetLastError() << std::endl;
+                }
+                closeConnection(conn);
+                continue;
+            }
+            if (!postReceive(conn)) closeConnection(conn);
+        }
+        return 0;
+    }
+
+}  // namespace ems
@@ -0,0 +1,131 @@
+/**
+ * @file iocpServer.h
+ * @author Yilin Wang (yilin233@foxmail.com)
+ * @brief I/O completion port backend for the TCP server, a small pool of worker
+ *  threads serves every connection through overlapped receives.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2024 Yilin Wang
+ *
+ * MIT License
+ */
+
+#pragma once
+
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <shared_mutex>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include "tcpConnector.h"
+#pragma comment(lib, "ws2_32.lib")
+
+namespace ems {
+
+    /**
+     * @class iocpServer
+     * @brief ɶ˿ڵ TCP ˡ
+     *
+     * ÿʼֻһδɵص WSARecvݵһ߳ȡ֪ͨ
+     * ӵ clientSession ͻظͶһνա߳ÿε
+     * GetQueuedCompletionStatusEx ȡ֪ͨʱ߳䡣
+     * дӵʱҪͣӲͶݽգ resumer ߳ӵָ
+     */
+    class iocpServer {
+    public:
+        /**
+         * @brief 캯ɶ˿ڡ
+         *
+         * @param mtx ͬ־
+         * @param log_operations Ƿ¼־
+         * @param thread_count ߳0 ʾʹ CPU 
+         */
+        iocpServer(std::shared_mutex& mtx, bool log_operations, unsigned int thread_count);
+
+        /**
+         * @brief ֪ͨ߳˳رɶ˿ڡ
+         */
+        ~iocpServer();
+
+        /**
+         * @brief ̣߳ڵǰ߳нӡ
+         *
+         * @param listenSocket ѿʼķ׽֡
+         * @param handleFunction ָ룬ڴյıЭϢ
+         * @param handleBatch ָ룬ڴЭݡ
+         * @param stopping λ׽ֱرʱֹͣӲء
+         * @return int ɹ0ʧܷ1
+         */
+        int run(SOCKET listenSocket, textHandler handleFunction, batchHandler handleBatch, const std::atomic<bool>& stopping);
+
+        /**
+         * @brief ֹͣӺжӣȴɹ̴߳յݲرա
+         *
+         * @param deadline ȴӽĽֹʱ䡣
+         */
+        void drain(std::chrono::steady_clock::time_point deadline);
+
+    private:
+        /**
+         * @brief һӣOVERLAPPED ǵһԱԱ֪ͨһӡ
+         */
+        struct connection {
+            OVERLAPPED overlapped;              ///< ղصṹ
+            SOCKET socket;                      ///< ͻ׽֡
+            WSABUF wsabuf;                      ///< ָ buffer Ľջ
+            char buffer[BUFFER_SIZE];           ///< ջ
+            clientSession session;              ///< Э״̬
+            std::string reply;                  ///< ͻ˵Ļظ
+            std::shared_ptr<trackedConnection> tracked;     ///< connectionTracker еӡ
+
+            connection(const std::shared_ptr<trackedConnection>& tracked, clientSession&& session)
+                : overlapped(), socket(tracked->socket), session(std::move(session)), tracked(tracked) {
+                wsabuf.buf = buffer;
+                wsabuf.len = BUFFER_SIZE;
+            }
+        };
+
+        static constexpr size_t completion_batch = 64;  ///< ÿȡ֪ͨ
+
+        HANDLE completionPort;                  ///< ɶ˿ڡ
+        unsigned int thread_count;              ///< ߳
+        std::vector<std::thread> threads;       ///< ̡߳
+        std::thread resumer;                    ///< ӵָͣӵ̡߳
+        std::atomic<bool> running;              ///< ǷС
+        std::mutex paused_mtx;                  ///<  paused
+        std::vector<connection*> paused;        ///< дӵͣȡӣûδɵĽղ
+        std::shared_mutex& mtx;                 ///< ͬ־
+        bool log_operations;                    ///< Ƿ¼־
+
+        /**
+         * @brief ΪͶһصա
+         *
+         * @param conn ӡ
+         * @return bool Ͷݳɹ true
+         */
+        bool postReceive(connection* conn);
+
+        /**
+         * @brief رӲͷԴ
+         *
+         * @param conn ӡ
+         */
+        void closeConnection(connection* conn);
+
+        /**
+         * @brief ߳ѭ
+         */
+        void workerLoop();
+
+        /**
+         * @brief ȴдӵΪͣͶݽա
+         */
+        void resumeLoop();
+    };
+
+}  // namespace ems
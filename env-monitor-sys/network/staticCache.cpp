@@ -0,0 +1,238 @@
+#include "staticCache.h"
+
+namespace ems {
+
+	namespace fs = std::filesystem;
+
+	staticCache::~staticCache()
+	{
+		stop();
+	}
+
+	bool staticCache::start(const std::string& dir, unsigned int reload_interval)
+	{
+		root = fs::path(dir);
+		reload_seconds = reload_interval;
+		bool loaded = reload();
+		if (reload_seconds > 0) {
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				if (running) return loaded;
+				running = true;
+			}
+			watcher = std::thread(&staticCache::watchLoop, this);
+		}
+		return loaded;
+	}
+
+	void staticCache::stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			if (!running) return;
+			running = false;
+		}
+		cv.notify_all();
+		if (watcher.joinable()) watcher.join();
+	}
+
+	uint64_t staticCache::scanSignature() const
+	{
+		uint64_t signature = 1469598103934665603ULL;
+		auto mix = [&signature](uint64_t value) {
+			signature ^= value;
+			signature *= 1099511628211ULL;
+		};
+		std::error_code ec;
+		for (fs::recursive_directory_iterator it(root, ec), end; !ec && it != end; it.increment(ec)) {
+			if (!it->is_regular_file(ec)) continue;
+			mix(std::hash<std::string>()(it->path().generic_string()));
+			mix(static_cast<uint64_t>(it->file_size(ec)));
+			mix(static_cast<uint64_t>(it->last_write_time(ec).time_since_epoch().count()));
+		}
+		return signature;
+	}
+
+	bool staticCache::reload()
+	{
+		std::error_code ec;
+		if (!fs::is_directory(root, ec)) {
+			std::cerr << "[staticCache]: Error: Mount directory \"" << root.string() << "\" does not exist." << std::endl;
+			return false;
+		}
+
+		auto readFile = [](const fs::path& path, std::string& data) -> bool {
+			std::ifstream file(path, std::ios::binary);
+			if (!file.is_open()) return false;
+			data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+			return true;
+		};
+
+		auto next = std::make_shared<assetTable>();
+		next->signature = scanSignature();
+		size_t bytes = 0, variants = 0;
+		for (fs::recursive_directory_iterator it(root, ec), end; !ec && it != end; it.increment(ec)) {
+			if (!it->is_regular_file(ec)) continue;
+			const fs::path& path = it->path();
+			std::string extension = path.extension().string();
+			// ԤѹĸΪԭļı汾ṩ
+			if ((extension == ".gz" || extension == ".br") && fs::exists(fs::path(path).replace_extension(), ec)) continue;
+
+			auto asset = std::make_shared<staticAsset>();
+			if (!readFile(path, asset->identity)) {
+				std::cerr << "[staticCache]: Error: Unable to read \"" << path.string() << "\"." << std::endl;
+				continue;
+			}
+			std::string key = "/" + path.lexically_relative(root).generic_string();
+			asset->content_type = httplib::detail::find_content_type(key, {}, "application/octet-stream");
+			asset->etag = hashContent(asset->identity);
+
+			// ɵļݹϣ index-CFxQ4YeQ.jsݱ仯ʱļҲ仯û
+			std::string stem = path.stem().string();
+			size_t dash = stem.rfind('-');
+			bool hashed = dash != std::string::npos && stem.length() - dash - 1 >= 8 &&
+				std::all_of(stem.begin() + dash + 1, stem.end(), [](char c) { return std::isalnum(static_cast<unsigned char>(c)) || c == '_'; });
+			asset->cache_control = hashed ? "public, max-age=31536000, immutable" : "no-cache";
+
+			if (httplib::detail::can_compress_content_type(asset->content_type) && asset->identity.size() >= 1024) {
+				readFile(fs::path(path.string() + ".gz"), asset->gzip);
+				readFile(fs::path(path.string() + ".br"), asset->brotli);
+				auto compress = [&asset](httplib::detail::compressor& compressor, std::string& out) {
+					compressor.compress(asset->identity.data(), asset->identity.size(), true, [&out](const char* data, size_t length) {
+						out.append(data, length);
+						return true;
+						});
+				};
+#ifdef CPPHTTPLIB_ZLIB_SUPPORT
+				if (asset->gzip.empty()) {
+					httplib::detail::gzip_compressor gzip;
+					compress(gzip, asset->gzip);
+				}
+#endif
+#ifdef CPPHTTPLIB_BROTLI_SUPPORT
+				if (asset->brotli.empty()) {
+					httplib::detail::brotli_compressor brotli;
+					compress(brotli, asset->brotli);
+				}
+#endif
+				(void)compress;
+				// ѹûбСİ汾ṩ
+				if (asset->gzip.size() >= asset->identity.size()) asset->gzip.clear();
+				if (asset->brotli.size() >= asset->identity.size()) asset->brotli.clear();
+				variants += !asset->gzip.empty() + !asset->brotli.empty();
+			}
+			bytes += asset->identity.size() + asset->gzip.size() + asset->brotli.size();
+			next->files[key] = std::move(asset);
+		}
+
+		size_t files = next->files.size();
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			table = std::move(next);
+		}
+		std::cout << "[staticCache]: Loaded " << files << " files (" << bytes << " bytes, " << variants
+			<< " compressed variants) from \"" << root.string() << "\"." << std::endl;
+		return true;
+	}
+
+	void staticCache::watchLoop()
+	{
+		std::unique_lock<std::mutex> lock(mtx);
+		while (running) {
+			cv.wait_for(lock, std::chrono::seconds(reload_seconds), [this] { return !running; });
+			if (!running) break;
+			uint64_t loaded = table ? table->signature : 0;
+			lock.unlock();
+			// дļڼǩ仯ȵμһ¼
+			if (scanSignature() != loaded) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(200));
+				uint64_t first = scanSignature();
+				std::this_thread::sleep_for(std::chrono::milliseconds(200));
+				if (scanSignature() == first) reload();
+			}
+			lock.lock();
+		}
+	}
+
+	std::string staticCache::hashContent(const std::string& data)
+	{
+		uint64_t hash = 1469598103934665603ULL;
+		for (unsigned char c : data) {
+			hash ^= c;
+			hash *= 1099511628211ULL;
+		}
+		char buffer[17];
+		std::snprintf(buffer, sizeof(buffer), "%016llx", static_cast<unsigned long long>(hash));
+		return buffer;
+	}
+
+	bool staticCache::acceptsEncoding(const std::string& accept, const std::string& coding)
+	{
+		size_t begin = 0;
+		while (begin < accept.length()) {
+			size_t end = accept.find(',', begin);
+			if (end == std::string::npos) end = accept.length();
+			std::string item = accept.substr(begin, end - begin);
+			begin = end + 1;
+
+			size_t semicolon = item.find(';');
+			std::string name = item.substr(0, semicolon);
+			name.erase(0, name.find_first_not_of(" \t"));
+			name.erase(name.find_last_not_of(" \t") + 1);
+			if (name != coding && name != "*") continue;
+			if (semicolon == std::string::npos) return true;
+			size_t q = item.find("q=", semicolon);
+			return q == std::string::npos || std::strtod(item.c_str() + q + 2, nullptr) > 0;
+		}
+		return false;
+	}
+
+	bool staticCache::serve(const httplib::Request& req, httplib::Response& res) const
+	{
+		std::shared_ptr<const assetTable> current;
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			current = table;
+		}
+		if (!current) return false;
+
+		std::string key = req.path.empty() ? "/" : req.path;
+		if (key.back() == '/') key += "index.html";
+		auto it = current->files.find(key);
+		if (it == current->files.end()) return false;
+		std::shared_ptr<const staticAsset> asset = it->second;
+
+		//  Accept-Encoding ѡ汾 brotli
+		const std::string accept = req.get_header_value("Accept-Encoding");
+		const std::string* body = &asset->identity;
+		std::string etag = "\"" + asset->etag + "\"";
+		if (!asset->brotli.empty() && acceptsEncoding(accept, "br")) {
+			body = &asset->brotli;
+			etag = "\"" + asset->etag + "-br\"";
+			res.set_header("Content-Encoding", "br");
+		}
+		else if (!asset->gzip.empty() && acceptsEncoding(accept, "gzip")) {
+			body = &asset->gzip;
+			etag = "\"" + asset->etag + "-gz\"";
+			res.set_header("Content-Encoding", "gzip");
+		}
+		res.set_header("ETag", etag);
+		res.set_header("Cache-Control", asset->cache_control);
+		if (!asset->gzip.empty() || !asset->brotli.empty()) res.set_header("Vary", "Accept-Encoding");
+
+		const std::string match = req.get_header_value("If-None-Match");
+		if (!match.empty() && (match == "*" || match.find(etag) != std::string::npos)) {
+			res.status = httplib::StatusCode::NotModified_304;
+			res.headers.erase("Content-Encoding");
+			return true;
+		}
+
+		// ɻеļֱдasset Ӧ֮ǰЧʹڼ¼Ŀ¼
+		res.set_content_provider(body->size(), asset->content_type,
+			[asset, body](size_t offset, size_t length, httplib::DataSink& sink) {
+				return sink.write(body->data() + offset, length);
+			});
+		return true;
+	}
+
+}  // namespace ems
@@ -0,0 +1,145 @@
+/**
+ * @file staticCache.h
+ * @author Yilin Wang (yilin233@foxmail.com)
+ * @brief In-memory cache of the dashboard bundle, serves precompressed variants
+ *  with strong ETags and reloads when the mount directory changes.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2024 Yilin Wang
+ *
+ * MIT License
+ */
+
+#pragma once
+
+#include <string>
+#include <memory>
+#include <fstream>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <filesystem>
+#include "httplib.h"
+
+namespace ems {
+
+    /**
+     * @struct staticAsset
+     * @brief һ̬ļԤѹİ汾
+     */
+    struct staticAsset {
+        std::string content_type;   ///< Content-Type
+        std::string cache_control;  ///< Cache-ControlļϣԴΪ immutableΪ no-cache
+        std::string etag;           ///< ԭʼݼǿ ETagţ汾Ӻ׺
+        std::string identity;       ///< ԭʼݡ
+        std::string gzip;           ///< gzip 汾ΪձʾûС
+        std::string brotli;         ///< brotli 汾ΪձʾûС
+    };
+
+    /**
+     * @class staticCache
+     * @brief ̬ļ档
+     *
+     * ʱ hs_mount_dir µļڴ棬׼ gzip  brotli 汾
+     * Ŀ¼е "ļ.gz""ļ.br"webapp ʱ vite.config.ts ɣֱʹãڱʱ CPPHTTPLIB_ZLIB_SUPPORT
+     * CPPHTTPLIB_BROTLI_SUPPORT ڼʱѹһΡʱ Accept-Encoding ѡ汾
+     * ̡ѹ̶̨߳ڼĿ¼ļĴС޸ʱ䣬б仯ʱ¼أ
+     * ǰʹþɵļ
+     */
+    class staticCache {
+    private:
+        /**
+         * @brief һμصõļغֻɱͬʱʹá
+         */
+        struct assetTable {
+            std::unordered_map<std::string, std::shared_ptr<const staticAsset>> files;  ///< key Ϊ "/" ͷ·
+            uint64_t signature = 0;     ///< ʱĿ¼ǩ
+        };
+
+        std::filesystem::path root;                     ///< ̬ļĿ¼
+        unsigned int reload_seconds = 0;                ///< Ŀ¼仯ļ룩0 ʾ顣
+        std::shared_ptr<const assetTable> table;        ///< ǰļ
+        mutable std::mutex mtx;                         ///<  table ָ״̬Ļ
+        std::condition_variable cv;                     ///< Ѽ̡߳
+        std::thread watcher;                            ///< Ŀ¼仯̡߳
+        bool running = false;                           ///< ߳ǷС
+
+        /**
+         * @brief Ŀ¼ǩļ·С޸ʱõ
+         *
+         * @return uint64_t ǩ
+         */
+        uint64_t scanSignature() const;
+
+        /**
+         * @brief Ŀ¼ļɹ滻ǰļ
+         *
+         * @return bool ɹ true
+         */
+        bool reload();
+
+        /**
+         * @brief ߳ѭ
+         */
+        void watchLoop();
+
+        /**
+         * @brief ݵ 64 λ FNV-1a ϣʮַء
+         *
+         * @param data ݡ
+         * @return std::string ʮƹϣ
+         */
+        static std::string hashContent(const std::string& data);
+
+        /**
+         * @brief ж Accept-Encoding Ƿĳֱ루q=0 Ϊܣ
+         *
+         * @param accept Accept-Encoding ֵ
+         * @param coding  "gzip"
+         * @return bool ܷ true
+         */
+        static bool acceptsEncoding(const std::string& accept, const std::string& coding);
+
+    public:
+        staticCache() = default;
+
+        /**
+         * @brief ֹ̡ͣ߳
+         */
+        ~staticCache();
+
+        staticCache(const staticCache&) = delete;
+        staticCache& operator=(const staticCache&) = delete;
+
+        /**
+         * @brief Ŀ¼ reload_interval  0 ʱ̡߳
+         *
+         * @param dir ̬ļĿ¼
+         * @param reload_interval Ŀ¼仯ļ룩0 ʾ顣
+         * @return bool ״μسɹ true
+         */
+        bool start(const std::string& dir, unsigned int reload_interval);
+
+        /**
+         * @brief ֹ̡ͣ߳
+         */
+        void stop();
+
+        /**
+         * @brief Ӧһ̬ļ
+         *
+         * · "/" βʱµ index.htmlIf-None-Match ѡ汾 ETag ͬʱ 304
+         *
+         * @param req HTTP 
+         * @param res HTTP Ӧ
+         * @return bool ļڷ true򷵻 falseɵ÷Ӧ
+         */
+        bool serve(const httplib::Request& req, httplib::Response& res) const;
+    };
+
+}  // namespace ems
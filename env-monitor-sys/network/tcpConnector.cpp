@@ -1,17 +1,15 @@
 #include "tcpConnector.h"
+#include "iocpServer.h"
 
 namespace ems {
 
-    tcpConnector::tcpConnector(std::shared_mutex& mtx) : serverSocket(INVALID_SOCKET), mtx(mtx) {
+    tcpConnector::tcpConnector(std::shared_mutex& mtx) : serverSocket(INVALID_SOCKET), stopping(false), mtx(mtx) {
         esysControl& esys = esysControl::getInstance();
-        dbTools& db = dbTools::getInstance();
         port = static_cast<unsigned short>(std::stoi(esys.getConfig("tcp_server_port")));
         log_operations = esys.getConfig("log_operations") == "false" ? false : true;
-        {
-            std::unique_lock lock(mtx);
-            db.dbDistinctSelect("envtable", "clientIP", all_client_ip);
-            std::cout << "[tcpConnector]: Get all exist client ip." << std::endl;
-        }
+        backend = esys.getConfig("tcp_backend") == "iocp" ? "iocp" : "threads";
+        std::string threads_value = esys.getConfig("tcp_iocp_threads");
+        iocp_threads = threads_value.empty() ? 0 : static_cast<unsigned int>(std::max(0, std::stoi(threads_value)));
     }
 
     tcpConnector::~tcpConnector() {
@@ -61,7 +59,7 @@ namespace ems {
         return true;
     }
 
-    void tcpConnector::acceptConnections(std::string(*handleFunction)(const std::string&, const std::string&)) {
+    void tcpConnector::acceptConnections(textHandler handleFunction, batchHandler handleBatch) {
         struct sockaddr_in clientAddr;
         int clientAddrSize = sizeof(clientAddr);
         SOCKET clientSocket;
@@ -72,68 +70,221 @@ namespace ems {
         }
         
 
-        while (true) {
+        while (!stopping) {
             clientSocket = accept(serverSocket, (struct sockaddr*)&clientAddr, &clientAddrSize);
             if (clientSocket == INVALID_SOCKET) {
+                // ׽ѱ stop ر
+                if (stopping) break;
                 std::unique_lock lock(mtx);
                 std::cerr << "[tcpConnector]: Accept failed: " << WSAGetLastError() << std::endl;
                 continue;
             }
 
+            // ޵ر
+            std::shared_ptr<trackedConnection> tracked = connectionTracker::getInstance().admit(clientSocket, peerAddress(clientSocket));
+            if (!tracked) {
+                closesocket(clientSocket);
+                continue;
+            }
+            configureClient(clientSocket);
             {
                 std::unique_lock lock(mtx);
                 std::cout << "[tcpConnector]: Connection accepted!\n";
             }
 
-            threads.push_back(std::thread(handleClient, std::ref(mtx), log_operations, std::ref(all_client_ip),  clientSocket, handleFunction));
+            reapThreads();
+            auto done = std::make_shared<std::atomic<bool>>(false);
+            threads.push_back({ std::thread(handleClient, std::ref(mtx), log_operations, tracked, handleFunction, handleBatch, done), done });
         }
     }
 
-    void tcpConnector::handleClient(std::shared_mutex& mtx, bool log_operations, std::vector<std::string>& all_client_ip, SOCKET clientSocket, std::string(*handleFunction)(const std::string&, const std::string&)) {
-        char buffer[BUFFER_SIZE] = { 0 };
+    clientSession::clientSession(std::shared_mutex& mtx, bool log_operations, const std::string& clientIP, textHandler handleFunction, batchHandler handleBatch)
+        : mtx(mtx), log_operations(log_operations), clientIP(clientIP), handleFunction(handleFunction), handleBatch(handleBatch),
+        arena(std::make_unique<messageArena>()), capture(clientIP), window_start(std::chrono::steady_clock::now()) {
+        std::string rate = esysControl::getInstance().getConfig("tcp_throttle_rate");
+        throttle_rate = rate.empty() ? 2 : static_cast<unsigned int>(std::max(0, std::stoi(rate)));
+    }
+
+    std::atomic<uint64_t> clientSession::throttled_connections{ 0 };
+    std::atomic<uint64_t> clientSession::throttle_events{ 0 };
+
+    void clientSession::countReadings(size_t readings) {
+        auto now = std::chrono::steady_clock::now();
+        if (now - window_start >= std::chrono::seconds(1)) {
+            // ûʱһڵļΪ 0
+            last_window_readings = now - window_start >= std::chrono::seconds(2) ? 0 : window_readings;
+            window_readings = 0;
+            window_start = now;
+        }
+        window_readings += readings;
+    }
+
+    bool clientSession::shouldThrottle() const {
+        if (!dbWriter::getInstance().congested()) return false;
+        return std::max(window_readings, last_window_readings) > throttle_rate;
+    }
+
+    void clientSession::setThrottled(bool paused) {
+        if (paused) {
+            throttled_connections++;
+            throttle_events++;
+        }
+        else {
+            throttled_connections--;
+        }
+    }
+
+    bool clientSession::onData(const char* data, int length, std::string& reply) {
+        reply.clear();
+        if (length <= 0) return true;
+        capture.record(data, static_cast<size_t>(length));
+        if (mode == protocol::UNKNOWN) {
+            mode = binaryProtocol::detect(data, length) ? protocol::BINARY : protocol::TEXT;
+            std::unique_lock lock(mtx);
+            if (log_operations) std::cout << "[tcpConnector]: [" + clientIP + "] Using " << (mode == protocol::BINARY ? "binary" : "text") << " protocol." << std::endl;
+        }
+        if (mode == protocol::BINARY) {
+            // 뻺֡봦ˮߣÿ֡ظ 1 ֽ
+            pending.append(data, length);
+            batch.reset(sensorSchema::getInstance().size(), 16);
+            sequences.clear();
+            std::string error;
+            size_t consumed = binaryProtocol::decode(pending.data(), pending.size(), clientIP, batch, sequences, error);
+            pending.erase(0, consumed);
+            if (batch.rows > 0) {
+                countReadings(batch.rows);
+                handleBatch(batch, alarm_mask);
+                for (size_t row = 0; row < batch.rows; ++row) {
+                    reply += static_cast<char>(alarm_mask[row >> 6] >> (row & 63) & 1 ? binaryProtocol::binaryAlarm : binaryProtocol::binaryAck);
+                    // Ų˵豸ʧط
+                    if (log_operations && has_sequence && sequences[row] != last_sequence + 1) {
+                        std::unique_lock lock(mtx);
+                        std::cout << "[tcpConnector]: [" + clientIP + "] Sequence jumped from " << last_sequence << " to " << sequences[row] << "." << std::endl;
+                    }
+                    last_sequence = sequences[row];
+                    has_sequence = true;
+                }
+            }
+            if (!error.empty()) {
+                reply += static_cast<char>(binaryProtocol::binaryError);
+                std::unique_lock lock(mtx);
+                std::cerr << "[tcpConnector]: [" + clientIP + "] Invalid binary frame: " + error + ", closing connection." << std::endl;
+                return false;
+            }
+            return true;
+        }
+
+        // 豸ͶϢһ recv յÿ JSON ֱظϲΪһη
+        pending.append(data, length);
+        size_t begin = 0;
+        while ((begin = pending.find_first_not_of(" \t\r\n", begin)) != std::string::npos) {
+            size_t end = messageEnd(pending, begin);
+            if (end == std::string::npos) {
+                // Ķ´ recvʱԭ⻺
+                if (pending.size() - begin <= max_text_pending) break;
+                end = pending.size();
+            }
+
+            // תϢͽļֵԶ arena 
+            {
+                std::pmr::string message(arena->resource());
+                tcpConnector::escapeMessage(pending.data() + begin, end - begin, message);
+                begin = end;
+                if (log_operations) {
+                    std::unique_lock lock(mtx);
+                    std::cout << "[tcpConnector]: [" << clientIP << "] Received message: \"" << message << "\"" << std::endl;
+                }
+
+                // ûԶĴ
+                countReadings(1);
+                reply += handleFunction(clientIP, message, *arena);
+            }
+        }
+        pending.erase(0, std::min(begin, pending.size()));
+        // յϢѴ꣬һͷ arena еڴ
+        arena->reset();
+        return true;
+    }
+
+    size_t clientSession::messageEnd(const std::string& buffer, size_t begin) {
+        //  '{' ͷ޷ָԭһΪһϢ
+        if (buffer[begin] != '{') return buffer.size();
+
+        int depth = 0;
+        bool in_string = false;
+        for (size_t pos = begin; pos < buffer.size(); ++pos) {
+            char c = buffer[pos];
+            if (in_string) {
+                if (c == '\\') ++pos;
+                else if (c == '"') in_string = false;
+            }
+            else if (c == '"') in_string = true;
+            else if (c == '{') ++depth;
+            else if (c == '}' && --depth == 0) return pos + 1;
+        }
+        return std::string::npos;
+    }
+
+    std::string tcpConnector::peerAddress(SOCKET clientSocket) {
         sockaddr_in clientInfo;
         int clientInfoSize = sizeof(clientInfo);
         getpeername(clientSocket, (struct sockaddr*)&clientInfo, &clientInfoSize);
 
         char ipStr[INET_ADDRSTRLEN];  // INET_ADDRSTRLEN IPv4ĵַȳ
-        std::string clientIP;
         if (inet_ntop(AF_INET, &(clientInfo.sin_addr), ipStr, INET_ADDRSTRLEN) != nullptr) {
-            clientIP = ipStr;
-            all_client_ip.push_back(clientIP);
+            return ipStr;
+        }
+        return "";
+    }
+
+    void tcpConnector::configureClient(SOCKET clientSocket) {
+        BOOL no_delay = TRUE;
+        setsockopt(clientSocket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&no_delay), sizeof(no_delay));
+    }
+
+    void tcpConnector::reapThreads() {
+        // ѽ߳ڽʱգֻ߳뵱ǰй
+        auto finished = std::remove_if(threads.begin(), threads.end(), [](clientThread& client) {
+            if (!client.done->load()) return false;
+            if (client.thread.joinable()) client.thread.join();
+            return true;
+            });
+        threads.erase(finished, threads.end());
+    }
+
+    void tcpConnector::handleClient(std::shared_mutex& mtx, bool log_operations, std::shared_ptr<trackedConnection> tracked, textHandler handleFunction, batchHandler handleBatch,
+        std::shared_ptr<std::atomic<bool>> done) {
+        char buffer[BUFFER_SIZE] = { 0 };
+        SOCKET clientSocket = tracked->socket;
+        std::string clientIP = tracked->clientIP;
+        if (!clientIP.empty()) {
+            deviceRegistry::getInstance().connected(clientIP);
         }
         else {
             std::unique_lock lock(mtx);
             std::cerr << "[tcpConnector]:Error converting IP address to string format." << std::endl;
         }
 
+        clientSession session(mtx, log_operations, clientIP, handleFunction, handleBatch);
+        std::string reply;
         while (true) {
             int bytesRead = recv(clientSocket, buffer, BUFFER_SIZE, 0);
             if (bytesRead > 0) {
-                // յϢͿͻ˵ IP ַϳһַ
-                std::string message = std::string(buffer, bytesRead);
-                // תmessageַ
-                std::ostringstream oss;
-                for (char c : message) {
-                    switch (c) {
-                    case '\n': oss << "\\n"; break;
-                    case '\r': oss << "\\r"; break;
-                    case '\t': oss << "\\t"; break;
-                    case '\\': oss << "\\\\"; break;
-                    case '\"': oss << "\\\""; break;
-                    default: oss << c; break;
+                tracked->touch();
+                bool keep = session.onData(buffer, bytesRead, reply);
+                // Ӧͻ
+                if (!reply.empty()) send(clientSocket, reply.data(), static_cast<int>(reply.size()), 0);
+                if (!keep) break;
+
+                // дӵʱͣȡӣֱѹˮλر
+                if (session.shouldThrottle()) {
+                    clientSession::setThrottled(true);
+                    while (!dbWriter::getInstance().waitUncongested(1000) && !tracked->draining) {
+                        // ͣȡУӵгʱӻᱻ뿪ӹر
+                        tracked->touch();
                     }
+                    clientSession::setThrottled(false);
                 }
-                message = oss.str();
-                {
-                    std::unique_lock lock(mtx);
-                    if(log_operations)  std::cout << "[tcpConnector]: ["+ clientIP +"] Received message: \"" + message + "\"" << std::endl;
-                }
-
-                // ûԶĴ
-                std::string response = handleFunction(clientIP, message);
-
-                // Ӧͻ
-                send(clientSocket, response.c_str(), static_cast<int>(response.length()), 0);
             }
             else if (bytesRead == 0) {
                 std::unique_lock lock(mtx);
@@ -142,32 +293,93 @@ namespace ems {
             }
             else {
                 std::unique_lock lock(mtx);
-                std::cerr << "[tcpConnector]:[" + clientIP + "] Receive failed: " << WSAGetLastError() << std::endl;
+                if (tracked->reaped) std::cout << "[tcpConnector]:[" + clientIP + "] Idle connection closed." << std::endl;
+                else if (tracked->draining) std::cout << "[tcpConnector]:[" + clientIP + "] Connection closed for shutdown." << std::endl;
+                else std::cerr << "[tcpConnector]:[" + clientIP + "] Receive failed: " << WSAGetLastError() << std::endl;
                 break;  // ִ󣬶Ͽ
             }
         }
+        connectionTracker::getInstance().release(tracked);
+        closesocket(clientSocket);
+        if (!clientIP.empty()) {
+            deviceRegistry::getInstance().disconnected(clientIP);
+        }
+        done->store(true);
+    }
+
+    void tcpConnector::escapeMessage(const char* data, size_t length, std::pmr::string& message) {
+        // תmessageַ
+        message.reserve(message.size() + length + length / 4);
+        for (size_t i = 0; i < length; ++i) {
+            char c = data[i];
+            switch (c) {
+            case '\n': message += "\\n"; break;
+            case '\r': message += "\\r"; break;
+            case '\t': message += "\\t"; break;
+            case '\\': message += "\\\\"; break;
+            case '\"': message += "\\\""; break;
+            default: message += c; break;
+            }
+        }
+    }
+
+    void tcpConnector::drainThreads() {
+        size_t closed = connectionTracker::getInstance().closeAll();
+        connectionTracker::getInstance().waitReleased(drain_deadline);
+        reapThreads();
+        // ֹʱδ̣߳ڵȴݿ⣩ٵȴ˳ʱһ
+        for (auto& client : threads) {
+            if (client.thread.joinable()) client.thread.detach();
+        }
+        std::unique_lock lock(mtx);
+        std::cout << "[tcpConnector]: Closed " << closed << " connection(s) for shutdown";
+        if (!threads.empty()) std::cout << ", " << threads.size() << " did not finish before the deadline";
+        std::cout << "." << std::endl;
+        threads.clear();
+    }
+
+    void tcpConnector::stop(std::chrono::steady_clock::time_point deadline) {
+        drain_deadline = deadline;
+        if (stopping.exchange(true)) return;
+        // رռ׽ʹ accept 
+        if (serverSocket != INVALID_SOCKET) closesocket(serverSocket);
     }
 
     void tcpConnector::closeServer() {
-        for (auto& th : threads) {
-            if (th.joinable()) {
-                th.join();
+        for (auto& client : threads) {
+            if (client.thread.joinable()) {
+                client.thread.join();
             }
         }
 
-        if (serverSocket != INVALID_SOCKET) {
+        if (serverSocket != INVALID_SOCKET && !stopping) {
             closesocket(serverSocket);
         }
         WSACleanup();
     }
 
-    int tcpConnector::startServer(std::string(*handleFunction)(const std::string&, const std::string&)) {
+    int tcpConnector::startServer(textHandler handleFunction, batchHandler handleBatch) {
         if (!initializeWinsock()) return 1;
         if (!createSocket()) return 1;
         if (!bindSocket()) return 1;
         if (!listenSocket()) return 1;
+        connectionTracker::getInstance().start();
+        trafficCapture::getInstance().start();
 
-        acceptConnections(handleFunction);
+        if (backend == "iocp") {
+            iocpServer server(mtx, log_operations, iocp_threads);
+            {
+                std::unique_lock lock(mtx);
+                std::cout << "[tcpConnector]: Waiting for connections on port " << port << " (iocp backend)...\n";
+            }
+            int result = server.run(serverSocket, handleFunction, handleBatch, stopping);
+            if (stopping) server.drain(drain_deadline);
+            trafficCapture::getInstance().stop();
+            return result;
+        }
+        acceptConnections(handleFunction, handleBatch);
+        if (stopping) drainThreads();
+        trafficCapture::getInstance().stop();
         return 0;
     }
 }
@@ -19,16 +19,147 @@
 #include <winsock2.h>
 #include <ws2tcpip.h>  // For inet_ntop
 #include <shared_mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string_view>
+#include "../esys/messageArena.h"
 #include "../esys/esysControl.h"
+#include "binaryProtocol.h"
+#include "connectionTracker.h"
+#include "trafficCapture.h"
 #pragma comment(lib, "ws2_32.lib")
 
 static constexpr int BUFFER_SIZE = 1024;  ///< Сڽݡ
 
 namespace ems {
 
+    /**
+     * @brief ıЭĴΪͻ IPϢͱϢڴأطͻ˵Ӧ
+     */
+    using textHandler = std::string(*)(const std::string&, std::string_view, messageArena&);
+
+    /**
+     * @brief ЭĴΪκıλͼ
+     */
+    using batchHandler = void(*)(const sensorBatch&, std::vector<uint64_t>&);
+
+    /**
+     * @class clientSession
+     * @brief һ TCP ӵЭ״̬ʹ޹ء
+     *
+     * ÿյһݾ͵ onDataѵõĻظͻˡ
+     * ıЭ鴦еʱԼ messageArena 䣬ÿ onData ʱͷš
+     */
+    class clientSession {
+    public:
+        /**
+         * @brief 캯
+         *
+         * @param mtx ͬ־
+         * @param log_operations Ƿ¼־
+         * @param clientIP ͻ IP ַ
+         * @param handleFunction ָ룬ڴյıЭϢ
+         * @param handleBatch ָ룬ڴЭݡ
+         */
+        clientSession(std::shared_mutex& mtx, bool log_operations, const std::string& clientIP, textHandler handleFunction, batchHandler handleBatch);
+
+        /**
+         * @brief յһݡ
+         *
+         * һеĶϢıЭĶ JSON ЭĶֱ֡
+         * ǵĻظ˳ϲ reply Уɺһη͡
+         *
+         * @param data ݡ
+         * @param length ݳȡ
+         * @param reply ͻ˵ĻظΪա
+         * @return bool Ӧַ trueӦڷͻظرշ false
+         */
+        bool onData(const char* data, int length, std::string& reply);
+
+        /**
+         * @brief ȡͻ IP ַ
+         */
+        const std::string& ip() const { return clientIP; }
+
+        /**
+         * @brief ǷӦͣȡӡ
+         *
+         * дӵʱһ tcp_throttle_rate ͣȡ
+         * ׽ֻУ TCP 豸ͣϱ豸Ӱ졣
+         *
+         * @return bool Ӧͣ true
+         */
+        bool shouldThrottle() const;
+
+        /**
+         * @brief ¼ӽ뿪ͣ״ָ̬ꡣ
+         *
+         * @param paused true ʾͣfalse ʾָȡ
+         */
+        static void setThrottled(bool paused);
+
+        /**
+         * @brief ȡǰͣ״̬
+         */
+        static uint64_t throttledConnections() { return throttled_connections.load(); }
+
+        /**
+         * @brief ȡۼͣӵĴ
+         */
+        static uint64_t throttleEvents() { return throttle_events.load(); }
+
+    private:
+        enum class protocol { UNKNOWN, TEXT, BINARY };
+
+        static constexpr size_t max_text_pending = 4096;   ///< ıЭеȴȫĶֽ
+
+        /**
+         * @brief ıЭһϢĽλá
+         *
+         * @param buffer 
+         * @param begin Ϣʼλãǿհַ
+         * @return size_t Ϣλãвʱ std::string::npos
+         */
+        static size_t messageEnd(const std::string& buffer, size_t begin);
+
+        std::shared_mutex& mtx;                 ///< ͬ־
+        bool log_operations;                    ///< Ƿ¼־
+        std::string clientIP;                   ///< ͻ IP ַ
+        textHandler handleFunction;             ///< ıЭĴ
+        batchHandler handleBatch;               ///< ЭĴ
+        protocol mode = protocol::UNKNOWN;      ///< ӵЭ飬յĵһֽھ
+        std::string pending;                    ///< в֡Э飩 JSON ıЭ飩
+        sensorBatch batch;                      ///< νΡ
+        std::vector<uint32_t> sequences;        ///< ν֡š
+        std::vector<uint64_t> alarm_mask;       ///< εıλͼ
+        std::unique_ptr<messageArena> arena;    ///< ıЭڴأʹỰƶ
+        captureStream capture;                  ///< ץģʽ¼¼յԭʼݡ
+        uint32_t last_sequence = 0;             ///< һ֡š
+        bool has_sequence = false;              ///< Ƿյ֡
+        unsigned int throttle_rate;             ///< ӵʱÿ
+        std::chrono::steady_clock::time_point window_start;     ///< ǰڵĿʼʱ䡣
+        size_t window_readings = 0;             ///< ǰڵ
+        size_t last_window_readings = 0;        ///< һڵ
+
+        static std::atomic<uint64_t> throttled_connections;     ///< ǰͣ״̬
+        static std::atomic<uint64_t> throttle_events;           ///< ۼͣӵĴ
+
+        /**
+         * @brief ۼƱӵڳΪ 1 롣
+         *
+         * @param readings δ
+         */
+        void countReadings(size_t readings);
+    };
+
     /**
      * @class tcpConnector
      * @brief TCPӺݽ
+     *
+     * ÿӸյĵһֽԶѡЭ飺ֽΪ binaryProtocol::magic0 ʱʹöЭ飬
+     * ʹԭеıЭ顣Эͬһ˿ͬʱʹá
+     *  tcp_backend ѡthreads Ϊÿһ̣߳iocp ʹɶ˿ڣ̴߳ӡ
      */
     class tcpConnector {
     public:
@@ -47,18 +178,67 @@ namespace ems {
         /**
          * @brief TCP
          *
-         * @param handleFunction ָ룬ڴյTCPϢ
+         * @param handleFunction ָ룬ڴյıЭϢ
+         * @param handleBatch ָ룬ڴЭݡ
          * @return int ɹ0ʧܷ1
          */
-        int startServer(std::string(*handleFunction)(const std::string&, const std::string&));
+        int startServer(textHandler handleFunction, batchHandler handleBatch);
+
+        /**
+         * @brief ֹͣTCP߳еá
+         *
+         * رռ׽ʹ startServer ֹͣӣжӣÿӴյ
+         * двظرգstartServer  deadline ء
+         *
+         * @param deadline ȴӽĽֹʱ䡣
+         */
+        void stop(std::chrono::steady_clock::time_point deadline);
+
+        /**
+         * @brief תıЭϢ messageHandle ƥֵԡ
+         *
+         * @param data յݡ
+         * @param length ݳȡ
+         * @param message תϢͨʹ messageArena еڴ档
+         */
+        static void escapeMessage(const char* data, size_t length, std::pmr::string& message);
+
+        /**
+         * @brief ȡ׽ֵĶԶ IP ַ
+         *
+         * @param clientSocket ͻ׽֡
+         * @return std::string Զ IP ַʧʱؿַ
+         */
+        static std::string peerAddress(SOCKET clientSocket);
+
+        /**
+         * @brief ӵ׽ѡֺ˽Ӻ󶼻á
+         *
+         * ظѾÿ recv ϲΪһηͣ˹ر Nagle 㷨TCP_NODELAY
+         * ⵥݵĻظӳٵһλظ ACK ֮
+         *
+         * @param clientSocket ͻ׽֡
+         */
+        static void configureClient(SOCKET clientSocket);
 
     private:
         unsigned short port;                            ///< ˿ڡ
+        std::string backend;                            ///< ˣthreads  iocp
+        unsigned int iocp_threads;                      ///< iocp ˵Ĺ߳
         SOCKET serverSocket;                            ///< ׽֡
-        std::vector<std::thread> threads;               ///< ̳߳أڴͻӡ
+        std::atomic<bool> stopping;                     ///< Ƿѵ stop
+        std::chrono::steady_clock::time_point drain_deadline;   ///< ȴӽĽֹʱ䣬 stopping λǰд롣
+        /**
+         * @brief һͻӵ̣߳done ߳̽ǰλ
+         */
+        struct clientThread {
+            std::thread thread;
+            std::shared_ptr<std::atomic<bool>> done;
+        };
+
+        std::vector<clientThread> threads;              ///< ̳߳أڴͻӡ
         std::shared_mutex& mtx;                         ///< ͬ
         bool log_operations;                            ///< Ƿ¼־ı־
-        std::vector<std::string> all_client_ip;         ///< ӵĿͻIPַб
 
         /**
          * @brief ʼWinsock⡣
@@ -91,20 +271,33 @@ namespace ems {
         /**
          * @brief ܿͻӲ߳̽д
          *
-         * @param handleFunction ָ룬ڴյTCPϢ
+         * @param handleFunction ָ룬ڴյıЭϢ
+         * @param handleBatch ָ룬ڴЭݡ
          */
-        void acceptConnections(std::string(*handleFunction)(const std::string&, const std::string&));
+        void acceptConnections(textHandler handleFunction, batchHandler handleBatch);
 
         /**
          * @brief ͻӵĺ
          *
          * @param mtx ͬ
          * @param log_opreations Ƿ¼־ı־
-         * @param all_client_ip ͻIPַб
-         * @param clientSocket ͻ׽֡
-         * @param handleFunction ָ룬ڴյTCPϢ
+         * @param tracked connectionTracker ɵӣͻ׽֡
+         * @param handleFunction ָ룬ڴյıЭϢ
+         * @param handleBatch ָ룬ڴЭݡ
+         * @param done ߳̽ǰλ reapThreads ա
+         */
+        static void handleClient(std::shared_mutex& mtx, bool log_opreations, std::shared_ptr<trackedConnection> tracked, textHandler handleFunction, batchHandler handleBatch,
+            std::shared_ptr<std::atomic<bool>> done);
+
+        /**
+         * @brief ѽ̡߳
+         */
+        void reapThreads();
+
+        /**
+         * @brief ֹͣӺжӣȴֹ߳̽ʱδ̲߳ٵȴ
          */
-        static void handleClient(std::shared_mutex& mtx, bool log_opreations, std::vector<std::string>& all_client_ip, SOCKET clientSocket, std::string(*handleFunction)(const std::string&, const std::string&));
+        void drainThreads();
 
         /**
          * @brief رշ׽ֲԴ
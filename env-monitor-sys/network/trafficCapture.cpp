@@ -0,0 +1,128 @@
+#include "trafficCapture.h"
+#include "../esys/esysControl.h"
+
+namespace ems {
+
+    trafficCapture::trafficCapture() {
+        esysControl& esys = esysControl::getInstance();
+        file_path = esys.getConfig("capture_file");
+        std::string max_mb = esys.getConfig("capture_max_mb");
+        max_bytes = (max_mb.empty() ? 1024ull : std::stoull(max_mb)) << 20;
+    }
+
+    trafficCapture::~trafficCapture() {
+        stop();
+    }
+
+    void trafficCapture::start() {
+        if (file_path.empty()) return;
+        std::lock_guard<std::mutex> lock(mtx);
+        if (running) return;
+
+        std::filesystem::path path(file_path);
+        std::error_code ec;
+        if (path.has_parent_path()) std::filesystem::create_directories(path.parent_path(), ec);
+        file.open(path, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            std::cerr << "[trafficCapture]: Failed to create capture file \"" << file_path << "\"." << std::endl;
+            return;
+        }
+
+        int64_t start_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        captureFormat::putHeader(pending, start_ms);
+        start_time = std::chrono::steady_clock::now();
+        last_us = 0;
+        total_bytes = pending.size();
+        records = dropped = 0;
+        running = true;
+        enabled.store(true, std::memory_order_relaxed);
+        writer = std::thread(&trafficCapture::writerLoop, this);
+        std::cout << "[trafficCapture]: Capturing received TCP traffic to \"" << file_path << "\"." << std::endl;
+    }
+
+    void trafficCapture::stop() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (!running) return;
+            running = false;
+            enabled.store(false, std::memory_order_relaxed);
+        }
+        cv.notify_all();
+        if (writer.joinable()) writer.join();
+        file.close();
+        std::cout << "[trafficCapture]: Captured " << records << " records (" << total_bytes << " bytes), "
+            << dropped << " dropped." << std::endl;
+    }
+
+    uint32_t trafficCapture::open(const std::string& clientIP) {
+        return append(captureRecord::OPEN, 0, clientIP.data(), clientIP.size());
+    }
+
+    void trafficCapture::data(uint32_t connection, const char* data, size_t length) {
+        append(captureRecord::DATA, connection, data, length);
+    }
+
+    void trafficCapture::close(uint32_t connection) {
+        append(captureRecord::CLOSE, connection, nullptr, 0);
+    }
+
+    uint32_t trafficCapture::append(captureRecord type, uint32_t connection, const char* data, size_t length) {
+        std::unique_lock<std::mutex> lock(mtx);
+        if (!running) return 0;
+        // ޺ټ¼ӺݣѼ¼дرգطʱ
+        size_t record_size = length + 16;
+        bool full = (max_bytes != 0 && total_bytes + record_size > max_bytes) || pending.size() + record_size > max_pending;
+        if (full && type != captureRecord::CLOSE) {
+            if (dropped++ == 0) {
+                std::cerr << "[trafficCapture]: Capture limit reached, dropping further records." << std::endl;
+            }
+            return 0;
+        }
+
+        // ʱȡã¼˳ʱ䶼
+        uint64_t now_us = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start_time).count());
+        if (now_us < last_us) now_us = last_us;
+        if (connection == 0) connection = next_connection++;
+        size_t before = pending.size();
+        pending.push_back(static_cast<char>(type));
+        captureFormat::putVarint(pending, now_us - last_us);
+        captureFormat::putVarint(pending, connection);
+        if (type != captureRecord::CLOSE) {
+            captureFormat::putVarint(pending, length);
+            pending.append(data, length);
+        }
+        last_us = now_us;
+        total_bytes += pending.size() - before;
+        ++records;
+        bool wake = pending.size() >= flush_bytes;
+        lock.unlock();
+        if (wake) cv.notify_one();
+        return connection;
+    }
+
+    void trafficCapture::writerLoop() {
+        std::string batch;
+        std::unique_lock<std::mutex> lock(mtx);
+        while (true) {
+            cv.wait_for(lock, std::chrono::seconds(1), [this] { return !running || pending.size() >= flush_bytes; });
+            batch.swap(pending);
+            bool stop = !running;
+            lock.unlock();
+            // дļʱֻ߳׷ӵµĻ
+            if (!batch.empty()) {
+                file.write(batch.data(), static_cast<std::streamsize>(batch.size()));
+                file.flush();
+                if (!file) {
+                    std::cerr << "[trafficCapture]: Failed to write capture file \"" << file_path << "\", capture stopped." << std::endl;
+                    enabled.store(false, std::memory_order_relaxed);
+                }
+                batch.clear();
+            }
+            lock.lock();
+            if (stop && pending.empty()) break;
+        }
+    }
+
+}  // namespace ems
@@ -0,0 +1,189 @@
+/**
+ * @file trafficCapture.h
+ * @author Yilin Wang (yilin233@foxmail.com)
+ * @brief Capture mode of the TCP server, records every received segment with its
+ *  timestamp and connection into a compact binary file for trafficReplay.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2024 Yilin Wang
+ *
+ * MIT License
+ */
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+#include "captureFormat.h"
+
+namespace ems {
+
+    /**
+     * @class trafficCapture
+     * @brief TCP ץ
+     *
+     * capture_file ΪʱáÿӵĽյÿһԭʼݣrecv ķأκν͹ر
+     * ȫ˳׷ӵڴ滺ɺ̨߳дļ̲߳ IO
+     * ļﵽ capture_max_mb 򻺳ѹ max_pending ʱֹͣ¼־б涪ļ¼
+     * ץļ trafficReplay ԭʱN ٻٶطš
+     */
+    class trafficCapture {
+    private:
+        static constexpr size_t flush_bytes = 1 << 20;          ///< ﵽֽʱѺ̨̡߳
+        static constexpr size_t max_pending = 64 << 20;         ///< ѹޣֽڣ
+
+        std::string file_path;                  ///< ץļ·Ϊձʾá
+        uint64_t max_bytes;                     ///< ļСޣֽڣ0 ʾơ
+        std::ofstream file;                     ///< ץļ
+        std::atomic<bool> enabled{ false };     ///< Ƿڼ¼
+
+        std::mutex mtx;                         ///< ³Ա
+        std::condition_variable cv;             ///< ڻѺֹ̨̡ͣ߳
+        std::string pending;                    ///< δдļļ¼
+        std::chrono::steady_clock::time_point start_time;   ///< ץʼʱ䡣
+        uint64_t last_us = 0;                   ///< һ¼ץʼ΢
+        uint32_t next_connection = 1;           ///< һӱš
+        uint64_t total_bytes = 0;               ///< Ѽ¼ֽļͷ
+        uint64_t records = 0;                   ///< Ѽ¼ļ¼
+        uint64_t dropped = 0;                   ///< ﵽ޶ļ¼
+        std::thread writer;                     ///< дļ̡߳
+        bool running = false;                   ///< ̨߳ǷС
+
+        /**
+         * @brief ˽й캯ȡץá
+         */
+        trafficCapture();
+
+        /**
+         * @brief ˽дʣļ¼
+         */
+        ~trafficCapture();
+
+        /**
+         * @brief ɾ캯
+         */
+        trafficCapture(const trafficCapture&) = delete;
+
+        /**
+         * @brief ɾֵ
+         */
+        trafficCapture& operator=(const trafficCapture&) = delete;
+
+        /**
+         * @brief ׷һ¼
+         *
+         * @param type ¼͡
+         * @param connection ӱţΪ 0 ʱһ±š
+         * @param data ¼ݡ
+         * @param length ݵֽ
+         * @return uint32_t ӱţ¼ʱ 0
+         */
+        uint32_t append(captureRecord type, uint32_t connection, const char* data, size_t length);
+
+        /**
+         * @brief ̨߳ѭ
+         */
+        void writerLoop();
+
+    public:
+        /**
+         * @brief ȡtrafficCaptureĵʵ
+         *
+         * @return trafficCapture& ʵá
+         */
+        static trafficCapture& getInstance() {
+            static trafficCapture instance;
+            return instance;
+        }
+
+        /**
+         * @brief  capture_file ʱļʼ¼
+         */
+        void start();
+
+        /**
+         * @brief ֹͣ¼д껺رļ
+         */
+        void stop();
+
+        /**
+         * @brief Ƿڼ¼
+         */
+        bool active() const { return enabled.load(std::memory_order_relaxed); }
+
+        /**
+         * @brief ¼һӡ
+         *
+         * @param clientIP ͻ IP ַ
+         * @return uint32_t ӱţδ¼ʱ 0
+         */
+        uint32_t open(const std::string& clientIP);
+
+        /**
+         * @brief ¼յһݡ
+         */
+        void data(uint32_t connection, const char* data, size_t length);
+
+        /**
+         * @brief ¼ӹرա
+         */
+        void close(uint32_t connection);
+    };
+
+    /**
+     * @class captureStream
+     * @brief һץļеļ¼ clientSession ƶʱ¼ӹرա
+     *
+     * δץʱֻһԭĶȡ
+     */
+    class captureStream {
+    public:
+        captureStream() = default;
+
+        /**
+         * @brief ץʱ¼ӡ
+         *
+         * @param clientIP ͻ IP ַ
+         */
+        explicit captureStream(const std::string& clientIP)
+            : id(trafficCapture::getInstance().active() ? trafficCapture::getInstance().open(clientIP) : 0) {}
+
+        captureStream(captureStream&& other) noexcept : id(other.id) { other.id = 0; }
+
+        captureStream& operator=(captureStream&& other) noexcept {
+            if (this != &other) {
+                finish();
+                id = other.id;
+                other.id = 0;
+            }
+            return *this;
+        }
+
+        captureStream(const captureStream&) = delete;
+        captureStream& operator=(const captureStream&) = delete;
+
+        ~captureStream() { finish(); }
+
+        /**
+         * @brief ¼յһݡ
+         */
+        void record(const char* data, size_t length) const {
+            if (id != 0) trafficCapture::getInstance().data(id, data, length);
+        }
+
+    private:
+        uint32_t id = 0;    ///< ӱţ0 ʾ¼
+
+        void finish() {
+            if (id != 0) trafficCapture::getInstance().close(id);
+            id = 0;
+        }
+    };
+
+}  // namespace ems
@@ -0,0 +1,193 @@
+#include "udpListener.h"
+
+namespace ems {
+
+    static constexpr int DATAGRAM_SIZE = 65536;  // UDP ݱ󳤶
+
+    udpListener::udpListener(std::shared_mutex& mtx) : serverSocket(INVALID_SOCKET), winsock_started(false), running(false), mtx(mtx) {
+        esysControl& esys = esysControl::getInstance();
+        std::string value = esys.getConfig("udp_server_port");
+        port = value.empty() ? 0 : static_cast<unsigned short>(std::stoi(value));
+        value = esys.getConfig("udp_threads");
+        thread_count = value.empty() ? 1 : std::max(1, std::stoi(value));
+        value = esys.getConfig("udp_recv_buffer_bytes");
+        recv_buffer_bytes = value.empty() ? 0 : std::max(0, std::stoi(value));
+        value = esys.getConfig("udp_batch_size");
+        batch_size = value.empty() ? 64 : static_cast<size_t>(std::max(1, std::stoi(value)));
+        log_operations = esys.getConfig("log_operations") == "false" ? false : true;
+    }
+
+    udpListener::~udpListener() {
+        stop();
+        for (auto& th : threads) {
+            if (th.joinable()) {
+                th.join();
+            }
+        }
+        if (serverSocket != INVALID_SOCKET) {
+            closesocket(serverSocket);
+        }
+        if (winsock_started) WSACleanup();
+    }
+
+    bool udpListener::createSocket() {
+        WSADATA wsaData;
+        if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+            std::unique_lock lock(mtx);
+            std::cerr << "[udpListener]: Failed to initialize Winsock" << std::endl;
+            return false;
+        }
+        winsock_started = true;
+
+        serverSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (serverSocket == INVALID_SOCKET) {
+            std::unique_lock lock(mtx);
+            std::cerr << "[udpListener]: Socket creation failed: " << WSAGetLastError() << std::endl;
+            return false;
+        }
+
+        // ͻʱں˻ݴݱµݱ
+        if (recv_buffer_bytes > 0 &&
+            setsockopt(serverSocket, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<const char*>(&recv_buffer_bytes), sizeof(recv_buffer_bytes)) == SOCKET_ERROR) {
+            std::unique_lock lock(mtx);
+            std::cerr << "[udpListener]: Failed to set receive buffer size: " << WSAGetLastError() << std::endl;
+        }
+
+        // ѹرյĶ˿ڻظʱ Windows һ recvfrom  WSAECONNRESETرոΪ
+        BOOL report_reset = FALSE;
+        DWORD bytes_returned = 0;
+        WSAIoctl(serverSocket, SIO_UDP_CONNRESET, &report_reset, sizeof(report_reset), nullptr, 0, &bytes_returned, nullptr, nullptr);
+
+        u_long non_blocking = 1;
+        if (ioctlsocket(serverSocket, FIONBIO, &non_blocking) == SOCKET_ERROR) {
+            std::unique_lock lock(mtx);
+            std::cerr << "[udpListener]: Failed to set non-blocking mode: " << WSAGetLastError() << std::endl;
+            return false;
+        }
+
+        struct sockaddr_in serverAddr;
+        serverAddr.sin_family = AF_INET;
+        serverAddr.sin_addr.s_addr = INADDR_ANY;
+        serverAddr.sin_port = htons(port);
+        if (bind(serverSocket, (struct sockaddr*)&serverAddr, sizeof(serverAddr)) == SOCKET_ERROR) {
+            std::unique_lock lock(mtx);
+            std::cerr << "[udpListener]: Bind failed: " << WSAGetLastError() << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    void udpListener::workerLoop(textHandler handleFunction, batchHandler handleBatch) {
+        std::vector<char> buffer(DATAGRAM_SIZE);
+        sensorBatch batch;
+        std::vector<uint32_t> sequences;
+        std::vector<uint64_t> alarm_mask;
+        std::vector<datagramRows> datagrams;
+        auto arena = std::make_unique<messageArena>();
+        char ipStr[INET_ADDRSTRLEN];
+        const char alarm_reply = static_cast<char>(binaryProtocol::binaryAlarm);
+
+        while (running) {
+            // ȴݿɶʱǷҪ˳
+            fd_set readSet;
+            FD_ZERO(&readSet);
+            FD_SET(serverSocket, &readSet);
+            timeval timeout{ 1, 0 };
+            int ready = select(0, &readSet, nullptr, nullptr, &timeout);
+            if (ready == SOCKET_ERROR) {
+                std::unique_lock lock(mtx);
+                std::cerr << "[udpListener]: Select failed: " << WSAGetLastError() << std::endl;
+                break;
+            }
+            if (ready == 0) continue;
+
+            // ȡѵݱ֡ϲΪһ
+            batch.reset(sensorSchema::getInstance().size(), batch_size);
+            datagrams.clear();
+            for (size_t received = 0; received < batch_size; ++received) {
+                sockaddr_in from;
+                int fromSize = sizeof(from);
+                int bytesRead = recvfrom(serverSocket, buffer.data(), DATAGRAM_SIZE, 0, (struct sockaddr*)&from, &fromSize);
+                if (bytesRead == SOCKET_ERROR) {
+                    int error = WSAGetLastError();
+                    // ߳ȡݣݱWSAEMSGSIZE
+                    if (error == WSAEWOULDBLOCK) break;
+                    if (error != WSAEMSGSIZE && error != WSAECONNRESET) {
+                        std::unique_lock lock(mtx);
+                        std::cerr << "[udpListener]: Receive failed: " << error << std::endl;
+                    }
+                    continue;
+                }
+                if (bytesRead == 0) continue;
+
+                std::string clientIP = inet_ntop(AF_INET, &from.sin_addr, ipStr, INET_ADDRSTRLEN) != nullptr ? ipStr : "";
+                if (binaryProtocol::detect(buffer.data(), bytesRead)) {
+                    // һݱпж֡ܿݱ
+                    datagramRows rows{ from, batch.rows, batch.rows };
+                    std::string error;
+                    sequences.clear();
+                    size_t consumed = binaryProtocol::decode(buffer.data(), bytesRead, clientIP, batch, sequences, error);
+                    rows.end_row = batch.rows;
+                    if (rows.end_row > rows.first_row) datagrams.push_back(rows);
+                    if (error.empty() && consumed < static_cast<size_t>(bytesRead)) error = "truncated frame";
+                    if (!error.empty() && log_operations) {
+                        std::unique_lock lock(mtx);
+                        std::cerr << "[udpListener]: [" + clientIP + "] Invalid binary datagram: " + error + "." << std::endl;
+                    }
+                }
+                else {
+                    {
+                        std::pmr::string message(arena->resource());
+                        tcpConnector::escapeMessage(buffer.data(), bytesRead, message);
+                        if (log_operations) {
+                            std::unique_lock lock(mtx);
+                            std::cout << "[udpListener]: [" << clientIP << "] Received message: \"" << message << "\"" << std::endl;
+                        }
+                        // ֻбе豸Ҫظ
+                        std::string response = handleFunction(clientIP, message, *arena);
+                        if (response == "alarm_active") {
+                            sendto(serverSocket, response.c_str(), static_cast<int>(response.length()), 0, (struct sockaddr*)&from, sizeof(from));
+                        }
+                    }
+                    arena->reset();
+                }
+            }
+
+            if (batch.rows == 0) continue;
+            handleBatch(batch, alarm_mask);
+            for (const datagramRows& rows : datagrams) {
+                for (size_t row = rows.first_row; row < rows.end_row; ++row) {
+                    if (alarm_mask[row >> 6] >> (row & 63) & 1) {
+                        sendto(serverSocket, &alarm_reply, 1, 0, (const struct sockaddr*)&rows.from, sizeof(rows.from));
+                    }
+                }
+            }
+        }
+    }
+
+    void udpListener::stop() {
+        running = false;
+    }
+
+    int udpListener::startServer(textHandler handleFunction, batchHandler handleBatch) {
+        if (!enabled()) return 0;
+        if (!createSocket()) return 1;
+
+        {
+            std::unique_lock lock(mtx);
+            std::cout << "[udpListener]: Waiting for datagrams on port " << port << " with " << thread_count << " thread(s)...\n";
+        }
+
+        running = true;
+        for (unsigned int i = 0; i < thread_count; ++i) {
+            threads.emplace_back(&udpListener::workerLoop, this, handleFunction, handleBatch);
+        }
+        for (auto& th : threads) {
+            if (th.joinable()) {
+                th.join();
+            }
+        }
+        return 0;
+    }
+
+}  // namespace ems
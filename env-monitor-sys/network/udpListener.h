@@ -0,0 +1,110 @@
+/**
+ * @file udpListener.h
+ * @author Yilin Wang (yilin233@foxmail.com)
+ * @brief UDP datagram ingest for fire-and-forget sensors, drains datagrams in
+ *  batches and feeds them into the same pipeline as the TCP server.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2024 Yilin Wang
+ *
+ * MIT License
+ */
+
+#pragma once
+
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <mstcpip.h>  // For SIO_UDP_CONNRESET
+#include <shared_mutex>
+#include "tcpConnector.h"
+#pragma comment(lib, "ws2_32.lib")
+
+namespace ems {
+
+    /**
+     * @class udpListener
+     * @brief UDP ݽ
+     *
+     * ÿݱһıЭϢһЭ֡ tcpConnector ʹͬĴ
+     * ׽Ϊģʽ̵߳ȵݿɶ recvfrom ֱûݻﵽ udp_batch_size
+     * һȡж֡ΪһδUDP ֤ʹֻдڱе豸Żյظ
+     * ̹߳ͬһ׽֣ϵͳ֮߳ݱ
+     */
+    class udpListener {
+    public:
+        /**
+         * @brief 캯ȡ UDP á
+         *
+         * @param mtx ͬ־
+         */
+        udpListener(std::shared_mutex& mtx);
+
+        /**
+         * @brief ֹ̲ͣ߳ر׽֡
+         */
+        ~udpListener();
+
+        /**
+         * @brief Ƿ UDP ˿ڡ
+         *
+         * @return bool ˷ true
+         */
+        bool enabled() const { return port != 0; }
+
+        /**
+         * @brief  UDP ֱй߳˳
+         *
+         * @param handleFunction ָ룬ڴıЭϢ
+         * @param handleBatch ָ룬ڴЭݡ
+         * @return int ɹ0ʧܷ1
+         */
+        int startServer(textHandler handleFunction, batchHandler handleBatch);
+
+        /**
+         * @brief ֪ͨ߳˳
+         */
+        void stop();
+
+    private:
+        /**
+         * @brief һݱжӦУδݴ˻ظ
+         */
+        struct datagramRows {
+            sockaddr_in from;                   ///< ͷַ
+            size_t first_row;                   ///< һС
+            size_t end_row;                     ///< һ֮
+        };
+
+        unsigned short port;                    ///< ˿ڣ0 ʾá
+        unsigned int thread_count;              ///< ߳
+        int recv_buffer_bytes;                  ///< ׽ֽջСSO_RCVBUF0 ʾʹϵͳĬֵ
+        size_t batch_size;                      ///< ÿȡݱ
+        SOCKET serverSocket;                    ///< UDP ׽֡
+        bool winsock_started;                   ///< Ƿѵ WSAStartup
+        std::vector<std::thread> threads;       ///< ̡߳
+        std::atomic<bool> running;              ///< ߳ǷӦС
+        std::shared_mutex& mtx;                 ///< ͬ־
+        bool log_operations;                    ///< Ƿ¼־
+
+        /**
+         * @brief ò UDP ׽֡
+         *
+         * @return bool ɹtrueʧܷfalse
+         */
+        bool createSocket();
+
+        /**
+         * @brief ߳ѭ
+         *
+         * @param handleFunction ָ룬ڴıЭϢ
+         * @param handleBatch ָ룬ڴЭݡ
+         */
+        void workerLoop(textHandler handleFunction, batchHandler handleBatch);
+    };
+
+}  // namespace ems
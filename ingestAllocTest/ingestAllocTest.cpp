@@ -0,0 +1,203 @@
+﻿#include <iostream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstdlib>
+#include <cstdio>
+#include <new>
+#include "../env-monitor-sys/esys/esysControl.h"
+#include "../env-monitor-sys/esys/alarmModule.h"
+#include "../env-monitor-sys/esys/deviceRegistry.h"
+#include "../env-monitor-sys/esys/sensorRecord.h"
+#include "../env-monitor-sys/db/dbTools.h"
+#include "../env-monitor-sys/db/dbWriter.h"
+
+using namespace ems;
+
+// 全局堆分配计数，只统计 counting 为 true 的线程，写入器等后台线程的分配不计入
+static std::atomic<uint64_t> allocations{ 0 };
+static thread_local bool counting = false;
+
+static void* countedAlloc(size_t size) {
+    if (counting) allocations.fetch_add(1, std::memory_order_relaxed);
+    void* p = std::malloc(size == 0 ? 1 : size);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+static void* countedAlignedAlloc(size_t size, std::align_val_t align) {
+    if (counting) allocations.fetch_add(1, std::memory_order_relaxed);
+    size_t alignment = static_cast<size_t>(align);
+#ifdef _MSC_VER
+    void* p = _aligned_malloc(size == 0 ? 1 : size, alignment);
+#else
+    void* p = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+#endif
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+static void alignedFree(void* p) {
+#ifdef _MSC_VER
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+
+void* operator new(size_t size) { return countedAlloc(size); }
+void* operator new[](size_t size) { return countedAlloc(size); }
+void* operator new(size_t size, std::align_val_t align) { return countedAlignedAlloc(size, align); }
+void* operator new[](size_t size, std::align_val_t align) { return countedAlignedAlloc(size, align); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { alignedFree(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { alignedFree(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { alignedFree(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { alignedFree(p); }
+
+// 测试用的设备和数据
+static const size_t device_count = 16;      // 设备数
+static const size_t variant_count = 64;     // 每个设备轮流发送的不同数据条数
+static const size_t batch_rows = 256;       // 每批二进制数据的行数
+
+static std::vector<std::string> devices;
+static std::vector<std::string> messages;   // 转义后的文本消息，与 tcpConnector 交给处理函数的形式相同
+
+// 第 n 条数据的采集值，在报警阈值以下小幅波动，不触发报警状态的变化
+static double temperatureOf(size_t n) { return 20 + static_cast<double>(n % 7) * 0.5; }
+static double humidityOf(size_t n) { return 30 + static_cast<double>(n % 5); }
+static double smokeOf(size_t n) { return 300 + static_cast<double>(n % 11); }
+
+static void prepareData() {
+    char buffer[128];
+    for (size_t d = 0; d < device_count; ++d) {
+        std::snprintf(buffer, sizeof(buffer), "192.168.1.%zu", 100 + d);
+        devices.emplace_back(buffer);
+    }
+    for (size_t n = 0; n < variant_count; ++n) {
+        std::snprintf(buffer, sizeof(buffer), "[\\\"temperatureVal\\\":%.2f, \\\"humidityVal\\\":%.2f, \\\"smokeVal\\\":%.0f]",
+            temperatureOf(n), humidityOf(n), smokeOf(n));
+        messages.emplace_back(buffer);
+    }
+}
+
+// 经文本消息处理路径送入 count 条数据，返回回复不是 "ack" 的条数
+static size_t sendText(size_t count, size_t offset, messageArena& arena) {
+    size_t unexpected = 0;
+    for (size_t n = 0; n < count; ++n) {
+        size_t i = offset + n;
+        std::string reply = esysControl::getInstance().messageHandle(devices[i % device_count], messages[(i / device_count) % variant_count], arena);
+        arena.reset();
+        if (reply != "ack") ++unexpected;
+        // 每写满一批等写入器处理完，队列不会因为测试发送过快而满
+        if ((i + 1) % 200 == 0) {
+            bool was_counting = counting;
+            counting = false;
+            dbWriter::getInstance().flush(10000);
+            counting = was_counting;
+        }
+    }
+    return unexpected;
+}
+
+// 构造一批二进制数据，每行的设备和采集值与文本消息相同
+static void buildBatch(sensorBatch& batch, size_t offset) {
+    const sensorSchema& schema = sensorSchema::getInstance();
+    batch.reset(schema.size(), batch_rows);
+    int temperature = schema.idOf("temperature");
+    int humidity = schema.idOf("humidity");
+    int smoke = schema.idOf("smoke");
+    for (size_t n = 0; n < batch_rows; ++n) {
+        size_t i = offset + n;
+        size_t row = batch.addRow(devices[i % device_count]);
+        size_t variant = (i / device_count) % variant_count;
+        if (temperature >= 0) batch.column(temperature)[row] = temperatureOf(variant);
+        if (humidity >= 0) batch.column(humidity)[row] = humidityOf(variant);
+        if (smoke >= 0) batch.column(smoke)[row] = smokeOf(variant);
+    }
+}
+
+// 经二进制批处理路径送入一批数据，之后等写入器处理完
+static ingestSummary sendBatch(const sensorBatch& batch, std::vector<uint64_t>& alarm_mask) {
+    ingestSummary summary = esysControl::getInstance().ingestBatch(batch, alarm_mask);
+    bool was_counting = counting;
+    counting = false;
+    dbWriter::getInstance().flush(10000);
+    counting = was_counting;
+    return summary;
+}
+
+int main() {
+    // 与 sysRun 相同的初始化顺序，数据库使用 configs/esys.conf 中配置的内存替身
+    esysControl::getInstance();
+    dbTools::getInstance();
+    dbWriter& writer = dbWriter::getInstance();
+    writer.start();
+    deviceRegistry::getInstance();
+    sensorSchema::getInstance();
+    alarmModule::getInstance();
+    prepareData();
+
+    static messageArena arena;
+    int failures = 0;
+
+    // 预热：登记设备、建立报警状态机和滑动窗口，并让写入队列的每个槽位都至少使用过一次
+    size_t slots = std::stoul(esysControl::getInstance().getConfig("writer_queue_capacity")) +
+        std::stoul(esysControl::getInstance().getConfig("writer_batch_rows"));
+    size_t warmup = 3 * slots;
+    if (sendText(warmup, 0, arena) != 0) {
+        std::cerr << "预热时收到了非 ack 的回复" << std::endl;
+        failures++;
+    }
+
+    // 文本消息：解析、入队、更新最新数据、报警判断
+    const size_t text_readings = 10000;
+    allocations = 0;
+    counting = true;
+    size_t unexpected = sendText(text_readings, warmup, arena);
+    counting = false;
+    uint64_t text_allocations = allocations.load();
+    std::cout << "文本消息: " << text_readings << " 条数据, " << text_allocations << " 次堆分配" << std::endl;
+    if (unexpected != 0) {
+        std::cerr << "文本消息: " << unexpected << " 条回复不是 ack" << std::endl;
+        failures++;
+    }
+    if (text_allocations != 0) failures++;
+
+    // 二进制批处理：同一条流水线按批进行报警判断
+    sensorBatch batch;
+    std::vector<uint64_t> alarm_mask;
+    alarm_mask.reserve(batch_rows / 64 + 1);
+    size_t offset = warmup + text_readings;
+    for (size_t round = 0; round < slots / batch_rows + 2; ++round, offset += batch_rows) {
+        buildBatch(batch, offset);
+        sendBatch(batch, alarm_mask);
+    }
+    const size_t batch_rounds = 40;
+    uint64_t batch_allocations = 0;
+    size_t unstored = 0, active = 0;
+    for (size_t round = 0; round < batch_rounds; ++round, offset += batch_rows) {
+        buildBatch(batch, offset);
+        allocations = 0;
+        counting = true;
+        ingestSummary summary = sendBatch(batch, alarm_mask);
+        counting = false;
+        unstored += summary.rows - summary.stored;
+        active += summary.alarm_rows;
+        batch_allocations += allocations.load();
+    }
+    std::cout << "二进制批处理: " << batch_rounds * batch_rows << " 条数据, " << batch_allocations << " 次堆分配" << std::endl;
+    if (unstored != 0 || active != 0) {
+        std::cerr << "二进制批处理: " << unstored << " 行未入队, " << active << " 行处于报警中" << std::endl;
+        failures++;
+    }
+    if (batch_allocations != 0) failures++;
+
+    writer.flush(10000);
+    writer.stop();
+    std::cout << (failures == 0 ? "通过" : "失败") << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,292 @@
+﻿#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <climits>
+#include <winsock2.h> // Windows Sockets API
+#include <ws2tcpip.h>
+#include <mmsystem.h> // timeBeginPeriod
+#include "../env-monitor-sys/network/captureFormat.h"
+
+// 链接到 ws2_32.lib 和 winmm.lib 库
+#pragma comment(lib, "ws2_32.lib")
+#pragma comment(lib, "winmm.lib")
+
+using namespace ems;
+using steady = std::chrono::steady_clock;
+
+// 重放参数
+struct replayOptions {
+    std::string capture_file;           // 抓包文件，由服务器的 capture_file 配置生成
+    std::string host = "127.0.0.1";     // 服务器地址
+    int port = 8080;                    // 服务器端口
+    double speed = 1;                   // 重放倍速，0 表示不等待，以最快速度发送
+    size_t fanout = 1;                  // 每个抓到的连接重放的份数
+    size_t threads = 8;                 // 发送线程数
+    bool spread = true;                 // 服务器在本机时，每个设备从不同的 127.x.y.z 地址连接
+};
+
+// 一个重放连接
+struct replayConnection {
+    std::string source_ip;              // 绑定的源地址，为空表示不绑定
+    SOCKET sock = INVALID_SOCKET;       // 套接字
+    bool closed = false;                // 是否已按抓包关闭
+};
+
+// 一条待发送的记录
+struct replayEvent {
+    uint64_t time_us;                   // 距抓包开始的微秒数
+    size_t connection;                  // 重放连接的下标
+    captureRecord type;                 // 记录类型
+    const std::string* payload;         // 数据
+};
+
+// 单个发送线程的统计
+struct replayStats {
+    uint64_t connections = 0;           // 建立的连接数
+    uint64_t connect_failures = 0;      // 连接失败数
+    uint64_t messages = 0;              // 发送的数据段数
+    uint64_t bytes = 0;                 // 发送的字节数
+    uint64_t reply_bytes = 0;           // 收到的回复字节数
+    uint64_t send_failures = 0;         // 发送失败的数据段数
+    int64_t max_lag_us = 0;             // 实际发送时间落后于计划时间的最大值
+};
+
+// 第 n 个设备使用的本机回环地址，从 127.0.0.2 开始
+std::string loopbackAddress(size_t n) {
+    n += 2;
+    return "127." + std::to_string((n >> 16) & 0xFF) + "." + std::to_string((n >> 8) & 0xFF) + "." + std::to_string(n & 0xFF);
+}
+
+// 取出已到达的回复，避免服务器因发送缓冲区满而阻塞
+void drainReplies(replayConnection& conn, replayStats& stats) {
+    char buffer[4096];
+    while (true) {
+        int received = recv(conn.sock, buffer, static_cast<int>(sizeof(buffer)), 0);
+        if (received <= 0) return;
+        stats.reply_bytes += received;
+    }
+}
+
+// 建立连接，连接后改为非阻塞模式
+bool openConnection(replayConnection& conn, const sockaddr_in& server, replayStats& stats) {
+    conn.sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (conn.sock == INVALID_SOCKET) return false;
+    BOOL no_delay = TRUE;
+    setsockopt(conn.sock, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&no_delay), sizeof(no_delay));
+    if (!conn.source_ip.empty()) {
+        sockaddr_in source = {};
+        source.sin_family = AF_INET;
+        inet_pton(AF_INET, conn.source_ip.c_str(), &source.sin_addr);
+        bind(conn.sock, reinterpret_cast<const sockaddr*>(&source), sizeof(source));
+    }
+    if (connect(conn.sock, reinterpret_cast<const sockaddr*>(&server), sizeof(server)) == SOCKET_ERROR) {
+        closesocket(conn.sock);
+        conn.sock = INVALID_SOCKET;
+        return false;
+    }
+    u_long non_blocking = 1;
+    ioctlsocket(conn.sock, FIONBIO, &non_blocking);
+    stats.connections++;
+    return true;
+}
+
+// 发送一段数据，发送缓冲区满时先取出回复再等待可写
+bool sendAll(replayConnection& conn, const std::string& data, replayStats& stats) {
+    const char* p = data.data();
+    size_t length = data.size();
+    while (length > 0) {
+        int sent = send(conn.sock, p, static_cast<int>(std::min<size_t>(length, INT_MAX)), 0);
+        if (sent > 0) {
+            p += sent;
+            length -= sent;
+            continue;
+        }
+        if (WSAGetLastError() != WSAEWOULDBLOCK) return false;
+        drainReplies(conn, stats);
+        fd_set writable;
+        FD_ZERO(&writable);
+        FD_SET(conn.sock, &writable);
+        timeval timeout = { 0, 10000 };
+        select(0, nullptr, &writable, nullptr, &timeout);
+    }
+    drainReplies(conn, stats);
+    return true;
+}
+
+void closeConnection(replayConnection& conn, replayStats& stats) {
+    if (conn.sock == INVALID_SOCKET) return;
+    drainReplies(conn, stats);
+    shutdown(conn.sock, SD_SEND);
+    closesocket(conn.sock);
+    conn.sock = INVALID_SOCKET;
+}
+
+// 发送线程：按全局顺序处理分配给自己的连接的记录
+void replayWorker(const std::vector<replayEvent>& events, std::vector<replayConnection>& connections, const sockaddr_in& server,
+    double speed, steady::time_point start, replayStats& stats) {
+    for (const replayEvent& event : events) {
+        if (speed > 0) {
+            auto target = start + std::chrono::microseconds(static_cast<int64_t>(event.time_us / speed));
+            std::this_thread::sleep_until(target);
+            int64_t lag = std::chrono::duration_cast<std::chrono::microseconds>(steady::now() - target).count();
+            stats.max_lag_us = std::max(stats.max_lag_us, lag);
+        }
+        replayConnection& conn = connections[event.connection];
+        if (conn.closed) continue;
+        switch (event.type) {
+        case captureRecord::OPEN:
+            if (!openConnection(conn, server, stats)) stats.connect_failures++;
+            break;
+        case captureRecord::DATA:
+            // 抓包时连接已存在（如超过上限后又有空间）时在第一次发送前建立连接
+            if (conn.sock == INVALID_SOCKET && !openConnection(conn, server, stats)) {
+                stats.connect_failures++;
+                conn.closed = true;
+                break;
+            }
+            stats.messages++;
+            stats.bytes += event.payload->size();
+            if (!sendAll(conn, *event.payload, stats)) {
+                stats.send_failures++;
+                closeConnection(conn, stats);
+                conn.closed = true;
+            }
+            break;
+        case captureRecord::CLOSE:
+            closeConnection(conn, stats);
+            conn.closed = true;
+            break;
+        }
+    }
+    for (size_t i = 0; i < connections.size(); ++i) {
+        if (connections[i].sock != INVALID_SOCKET) closeConnection(connections[i], stats);
+    }
+}
+
+void printUsage() {
+    std::cout << "用法: trafficReplay <抓包文件> [--host 127.0.0.1] [--port 8080] [--speed 1 | --max] [--fanout 1] [--threads 8] [--no-spread]\n"
+        << "  --speed N    按 N 倍速重放，1 为原速\n"
+        << "  --max        不等待，以最快速度重放\n"
+        << "  --fanout K   每个抓到的连接重放 K 份，模拟 K 倍的设备数\n"
+        << "  --threads T  发送线程数\n"
+        << "  --no-spread  服务器在本机时也不为每个设备绑定不同的 127.x.y.z 源地址" << std::endl;
+}
+
+bool parseOptions(int argc, char* argv[], replayOptions& options) {
+    if (argc < 2) return false;
+    options.capture_file = argv[1];
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--host" && has_value) options.host = argv[++i];
+        else if (arg == "--port" && has_value) options.port = std::stoi(argv[++i]);
+        else if (arg == "--speed" && has_value) options.speed = std::stod(argv[++i]);
+        else if (arg == "--max") options.speed = 0;
+        else if (arg == "--fanout" && has_value) options.fanout = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--threads" && has_value) options.threads = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--no-spread") options.spread = false;
+        else return false;
+    }
+    if (options.host.compare(0, 4, "127") != 0) options.spread = false;
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    replayOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage();
+        return 1;
+    }
+
+    // 读取抓包文件
+    std::vector<captureEvent> captured;
+    int64_t capture_start_ms = 0;
+    std::string error;
+    if (!captureFormat::readFile(options.capture_file, captured, capture_start_ms, error)) {
+        std::cerr << "读取抓包文件失败: " << error << std::endl;
+        return 1;
+    }
+    if (captured.empty()) {
+        std::cerr << "抓包文件中没有记录" << std::endl;
+        return 1;
+    }
+
+    // 每个抓到的连接展开为 fanout 个重放连接，同一设备的连接使用同一个源地址
+    std::vector<replayConnection> connections;
+    std::unordered_map<uint32_t, size_t> first_copy;        // 抓包中的连接编号 -> 第一份重放连接的下标
+    std::unordered_map<std::string, size_t> device_index;   // 抓包中的客户端 IP -> 设备序号
+    std::vector<std::vector<replayEvent>> worker_events(options.threads);
+    size_t data_records = 0;
+    for (const captureEvent& event : captured) {
+        auto found = first_copy.find(event.connection);
+        if (found == first_copy.end()) {
+            const std::string& clientIP = event.type == captureRecord::OPEN ? event.payload : std::string();
+            size_t device = device_index.try_emplace(clientIP, device_index.size()).first->second;
+            found = first_copy.emplace(event.connection, connections.size()).first;
+            for (size_t copy = 0; copy < options.fanout; ++copy) {
+                replayConnection conn;
+                if (options.spread) conn.source_ip = loopbackAddress(device * options.fanout + copy);
+                connections.push_back(conn);
+            }
+        }
+        if (event.type == captureRecord::DATA) data_records++;
+        for (size_t copy = 0; copy < options.fanout; ++copy) {
+            size_t index = found->second + copy;
+            worker_events[index % options.threads].push_back({ event.time_us, index, event.type, &event.payload });
+        }
+    }
+    double capture_seconds = captured.back().time_us / 1e6;
+    std::cout << "抓包包含 " << first_copy.size() << " 个连接（" << device_index.size() << " 个设备）、"
+        << data_records << " 段数据，时长 " << capture_seconds << " s" << std::endl;
+
+    // 初始化WinSock
+    WSADATA wsaData;
+    int result = WSAStartup(MAKEWORD(2, 2), &wsaData);
+    if (result != 0) {
+        std::cerr << "WSAStartup失败: " << result << std::endl;
+        return 1;
+    }
+    timeBeginPeriod(1);  // 提高 sleep 的精度
+
+    sockaddr_in server_address = {};
+    server_address.sin_family = AF_INET;
+    server_address.sin_port = htons(static_cast<u_short>(options.port));
+    inet_pton(AF_INET, options.host.c_str(), &server_address.sin_addr);
+
+    // 所有线程使用同一个起点，记录之间的间隔按倍速缩放
+    std::vector<replayStats> stats(options.threads);
+    std::vector<std::thread> workers;
+    auto start = steady::now() + std::chrono::milliseconds(100);
+    for (size_t i = 0; i < options.threads; ++i) {
+        workers.emplace_back(replayWorker, std::cref(worker_events[i]), std::ref(connections), std::cref(server_address),
+            options.speed, start, std::ref(stats[i]));
+    }
+    for (auto& worker : workers) worker.join();
+    double elapsed = std::chrono::duration<double>(steady::now() - start).count();
+
+    timeEndPeriod(1);
+    WSACleanup();
+
+    replayStats total;
+    for (const replayStats& s : stats) {
+        total.connections += s.connections;
+        total.connect_failures += s.connect_failures;
+        total.messages += s.messages;
+        total.bytes += s.bytes;
+        total.reply_bytes += s.reply_bytes;
+        total.send_failures += s.send_failures;
+        total.max_lag_us = std::max(total.max_lag_us, s.max_lag_us);
+    }
+    std::cout << "重放完成: " << (options.speed > 0 ? std::to_string(options.speed) + " 倍速" : std::string("最快速度"))
+        << "，用时 " << elapsed << " s\n"
+        << "  连接 " << total.connections << "，连接失败 " << total.connect_failures << "\n"
+        << "  发送 " << total.messages << " 段、" << total.bytes << " 字节，发送失败 " << total.send_failures << "\n"
+        << "  吞吐 " << (elapsed > 0 ? total.messages / elapsed : 0) << " 段/s、" << (elapsed > 0 ? total.bytes / elapsed / 1048576 : 0) << " MB/s\n"
+        << "  收到回复 " << total.reply_bytes << " 字节\n"
+        << "  最大调度延迟 " << total.max_lag_us / 1000.0 << " ms" << std::endl;
+    return total.connect_failures + total.send_failures > 0 ? 2 : 0;
+}
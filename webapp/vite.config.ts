@@ -1,12 +1,51 @@
 import { fileURLToPath, URL } from 'node:url'
+import { readdirSync, readFileSync, statSync, writeFileSync } from 'node:fs'
+import { join } from 'node:path'
+import { brotliCompressSync, constants, gzipSync } from 'node:zlib'
 
-import { defineConfig } from 'vite'
+import { defineConfig, type Plugin } from 'vite'
 import vue from '@vitejs/plugin-vue'
 
+// 构建完成后为文本资源生成 .gz 和 .br 预压缩版本，由 env-monitor-sys 的静态文件缓存直接提供
+function precompress(): Plugin {
+  let outDir = 'dist'
+  const compressible = /\.(js|mjs|css|html|svg|json|xml|txt)$/
+  const walk = (dir: string): string[] =>
+    readdirSync(dir).flatMap((name) => {
+      const path = join(dir, name)
+      return statSync(path).isDirectory() ? walk(path) : [path]
+    })
+  return {
+    name: 'precompress',
+    apply: 'build',
+    configResolved(config) {
+      outDir = config.build.outDir
+    },
+    closeBundle() {
+      for (const file of walk(outDir)) {
+        if (!compressible.test(file)) continue
+        const content = readFileSync(file)
+        if (content.length < 1024) continue
+        const gzip = gzipSync(content, { level: 9 })
+        const brotli = brotliCompressSync(content, {
+          params: {
+            [constants.BROTLI_PARAM_QUALITY]: constants.BROTLI_MAX_QUALITY,
+            [constants.BROTLI_PARAM_SIZE_HINT]: content.length
+          }
+        })
+        // 压缩后没有变小的版本不生成
+        if (gzip.length < content.length) writeFileSync(`${file}.gz`, gzip)
+        if (brotli.length < content.length) writeFileSync(`${file}.br`, brotli)
+      }
+    }
+  }
+}
+
 // https://vitejs.dev/config/
 export default defineConfig({
   plugins: [
     vue(),
+    precompress(),
   ],
   resolve: {
     alias: {